@@ -5,8 +5,9 @@
 # 1. Install PlatformIO: pip install platformio
 # 2. Run this script from the software/ directory
 #
-# This will generate the firmware .hex file at:
-#   .pio/build/T41_ILI9341/firmware.hex
+# Builds every environment (or only those given as arguments), as CI does,
+# and generates the firmware .hex files at:
+#   .pio/build/<env>/firmware.hex
 
 set -e
 
@@ -25,10 +26,19 @@ fi
 echo "PlatformIO found: $(pio --version)"
 echo ""
 
-# Build for Teensy 4.1 with ILI9341
-echo "Building firmware for Teensy 4.1 with ILI9341 display..."
-echo ""
-pio run -e T41_ILI9341
+# ILI9341, SH1106 OLED, and both displays at once
+if [ $# -gt 0 ]; then
+    envs=("$@")
+else
+    envs=(T41_ILI9341 T41_SH1106 T41_MIRROR)
+fi
+
+for env in "${envs[@]}"; do
+    echo "Building firmware for Teensy 4.1: $env..."
+    echo ""
+    pio run -e "$env"
+    echo ""
+done
 
 echo ""
 echo "=================================================="
@@ -36,8 +46,10 @@ echo "Build Complete!"
 echo "=================================================="
 echo ""
 echo "Firmware files generated:"
-echo "  HEX: .pio/build/T41_ILI9341/firmware.hex"
-echo "  ELF: .pio/build/T41_ILI9341/firmware.elf"
+for env in "${envs[@]}"; do
+    echo "  HEX: .pio/build/$env/firmware.hex"
+    echo "  ELF: .pio/build/$env/firmware.elf"
+done
 echo ""
 echo "To upload to Teensy 4.1:"
 echo "  pio run -e T41_ILI9341 -t upload"
@@ -0,0 +1,10 @@
+# cxx_flags.py - C++-only compiler flags for platformio.ini (extra_scripts)
+#
+# build_flags also reach the C files of the Teensy core, where C++ options
+# draw a warning for every file. C++20 is for coroutines (OC_coro.h).
+# Register updates such as `REG |= bit` are deprecated on volatiles in C++20,
+# but are all over the core library, hence -Wno-volatile.
+
+Import("env")
+
+env.Append(CXXFLAGS=["-std=gnu++20", "-Wno-volatile"])
@@ -15,6 +15,17 @@
 
 #include <Arduino.h>
 #include "src/drivers/display.h"
+#include "src/OC_clock.h"
+#include "src/OC_core.h"
+#include "src/OC_coro.h"
+#include "src/OC_debug.h"
+#include "src/OC_events.h"
+#include "src/OC_memory.h"
+#include "src/OC_mirror.h"
+#include "src/OC_panel.h"
+#include "src/OC_player.h"
+#include "src/OC_preset.h"
+#include "src/OC_trace.h"
 
 // Version information
 #define OC_VERSION_MAJOR 1
@@ -33,12 +44,61 @@ void loop();
 static uint32_t last_redraw = 0;
 static const uint32_t REDRAW_INTERVAL_MS = 33; // ~30 FPS
 
-// Animation state
-static int frame_count = 0;
-static int ball_x = 64;
-static int ball_y = 32;
-static int ball_dx = 2;
-static int ball_dy = 1;
+// Animation state, allocated from the applet arena
+struct DemoApplet {
+  int frame_count;
+  int ball_x;
+  int ball_y;
+  int ball_dx;
+  int ball_dy;
+};
+static DemoApplet *demo = nullptr;
+
+// A ring drawn where the ball was when a trigger came in; they come and go
+// with the clock, so they live in a pool
+struct Ripple {
+  Ripple *next;
+  int x;
+  int y;
+  int radius;
+};
+static const int RIPPLE_MAX_RADIUS = 12;
+static util::Pool<Ripple, 4> ripple_pool;
+static Ripple *ripples = nullptr;
+
+// Title band colors on color displays (RGB565): the title turns from
+// white to amber once the clock input locks
+static const uint8_t TITLE_PALETTE = 1;
+static const uint16_t TITLE_BG = 0x0010;       // Dark blue
+static const uint16_t TITLE_FG = 0xFFFF;       // White
+static const uint16_t TITLE_FG_LOCKED = 0xFD20; // Amber
+
+// Latest event from the ISRs, shown on the demo screen
+static OC::EVENTS::Event last_event;
+static bool have_event = false;
+
+static void HandleEvents() {
+  OC::EVENTS::Event events[16];
+  size_t count;
+  while ((count = OC::EVENTS::Drain(events, 16)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      const OC::EVENTS::Event &event = events[i];
+      if (event.type == OC::EVENTS::EVENT_CLOCK_LOCK)
+        display::SetPalette(TITLE_PALETTE, event.value ? TITLE_FG_LOCKED : TITLE_FG, TITLE_BG);
+      // With all rings still growing, the trigger gets none
+      if (event.type == OC::EVENTS::EVENT_TRIGGER) {
+        Ripple *ripple = ripple_pool.New(Ripple{ripples, demo->ball_x, demo->ball_y, 1});
+        if (ripple)
+          ripples = ripple;
+      }
+      // Triggers would hide everything else at audio-rate clocks
+      if (event.type != OC::EVENTS::EVENT_TRIGGER) {
+        last_event = event;
+        have_event = true;
+      }
+    }
+  }
+}
 
 void setup() {
   // Initialize serial for debugging
@@ -48,30 +108,63 @@ void setup() {
   Serial.println("O_C Phazerville - ILI9341 Display");
   Serial.println("Initializing...");
   
+  // Applet state before anything posts events that use it
+  OC::MEMORY::Init();
+  OC::MEMORY::SwitchApplet();
+  demo = OC::MEMORY::arena().New<DemoApplet>(DemoApplet{0, 64, 32, 2, 1});
+  ripple_pool.Init();
+  OC::MEMORY::RegisterPool("ripples", &ripple_pool.stats());
+
+  // Before the drivers, which start their power-up sequences as tasks
+  OC::CORO::Init();
+  OC::MEMORY::RegisterPool("coroutines", &OC::CORO::frame_stats());
+
   // Initialize display subsystem
   display::Init();
+  display::SetPalette(TITLE_PALETTE, TITLE_FG, TITLE_BG);
+  display::SetPaletteRegion(8, 0, 112, 24, TITLE_PALETTE);
+  OC::MIRROR::Init();
+  OC::PANEL::Init();
   
   Serial.println("Display initialized");
+
+  // Initialize DAC outputs, clock engine, presets and core timer
+  OC::CORE::Init();
+
+  Serial.println("Core initialized");
   Serial.println("Starting main loop...");
 }
 
 void loop() {
   uint32_t now = millis();
+  HandleEvents();
   
   // Redraw at fixed interval
   if (now - last_redraw >= REDRAW_INTERVAL_MS) {
     last_redraw = now;
-    frame_count++;
+    demo->frame_count++;
     
     // Update ball position
-    ball_x += ball_dx;
-    ball_y += ball_dy;
+    demo->ball_x += demo->ball_dx;
+    demo->ball_y += demo->ball_dy;
     
     // Bounce off walls
-    if (ball_x <= 4 || ball_x >= 123) ball_dx = -ball_dx;
-    if (ball_y <= 4 || ball_y >= 59) ball_dy = -ball_dy;
+    if (demo->ball_x <= 4 || demo->ball_x >= 123) demo->ball_dx = -demo->ball_dx;
+    if (demo->ball_y <= 4 || demo->ball_y >= 59) demo->ball_dy = -demo->ball_dy;
+
+    // Grow the ripples and return the finished ones to the pool
+    for (Ripple **link = &ripples; *link;) {
+      Ripple *ripple = *link;
+      if (++ripple->radius > RIPPLE_MAX_RADIUS) {
+        *link = ripple->next;
+        ripple_pool.Delete(ripple);
+      } else {
+        link = &ripple->next;
+      }
+    }
     
     // Begin frame
+    OC::TRACE::Begin(OC::TRACE::EVENT_UI_RENDER);
     GRAPHICS_BEGIN_FRAME(true);
     
     // Draw border
@@ -80,13 +173,28 @@ void loop() {
     // Draw title
     graphics.drawStr(20, 2, "O_C Phazerville");
     graphics.drawStr(28, 12, "ILI9341 Demo");
+
+    // Draw latest event with its value (the note for notes)
+    if (have_event) {
+      graphics.setPrintPos(2, 34);
+      graphics.printf("%s %u", OC::EVENTS::type_name(last_event.type), last_event.value & 0x7F);
+    }
+
+    // Draw clock tempo
+    graphics.setPrintPos(2, 44);
+    if (OC::CLOCK::locked())
+      graphics.printf("Clock: %.1f BPM", OC::CLOCK::bpm());
+    else
+      graphics.print("Clock: ---");
     
     // Draw animated ball
-    graphics.drawCircle(ball_x, ball_y, 4);
+    graphics.drawCircle(demo->ball_x, demo->ball_y, 4);
+    for (const Ripple *ripple = ripples; ripple; ripple = ripple->next)
+      graphics.drawCircle(ripple->x, ripple->y, ripple->radius);
     
     // Draw frame counter
     graphics.setPrintPos(2, 54);
-    graphics.printf("Frame: %d", frame_count);
+    graphics.printf("Frame: %d", demo->frame_count);
     
     // Draw version info
     graphics.setPrintPos(70, 54);
@@ -95,12 +203,21 @@ void loop() {
       OC_VERSION_EXTRA);
     
     GRAPHICS_END_FRAME();
+    OC::TRACE::End(OC::TRACE::EVENT_UI_RENDER);
     
     // Update display
     display::Update();
     display::Flush();
   }
   
-  // Handle display updates
+  // Handle display updates. Flush releases a frame once all its pages are
+  // out, so it isn't presented again and the bus can go idle.
+  display::Flush();
   display::Update();
+  OC::PANEL::Update();
+
+  OC::CORO::Poll();
+  OC::PLAYER::Poll();
+  OC::PRESET::Poll();
+  OC::DEBUG::Poll();
 }
@@ -0,0 +1,283 @@
+// OC_DAC.cpp - CV/gate output engine implementation
+
+#include <Arduino.h>
+#include "OC_DAC.h"
+#include "util/util_dither.h"
+#include "util/util_ringbuffer.h"
+
+namespace OC {
+
+/*static*/ volatile uint16_t DAC::values_[DAC::kNumChannels];
+/*static*/ volatile uint32_t DAC::fine_[DAC::kNumChannels];
+/*static*/ uint32_t DAC::dirty_;
+/*static*/ DAC::ChannelStats DAC::stats_[DAC::kNumChannels];
+/*static*/ volatile uint32_t DAC::audio_mask_;
+
+static_assert(DAC::kNumChannels <= 32, "Channel masks are 32 bits");
+
+static constexpr uint8_t kRateClasses[] = {
+  DAC::RATE_FULL, DAC::RATE_HALF, DAC::RATE_QUARTER, DAC::RATE_SLOW, DAC::RATE_CONTROL
+};
+
+static uint8_t rate_shift[DAC::kNumChannels];
+static uint32_t last_write[DAC::kNumChannels];
+static uint32_t class_mask[sizeof(kRateClasses)];
+static uint32_t round_robin[sizeof(kRateClasses)];
+static size_t write_budget;
+static uint32_t stats_start_tick;
+static uint32_t last_tick;
+
+static uint32_t dither_mask;
+static uint32_t second_order_mask;
+static util::SigmaDelta modulators[DAC::kNumChannels];
+static_assert(DAC::kFineBits == util::SigmaDelta::kFracBits, "Fine value format mismatch");
+static uint16_t written[DAC::kNumChannels];
+
+static uint8_t device_bus[DAC8568_Driver::kNumDevices];
+static uint32_t bus_mask;
+
+// CV words from the core ISR to the sample ISR while audio mode is active.
+// The DAC ignores the top four (prefix) bits, they carry the device here.
+static constexpr uint32_t kDeviceShift = 28;
+static util::RingBuffer<uint32_t, 16> cv_words;
+
+static inline void WriteCVWord(uint32_t word) {
+  DAC8568_Driver::WriteWord(word >> kDeviceShift, word & ((1UL << kDeviceShift) - 1));
+}
+
+static void UpdateClassMasks() {
+  for (size_t i = 0; i < sizeof(kRateClasses); ++i) {
+    uint32_t mask = 0;
+    for (size_t channel = 0; channel < DAC::kNumChannels; ++channel) {
+      if (rate_shift[channel] == kRateClasses[i])
+        mask |= 1UL << channel;
+    }
+    class_mask[i] = mask;
+  }
+}
+
+/*static*/
+void DAC::Init() {
+  DAC8568_Driver::Init();
+  for (size_t channel = 0; channel < kNumChannels; ++channel) {
+    values_[channel] = 0;
+    fine_[channel] = 0;
+    written[channel] = 0;
+    modulators[channel].Init();
+    rate_shift[channel] = RATE_FULL;
+    last_write[channel] = 0 - (uint32_t(1) << RATE_CONTROL);
+  }
+  UpdateClassMasks();
+  bus_mask = 0;
+  for (size_t device = 0; device < DAC8568_Driver::kNumDevices; ++device) {
+    device_bus[device] = DAC8568_Driver::bus(device);
+    bus_mask |= 1UL << device_bus[device];
+  }
+  write_budget = kDefaultWriteBudget;
+  dither_mask = second_order_mask = 0;
+  audio_mask_ = 0;
+  cv_words.Init();
+  dirty_ = (1UL << kNumChannels) - 1;
+  ResetStats();
+}
+
+/*static*/
+void FASTRUN DAC::Update(uint32_t tick) {
+  last_tick = tick;
+  // Values stay dirty until the DACs are powered up
+  if (!DAC8568_Driver::ready())
+    return;
+  const uint32_t audio_mask = audio_mask_;
+  uint32_t dirty = __atomic_load_n(&dirty_, __ATOMIC_ACQUIRE) & ~audio_mask;
+  uint32_t active = dirty | (dither_mask & ~audio_mask);
+  if (!active)
+    return;
+
+  uint32_t due = 0;
+  for (uint32_t pending = active; pending; pending &= pending - 1) {
+    size_t channel = __builtin_ctz(pending);
+    // Unsigned elapsed time, so a channel idle for days is never held back
+    // for more than one period after the tick counter wraps
+    if (tick - last_write[channel] >= (1UL << rate_shift[channel]))
+      due |= 1UL << channel;
+  }
+
+  // Budget per bus; in audio mode everything goes through the FIFO instead
+  size_t bus_budget[DAC8568_Driver::kNumBuses];
+  size_t budget = 0;
+  for (size_t bus = 0; bus < DAC8568_Driver::kNumBuses; ++bus) {
+    bus_budget[bus] = (bus_mask & (1UL << bus)) ? write_budget : 0;
+    budget += bus_budget[bus];
+  }
+  if (audio_mask && cv_words.writable() < budget)
+    budget = cv_words.writable();
+
+  uint32_t words[DAC8568_Driver::kNumDevices][DAC8568_Driver::kChannelsPerDevice];
+  size_t num_words[DAC8568_Driver::kNumDevices] = { 0 };
+  for (size_t i = 0; i < sizeof(kRateClasses) && budget; ++i) {
+    uint32_t candidates = due & class_mask[i];
+
+    // Start after the channel served last in this class. A channel skipped
+    // because its bus is out of budget goes first next time, so devices
+    // sharing a bus take turns.
+    const uint32_t start = round_robin[i];
+    bool skipped = false;
+    for (size_t k = 1; k <= kNumChannels && candidates && budget; ++k) {
+      size_t channel = (start + k) % kNumChannels;
+      uint32_t bit = 1UL << channel;
+      if (!(candidates & bit))
+        continue;
+      candidates &= ~bit;
+      size_t device = channel / DAC8568_Driver::kChannelsPerDevice;
+      size_t &remaining = bus_budget[device_bus[device]];
+      if (!remaining) {
+        if (!skipped)
+          round_robin[i] = (channel + kNumChannels - 1) % kNumChannels;
+        skipped = true;
+        continue;
+      }
+      due &= ~bit;
+
+      // Clear first: a set() racing with the write marks it dirty again
+      __atomic_fetch_and(&dirty_, ~bit, __ATOMIC_ACQUIRE);
+      uint16_t value = values_[channel];
+      if (dither_mask & bit) {
+        uint32_t fine = fine_[channel];
+        value = (second_order_mask & bit)
+            ? modulators[channel].SecondOrder(fine)
+            : modulators[channel].FirstOrder(fine);
+        // Holding the same code needs no bus time
+        if (value == written[channel] && !(dirty & bit)) {
+          last_write[channel] = tick;
+          continue;
+        }
+      }
+
+      uint32_t word = DAC8568_Driver::Pack(DAC8568_Driver::CMD_WRITE_UPDATE,
+                                           channel % DAC8568_Driver::kChannelsPerDevice, value);
+      if (audio_mask)
+        cv_words.Write(word | (device << kDeviceShift));
+      else
+        words[device][num_words[device]++] = word;
+      written[channel] = value;
+      last_write[channel] = tick;
+      ++stats_[channel].writes;
+      if (!skipped)
+        round_robin[i] = channel;
+      --remaining;
+      --budget;
+    }
+  }
+
+  // Interleave the devices: each round writes one word per device, and
+  // devices on separate buses transfer concurrently
+  for (size_t round = 0; round < DAC8568_Driver::kChannelsPerDevice; ++round) {
+    uint32_t round_words[DAC8568_Driver::kNumDevices];
+    uint32_t device_mask = 0;
+    for (size_t device = 0; device < DAC8568_Driver::kNumDevices; ++device) {
+      if (num_words[device] > round) {
+        round_words[device] = words[device][round];
+        device_mask |= 1UL << device;
+      }
+    }
+    if (!device_mask)
+      break;
+    DAC8568_Driver::WriteParallel(round_words, device_mask);
+  }
+
+  // Anything still due has to wait for the next tick
+  for (; due; due &= due - 1)
+    ++stats_[__builtin_ctz(due)].deferred;
+}
+
+/*static*/
+void DAC::StartAudio(uint32_t audio_mask) {
+  noInterrupts();
+  cv_words.Init();
+  audio_mask_ = audio_mask;
+  interrupts();
+}
+
+/*static*/
+void DAC::StopAudio() {
+  // The sample ISR has stopped, so whatever it didn't get to is written here
+  noInterrupts();
+  uint32_t word;
+  while (cv_words.Read(word))
+    WriteCVWord(word);
+  // Restore the CV values of the former audio channels
+  __atomic_fetch_or(&dirty_, audio_mask_, __ATOMIC_RELEASE);
+  audio_mask_ = 0;
+  interrupts();
+}
+
+/*static*/
+void FASTRUN DAC::DrainCV(size_t max_words) {
+  uint32_t word;
+  while (max_words-- && cv_words.Read(word))
+    WriteCVWord(word);
+}
+
+/*static*/
+void DAC::set_rate(size_t channel, RateClass rate) {
+  if (channel >= kNumChannels)
+    return;
+  noInterrupts();
+  rate_shift[channel] = rate;
+  UpdateClassMasks();
+  interrupts();
+}
+
+/*static*/
+DAC::RateClass DAC::rate(size_t channel) {
+  return static_cast<RateClass>(rate_shift[channel]);
+}
+
+/*static*/
+void DAC::set_dither(size_t channel, DitherMode mode) {
+  if (channel >= kNumChannels)
+    return;
+  uint32_t bit = 1UL << channel;
+  noInterrupts();
+  modulators[channel].Init();
+  dither_mask = mode != DITHER_OFF ? dither_mask | bit : dither_mask & ~bit;
+  second_order_mask = mode == DITHER_SECOND_ORDER ? second_order_mask | bit : second_order_mask & ~bit;
+  // Leaving dither mode settles on the plain code
+  __atomic_fetch_or(&dirty_, bit, __ATOMIC_RELEASE);
+  interrupts();
+}
+
+/*static*/
+DAC::DitherMode DAC::dither(size_t channel) {
+  uint32_t bit = 1UL << channel;
+  if (!(dither_mask & bit))
+    return DITHER_OFF;
+  return (second_order_mask & bit) ? DITHER_SECOND_ORDER : DITHER_FIRST_ORDER;
+}
+
+/*static*/
+void DAC::set_write_budget(size_t writes_per_bus) {
+  write_budget = writes_per_bus ? writes_per_bus : 1;
+}
+
+/*static*/
+DAC::ChannelStats DAC::channel_stats(size_t channel) {
+  return stats_[channel];
+}
+
+/*static*/
+uint32_t DAC::stats_ticks() {
+  return last_tick - stats_start_tick;
+}
+
+/*static*/
+void DAC::ResetStats() {
+  noInterrupts();
+  for (auto &stats : stats_)
+    stats = { 0, 0, 0 };
+  stats_start_tick = last_tick;
+  interrupts();
+  DAC8568_Driver::ResetStats();
+}
+
+}; // namespace OC
@@ -0,0 +1,143 @@
+// OC_DAC.h - CV/gate output engine
+//
+// Channel values can be set from any context; the core ISR writes changed
+// channels to the DAC8568(s) via DAC::Update(). With several DACs, channel n
+// is on device n / 8 (see DAC8568_driver.h).
+//
+// Each channel has a rate class that limits how often it is written, and the
+// number of SPI words per tick on each bus is bounded by a write budget. Due
+// channels are served fastest class first (round-robin within a class), so
+// fast channels get the bus bandwidth that slow ones don't need. A value that
+// is replaced before it could be written counts as a dropped update.
+//
+// Words for different devices are interleaved, so devices on separate buses
+// are written concurrently and the tick budget scales with the buses.
+//
+// A channel can also carry a 24-bit (16.8) value with set_fine(). With a
+// dither mode enabled, the fraction is carried across updates by a
+// sigma-delta requantizer (util/util_dither.h) so that the averaged output
+// resolves below one 16-bit step; such channels are re-evaluated at their
+// rate class even when the value hasn't changed.
+//
+// In audio mode (see OC_audio.h) the sample-rate ISR owns the DAC buses: it
+// writes the audio channels every sample, and Update() hands the words for
+// the remaining channels to it through a small FIFO instead of writing them.
+
+#ifndef OC_DAC_H_
+#define OC_DAC_H_
+
+#include <stdint.h>
+#include "drivers/DAC8568_driver.h"
+
+namespace OC {
+
+class DAC {
+public:
+  static constexpr size_t kNumChannels = DAC8568_Driver::kNumChannels;
+  static constexpr uint16_t kMaxValue = 0xFFFF;
+
+  // Gate levels; full scale is 5V with VDD as reference
+  static constexpr uint16_t kGateLow = 0;
+  static constexpr uint16_t kGateHigh = kMaxValue;
+
+  // Channel is written at most every 2^n core ticks
+  enum RateClass : uint8_t {
+    RATE_FULL = 0,     // 16.7 kHz, gates and fast modulation
+    RATE_HALF = 1,     // 8.3 kHz
+    RATE_QUARTER = 2,  // 4.2 kHz
+    RATE_SLOW = 4,     // 1 kHz, LFOs and envelopes
+    RATE_CONTROL = 6,  // 260 Hz, pitch and static CVs
+  };
+
+  // Words per bus per tick; the default allows every channel each tick
+  static constexpr size_t kDefaultWriteBudget = kNumChannels;
+
+  enum DitherMode : uint8_t {
+    DITHER_OFF,
+    DITHER_FIRST_ORDER,
+    DITHER_SECOND_ORDER,
+  };
+
+  // Fractional bits below the DAC code carried by set_fine()
+  static constexpr int kFineBits = 8;
+
+  struct ChannelStats {
+    uint32_t writes;
+    uint32_t dropped;   // Values replaced before being written
+    uint32_t deferred;  // Ticks a due channel waited for bus budget
+  };
+
+  static void Init();
+
+  static inline void set(size_t channel, uint16_t value) {
+    if (channel < kNumChannels) {
+      values_[channel] = value;
+      fine_[channel] = static_cast<uint32_t>(value) << kFineBits;
+      uint32_t bit = 1UL << channel;
+      if (__atomic_fetch_or(&dirty_, bit, __ATOMIC_RELEASE) & bit)
+        ++stats_[channel].dropped;
+    }
+  }
+
+  // Set a 16.8 fixed-point value; the fraction is only heard with dither
+  static inline void set_fine(size_t channel, uint32_t value) {
+    if (channel < kNumChannels) {
+      fine_[channel] = value;
+      values_[channel] = value >> kFineBits;
+      uint32_t bit = 1UL << channel;
+      if (__atomic_fetch_or(&dirty_, bit, __ATOMIC_RELEASE) & bit)
+        ++stats_[channel].dropped;
+    }
+  }
+
+  static inline void set_gate(size_t channel, bool high) {
+    set(channel, high ? kGateHigh : kGateLow);
+  }
+
+  static inline uint16_t value(size_t channel) {
+    return values_[channel];
+  }
+
+  static void set_rate(size_t channel, RateClass rate);
+  static RateClass rate(size_t channel);
+  static void set_dither(size_t channel, DitherMode mode);
+  static DitherMode dither(size_t channel);
+  static void set_write_budget(size_t writes_per_bus);
+
+  // Write due channel values within the budget; called from the core ISR
+  static void Update(uint32_t tick);
+
+  // Audio mode; channels in `audio_mask` are skipped by Update()
+  static void StartAudio(uint32_t audio_mask);
+  static void StopAudio();
+  static inline uint32_t audio_mask() {
+    return audio_mask_;
+  }
+
+  // Write an audio sample; sample ISR only
+  static inline void WriteAudio(size_t channel, uint16_t value) {
+    DAC8568_Driver::WriteChannel(channel, value);
+  }
+
+  // Write up to `max_words` pending CV words; sample ISR only
+  static void DrainCV(size_t max_words);
+
+  static ChannelStats channel_stats(size_t channel);
+  static inline DAC8568_Driver::DeviceStats device_stats(size_t device) {
+    return DAC8568_Driver::stats(device);
+  }
+  // Ticks since the last ResetStats(), to turn counts into rates
+  static uint32_t stats_ticks();
+  static void ResetStats();
+
+private:
+  static volatile uint16_t values_[kNumChannels];
+  static volatile uint32_t fine_[kNumChannels];
+  static uint32_t dirty_;
+  static ChannelStats stats_[kNumChannels];
+  static volatile uint32_t audio_mask_;
+};
+
+}; // namespace OC
+
+#endif // OC_DAC_H_
@@ -0,0 +1,184 @@
+// OC_audio.cpp - Audio-rate DAC output implementation
+
+#include <Arduino.h>
+#include "OC_audio.h"
+#include "OC_DAC.h"
+#include "OC_events.h"
+#include "OC_trace.h"
+
+namespace OC {
+namespace AUDIO {
+
+util::RunningStats render_cycles;
+util::RunningStats sample_cycles;
+
+static IntervalTimer sample_timer;
+static bool running_ = false;
+static uint32_t sample_rate_ = SAMPLE_RATE_48K;
+static uint8_t channels_[kMaxChannels];
+static size_t num_channels_ = 0;
+
+static util::Oscillator oscillators[kMaxChannels];
+static RenderFn render_fn = nullptr;
+
+// Blocks [read_block, write_block) are ready; the sample ISR advances
+// read_block, the render ISR advances write_block.
+static uint16_t blocks[kNumBlocks][kBlockSize * kMaxChannels];
+static volatile uint32_t read_block;
+static volatile uint32_t write_block;
+static size_t frame_pos;
+static uint16_t frame[kMaxChannels];
+
+static uint32_t blocks_played;
+static uint32_t underruns;
+static uint32_t min_depth;
+static bool starved;
+
+static void RenderOscillators(uint16_t *frames, size_t num_channels, size_t num_frames) {
+  for (size_t i = 0; i < num_channels; ++i)
+    oscillators[i].Render(frames + i, num_channels, num_frames);
+}
+
+static void AUDIO_render_ISR() {
+  RenderFn render = render_fn ? render_fn : RenderOscillators;
+  while (write_block - read_block < kNumBlocks) {
+    uint32_t start = ARM_DWT_CYCCNT;
+    TRACE::Begin(TRACE::EVENT_AUDIO_RENDER);
+    render(blocks[write_block % kNumBlocks], num_channels_, kBlockSize);
+    TRACE::End(TRACE::EVENT_AUDIO_RENDER);
+    render_cycles.Push(ARM_DWT_CYCCNT - start);
+    write_block = write_block + 1;
+  }
+}
+
+static void FASTRUN AUDIO_sample_ISR() {
+  uint32_t start = ARM_DWT_CYCCNT;
+
+  uint32_t block = read_block;
+  if (block != write_block) {
+    const uint16_t *src = &blocks[block % kNumBlocks][frame_pos * num_channels_];
+    for (size_t i = 0; i < num_channels_; ++i)
+      frame[i] = src[i];
+    if (++frame_pos == kBlockSize) {
+      frame_pos = 0;
+      read_block = ++block;
+      ++blocks_played;
+      uint32_t depth = write_block - block;
+      if (depth < min_depth)
+        min_depth = depth;
+      NVIC_SET_PENDING(IRQ_SOFTWARE);
+    }
+    starved = false;
+  } else {
+    ++underruns;
+    if (!starved)
+      EVENTS::Post(EVENTS::EVENT_UNDERRUN, EVENTS::SOURCE_AUDIO);
+    starved = true;
+  }
+
+  for (size_t i = 0; i < num_channels_; ++i)
+    DAC::WriteAudio(channels_[i], frame[i]);
+  DAC::DrainCV(kCVWordsPerSample);
+
+  sample_cycles.Push(ARM_DWT_CYCCNT - start);
+}
+
+void Init() {
+  for (auto &oscillator : oscillators)
+    oscillator.Init(sample_rate_);
+  oscillators[1].set_frequency(220.f);
+
+  attachInterruptVector(IRQ_SOFTWARE, AUDIO_render_ISR);
+  NVIC_SET_PRIORITY(IRQ_SOFTWARE, kRenderPriority);
+  NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
+  ResetStats();
+}
+
+bool Start(SampleRate rate, const uint8_t *channels, size_t num_channels) {
+  if (!num_channels || num_channels > kMaxChannels)
+    return false;
+  uint32_t mask = 0;
+  for (size_t i = 0; i < num_channels; ++i) {
+    if (channels[i] >= DAC::kNumChannels)
+      return false;
+    mask |= 1UL << channels[i];
+  }
+
+  if (running_)
+    Stop();
+
+  sample_rate_ = rate;
+  for (auto &oscillator : oscillators)
+    oscillator.set_sample_rate(rate);
+  for (size_t i = 0; i < num_channels; ++i) {
+    channels_[i] = channels[i];
+    frame[i] = DAC::value(channels[i]);
+  }
+  num_channels_ = num_channels;
+  read_block = write_block = 0;
+  frame_pos = 0;
+  starved = false;
+  ResetStats();
+
+  // Fill the queue before the first sample (runs as soon as it's pended)
+  NVIC_SET_PENDING(IRQ_SOFTWARE);
+
+  DAC::StartAudio(mask);
+  sample_timer.priority(kSamplePriority);
+  running_ = sample_timer.begin(AUDIO_sample_ISR, 1000000.f / static_cast<uint32_t>(rate));
+  if (!running_)
+    DAC::StopAudio();
+  return running_;
+}
+
+void Stop() {
+  if (!running_)
+    return;
+  sample_timer.end();
+  running_ = false;
+  DAC::StopAudio();
+}
+
+bool running() {
+  return running_;
+}
+
+uint32_t sample_rate() {
+  return sample_rate_;
+}
+
+size_t num_channels() {
+  return running_ ? num_channels_ : 0;
+}
+
+uint8_t channel(size_t index) {
+  return channels_[index];
+}
+
+void set_render(RenderFn render) {
+  render_fn = render;
+}
+
+util::Oscillator &oscillator(size_t index) {
+  return oscillators[index];
+}
+
+size_t depth() {
+  return write_block - read_block;
+}
+
+Stats stats() {
+  return { blocks_played, underruns, min_depth };
+}
+
+void ResetStats() {
+  noInterrupts();
+  render_cycles.Reset();
+  sample_cycles.Reset();
+  blocks_played = underruns = 0;
+  min_depth = kNumBlocks;
+  interrupts();
+}
+
+}; // namespace AUDIO
+}; // namespace OC
@@ -0,0 +1,75 @@
+// OC_audio.h - Audio-rate DAC output
+//
+// Dedicates one or two DAC channels to audio-rate output at 32 or 48 kHz.
+// Samples are rendered in blocks by a low-priority software interrupt into a
+// short queue, and a sample-rate timer ISR writes one frame per period. The
+// remaining channels keep running at CV rates through the core tick (see
+// DAC::StartAudio).
+//
+// /SYNC is a plain GPIO, so every DAC word needs the CPU to frame it; the
+// sample ISR writes the frame itself rather than streaming it by DMA.
+
+#ifndef OC_AUDIO_H_
+#define OC_AUDIO_H_
+
+#include <stdint.h>
+#include "util/util_oscillator.h"
+#include "util/util_stats.h"
+
+namespace OC {
+namespace AUDIO {
+
+static constexpr size_t kMaxChannels = 2;
+static constexpr size_t kBlockSize = 128;
+static constexpr size_t kNumBlocks = 4;
+
+// CV words written after each audio frame; at 48 kHz this is ~2.9 words per
+// core tick, which DAC::Update() budgets for.
+static constexpr size_t kCVWordsPerSample = 1;
+
+// Sample ISR preempts the core tick, rendering runs below it
+static constexpr uint8_t kSamplePriority = 32;
+static constexpr uint8_t kRenderPriority = 208;
+
+enum SampleRate : uint32_t {
+  SAMPLE_RATE_32K = 32000,
+  SAMPLE_RATE_48K = 48000,
+};
+
+// Fill `num_frames` interleaved frames of `num_channels` DAC codes
+typedef void (*RenderFn)(uint16_t *frames, size_t num_channels, size_t num_frames);
+
+struct Stats {
+  uint32_t blocks;     // Blocks played
+  uint32_t underruns;  // Samples that repeated the last frame for lack of a block
+  uint32_t min_depth;  // Fewest queued blocks seen at a block boundary
+};
+
+// Render time per block and sample ISR time, in cycles
+extern util::RunningStats render_cycles;
+extern util::RunningStats sample_cycles;
+
+void Init();
+
+// Start output on `num_channels` DAC channels; restarts if already running.
+bool Start(SampleRate rate, const uint8_t *channels, size_t num_channels);
+void Stop();
+
+bool running();
+uint32_t sample_rate();
+size_t num_channels();
+uint8_t channel(size_t index);
+
+// Replace the block renderer; nullptr restores the built-in oscillators
+void set_render(RenderFn render);
+util::Oscillator &oscillator(size_t index);
+
+// Blocks ready to play
+size_t depth();
+Stats stats();
+void ResetStats();
+
+}; // namespace AUDIO
+}; // namespace OC
+
+#endif // OC_AUDIO_H_
@@ -0,0 +1,219 @@
+// OC_clock.cpp - Clock input tracking and clock outputs implementation
+
+#include <Arduino.h>
+#include "OC_clock.h"
+#include "OC_core.h"
+#include "OC_DAC.h"
+#include "OC_events.h"
+#include "OC_output_queue.h"
+#include "util/util_ringbuffer.h"
+
+namespace OC {
+namespace CLOCK {
+
+// Loop gains for a clock from a module: fairly fast lock, moderate smoothing
+static constexpr uint8_t kInputPhaseShift = 2;
+static constexpr uint8_t kInputFreqShift = 4;
+
+// MIDI clock arrives with USB/host jitter of up to a millisecond at 24 PPQN,
+// so a much narrower loop is used. Relock only on jumps of half a period.
+static constexpr uint32_t kMidiPPQN = 24;
+static constexpr uint8_t kMidiPhaseShift = 5;
+static constexpr uint8_t kMidiFreqShift = 10;
+static constexpr uint8_t kMidiRelockShift = 1;
+
+// Song position pointer counts sixteenths
+static constexpr uint32_t kMidiClocksPerSixteenth = kMidiPPQN / 4;
+
+static util::RingBuffer<uint32_t, 8> input_edges;
+static util::ClockTracker input_tracker;
+static util::ClockTracker midi_tracker_;
+static Engine engine_;
+static const util::ClockTracker *source;
+
+static bool locked_;
+static bool midi_running_;
+static int64_t midi_position;  // Pulse number of the next MIDI clock
+
+static int output_channels[kNumOutputs];
+// Ticks left of a pulse whose fall couldn't be queued
+static uint32_t pulse_ticks[kNumOutputs];
+static uint32_t pulse_width_ticks;
+
+static void FASTRUN clock_input_ISR() {
+  uint32_t now = ARM_DWT_CYCCNT;
+  input_edges.Write(now);
+  EVENTS::Post(EVENTS::EVENT_TRIGGER, 0);
+}
+
+void Init() {
+  input_edges.Init();
+  input_tracker.Init(1, kInputPhaseShift, kInputFreqShift);
+  midi_tracker_.Init(kMidiPPQN, kMidiPhaseShift, kMidiFreqShift, kMidiRelockShift);
+  source = &input_tracker;
+  engine_.Init(source);
+  locked_ = false;
+  // Until the first stop, follow MIDI clock even without a start message
+  midi_running_ = true;
+  midi_position = 0;
+
+  for (size_t i = 0; i < kNumOutputs; ++i) {
+    output_channels[i] = -1;
+    pulse_ticks[i] = 0;
+  }
+  set_pulse_width(kDefaultPulseWidthUs);
+
+  // Default: clock thru and x4 on the last two channels
+  set_output(0, 6, 1, 1);
+  set_output(1, 7, 4, 1);
+
+  pinMode(CLOCK_IN_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(CLOCK_IN_PIN), clock_input_ISR, CLOCK_IN_EDGE);
+}
+
+void FASTRUN Tick(int64_t now) {
+  uint32_t edge;
+  while (input_edges.Read(edge))
+    input_tracker.Edge(CORE::extend_cycles(edge));
+  input_tracker.Update(now);
+  midi_tracker_.Update(now);
+
+  // MIDI clock takes precedence while it is being received
+  const util::ClockTracker *active = midi_tracker_.locked() ? &midi_tracker_ : &input_tracker;
+  if (active != source) {
+    source = active;
+    engine_.set_source(source);
+  }
+  if (source->locked() != locked_) {
+    locked_ = source->locked();
+    EVENTS::Post(EVENTS::EVENT_CLOCK_LOCK, 0, locked_);
+  }
+
+  uint32_t edges = 0;
+  if (source->cued() || (source == &midi_tracker_ && !midi_running_))
+    engine_.Sync();
+  else
+    edges = engine_.Process(now, CORE::kCyclesPerTick);
+
+  for (size_t i = 0; i < kNumOutputs; ++i) {
+    int channel = output_channels[i];
+    if (channel < 0)
+      continue;
+
+    if (edges & (1UL << i)) {
+      // Cap the pulse at half the output period so fast multiples keep a gap
+      uint32_t width = pulse_width_ticks;
+      uint32_t half_period = engine_.output_period(i) / (2 * CORE::kCyclesPerTick);
+      if (width > half_period) width = half_period;
+      if (!width) width = 1;
+      // The fall is scheduled for its tick, so it is counted down here only
+      // if the output queue is full
+      pulse_ticks[i] = OutputQueue::PostGate(CORE::ticks + width, channel, false) ? 0 : width;
+      DAC::set_gate(channel, true);
+    } else if (pulse_ticks[i] && !--pulse_ticks[i]) {
+      DAC::set_gate(channel, false);
+    }
+  }
+}
+
+void set_output(size_t output, int channel, int32_t num, int32_t den) {
+  if (output >= kNumOutputs)
+    return;
+  if (channel >= static_cast<int>(DAC::kNumChannels))
+    channel = -1;
+
+  noInterrupts();
+  int previous = output_channels[output];
+  output_channels[output] = channel;
+  pulse_ticks[output] = 0;
+  engine_.set_ratio(output, num, den);
+  engine_.enable(output, channel >= 0);
+  interrupts();
+
+  if (previous >= 0 && previous != channel)
+    DAC::set_gate(previous, false);
+}
+
+int output_channel(size_t output) {
+  return output < kNumOutputs ? output_channels[output] : -1;
+}
+
+uint32_t pulse_width() {
+  return pulse_width_ticks * CORE::kTickUs;
+}
+
+void set_pulse_width(uint32_t us) {
+  pulse_width_ticks = us / CORE::kTickUs;
+}
+
+void FASTRUN MidiClock(uint32_t cycles) {
+  midi_tracker_.Edge(CORE::extend_cycles(cycles));
+  if (midi_running_)
+    ++midi_position;
+}
+
+void MidiStart() {
+  midi_position = 0;
+  midi_tracker_.Cue(0);
+  midi_running_ = true;
+  EVENTS::Post(EVENTS::EVENT_TRANSPORT, 0, EVENTS::TRANSPORT_START);
+}
+
+void MidiContinue() {
+  midi_tracker_.Cue(midi_position);
+  midi_running_ = true;
+  EVENTS::Post(EVENTS::EVENT_TRANSPORT, 0, EVENTS::TRANSPORT_CONTINUE);
+}
+
+void MidiStop() {
+  midi_running_ = false;
+  EVENTS::Post(EVENTS::EVENT_TRANSPORT, 0, EVENTS::TRANSPORT_STOP);
+}
+
+void MidiSongPosition(uint16_t sixteenths) {
+  // Only valid while stopped; takes effect on the next continue
+  if (!midi_running_)
+    midi_position = static_cast<int64_t>(sixteenths) * kMidiClocksPerSixteenth;
+}
+
+bool locked() {
+  return source->locked();
+}
+
+bool midi_active() {
+  return source == &midi_tracker_;
+}
+
+bool midi_running() {
+  return midi_running_;
+}
+
+float bpm() {
+  int64_t beat_period = source->beat_period();
+  if (!source->locked() || beat_period <= 0)
+    return 0.f;
+  return 60.f * F_CPU / beat_period;
+}
+
+const util::ClockTracker &tracker() {
+  return input_tracker;
+}
+
+const util::ClockTracker &midi_tracker() {
+  return midi_tracker_;
+}
+
+const Engine &engine() {
+  return engine_;
+}
+
+void ResetStats() {
+  noInterrupts();
+  input_tracker.ResetStats();
+  midi_tracker_.ResetStats();
+  engine_.ResetStats();
+  interrupts();
+}
+
+}; // namespace CLOCK
+}; // namespace OC
@@ -0,0 +1,71 @@
+// OC_clock.h - Clock input tracking and multiplied/divided clock outputs
+//
+// Edges on CLOCK_IN_PIN are timestamped with the cycle counter in the pin
+// ISR and fed to a ClockTracker from the core ISR. Clock outputs are gates on
+// DAC channels, raised on the tick nearest to the ideal edge time. Each
+// pulse's fall is posted to the OutputQueue for the tick it is due.
+//
+// MIDI clock (24 PPQN) is followed by a second, more heavily filtered tracker
+// which takes over as the output source while it is receiving, so USB jitter
+// is smoothed out of the outputs. Start/stop/continue and song position gate
+// and position the outputs.
+
+#ifndef OC_CLOCK_H_
+#define OC_CLOCK_H_
+
+#include <stdint.h>
+#include "util/util_clock.h"
+
+// Pin definitions - can be overridden in platformio.ini
+#ifndef CLOCK_IN_PIN
+#define CLOCK_IN_PIN 5
+#endif
+
+// Trigger inputs are inverted by the input stage
+#ifndef CLOCK_IN_EDGE
+#define CLOCK_IN_EDGE FALLING
+#endif
+
+namespace OC {
+namespace CLOCK {
+
+static constexpr size_t kNumOutputs = 4;
+static constexpr uint32_t kDefaultPulseWidthUs = 5000;
+
+typedef util::ClockEngine<kNumOutputs> Engine;
+
+void Init();
+
+// Called from the core ISR at the start of each tick
+void Tick(int64_t now);
+
+// Assign output to a DAC channel (-1 disables it) with edges per beat of
+// num/den.
+void set_output(size_t output, int channel, int32_t num, int32_t den);
+int output_channel(size_t output);
+
+void set_pulse_width(uint32_t us);
+uint32_t pulse_width();  // us
+
+// MIDI realtime/transport messages, called from the core ISR. Clocks carry
+// the cycle count at which they arrived, as stamped by OC_midi.cpp.
+void MidiClock(uint32_t cycles);
+void MidiStart();
+void MidiContinue();
+void MidiStop();
+void MidiSongPosition(uint16_t sixteenths);
+
+bool locked();
+bool midi_active();
+bool midi_running();
+float bpm();
+
+const util::ClockTracker &tracker();
+const util::ClockTracker &midi_tracker();
+const Engine &engine();
+void ResetStats();
+
+}; // namespace CLOCK
+}; // namespace OC
+
+#endif // OC_CLOCK_H_
@@ -0,0 +1,77 @@
+// OC_core.cpp - Core timer tick implementation
+
+#include <Arduino.h>
+#include "OC_core.h"
+#include "OC_audio.h"
+#include "OC_clock.h"
+#include "OC_DAC.h"
+#include "OC_events.h"
+#include "OC_midi.h"
+#include "OC_output_queue.h"
+#include "OC_player.h"
+#include "OC_preset.h"
+#include "OC_stream.h"
+#include "OC_trace.h"
+
+namespace OC {
+namespace CORE {
+
+volatile uint32_t ticks = 0;
+util::RunningStats isr_cycles;
+util::RunningStats tick_jitter;
+
+static IntervalTimer core_timer;
+static uint64_t tick_cycles_ = 0;
+
+uint64_t tick_cycles() {
+  return tick_cycles_;
+}
+
+static void FASTRUN CORE_timer_ISR() {
+  uint32_t start = ARM_DWT_CYCCNT;
+  TRACE::Begin(TRACE::EVENT_CORE_TICK);
+  uint32_t period = start - static_cast<uint32_t>(tick_cycles_);
+  tick_cycles_ += period;
+  // The first period includes the module init
+  if (ticks)
+    tick_jitter.Push(static_cast<int32_t>(period - kCyclesPerTick));
+
+  // A recalled preset first, so every output this tick uses all of it
+  PRESET::Tick();
+  OutputQueue::Apply(ticks);
+  STREAM::Tick();
+  PLAYER::Tick();
+  CLOCK::Tick(tick_cycles_);
+  MIDI::Tick();
+  DAC::Update(ticks);
+  MIDI::Written(ARM_DWT_CYCCNT);
+
+  ++ticks;
+  isr_cycles.Push(ARM_DWT_CYCCNT - start);
+  TRACE::End(TRACE::EVENT_CORE_TICK);
+}
+
+void Init() {
+  // The Teensy 4 startup code already enables the DWT cycle counter
+  tick_cycles_ = ARM_DWT_CYCCNT;
+  ticks = 0;
+  isr_cycles.Reset();
+  tick_jitter.Reset();
+
+  // Before any producer
+  EVENTS::Init();
+  DAC::Init();
+  AUDIO::Init();
+  OutputQueue::Init();
+  STREAM::Init();
+  PLAYER::Init();
+  CLOCK::Init();
+  MIDI::Init();
+  PRESET::Init();
+
+  core_timer.priority(64);
+  core_timer.begin(CORE_timer_ISR, kTickUs);
+}
+
+}; // namespace CORE
+}; // namespace OC
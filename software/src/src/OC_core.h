@@ -0,0 +1,44 @@
+// OC_core.h - Core timer tick
+//
+// The core ISR runs at a fixed rate (as on the original O_C) and is the only
+// context that writes to the DAC. Everything that needs sample-accurate
+// timing (clock outputs, ...) is evaluated from here.
+
+#ifndef OC_CORE_H_
+#define OC_CORE_H_
+
+#include <Arduino.h>
+#include "util/util_stats.h"
+
+namespace OC {
+namespace CORE {
+
+static constexpr uint32_t kTickUs = 60;  // 16.667 kHz
+static constexpr uint32_t kTickRate = 1000000 / kTickUs;
+static constexpr uint32_t kCyclesPerUs = F_CPU / 1000000;
+static constexpr uint32_t kCyclesPerTick = kCyclesPerUs * kTickUs;
+
+extern volatile uint32_t ticks;
+
+// Time spent in the core ISR per tick, in cycles
+extern util::RunningStats isr_cycles;
+
+// Deviation of the tick period from kCyclesPerTick, i.e. DAC update jitter
+extern util::RunningStats tick_jitter;
+
+void Init();
+
+// Unwrapped 64-bit cycle count at the start of the current tick
+uint64_t tick_cycles();
+
+// Extend a 32-bit ARM_DWT_CYCCNT timestamp taken within ~3.5s of the current
+// tick to the 64-bit timeline. Only valid in the core ISR.
+static inline int64_t extend_cycles(uint32_t cycles) {
+  int64_t now = tick_cycles();
+  return now + static_cast<int32_t>(cycles - static_cast<uint32_t>(now));
+}
+
+}; // namespace CORE
+}; // namespace OC
+
+#endif // OC_CORE_H_
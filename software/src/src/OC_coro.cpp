@@ -0,0 +1,83 @@
+// OC_coro.cpp - Coroutine tasks implementation
+
+#include <Arduino.h>
+#include <utility>
+#include "OC_coro.h"
+
+namespace OC {
+namespace CORO {
+
+util::RunningStats poll_cycles;
+
+struct Frame {
+  alignas(max_align_t) uint8_t bytes[kFrameSize];
+};
+
+static util::Pool<Frame, kNumFrames> frames;
+static util::Scheduler scheduler;
+static uint32_t too_large;
+static uint32_t max_frame_size;
+
+void *Frames::Allocate(size_t bytes) noexcept {
+  if (bytes > max_frame_size)
+    max_frame_size = bytes;
+  if (bytes > kFrameSize) {
+    ++too_large;
+    return nullptr;
+  }
+  return frames.New();
+}
+
+void Frames::Free(void *frame) noexcept {
+  frames.Delete(static_cast<Frame *>(frame));
+}
+
+void Init() {
+  frames.Init();
+  scheduler.Init();
+  too_large = 0;
+  max_frame_size = 0;
+  poll_cycles.Reset();
+}
+
+bool Spawn(Task &&task) {
+  return scheduler.Spawn(std::move(task));
+}
+
+void Poll() {
+  uint32_t resumes = scheduler.stats().resumes;
+  uint32_t start = ARM_DWT_CYCCNT;
+  scheduler.Poll(micros());
+  if (scheduler.stats().resumes != resumes)
+    poll_cycles.Push(ARM_DWT_CYCCNT - start);
+}
+
+Awaiter Sleep(uint32_t us) {
+  return scheduler.SleepUntil(micros() + us);
+}
+
+Awaiter Yield() {
+  return scheduler.Yield();
+}
+
+Awaiter Wait(const Completion &completion) {
+  return scheduler.Wait(completion);
+}
+
+Stats stats() {
+  return { scheduler.stats(), too_large, max_frame_size };
+}
+
+const util::PoolStats &frame_stats() {
+  return frames.stats();
+}
+
+void ResetStats() {
+  scheduler.ResetStats();
+  frames.ResetStats();
+  too_large = 0;
+  poll_cycles.Reset();
+}
+
+}; // namespace CORO
+}; // namespace OC
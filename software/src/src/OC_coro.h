@@ -0,0 +1,78 @@
+// OC_coro.h - Coroutine tasks for multi-step hardware sequences
+//
+// Runtime and frame pool for util/util_coro.h. Sequences such as a device
+// power-up (write, wait 10 ms, write, wait 20 ms, ...) or a run of DMA
+// transfers are written as tasks that co_await Sleep(), Yield() or a
+// Completion signalled from an ISR, and loop() carries on while they wait.
+// Task bodies run from Spawn() (up to the first wait) and from Poll() in
+// loop(), never from an interrupt.
+//
+// Frames come from a pool of kNumFrames blocks of kFrameSize bytes; a
+// coroutine with a larger frame, or one spawned with the pool empty, doesn't
+// run and is counted. Callers check Spawn()'s result and fall back to doing
+// the work in place.
+
+#ifndef OC_CORO_H_
+#define OC_CORO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "util/util_coro.h"
+#include "util/util_pool.h"
+#include "util/util_stats.h"
+
+#ifndef OC_CORO_FRAME_SIZE
+#define OC_CORO_FRAME_SIZE 256
+#endif
+
+#ifndef OC_CORO_FRAMES
+#define OC_CORO_FRAMES 8
+#endif
+
+namespace OC {
+namespace CORO {
+
+static constexpr size_t kFrameSize = OC_CORO_FRAME_SIZE;
+static constexpr size_t kNumFrames = OC_CORO_FRAMES;
+
+struct Frames {
+  static void *Allocate(size_t bytes) noexcept;
+  static void Free(void *frame) noexcept;
+};
+
+typedef util::Task<Frames> Task;
+typedef util::Completion Completion;
+typedef util::Scheduler::Awaiter Awaiter;
+
+struct Stats {
+  util::Scheduler::Stats scheduler;
+  uint32_t too_large;       // Frames bigger than kFrameSize
+  uint32_t max_frame_size;  // Largest frame asked for
+};
+
+// Cycles per Poll() that resumed anything, i.e. how long task steps hold up
+// the loop
+extern util::RunningStats poll_cycles;
+
+// Before anything spawns a task
+void Init();
+
+// Start a task; false if it got no frame (and didn't run)
+bool Spawn(Task &&task);
+
+// Resume tasks whose wait is over; call from loop()
+void Poll();
+
+// Awaitables for tasks
+Awaiter Sleep(uint32_t us);
+Awaiter Yield();  // Until the next Poll()
+Awaiter Wait(const Completion &completion);
+
+Stats stats();
+const util::PoolStats &frame_stats();
+void ResetStats();
+
+}; // namespace CORO
+}; // namespace OC
+
+#endif // OC_CORO_H_
@@ -0,0 +1,498 @@
+// OC_debug.cpp - Serial debug commands and statistics reports
+
+#include <Arduino.h>
+#include "OC_debug.h"
+#include "OC_audio.h"
+#include "OC_clock.h"
+#include "OC_coro.h"
+#include "OC_core.h"
+#include "OC_DAC.h"
+#include "OC_events.h"
+#include "OC_memory.h"
+#include "OC_midi.h"
+#include "OC_mirror.h"
+#include "OC_output_queue.h"
+#include "OC_player.h"
+#include "OC_preset.h"
+#include "OC_profile.h"
+#include "OC_stream.h"
+#include "OC_trace.h"
+#include "drivers/display.h"
+#include "util/util_math.h"
+
+namespace OC {
+namespace DEBUG {
+
+static inline float cycles_to_us(double cycles) {
+  return cycles / CORE::kCyclesPerUs;
+}
+
+static void PrintStats(const char *label, const util::RunningStats &stats) {
+  Serial.printf("  %-12s n=%lu min=%.2fus max=%.2fus mean=%.2fus rms=%.2fus sd=%.2fus\n",
+                label, stats.count(),
+                cycles_to_us(stats.min()), cycles_to_us(stats.max()),
+                cycles_to_us(stats.mean()), cycles_to_us(stats.rms()),
+                cycles_to_us(stats.stddev()));
+}
+
+static void PrintCore() {
+  Serial.printf("CORE: %lu ticks @ %luHz\n", CORE::ticks, CORE::kTickRate);
+  PrintStats("isr", CORE::isr_cycles);
+  PrintStats("jitter", CORE::tick_jitter);
+  Serial.printf("  load=%.1f%%\n", 100.0 * CORE::isr_cycles.mean() / CORE::kCyclesPerTick);
+}
+
+// Tick jitter over two seconds with the display idle, then with frames sent
+// back to back. Every page changes from one frame to the next.
+static void BenchDisplayJitter() {
+  static const char *const kPhases[] = { "display idle", "display busy" };
+  static constexpr uint32_t kPhaseMs = 2000;
+  for (int phase = 0; phase < 2; ++phase) {
+    // Includes a display that is still starting up
+    while (SH1106_128x64_Driver::busy())
+      CORO::Poll();
+    noInterrupts();
+    CORE::tick_jitter.Reset();
+    interrupts();
+    SH1106_128x64_Driver::ResetStats();
+
+    uint32_t frames = 0;
+    uint32_t start = millis();
+    while (millis() - start < kPhaseMs) {
+      if (!phase)
+        continue;
+      GRAPHICS_BEGIN_FRAME(false);
+      if (frames & 1)
+        graphics.invertRect(0, 0, 128, 64);
+      ++frames;
+      GRAPHICS_END_FRAME();
+      display::Update();
+      display::Flush();
+    }
+
+    noInterrupts();
+    util::RunningStats jitter = CORE::tick_jitter;
+    interrupts();
+    SH1106_128x64_Driver::Stats display_stats = SH1106_128x64_Driver::stats();
+    Serial.printf("JITTER: %s, %lu frames, %lu pages, SPI busy=%.1f%%\n", kPhases[phase], frames,
+                  display_stats.pages, 100.0 * display_stats.busy_cycles / (F_CPU / 1000.0 * kPhaseMs));
+    PrintStats("tick", jitter);
+  }
+}
+
+static void PrintClock() {
+  const util::ClockTracker &tracker = CLOCK::tracker();
+  Serial.printf("CLOCK: %s bpm=%.2f relocks=%lu\n",
+                tracker.locked() ? "locked" : "unlocked", CLOCK::bpm(), tracker.relocks());
+  PrintStats("input", tracker.phase_error());
+
+  const util::ClockTracker &midi_tracker = CLOCK::midi_tracker();
+  Serial.printf(" MIDI clock: %s%s %s pulse=%ld relocks=%lu\n",
+                midi_tracker.locked() ? "locked" : "unlocked",
+                CLOCK::midi_active() ? " (active)" : "",
+                CLOCK::midi_running() ? "running" : "stopped",
+                static_cast<int32_t>(midi_tracker.pulse_count()), midi_tracker.relocks());
+  PrintStats("midi", midi_tracker.phase_error());
+
+  const CLOCK::Engine &engine = CLOCK::engine();
+  for (size_t i = 0; i < CLOCK::kNumOutputs; ++i) {
+    if (!engine.enabled(i))
+      continue;
+    Serial.printf(" out%u ch%d %ld/%ld\n", i, CLOCK::output_channel(i), engine.num(i), engine.den(i));
+    PrintStats("edge", engine.jitter(i));
+    PrintStats("period", engine.period(i));
+  }
+}
+
+static void PrintMIDI() {
+  Serial.printf("MIDI: %lu messages, %lu dropped\n", MIDI::message_count(), MIDI::dropped_count());
+  PrintStats("latency", MIDI::latency());
+  MIDI::SettingsStats settings = MIDI::settings_stats();
+  Serial.printf("  settings: writes=%lu reads=%lu retries=%lu max=%lu\n",
+                settings.writes, settings.reads, settings.retries, settings.max_retries);
+}
+
+// Middle C on and off in turn, through the same path as USB MIDI
+static void InjectNote() {
+  static bool on = false;
+  on = !on;
+  const uint8_t message[] = { static_cast<uint8_t>(on ? 0x90 : 0x80), 60, 100 };
+  MIDI::Inject(message, sizeof(message));
+  Serial.printf("Injected note 60 %s\n", on ? "on" : "off");
+}
+
+static void PrintOutputQueue() {
+  OutputQueue::Stats stats = OutputQueue::stats();
+  Serial.printf("QUEUE: posted=%lu applied=%lu late=%lu overflows=%lu dropped=%lu pending=%u max=%lu\n",
+                stats.posted, stats.applied, stats.late, stats.overflows, stats.dropped,
+                OutputQueue::pending(), stats.max_pending);
+}
+
+static void PrintEvents() {
+  EVENTS::Stats stats = EVENTS::stats();
+  Serial.printf("EVENTS: posted=%lu drained=%lu overflows=%lu max depth=%lu/%u\n",
+                stats.posted, stats.drained, stats.overflows, stats.max_depth,
+                static_cast<unsigned>(EVENTS::kQueueSize));
+  PrintStats("latency", EVENTS::latency);
+  for (size_t type = 0; type < EVENTS::EVENT_LAST; ++type) {
+    uint32_t overflows = EVENTS::overflows(static_cast<EVENTS::Type>(type));
+    if (overflows)
+      Serial.printf("  %-12s overflows=%lu\n", EVENTS::type_name(type), overflows);
+  }
+}
+
+static void PrintMemory() {
+  const MEMORY::AppletArena &arena = MEMORY::arena();
+  Serial.printf("MEMORY: arena used=%u high=%u of %u failures=%lu switches=%lu heap=%u\n",
+                arena.used(), arena.high_water(), MEMORY::kArenaSize, arena.failures(),
+                MEMORY::applet_switches(), MEMORY::heap_used());
+  for (size_t i = 0; i < MEMORY::num_pools(); ++i) {
+    util::PoolStats stats = MEMORY::pool_stats(i);
+    Serial.printf("  %-12s in use=%lu high=%lu of %lu failures=%lu\n", MEMORY::pool_name(i),
+                  stats.in_use, stats.high_water, stats.capacity, stats.failures);
+  }
+}
+
+static void PrintPresets() {
+  PRESET::Stats stats = PRESET::stats();
+  Serial.printf("PRESET: recalls=%lu saves=%lu coalesced=%lu pending=%02lx valid=%02lx\n",
+                stats.recalls, stats.saves, stats.coalesced, stats.pending, stats.valid);
+  Serial.printf("  %u bytes, slot %lu of %u, free=%lu%s discarded=%lu erased=%lu sectors\n",
+                static_cast<unsigned>(sizeof(PRESET::State)), stats.next_slot,
+                static_cast<unsigned>(PRESET::num_slots()), stats.free_slots,
+                stats.full ? " (full until reboot)" : "", stats.discarded, stats.erases);
+  PrintStats("recall", PRESET::recall_cycles);
+  Serial.printf("  %-12s n=%lu min=%.1fms max=%.1fms mean=%.1fms\n", "save",
+                PRESET::save_us.count(), PRESET::save_us.min() / 1000.f,
+                PRESET::save_us.max() / 1000.f, PRESET::save_us.mean() / 1000.f);
+  PrintStats("step", PRESET::step_cycles);
+  PrintStats("tick late", PRESET::save_tick_lateness);
+}
+
+// Preset 1 is the first one
+static void SavePreset() {
+  PRESET::Save(0);
+  Serial.println("Preset 1 queued for saving");
+}
+
+static void RecallPreset() {
+  PRESET::Recall(0);
+  Serial.printf("Preset 1 recalled%s\n", PRESET::valid(0) ? "" : " (not saved yet)");
+}
+
+static void PrintCoroutines() {
+  CORO::Stats stats = CORO::stats();
+  const util::PoolStats &frames = CORO::frame_stats();
+  Serial.printf("CORO: spawned=%lu resumes=%lu waiting=%lu max=%lu late=%luus\n",
+                stats.scheduler.spawned, stats.scheduler.resumes, stats.scheduler.waiting,
+                stats.scheduler.max_waiting, stats.scheduler.max_late_us);
+  Serial.printf("  frames in use=%lu high=%lu of %lu failures=%lu too large=%lu largest=%lu/%u\n",
+                frames.in_use, frames.high_water, frames.capacity, frames.failures,
+                stats.too_large, stats.max_frame_size, static_cast<unsigned>(CORO::kFrameSize));
+  PrintStats("poll", CORO::poll_cycles);
+}
+
+static void PrintDAC() {
+  uint32_t ticks = DAC::stats_ticks();
+  Serial.printf("DAC: %lu ticks\n", ticks);
+  for (size_t device = 0; device < DAC8568_Driver::kNumDevices; ++device) {
+    DAC8568_Driver::DeviceStats stats = DAC::device_stats(device);
+    double cycles = static_cast<double>(ticks) * CORE::kCyclesPerTick;
+    Serial.printf("  dac%u SPI%u words=%lu busy=%.1f%%\n", device, DAC8568_Driver::bus(device),
+                  stats.words, cycles > 0 ? 100.0 * stats.busy_cycles / cycles : 0.0);
+  }
+  for (size_t channel = 0; channel < DAC::kNumChannels; ++channel) {
+    DAC::ChannelStats stats = DAC::channel_stats(channel);
+    float rate = ticks ? static_cast<float>(stats.writes) * CORE::kTickRate / ticks : 0.f;
+    Serial.printf("  ch%u %04x class=%u max=%luHz rate=%.1fHz dropped=%lu deferred=%lu dither=%u\n",
+                  channel, DAC::value(channel), DAC::rate(channel),
+                  CORE::kTickRate >> DAC::rate(channel), rate, stats.dropped, stats.deferred,
+                  DAC::dither(channel));
+  }
+}
+
+static void PrintAudio() {
+  AUDIO::Stats stats = AUDIO::stats();
+  Serial.printf("AUDIO: %s %luHz", AUDIO::running() ? "running" : "stopped", AUDIO::sample_rate());
+  for (size_t i = 0; i < AUDIO::num_channels(); ++i)
+    Serial.printf(" ch%u", AUDIO::channel(i));
+  Serial.printf("\n  blocks=%lu underruns=%lu depth=%u min=%lu\n",
+                stats.blocks, stats.underruns, AUDIO::depth(), stats.min_depth);
+  PrintStats("render", AUDIO::render_cycles);
+  PrintStats("sample", AUDIO::sample_cycles);
+  double block_cycles = static_cast<double>(F_CPU) * AUDIO::kBlockSize / AUDIO::sample_rate();
+  Serial.printf("  load: render=%.1f%% sample=%.1f%%\n",
+                100.0 * AUDIO::render_cycles.mean() / block_cycles,
+                100.0 * AUDIO::sample_cycles.mean() * AUDIO::kBlockSize / block_cycles);
+}
+
+static volatile uint32_t math_sink;
+
+// Cycles per call including the loop, the best of 16 batches so that
+// interrupts taken meanwhile don't count
+template <typename Function>
+static float CyclesPerCall(Function function) {
+  static constexpr size_t kCalls = 64;
+  uint32_t inputs[kCalls];
+  uint32_t seed = 1;
+  for (uint32_t &input : inputs) {
+    seed = seed * 1664525 + 1013904223;
+    input = seed | 2;
+  }
+  uint32_t best = UINT32_MAX;
+  for (int batch = 0; batch < 16; ++batch) {
+    uint32_t sum = 0;
+    uint32_t start = ARM_DWT_CYCCNT;
+    for (uint32_t input : inputs)
+      sum += function(input);
+    uint32_t cycles = ARM_DWT_CYCCNT - start;
+    math_sink = sum;
+    if (cycles < best)
+      best = cycles;
+  }
+  return static_cast<float>(best) / kCalls;
+}
+
+static void BenchMath() {
+  Serial.printf("MATH: cycles per call, fixed point vs float\n");
+  Serial.printf("  sin  %6.1f vs %6.1f (sinf)\n",
+                CyclesPerCall([](uint32_t x) { return util::sin_q15(x); }),
+                CyclesPerCall([](uint32_t x) {
+                  return static_cast<int32_t>(32767.f * sinf(x * (6.28318531f / 4294967296.f)));
+                }));
+  Serial.printf("  exp2 %6.1f vs %6.1f (exp2f)\n",
+                CyclesPerCall([](uint32_t x) { return util::exp2_q16(static_cast<int32_t>(x) >> 12); }),
+                CyclesPerCall([](uint32_t x) {
+                  return static_cast<uint32_t>(65536.f * exp2f((static_cast<int32_t>(x) >> 12) / 65536.f));
+                }));
+  Serial.printf("  log2 %6.1f vs %6.1f (log2f)\n",
+                CyclesPerCall([](uint32_t x) { return util::log2_q16(x); }),
+                CyclesPerCall([](uint32_t x) { return static_cast<int32_t>(65536.f * log2f(x / 65536.f)); }));
+  Serial.printf("  1/x  %6.1f vs %6.1f (64-bit division)\n",
+                CyclesPerCall([](uint32_t x) { return util::reciprocal_q32(x); }),
+                CyclesPerCall([](uint32_t x) { return static_cast<uint32_t>((1ULL << 32) / x); }));
+}
+
+// Test tone on channels 5 and 6
+static void ToggleAudio() {
+  static const uint8_t channels[] = { 4, 5 };
+  if (AUDIO::running())
+    AUDIO::Stop();
+  else
+    AUDIO::Start(AUDIO::SAMPLE_RATE_48K, channels, sizeof(channels));
+  Serial.printf("Audio %s\n", AUDIO::running() ? "started" : "stopped");
+}
+
+static void PrintStream() {
+  static const char *const kStateNames[] = { "idle", "buffering", "playing" };
+  STREAM::Stats stats = STREAM::stats();
+  Serial.printf("STREAM: %s %luHz fill=%u target=%u jitter=%.0fus correction=%ldppm\n",
+                kStateNames[STREAM::state()], STREAM::sample_rate(),
+                STREAM::fill(), STREAM::target(), STREAM::jitter(), STREAM::correction_ppm());
+  Serial.printf("  blocks=%lu frames=%lu underruns=%lu skipped=%lu overruns=%lu lost=%lu late=%lu errors=%lu\n",
+                stats.blocks, stats.frames, stats.underruns, stats.skipped, stats.overruns,
+                stats.lost, stats.late, stats.errors);
+  PrintStats("arrival", STREAM::arrival());
+}
+
+static void PrintPlayer() {
+  static const char *const kStateNames[] = { "stopped", "playing CV", "playing audio" };
+  PLAYER::Stats stats = PLAYER::stats();
+  Serial.printf("PLAYER: %s", kStateNames[PLAYER::state()]);
+  if (PLAYER::state() != PLAYER::STATE_STOPPED) {
+    const util::CVFileHeader &header = PLAYER::header();
+    Serial.printf(" %u channels @ %luHz, %lu frames", header.num_channels, header.sample_rate, header.num_frames);
+  }
+  Serial.printf("\n  frames=%lu blocks=%lu underruns=%lu read_errors=%lu buffered=%lu\n",
+                stats.frames, stats.blocks, stats.underruns, stats.read_errors, stats.buffered);
+  PrintStats("read", PLAYER::read_cycles);
+}
+
+static void TogglePlayer() {
+  static const char kTestFile[] = "/play.ocv";
+  if (PLAYER::state() != PLAYER::STATE_STOPPED) {
+    PLAYER::Stop();
+    Serial.println("Player stopped");
+  } else {
+    PLAYER::Error error = PLAYER::Play(kTestFile, true);
+    Serial.printf("Play %s: %s\n", kTestFile, error == PLAYER::ERROR_NONE ? "ok" : "failed");
+  }
+}
+
+static void PrintMirror() {
+  MIRROR::Stats stats = MIRROR::stats();
+  Serial.printf("MIRROR: %s frames=%lu key=%lu dropped=%lu\n",
+                MIRROR::running() ? "running" : "stopped",
+                stats.frames, stats.key_frames, stats.dropped);
+  Serial.printf("  bytes=%lu mean=%.0f/frame max=%lu (raw %u)\n",
+                stats.bytes, stats.frames ? static_cast<float>(stats.bytes) / stats.frames : 0.f,
+                stats.max_bytes, MIRROR::kFrameSize);
+}
+
+static void ToggleMirror() {
+  if (MIRROR::running())
+    MIRROR::Stop();
+  else
+    MIRROR::Start();
+  Serial.printf("Mirror %s\n", MIRROR::running() ? "started" : "stopped");
+}
+
+// The hottest addresses; tools/profile_report.py resolves them to functions
+static void PrintProfile() {
+  static constexpr size_t kTop = 8;
+  PROFILE::Stats stats = PROFILE::stats();
+  Serial.printf("PROFILE: %s @ %luHz samples=%lu dropped=%lu entries=%lu\n",
+                PROFILE::running() ? "running" : "stopped", PROFILE::rate(),
+                stats.samples, stats.dropped, stats.entries);
+  PrintStats("sample", PROFILE::sample_cycles);
+  Serial.printf("  overhead=%.2f%%\n", 100.0 * PROFILE::overhead());
+  PROFILE::Entry top[kTop];
+  size_t count = PROFILE::Top(top, kTop);
+  for (size_t i = 0; i < count; ++i) {
+    Serial.printf("  %08lx <- %08lx %5.1f%%\n", top[i].pc, top[i].lr,
+                  stats.samples ? 100.0 * top[i].count / stats.samples : 0.0);
+  }
+}
+
+// Stopping sends the profile to the host
+static void ToggleProfile() {
+  if (PROFILE::running()) {
+    PROFILE::Stats stats = PROFILE::stats();
+    Serial.printf("Profiler stopped: %lu samples, %lu dropped, overhead %.2f%%\n",
+                  stats.samples, stats.dropped, 100.0 * PROFILE::overhead());
+    PROFILE::Dump();
+  } else {
+    PROFILE::Start();
+    Serial.printf("Profiler started @ %luHz\n", PROFILE::rate());
+  }
+}
+
+static void PrintTraceStats(const TRACE::Stats &stats) {
+  const float span_ms = cycles_to_us(stats.span_cycles) / 1000.f;
+  Serial.printf("  records=%lu lost=%lu span=%.1fms rate=%.0f/s record=%lu cycles\n",
+                stats.records, stats.lost, span_ms,
+                span_ms > 0.f ? 1000.f * stats.records / span_ms : 0.f, stats.record_cycles);
+}
+
+static void PrintTrace() {
+  Serial.printf("TRACE: %s, %u records\n", TRACE::running() ? "recording" : "stopped",
+                static_cast<unsigned>(TRACE::kNumRecords));
+  PrintTraceStats(TRACE::stats());
+}
+
+// Stopping sends the trace to the host; tools/trace_export.py converts it
+static void ToggleTrace() {
+  if (TRACE::running()) {
+    TRACE::Stop();
+    Serial.println("Trace stopped");
+    PrintTraceStats(TRACE::stats());
+    TRACE::Dump();
+  } else {
+    TRACE::Start();
+    Serial.println("Trace started");
+  }
+}
+
+#ifdef USE_ILI9341_DISPLAY
+// Tear-free presentation on the TFT
+static void ToggleTearFree() {
+  bool beam = ILI9341_Driver::present_mode() != ILI9341_Driver::PRESENT_BEAM;
+  ILI9341_Driver::SetPresentMode(beam ? ILI9341_Driver::PRESENT_BEAM : ILI9341_Driver::PRESENT_PAGES);
+  ILI9341_Driver::Stats stats = ILI9341_Driver::stats();
+  Serial.printf("TFT: %s, refresh %luHz, line %.2fus, beam waits=%lu\n",
+                beam ? "tear-free" : "pages", ILI9341_Driver::refresh_rate(),
+                cycles_to_us(ILI9341_Driver::line_cycles()), stats.beam_waits);
+}
+#endif
+
+static void ResetStats() {
+  noInterrupts();
+  CORE::isr_cycles.Reset();
+  CORE::tick_jitter.Reset();
+  interrupts();
+  DAC::ResetStats();
+  AUDIO::ResetStats();
+  CLOCK::ResetStats();
+  MIDI::ResetStats();
+  OutputQueue::ResetStats();
+  EVENTS::ResetStats();
+  MEMORY::ResetStats();
+  CORO::ResetStats();
+  STREAM::ResetStats();
+  PLAYER::ResetStats();
+  PRESET::ResetStats();
+  MIRROR::ResetStats();
+  PROFILE::ResetStats();
+  SH1106_128x64_Driver::ResetStats();
+  Serial.println("Stats reset");
+}
+
+static void PrintHelp();
+
+struct Command {
+  char key;
+  const char *help;
+  void (*handler)();
+};
+
+static const Command commands[] = {
+  { 't', "core tick stats", PrintCore },
+  { 'j', "tick jitter with the display idle and busy (4s)", BenchDisplayJitter },
+  { 'c', "clock tracking and output jitter", PrintClock },
+  { 'm', "MIDI message count and latency", PrintMIDI },
+  { 'n', "inject MIDI note 60 on / off (toggle)", InjectNote },
+  { 'q', "output event queue", PrintOutputQueue },
+  { 'b', "event bus to the UI loop", PrintEvents },
+  { 'h', "applet arena, object pools and heap use", PrintMemory },
+  { 'k', "coroutine tasks and frames", PrintCoroutines },
+  { 's', "host CV stream buffer and timing", PrintStream },
+  { 'p', "SD player buffers and read times", PrintPlayer },
+  { 'P', "loop /play.ocv from SD (toggle)", TogglePlayer },
+  { 'o', "preset recall latency and save times", PrintPresets },
+  { 'w', "save preset 1", SavePreset },
+  { 'l', "recall preset 1", RecallPreset },
+  { 'd', "DAC channel values and update rates", PrintDAC },
+  { 'a', "audio output queue and render load", PrintAudio },
+  { 'A', "toggle 48kHz test tones on channels 5 and 6", ToggleAudio },
+  { 'f', "fixed-point math cycles per call", BenchMath },
+  { 'v', "screen mirror bandwidth", PrintMirror },
+  { 'V', "mirror the screen to the host (toggle)", ToggleMirror },
+  { 'x', "sampling profiler summary", PrintProfile },
+  { 'X', "sampling profiler start / stop and dump (toggle)", ToggleProfile },
+  { 'e', "event trace summary", PrintTrace },
+  { 'E', "event trace start / stop and dump (toggle)", ToggleTrace },
+#ifdef USE_ILI9341_DISPLAY
+  { 'T', "tear-free TFT presentation (toggle)", ToggleTearFree },
+#endif
+  { 'r', "reset statistics", ResetStats },
+  { '?', "this help", PrintHelp },
+};
+
+static void PrintHelp() {
+  for (const auto &command : commands)
+    Serial.printf("  %c  %s\n", command.key, command.help);
+}
+
+void Poll() {
+  uint8_t buffer[64];
+  size_t length;
+  while ((length = Serial.available()) > 0) {
+    if (length > sizeof(buffer))
+      length = sizeof(buffer);
+    length = Serial.readBytes(reinterpret_cast<char *>(buffer), length);
+    for (size_t i = 0; i < length; ++i) {
+      // Stream packets share the port with the commands
+      if (STREAM::Parse(buffer[i]))
+        continue;
+      for (const auto &command : commands) {
+        if (command.key == buffer[i]) {
+          command.handler();
+          break;
+        }
+      }
+    }
+  }
+}
+
+}; // namespace DEBUG
+}; // namespace OC
@@ -0,0 +1,19 @@
+// OC_debug.h - Serial debug commands and statistics reports
+//
+// Single-character commands on the USB serial port print timing and state
+// reports; '?' lists them. Bytes belonging to host CV stream packets
+// (OC_stream.h) are passed on instead.
+
+#ifndef OC_DEBUG_H_
+#define OC_DEBUG_H_
+
+namespace OC {
+namespace DEBUG {
+
+// Handle pending serial commands and stream data; called from loop()
+void Poll();
+
+}; // namespace DEBUG
+}; // namespace OC
+
+#endif // OC_DEBUG_H_
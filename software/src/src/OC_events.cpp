@@ -0,0 +1,73 @@
+// OC_events.cpp - Event bus implementation
+
+#include <Arduino.h>
+#include "OC_events.h"
+#include "util/util_mpsc_queue.h"
+
+namespace OC {
+namespace EVENTS {
+
+util::RunningStats latency;
+
+static util::MpscQueue<Event, kQueueSize> queue;
+static uint32_t posted;
+static uint32_t drained;
+static uint32_t max_depth;
+static uint32_t type_overflows[EVENT_LAST];
+
+static const char *const kTypeNames[] = {
+  "trigger", "clock lock", "transport", "note on", "note off", "underrun",
+};
+static_assert(sizeof(kTypeNames) / sizeof(kTypeNames[0]) == EVENT_LAST, "A name per type");
+
+void Init() {
+  queue.Init();
+  ResetStats();
+}
+
+bool FASTRUN Post(Type type, uint8_t source, uint16_t value) {
+  if (!queue.Push({ ARM_DWT_CYCCNT, type, source, value })) {
+    if (type < EVENT_LAST)
+      __atomic_fetch_add(&type_overflows[type], 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  __atomic_fetch_add(&posted, 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+size_t Drain(Event *events, size_t max) {
+  size_t depth = queue.readable();
+  if (depth > max_depth)
+    max_depth = depth;
+  size_t count = queue.Pop(events, max);
+  const uint32_t now = ARM_DWT_CYCCNT;
+  for (size_t i = 0; i < count; ++i)
+    latency.Push(now - events[i].cycles);
+  drained += count;
+  return count;
+}
+
+const char *type_name(uint8_t type) {
+  return type < EVENT_LAST ? kTypeNames[type] : "?";
+}
+
+Stats stats() {
+  return { posted, drained, queue.overflows(), max_depth };
+}
+
+uint32_t overflows(Type type) {
+  return type < EVENT_LAST ? type_overflows[type] : 0;
+}
+
+void ResetStats() {
+  __atomic_store_n(&posted, 0, __ATOMIC_RELAXED);
+  drained = 0;
+  max_depth = 0;
+  for (uint32_t &count : type_overflows)
+    __atomic_store_n(&count, 0, __ATOMIC_RELAXED);
+  queue.ResetOverflows();
+  latency.Reset();
+}
+
+}; // namespace EVENTS
+}; // namespace OC
@@ -0,0 +1,82 @@
+// OC_events.h - Event bus from the ISRs to the UI loop
+//
+// Producers in any context (clock input pin ISR, core ISR, audio ISR, the
+// main loop) post small typed events; the UI loop is the single consumer and
+// drains them in batches. Posting is lock-free (util::MpscQueue) and never
+// waits, so it is safe from every interrupt priority. When the queue is full
+// the event is dropped and counted as an overflow against its type; events
+// that report a state (clock lock, transport) are worth re-reading from their
+// module after an overflow.
+//
+// Each event carries the cycle count at which it was posted, so the consumer
+// can tell how old it is and the delivery latency is measured.
+
+#ifndef OC_EVENTS_H_
+#define OC_EVENTS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "util/util_stats.h"
+
+namespace OC {
+namespace EVENTS {
+
+static constexpr size_t kQueueSize = 64;
+
+enum Type : uint8_t {
+  EVENT_TRIGGER,      // source: input (0 = clock input)
+  EVENT_CLOCK_LOCK,   // value: locked
+  EVENT_TRANSPORT,    // value: Transport
+  EVENT_NOTE_ON,      // source: voice, value: note | velocity << 8
+  EVENT_NOTE_OFF,     // source: voice, value: note
+  EVENT_UNDERRUN,     // source: Source, start of a run of underruns
+  EVENT_LAST
+};
+
+enum Transport : uint16_t {
+  TRANSPORT_STOP,
+  TRANSPORT_START,
+  TRANSPORT_CONTINUE,
+};
+
+enum Source : uint8_t {
+  SOURCE_AUDIO,
+  SOURCE_STREAM,
+};
+
+struct Event {
+  uint32_t cycles;  // ARM_DWT_CYCCNT when posted
+  uint8_t type;
+  uint8_t source;
+  uint16_t value;
+};
+
+struct Stats {
+  uint32_t posted;
+  uint32_t drained;
+  uint32_t overflows;  // All types
+  uint32_t max_depth;  // Most events found by one Drain()
+};
+
+// Cycles from posting to draining
+extern util::RunningStats latency;
+
+void Init();
+
+// Any context. Returns false (and counts an overflow) if the queue is full.
+bool Post(Type type, uint8_t source = 0, uint16_t value = 0);
+
+// Consumer only: move up to `max` events, oldest first, into `events`.
+// Returns how many.
+size_t Drain(Event *events, size_t max);
+
+const char *type_name(uint8_t type);
+
+Stats stats();
+uint32_t overflows(Type type);
+void ResetStats();
+
+}; // namespace EVENTS
+}; // namespace OC
+
+#endif // OC_EVENTS_H_
@@ -0,0 +1,76 @@
+// OC_memory.cpp - Static memory for applets and UI objects implementation
+
+#include <Arduino.h>
+#include "OC_memory.h"
+
+#if defined(__IMXRT1062__)
+// Teensy 4 sbrk(): the heap grows up from _heap_start in RAM2
+extern unsigned long _heap_start;
+extern char *__brkval;
+#endif
+
+namespace OC {
+namespace MEMORY {
+
+// Applet state isn't touched by DMA or the ISRs; RAM2 keeps it out of the
+// tightly coupled RAM
+DMAMEM static AppletArena applet_arena;
+static uint32_t switches;
+
+struct PoolEntry {
+  const char *name;
+  const util::PoolStats *stats;
+};
+
+static PoolEntry pools[kMaxPools];
+static size_t num_pools_;
+
+void Init() {
+  applet_arena.Init();
+  switches = 0;
+}
+
+AppletArena &arena() {
+  return applet_arena;
+}
+
+void SwitchApplet() {
+  applet_arena.Reset();
+  ++switches;
+}
+
+uint32_t applet_switches() {
+  return switches;
+}
+
+void RegisterPool(const char *name, const util::PoolStats *stats) {
+  if (num_pools_ < kMaxPools)
+    pools[num_pools_++] = { name, stats };
+}
+
+size_t num_pools() {
+  return num_pools_;
+}
+
+const char *pool_name(size_t index) {
+  return index < num_pools_ ? pools[index].name : "";
+}
+
+util::PoolStats pool_stats(size_t index) {
+  return index < num_pools_ ? *pools[index].stats : util::PoolStats{ 0, 0, 0, 0 };
+}
+
+size_t heap_used() {
+#if defined(__IMXRT1062__)
+  return __brkval - reinterpret_cast<char *>(&_heap_start);
+#else
+  return 0;
+#endif
+}
+
+void ResetStats() {
+  applet_arena.ResetStats();
+}
+
+}; // namespace MEMORY
+}; // namespace OC
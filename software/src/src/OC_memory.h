@@ -0,0 +1,59 @@
+// OC_memory.h - Static memory for applets and UI objects
+//
+// Nothing in the firmware allocates from the heap, so a device that runs for
+// weeks can't fragment it or stall on it. Applet state comes from a single
+// arena sized at compile time (OC_APPLET_ARENA_SIZE); switching applets
+// resets it, which takes constant time however much the applet allocated.
+// Objects that come and go while an applet runs (widgets, event payloads)
+// come from fixed-size util::Pool instances owned by their users, which
+// register them here for the usage report.
+//
+// None of this is for the real-time path: the ISRs only use memory that was
+// set up before they run.
+
+#ifndef OC_MEMORY_H_
+#define OC_MEMORY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "util/util_arena.h"
+#include "util/util_pool.h"
+
+#ifndef OC_APPLET_ARENA_SIZE
+#define OC_APPLET_ARENA_SIZE 32768
+#endif
+
+namespace OC {
+namespace MEMORY {
+
+static constexpr size_t kArenaSize = OC_APPLET_ARENA_SIZE;
+static constexpr size_t kMaxPools = 8;
+
+typedef util::Arena<kArenaSize> AppletArena;
+
+void Init();
+
+// The current applet's state. Allocate with arena().New<T>() in the UI loop.
+AppletArena &arena();
+
+// Release all applet state, before the next applet allocates its own
+void SwitchApplet();
+uint32_t applet_switches();
+
+// Add a pool to the usage report; `name` and `stats` must outlive it. Pools
+// keep their own counters, so ResetStats() leaves their high-water marks.
+void RegisterPool(const char *name, const util::PoolStats *stats);
+size_t num_pools();
+const char *pool_name(size_t index);
+util::PoolStats pool_stats(size_t index);
+
+// Bytes taken from the heap since startup (by the core libraries), for
+// checking that it doesn't grow
+size_t heap_used();
+
+void ResetStats();
+
+}; // namespace MEMORY
+}; // namespace OC
+
+#endif // OC_MEMORY_H_
@@ -0,0 +1,314 @@
+// OC_midi.cpp - USB MIDI to CV/gate implementation
+
+#include <Arduino.h>
+#include "OC_midi.h"
+#include "OC_clock.h"
+#include "OC_events.h"
+#include "util/util_ringbuffer.h"
+#include "util/util_seqlock.h"
+
+namespace OC {
+namespace MIDI {
+
+static util::VoiceAllocator<kMaxVoices> voices;
+static util::MidiParser inject_parser;
+
+// Stamped with the cycle count on arrival
+struct Injected {
+  util::MidiMessage message;
+  uint32_t cycles;
+};
+static util::RingBuffer<Injected, 64> injected;
+
+static uint16_t pitch_table[128];
+static int32_t bend_offset;
+static uint32_t retrigger_mask;
+
+// Edited by the setters in the UI loop, published to the core ISR as a whole
+static Settings edit;
+static util::Seqlock<Settings> settings;
+// What the core ISR uses; not refreshed from the snapshot while a preset
+// recall is held
+static Settings active;
+static volatile bool held;
+
+static uint32_t messages;
+static uint32_t dropped;
+static uint32_t pending_since;  // Earliest arrival handled this tick
+static bool pending;
+// Last tick that found no USB message waiting; later messages arrived after it
+static uint32_t usb_empty_since;
+static util::RunningStats latency_cycles;
+
+static inline size_t pitch_channel(size_t voice) { return 2 * voice; }
+static inline size_t gate_channel(size_t voice) { return 2 * voice + 1; }
+
+static void ComputePitchTable(uint8_t base_note, uint32_t codes_per_octave) {
+  for (int note = 0; note < 128; ++note) {
+    int32_t code = (note - base_note) * static_cast<int32_t>(codes_per_octave) / 12;
+    if (code < 0) code = 0;
+    if (code > DAC::kMaxValue) code = DAC::kMaxValue;
+    pitch_table[note] = code;
+  }
+}
+
+static inline void UpdatePitch(size_t voice) {
+  int32_t code = pitch_table[voices.note(voice) & 0x7F] + bend_offset;
+  if (code < 0) code = 0;
+  if (code > DAC::kMaxValue) code = DAC::kMaxValue;
+  DAC::set(pitch_channel(voice), code);
+}
+
+static void FASTRUN HandleMessage(const util::MidiMessage &message, const Settings &current,
+                                  uint32_t arrival) {
+  uint8_t type = message.type();
+  if (type < 0xF0 && current.channel != kOmni && message.channel() != current.channel)
+    return;
+
+  switch (type) {
+    case util::MIDI_NOTE_ON:
+      if (message.data2) {
+        size_t voice = voices.NoteOn(message.data1);
+        UpdatePitch(voice);
+        EVENTS::Post(EVENTS::EVENT_NOTE_ON, voice, message.data1 | message.data2 << 8);
+        if (DAC::value(gate_channel(voice)) != DAC::kGateLow) {
+          // Stolen or retriggered voice: drop the gate for one tick
+          DAC::set_gate(gate_channel(voice), false);
+          retrigger_mask |= 1UL << voice;
+        } else {
+          DAC::set_gate(gate_channel(voice), true);
+        }
+        break;
+      }
+      // Note on with velocity 0 is a note off
+      [[fallthrough]];
+    case util::MIDI_NOTE_OFF: {
+      int voice = voices.NoteOff(message.data1);
+      if (voice >= 0) {
+        retrigger_mask &= ~(1UL << voice);
+        DAC::set_gate(gate_channel(voice), false);
+        EVENTS::Post(EVENTS::EVENT_NOTE_OFF, voice, message.data1);
+      }
+    } break;
+    case util::MIDI_PITCH_BEND:
+      bend_offset = (static_cast<int64_t>(message.data14() - 8192) * current.bend_range *
+                     static_cast<int32_t>(kDefaultCodesPerOctave / 12)) >> 13;
+      for (size_t voice = 0; voice < voices.num_voices(); ++voice)
+        UpdatePitch(voice);
+      break;
+    case util::MIDI_CONTROL_CHANGE:
+      if (message.data1 == 123) {  // All notes off
+        voices.AllOff();
+        retrigger_mask = 0;
+        for (size_t voice = 0; voice < voices.num_voices(); ++voice)
+          DAC::set_gate(gate_channel(voice), false);
+        break;
+      }
+      for (size_t channel = 0; channel < DAC::kNumChannels; ++channel) {
+        if (current.cc_map[channel] == message.data1)
+          DAC::set(channel, (message.data2 * DAC::kMaxValue) / 127);
+      }
+      break;
+    case util::MIDI_CLOCK:
+      CLOCK::MidiClock(arrival);
+      ++messages;
+      return;
+    case util::MIDI_START:
+      CLOCK::MidiStart();
+      break;
+    case util::MIDI_CONTINUE:
+      CLOCK::MidiContinue();
+      break;
+    case util::MIDI_STOP:
+      CLOCK::MidiStop();
+      break;
+    case util::MIDI_SONG_POSITION:
+      CLOCK::MidiSongPosition(message.data14());
+      break;
+    default:
+      return;
+  }
+
+  ++messages;
+  if (!pending || static_cast<int32_t>(arrival - pending_since) < 0) {
+    pending = true;
+    pending_since = arrival;
+  }
+}
+
+void Init() {
+  voices.Init(kDefaultVoices);
+  inject_parser.Reset();
+  injected.Init();
+  ComputePitchTable(kDefaultBaseNote, kDefaultCodesPerOctave);
+  bend_offset = 0;
+  edit.channel = kOmni;
+  edit.bend_range = kDefaultBendRange;
+  for (auto &cc : edit.cc_map)
+    cc = -1;
+  settings.Init(edit);
+  active = edit;
+  held = false;
+  retrigger_mask = 0;
+  usb_empty_since = ARM_DWT_CYCCNT;
+  ResetStats();
+}
+
+void FASTRUN Tick() {
+  // Gates dropped for a retrigger last tick go back up
+  uint32_t retrigger = retrigger_mask;
+  retrigger_mask = 0;
+  while (retrigger) {
+    size_t voice = __builtin_ctz(retrigger);
+    retrigger &= retrigger - 1;
+    DAC::set_gate(gate_channel(voice), true);
+  }
+
+  // One consistent copy for the whole tick
+  if (!held)
+    settings.Read(active);
+  const Settings &current = active;
+
+  size_t budget = kMessagesPerTick;
+  Injected entry;
+  while (budget && injected.Read(entry)) {
+    HandleMessage(entry.message, current, entry.cycles);
+    --budget;
+  }
+#if defined(MIDI_INTERFACE)
+  const uint32_t now = ARM_DWT_CYCCNT;
+  util::MidiMessage message;
+  while (budget) {
+    if (!usbMIDI.read()) {
+      usb_empty_since = now;
+      break;
+    }
+    uint8_t type = usbMIDI.getType();
+    message.status = type < 0xF0 ? type | ((usbMIDI.getChannel() - 1) & 0x0F) : type;
+    message.data1 = usbMIDI.getData1();
+    message.data2 = usbMIDI.getData2();
+    HandleMessage(message, current, usb_empty_since);
+    --budget;
+  }
+#endif
+}
+
+void FASTRUN Written(uint32_t cycles) {
+  if (pending) {
+    pending = false;
+    latency_cycles.Push(cycles - pending_since);
+  }
+}
+
+void Inject(const uint8_t *data, size_t length) {
+  Injected entry;
+  while (length--) {
+    if (inject_parser.Parse(*data++, entry.message)) {
+      entry.cycles = ARM_DWT_CYCCNT;
+      if (!injected.Write(entry))
+        ++dropped;
+    }
+  }
+}
+
+static void FASTRUN InitVoices(size_t num_voices) {
+  for (size_t voice = 0; voice < voices.num_voices(); ++voice)
+    DAC::set_gate(gate_channel(voice), false);
+  voices.Init(num_voices);
+  retrigger_mask = 0;
+}
+
+void set_voices(size_t num_voices) {
+  if (num_voices > kMaxVoices)
+    num_voices = kMaxVoices;
+  noInterrupts();
+  InitVoices(num_voices);
+  for (size_t channel = 0; channel < 2 * num_voices; ++channel)
+    edit.cc_map[channel] = -1;
+  settings.Write(edit);
+  interrupts();
+}
+
+void set_channel(int channel) {
+  edit.channel = (channel >= 0 && channel < 16) ? channel : kOmni;
+  settings.Write(edit);
+}
+
+void set_bend_range(uint8_t semitones) {
+  edit.bend_range = semitones;
+  settings.Write(edit);
+}
+
+void map_cc(size_t dac_channel, int cc) {
+  if (dac_channel >= DAC::kNumChannels || dac_channel < 2 * voices.num_voices())
+    return;
+  edit.cc_map[dac_channel] = (cc >= 0 && cc < 128) ? cc : -1;
+  settings.Write(edit);
+}
+
+size_t num_voices() {
+  return voices.num_voices();
+}
+
+void set_settings(const Settings &values) {
+  edit = values;
+  // CCs can't take the voice channels
+  for (size_t channel = 0; channel < 2 * voices.num_voices(); ++channel)
+    edit.cc_map[channel] = -1;
+  settings.Write(edit);
+}
+
+void StageRecall(const Settings &values, size_t num_voices) {
+  if (num_voices > kMaxVoices)
+    num_voices = kMaxVoices;
+  held = true;
+  edit = values;
+  for (size_t channel = 0; channel < 2 * num_voices; ++channel)
+    edit.cc_map[channel] = -1;
+  settings.Write(edit);
+}
+
+void FASTRUN ApplyRecall(size_t num_voices) {
+  if (num_voices > kMaxVoices)
+    num_voices = kMaxVoices;
+  if (num_voices != voices.num_voices())
+    InitVoices(num_voices);
+  held = false;
+}
+
+Settings current_settings() {
+  return settings.Read();
+}
+
+SettingsStats settings_stats() {
+  return { settings.writes(), settings.reads(), settings.retries(), settings.max_retries() };
+}
+
+uint16_t pitch_code(uint8_t note) {
+  return pitch_table[note & 0x7F];
+}
+
+uint32_t message_count() {
+  return messages;
+}
+
+uint32_t dropped_count() {
+  return dropped;
+}
+
+const util::RunningStats &latency() {
+  return latency_cycles;
+}
+
+void ResetStats() {
+  noInterrupts();
+  messages = 0;
+  dropped = 0;
+  pending = false;
+  latency_cycles.Reset();
+  interrupts();
+  settings.ResetStats();
+}
+
+}; // namespace MIDI
+}; // namespace OC
@@ -0,0 +1,96 @@
+// OC_midi.h - USB MIDI to CV/gate
+//
+// usbMIDI is drained from the core ISR, so a message is converted and written
+// to the DAC in the same tick it is picked up, i.e. within one tick of its
+// arrival. Voice i uses DAC channel 2i for pitch and 2i+1 for its gate; any
+// remaining channel can follow a CC.
+
+#ifndef OC_MIDI_H_
+#define OC_MIDI_H_
+
+#include <stdint.h>
+#include "OC_DAC.h"
+#include "util/util_midi.h"
+#include "util/util_stats.h"
+
+namespace OC {
+namespace MIDI {
+
+static constexpr size_t kMaxVoices = DAC::kNumChannels / 2;
+static constexpr size_t kDefaultVoices = 3;
+
+// Upper bound on messages handled per tick to bound the ISR time
+static constexpr size_t kMessagesPerTick = 8;
+
+// Pitch calibration: 1V/oct with 5V full scale, C1 (note 24) at 0V
+static constexpr uint8_t kDefaultBaseNote = 24;
+static constexpr uint32_t kDefaultCodesPerOctave = 65536 / 5;
+static constexpr uint8_t kDefaultBendRange = 2;
+
+static constexpr int kOmni = -1;
+
+// Parameters read by the core ISR. The setters below publish them as one
+// snapshot (util/util_seqlock.h), so a tick never sees half an update and
+// neither side masks interrupts. The setters are for the UI loop only, as
+// the snapshot has a single writer.
+struct Settings {
+  int8_t channel;  // 0-15 or kOmni
+  uint8_t bend_range;
+  int8_t cc_map[DAC::kNumChannels];  // CC per DAC channel, -1 if none
+};
+
+struct SettingsStats {
+  uint32_t writes;
+  uint32_t reads;
+  uint32_t retries;      // Reads that overlapped a write and copied again
+  uint32_t max_retries;  // Of a single read
+};
+
+void Init();
+
+// Called from the core ISR before the DAC update
+void Tick();
+
+// Called from the core ISR once the DAC writes for this tick completed
+void Written(uint32_t cycles);
+
+// Feed raw MIDI bytes from the UI loop, e.g. the 'n' debug command or a host
+// test. Messages are stamped on arrival and handled at the next tick.
+void Inject(const uint8_t *data, size_t length);
+
+void set_voices(size_t num_voices);
+size_t num_voices();
+void set_channel(int midi_channel);  // 0-15 or kOmni
+void set_bend_range(uint8_t semitones);
+void map_cc(size_t dac_channel, int cc);  // cc < 0 unmaps
+// Replace all settings at once
+void set_settings(const Settings &settings);
+
+// Preset recall, so the MIDI part switches in the same tick as the rest of a
+// preset. StageRecall() (UI loop) publishes the settings, but the core ISR
+// keeps using the ones it has until ApplyRecall() (core ISR) sets the number
+// of voices and releases them.
+void StageRecall(const Settings &settings, size_t num_voices);
+void ApplyRecall(size_t num_voices);
+
+// Precomputed DAC code for a note, without bend
+uint16_t pitch_code(uint8_t note);
+
+Settings current_settings();
+SettingsStats settings_stats();
+
+uint32_t message_count();
+uint32_t dropped_count();
+
+// Cycles from a message's arrival to the DAC write for its tick completing,
+// for the earliest message of each tick. Injected messages are stamped in
+// Inject(). The USB stack doesn't timestamp messages, so USB messages count
+// from the last tick that found none waiting; they can't have arrived
+// earlier, so for them this is an upper bound.
+const util::RunningStats &latency();
+void ResetStats();
+
+}; // namespace MIDI
+}; // namespace OC
+
+#endif // OC_MIDI_H_
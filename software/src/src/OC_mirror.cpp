@@ -0,0 +1,103 @@
+// OC_mirror.cpp - Screen mirroring to the host implementation
+
+#include <Arduino.h>
+#include <string.h>
+#include "OC_mirror.h"
+#include "OC_packet.h"
+#include "drivers/display.h"
+#include "util/util_delta_rle.h"
+
+namespace OC {
+namespace MIRROR {
+
+static_assert(kFrameSize == SH1106_128x64_Driver::kFrameSize, "Mirror frame size");
+
+static constexpr size_t kHeaderSize = PACKET::kHeaderSize;
+static constexpr size_t kSequenceSize = 4;
+static constexpr size_t kMaxPacketSize =
+    kHeaderSize + kSequenceSize + util::DeltaRLE::MaxEncodedSize(kFrameSize);
+
+static bool running_;
+static bool need_key_frame;
+static uint32_t sequence;
+static uint32_t since_key_frame;
+// What the host has, so a dropped frame is folded into the next delta
+static uint8_t reference[kFrameSize];
+static uint8_t packet[kMaxPacketSize];
+
+static uint32_t frames;
+static uint32_t key_frames;
+static uint32_t dropped;
+static uint32_t bytes;
+static uint32_t max_bytes;
+
+void Init() {
+  running_ = false;
+  ResetStats();
+  display::present_hook = Present;
+}
+
+void Start() {
+  sequence = 0;
+  need_key_frame = true;
+  running_ = true;
+}
+
+void Stop() {
+  running_ = false;
+}
+
+bool running() {
+  return running_;
+}
+
+void Present(const uint8_t *frame) {
+  if (!running_)
+    return;
+  if (!Serial) {
+    ++dropped;
+    return;
+  }
+
+  bool key_frame = need_key_frame || since_key_frame + 1 >= kKeyFrameInterval;
+  size_t length = util::DeltaRLE::Encode(frame, key_frame ? nullptr : reference, kFrameSize,
+                                         packet + kHeaderSize + kSequenceSize);
+  size_t payload_length = kSequenceSize + length;
+  PACKET::WriteHeader(packet, key_frame ? PACKET::MIRROR_KEY_FRAME : PACKET::MIRROR_DELTA_FRAME,
+                      payload_length);
+  memcpy(packet + kHeaderSize, &sequence, kSequenceSize);
+  size_t packet_length = kHeaderSize + payload_length;
+  ++sequence;
+
+  // Never wait for the host: a partial packet would be worse than none
+  if (static_cast<size_t>(Serial.availableForWrite()) < packet_length) {
+    ++dropped;
+    return;
+  }
+  Serial.write(packet, packet_length);
+  memcpy(reference, frame, kFrameSize);
+
+  need_key_frame = false;
+  since_key_frame = key_frame ? 0 : since_key_frame + 1;
+  ++frames;
+  if (key_frame)
+    ++key_frames;
+  bytes += packet_length;
+  if (packet_length > max_bytes)
+    max_bytes = packet_length;
+}
+
+Stats stats() {
+  return { frames, key_frames, dropped, bytes, max_bytes };
+}
+
+void ResetStats() {
+  frames = 0;
+  key_frames = 0;
+  dropped = 0;
+  bytes = 0;
+  max_bytes = 0;
+}
+
+}; // namespace MIRROR
+}; // namespace OC
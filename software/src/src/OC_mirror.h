@@ -0,0 +1,53 @@
+// OC_mirror.h - Screen mirroring to the host over USB serial
+//
+// While running, every frame the display starts to present is sent to the
+// host as an XOR delta against the last frame sent, run-length coded
+// (util_delta_rle.h). A key frame (delta against blank) goes out when
+// mirroring starts and every kKeyFrameInterval frames, so a viewer can join
+// at any time. A frame is only written if the whole packet fits in the USB
+// transmit buffer. Otherwise it is dropped and the next delta is still taken
+// against the last frame sent, so rendering never waits for the host.
+//
+// Frames go out as packets (OC_packet.h), so the host can tell them from the
+// debug text:
+// MIRROR_KEY_FRAME / MIRROR_DELTA_FRAME: uint32 frame sequence number, then
+//   the coded frame
+// See tools/screen_view.py for a viewer.
+
+#ifndef OC_MIRROR_H_
+#define OC_MIRROR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace OC {
+namespace MIRROR {
+
+static constexpr size_t kFrameSize = 128 * 64 / 8;
+static constexpr uint32_t kKeyFrameInterval = 60;
+
+struct Stats {
+  uint32_t frames;      // Frames sent
+  uint32_t key_frames;
+  uint32_t dropped;     // Not sent because the host wasn't reading
+  uint32_t bytes;       // Packet bytes sent, including headers
+  uint32_t max_bytes;   // Largest packet
+};
+
+// Registers with the display; called from setup()
+void Init();
+
+void Start();
+void Stop();
+bool running();
+
+// Called with each frame as the display starts presenting it
+void Present(const uint8_t *frame);
+
+Stats stats();
+void ResetStats();
+
+}; // namespace MIRROR
+}; // namespace OC
+
+#endif // OC_MIRROR_H_
@@ -0,0 +1,147 @@
+// OC_output_queue.cpp - Timestamped output events implementation
+
+#include <Arduino.h>
+#include "OC_output_queue.h"
+#include "util/util_mpsc_queue.h"
+
+namespace OC {
+
+// Pending event in the ISR heap. The sequence number keeps events for the
+// same tick in posting order, so the last change to a channel wins.
+struct PendingEvent {
+  OutputQueue::Event event;
+  uint32_t sequence;
+};
+
+static util::MpscQueue<OutputQueue::Event, OutputQueue::kQueueSize> queue;
+static PendingEvent heap[OutputQueue::kMaxPending];
+static size_t heap_size;
+static uint32_t sequence;
+
+static uint32_t posted;
+static uint32_t applied;
+static uint32_t late;
+static uint32_t dropped;
+static uint32_t max_pending;
+
+static inline bool Earlier(const PendingEvent &a, const PendingEvent &b) {
+  int32_t dt = static_cast<int32_t>(a.event.tick - b.event.tick);
+  return dt < 0 || (!dt && static_cast<int32_t>(a.sequence - b.sequence) < 0);
+}
+
+static void HeapPush(const OutputQueue::Event &event) {
+  size_t i = heap_size++;
+  PendingEvent pending = { event, sequence++ };
+  while (i) {
+    size_t parent = (i - 1) / 2;
+    if (!Earlier(pending, heap[parent]))
+      break;
+    heap[i] = heap[parent];
+    i = parent;
+  }
+  heap[i] = pending;
+}
+
+static void HeapPop() {
+  PendingEvent last = heap[--heap_size];
+  size_t i = 0;
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= heap_size)
+      break;
+    if (child + 1 < heap_size && Earlier(heap[child + 1], heap[child]))
+      ++child;
+    if (!Earlier(heap[child], last))
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+}
+
+// With the heap full: the latest event is one of the leaves. If the new event
+// is earlier, it takes the leaf's place and moves up; otherwise it is dropped.
+static void HeapReplaceLatest(const OutputQueue::Event &event) {
+  size_t latest = heap_size / 2;
+  for (size_t i = latest + 1; i < heap_size; ++i) {
+    if (Earlier(heap[latest], heap[i]))
+      latest = i;
+  }
+  ++dropped;
+  PendingEvent pending = { event, sequence++ };
+  if (!Earlier(pending, heap[latest]))
+    return;
+  size_t i = latest;
+  while (i) {
+    size_t parent = (i - 1) / 2;
+    if (!Earlier(pending, heap[parent]))
+      break;
+    heap[i] = heap[parent];
+    i = parent;
+  }
+  heap[i] = pending;
+}
+
+/*static*/
+void OutputQueue::Init() {
+  queue.Init();
+  heap_size = 0;
+  sequence = 0;
+  ResetStats();
+}
+
+/*static*/
+bool OutputQueue::Push(const Event &event) {
+  if (event.channel >= DAC::kNumChannels || !queue.Push(event))
+    return false;
+  __atomic_fetch_add(&posted, 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+/*static*/
+void FASTRUN OutputQueue::Apply(uint32_t tick) {
+  Event event;
+  while (queue.Pop(event)) {
+    if (heap_size < kMaxPending)
+      HeapPush(event);
+    else
+      HeapReplaceLatest(event);
+  }
+  if (heap_size > max_pending)
+    max_pending = heap_size;
+
+  while (heap_size) {
+    const Event &next = heap[0].event;
+    int32_t due = static_cast<int32_t>(tick - next.tick);
+    if (due < 0)
+      break;
+    if (due > 0)
+      ++late;
+    if (next.type == EVENT_GATE)
+      DAC::set_gate(next.channel, next.value);
+    else
+      DAC::set(next.channel, next.value);
+    ++applied;
+    HeapPop();
+  }
+}
+
+/*static*/
+OutputQueue::Stats OutputQueue::stats() {
+  return { posted, applied, late, queue.overflows(), dropped, max_pending };
+}
+
+/*static*/
+size_t OutputQueue::pending() {
+  return heap_size + queue.readable();
+}
+
+/*static*/
+void OutputQueue::ResetStats() {
+  noInterrupts();
+  posted = applied = late = dropped = max_pending = 0;
+  queue.ResetOverflows();
+  interrupts();
+}
+
+}; // namespace OC
@@ -0,0 +1,78 @@
+// OC_output_queue.h - Timestamped output events
+//
+// Producers in any context (UI loop, MIDI, clock, sequencers) post value or
+// gate changes for a future core tick. The core ISR applies each event at the
+// start of exactly that tick, in timestamp order, so changes scheduled ahead
+// of time from slow contexts carry no jitter of their own.
+//
+// Posting is lock-free for multiple producers (util::MpscQueue); the core ISR
+// is the single consumer and keeps pending events in a small min-heap. The
+// queue is drained every tick even when the heap is full: an event earlier
+// than the latest pending one takes its place, and the event furthest in the
+// future is dropped, so far-future events never hold up due ones.
+//
+// The clock outputs schedule their gate falls here (OC_clock.cpp).
+
+#ifndef OC_OUTPUT_QUEUE_H_
+#define OC_OUTPUT_QUEUE_H_
+
+#include <stdint.h>
+#include "OC_DAC.h"
+
+namespace OC {
+
+class OutputQueue {
+public:
+  // Events in flight from producers to the core ISR
+  static constexpr size_t kQueueSize = 128;
+  // Events waiting in the ISR for their tick
+  static constexpr size_t kMaxPending = 128;
+
+  enum EventType : uint8_t {
+    EVENT_VALUE,
+    EVENT_GATE,
+  };
+
+  struct Event {
+    uint32_t tick;
+    uint8_t channel;
+    uint8_t type;
+    uint16_t value;
+  };
+
+  struct Stats {
+    uint32_t posted;
+    uint32_t applied;
+    uint32_t late;        // Applied after their tick had passed
+    uint32_t overflows;   // Rejected because the queue was full
+    uint32_t dropped;     // Furthest in the future while the heap was full
+    uint32_t max_pending;
+  };
+
+  static void Init();
+
+  // Schedule a value or gate change for core tick `tick` (compare with
+  // CORE::ticks). Returns false if the queue is full.
+  static bool Post(uint32_t tick, size_t channel, uint16_t value) {
+    return Push({tick, static_cast<uint8_t>(channel), EVENT_VALUE, value});
+  }
+
+  static bool PostGate(uint32_t tick, size_t channel, bool high) {
+    return Push({tick, static_cast<uint8_t>(channel), EVENT_GATE, high});
+  }
+
+  // Apply all events due at `tick`; called from the core ISR before any
+  // other output processing.
+  static void Apply(uint32_t tick);
+
+  static Stats stats();
+  static size_t pending();
+  static void ResetStats();
+
+private:
+  static bool Push(const Event &event);
+};
+
+}; // namespace OC
+
+#endif // OC_OUTPUT_QUEUE_H_
@@ -0,0 +1,19 @@
+// OC_packet.cpp - Binary packets on the USB serial port implementation
+
+#include <Arduino.h>
+#include "OC_packet.h"
+
+namespace OC {
+namespace PACKET {
+
+void Write(Type type, const void *payload, size_t length) {
+  if (length > kMaxPayload)
+    return;
+  uint8_t header[kHeaderSize];
+  WriteHeader(header, type, length);
+  Serial.write(header, sizeof(header));
+  Serial.write(static_cast<const uint8_t *>(payload), length);
+}
+
+}; // namespace PACKET
+}; // namespace OC
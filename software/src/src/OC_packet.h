@@ -0,0 +1,56 @@
+// OC_packet.h - Binary packets on the USB serial port
+//
+// Binary data shares the USB serial port with the debug commands and their
+// text replies, so every packet, in either direction, is framed the same way
+// (little-endian):
+//   kSync, type, uint16 payload length, payload
+// and all packet types are listed here, so one parser on either side can
+// tell every packet from the text and from each other. The payloads are
+// described with the modules that send or receive them.
+
+#ifndef OC_PACKET_H_
+#define OC_PACKET_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace OC {
+namespace PACKET {
+
+static constexpr uint8_t kSync = 0xA5;
+static constexpr size_t kHeaderSize = 4;
+static constexpr size_t kMaxPayload = 0xFFFF;
+
+enum Type : uint8_t {
+  // CV stream, host to Teensy (OC_stream.h, tools/cv_stream.py)
+  STREAM_START = 0x01,
+  STREAM_DATA = 0x02,
+  STREAM_STOP = 0x03,
+  // Screen mirror (OC_mirror.h, tools/screen_view.py)
+  MIRROR_KEY_FRAME = 0x10,
+  MIRROR_DELTA_FRAME = 0x11,
+  // Profiler dump (OC_profile.h, tools/profile_report.py)
+  PROFILE_HEADER = 0x20,
+  PROFILE_ENTRIES = 0x21,
+  // Trace dump (OC_trace.h, tools/trace_export.py)
+  TRACE_HEADER = 0x30,
+  TRACE_NAMES = 0x31,
+  TRACE_RECORDS = 0x32,
+};
+
+// Fill in the kHeaderSize bytes in front of a payload of `length` bytes
+static inline void WriteHeader(uint8_t *header, Type type, size_t length) {
+  header[0] = kSync;
+  header[1] = type;
+  header[2] = length & 0xFF;
+  header[3] = (length >> 8) & 0xFF;
+}
+
+// Send a packet, waiting for room in the USB buffer; for dumps from the UI
+// loop. Payloads over kMaxPayload aren't sent.
+void Write(Type type, const void *payload, size_t length);
+
+}; // namespace PACKET
+}; // namespace OC
+
+#endif // OC_PACKET_H_
@@ -0,0 +1,92 @@
+// OC_panel.cpp - Status panel implementation
+
+#include <Arduino.h>
+#include "OC_panel.h"
+#include "drivers/display.h"
+
+#ifdef USE_ILI9341_DISPLAY
+
+#include "OC_clock.h"
+#include "OC_core.h"
+#include "OC_DAC.h"
+
+namespace OC {
+namespace PANEL {
+
+static constexpr int kBarTop = 9;
+static constexpr int kBarHeight = ILI9341_Driver::kPanelHeight - kBarTop;
+static constexpr int kBarPitch = ILI9341_Driver::kPanelWidth / DAC::kNumChannels;
+
+// weegfx draws into whole 128x64 frames; the panel is the top pages
+static uint8_t surface[weegfx::Graphics::kFrameSize];
+static weegfx::Graphics panel_graphics;
+static uint32_t last_refresh;
+
+// ISR load since the last refresh
+static uint32_t last_ticks;
+static int64_t last_cycles;
+
+void Init() {
+  last_refresh = millis();
+  last_ticks = 0;
+  last_cycles = 0;
+}
+
+static float Load() {
+  noInterrupts();
+  uint32_t count = CORE::isr_cycles.count();
+  int64_t cycles = CORE::isr_cycles.sum();
+  interrupts();
+  // Stats may have been reset in the meantime
+  if (count < last_ticks) {
+    last_ticks = 0;
+    last_cycles = 0;
+  }
+  uint32_t ticks = count - last_ticks;
+  float load = ticks ? 100.f * (cycles - last_cycles) / (static_cast<float>(ticks) * CORE::kCyclesPerTick) : 0.f;
+  last_ticks = count;
+  last_cycles = cycles;
+  return load;
+}
+
+void Update() {
+  uint32_t now = millis();
+  if (now - last_refresh < kRefreshMs)
+    return;
+  last_refresh = now;
+
+  panel_graphics.Begin(surface, weegfx::CLEAR_FRAME_ENABLE);
+  panel_graphics.setPrintPos(0, 0);
+  panel_graphics.printf("CPU %4.1f%%", Load());
+  panel_graphics.setPrintPos(64, 0);
+  if (CLOCK::locked())
+    panel_graphics.printf("%5.1f BPM", CLOCK::bpm());
+  else
+    panel_graphics.print("  --- BPM");
+  for (size_t channel = 0; channel < DAC::kNumChannels; ++channel) {
+    int x = channel * kBarPitch;
+    int h = (DAC::value(channel) * kBarHeight + 0x8000) >> 16;
+    panel_graphics.drawFrame(x, kBarTop, kBarPitch - 1, kBarHeight);
+    if (h)
+      panel_graphics.drawRect(x, kBarTop + kBarHeight - h, kBarPitch - 1, h);
+  }
+  panel_graphics.End();
+
+  ILI9341_Driver::SetPanel(surface);
+}
+
+}; // namespace PANEL
+}; // namespace OC
+
+#else
+
+namespace OC {
+namespace PANEL {
+
+void Init() {}
+void Update() {}
+
+}; // namespace PANEL
+}; // namespace OC
+
+#endif // USE_ILI9341_DISPLAY
@@ -0,0 +1,26 @@
+// OC_panel.h - Status panel in the spare area of the TFT
+//
+// Redraws a small status surface (CPU load, tempo and a bar per DAC channel)
+// at kRefreshMs and hands it to the ILI9341 driver, which sends the rows that
+// changed in bus time the main view leaves free. Builds without the TFT
+// compile this to nothing.
+
+#ifndef OC_PANEL_H_
+#define OC_PANEL_H_
+
+#include <stdint.h>
+
+namespace OC {
+namespace PANEL {
+
+static constexpr uint32_t kRefreshMs = 250;
+
+void Init();
+
+// Called from loop(); redraws the panel when it is due
+void Update();
+
+}; // namespace PANEL
+}; // namespace OC
+
+#endif // OC_PANEL_H_
@@ -0,0 +1,163 @@
+// OC_player.cpp - CV and waveform file playback implementation
+
+#include <Arduino.h>
+#include <SD.h>
+#include "OC_player.h"
+#include "OC_audio.h"
+#include "OC_DAC.h"
+
+namespace OC {
+namespace PLAYER {
+
+// Block device on top of an SD file. Reads are sector aligned into aligned
+// buffers, so SdFat transfers straight into them without its sector cache.
+struct SDFileDevice {
+  File file;
+
+  bool Read(uint32_t offset, void *dst, size_t length) {
+    return file.seek(offset) && file.read(dst, length) == static_cast<int>(length);
+  }
+};
+
+util::RunningStats read_cycles;
+
+static bool card_present = false;
+static SDFileDevice device;
+static util::BlockPlayer<SDFileDevice, kBufferSize> player;
+static volatile State state_ = STATE_STOPPED;
+
+static uint32_t increment;
+static uint32_t phase;
+static uint32_t frames_played;
+static uint16_t last_frame[util::kCVFileMaxChannels];
+
+static void RenderFile(uint16_t *frames, size_t num_channels, size_t num_frames) {
+  for (size_t i = 0; i < num_frames; ++i, frames += num_channels) {
+    const uint16_t *frame = player.Next();
+    if (frame) {
+      for (size_t channel = 0; channel < num_channels; ++channel)
+        last_frame[channel] = frame[channel];
+      ++frames_played;
+    }
+    for (size_t channel = 0; channel < num_channels; ++channel)
+      frames[channel] = last_frame[channel];
+  }
+}
+
+void Init() {
+  card_present = SD.begin(BUILTIN_SDCARD);
+  state_ = STATE_STOPPED;
+  ResetStats();
+}
+
+Error Play(const char *path, bool loop) {
+  Stop();
+  if (!card_present) {
+    card_present = SD.begin(BUILTIN_SDCARD);
+    if (!card_present)
+      return ERROR_NO_CARD;
+  }
+
+  device.file = SD.open(path, FILE_READ);
+  if (!device.file)
+    return ERROR_OPEN;
+  if (player.Open(&device) != player.ERROR_NONE) {
+    device.file.close();
+    return ERROR_FORMAT;
+  }
+
+  const util::CVFileHeader &header = player.header();
+  bool audio = (header.sample_rate == AUDIO::SAMPLE_RATE_32K || header.sample_rate == AUDIO::SAMPLE_RATE_48K) &&
+               header.num_channels <= AUDIO::kMaxChannels;
+  if (!audio && header.sample_rate > kMaxCVRate) {
+    device.file.close();
+    return ERROR_RATE;
+  }
+
+  player.set_loop(loop);
+  for (size_t channel = 0; channel < header.num_channels; ++channel)
+    last_frame[channel] = DAC::value(header.channels[channel]);
+  ResetStats();
+  // Both buffers are full before the first frame is taken
+  Poll();
+
+  if (audio) {
+    AUDIO::set_render(RenderFile);
+    if (!AUDIO::Start(static_cast<AUDIO::SampleRate>(header.sample_rate), header.channels, header.num_channels)) {
+      AUDIO::set_render(nullptr);
+      device.file.close();
+      return ERROR_RATE;
+    }
+    state_ = STATE_PLAYING_AUDIO;
+  } else {
+    increment = (static_cast<uint64_t>(header.sample_rate) << 32) / CORE::kTickRate;
+    phase = 0 - increment;
+    state_ = STATE_PLAYING_CV;
+  }
+  return ERROR_NONE;
+}
+
+void Stop() {
+  State state = state_;
+  if (state == STATE_STOPPED)
+    return;
+  state_ = STATE_STOPPED;
+  if (state == STATE_PLAYING_AUDIO) {
+    AUDIO::Stop();
+    AUDIO::set_render(nullptr);
+  }
+  device.file.close();
+}
+
+void Poll() {
+  if (!device.file)
+    return;
+  uint32_t start = ARM_DWT_CYCCNT;
+  size_t blocks = player.Prefetch();
+  if (blocks)
+    read_cycles.Push((ARM_DWT_CYCCNT - start) / blocks);
+  if (state_ != STATE_STOPPED && player.finished())
+    Stop();
+}
+
+void FASTRUN Tick() {
+  if (state_ != STATE_PLAYING_CV)
+    return;
+
+  uint32_t next_phase = phase + increment;
+  bool due = next_phase < phase;
+  phase = next_phase;
+  if (!due)
+    return;
+
+  const uint16_t *frame = player.Next();
+  if (!frame)
+    return;
+  const util::CVFileHeader &header = player.header();
+  for (size_t channel = 0; channel < header.num_channels; ++channel)
+    DAC::set(header.channels[channel], frame[channel]);
+  ++frames_played;
+}
+
+State state() {
+  return state_;
+}
+
+const util::CVFileHeader &header() {
+  return player.header();
+}
+
+Stats stats() {
+  return { frames_played, player.blocks_read(), player.underruns(), player.read_errors(), player.buffered() };
+}
+
+void ResetStats() {
+  noInterrupts();
+  frames_played = 0;
+  player.ResetStats();
+  interrupts();
+  read_cycles.Reset();
+}
+
+}; // namespace PLAYER
+}; // namespace OC
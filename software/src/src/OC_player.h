@@ -0,0 +1,71 @@
+// OC_player.h - CV and waveform file playback from the SD card
+//
+// Streams files in the block layout of util/util_block_player.h from the
+// Teensy 4.1 SD slot. loop() reads whole blocks ahead into two buffers; the
+// output side only takes frames from the ready buffer:
+// - CV files (up to kMaxCVRate) play from the core tick into the DAC engine
+// - 32/48 kHz files with one or two channels play through OC::AUDIO
+// Each file channel goes to the DAC channel given in the file header.
+// tools/cv_file.py converts CSV data into this format.
+
+#ifndef OC_PLAYER_H_
+#define OC_PLAYER_H_
+
+#include <stdint.h>
+#include "OC_core.h"
+#include "util/util_block_player.h"
+#include "util/util_stats.h"
+
+namespace OC {
+namespace PLAYER {
+
+// Per buffer; at 8 channels x 1 kHz a block lasts ~1 s, at 2 x 48 kHz ~85 ms
+static constexpr size_t kBufferSize = 16384;
+static constexpr uint32_t kMaxCVRate = CORE::kTickRate / 2;
+
+enum State : uint8_t {
+  STATE_STOPPED,
+  STATE_PLAYING_CV,
+  STATE_PLAYING_AUDIO,
+};
+
+enum Error : uint8_t {
+  ERROR_NONE,
+  ERROR_NO_CARD,
+  ERROR_OPEN,
+  ERROR_FORMAT,
+  ERROR_RATE,
+};
+
+struct Stats {
+  uint32_t frames;
+  uint32_t blocks;
+  uint32_t underruns;
+  uint32_t read_errors;
+  uint32_t buffered;  // Frames ready to play
+};
+
+void Init();
+
+// Start playing `path`; stops whatever is playing first.
+Error Play(const char *path, bool loop);
+void Stop();
+
+// Prefetch blocks; called from loop()
+void Poll();
+
+// Called from the core ISR before the DAC update
+void Tick();
+
+State state();
+const util::CVFileHeader &header();
+
+// Time to read one block, in cycles
+extern util::RunningStats read_cycles;
+Stats stats();
+void ResetStats();
+
+}; // namespace PLAYER
+}; // namespace OC
+
+#endif // OC_PLAYER_H_
@@ -0,0 +1,240 @@
+// OC_preset.cpp - Preset save and recall implementation
+
+#include <Arduino.h>
+#include <string.h>
+#include <type_traits>
+#include "OC_core.h"
+#include "OC_preset.h"
+#include "util/util_record_log.h"
+
+namespace OC {
+namespace PRESET {
+
+static_assert(std::is_trivially_copyable<State>::value, "Presets are stored as bytes");
+
+}; // namespace PRESET
+}; // namespace OC
+
+// Teensy 4 core (eeprom.c); both run with interrupts disabled
+extern "C" void eepromemu_flash_write(void *addr, const void *data, uint32_t len);
+extern "C" void eepromemu_flash_erase_sector(void *addr);
+extern "C" unsigned long _flashimagelen;
+
+namespace OC {
+namespace PRESET {
+
+// The 64 KB right below the EEPROM emulation, which starts at 0x607C0000
+static constexpr uint32_t kFlashStart = 0x60000000;
+static constexpr uint32_t kFlashBase = 0x607B0000;
+static constexpr size_t kFlashSize = 0x10000;
+static constexpr size_t kSectorSize = 4096;
+
+// Latest point in a tick at which a write may start, so it is done before
+// the next tick is due
+static constexpr uint32_t kLatestWriteCycles = CORE::kCyclesPerTick / 4;
+
+struct FlashDevice {
+  void Read(uint32_t address, void *dst, size_t length) {
+    memcpy(dst, reinterpret_cast<const void *>(kFlashBase + address), length);
+  }
+
+  // Right after a core tick has run, so the core timer is never held off
+  void Write(uint32_t address, uint8_t value) {
+    const uint32_t tick = CORE::ticks;
+    for (;;) {
+      noInterrupts();
+      if (CORE::ticks != tick &&
+          ARM_DWT_CYCCNT - static_cast<uint32_t>(CORE::tick_cycles()) < kLatestWriteCycles)
+        break;
+      interrupts();
+    }
+    eepromemu_flash_write(reinterpret_cast<void *>(kFlashBase + address), &value, 1);
+    interrupts();
+  }
+
+  // Only from Init(), before the core timer runs
+  void Erase(uint32_t address) {
+    eepromemu_flash_erase_sector(reinterpret_cast<void *>(kFlashBase + address));
+  }
+};
+
+typedef util::RecordLog<FlashDevice, sizeof(State), kNumPresets,
+                        kFlashSize / util::RecordLogSlotSize(sizeof(State)), true> Log;
+
+util::RunningStats recall_cycles;
+util::RunningStats save_us;
+util::RunningStats step_cycles;
+util::RunningStats save_tick_lateness;
+
+static FlashDevice flash;
+static Log log_;
+static bool full;
+
+static State images[kNumPresets];
+static uint32_t valid_mask;
+
+// Recall() copies a preset into the buffer that isn't pending and hands it
+// over; the core ISR is done with a buffer once it has been replaced or taken
+static State handoff[2];
+static uint8_t next_handoff;
+static const State *volatile pending;
+static uint32_t recall_start;
+static uint32_t recalls;
+
+static uint32_t queued;
+static size_t saving;
+static uint32_t save_start;
+static volatile bool writing;
+static uint64_t last_tick;
+static uint32_t coalesced;
+
+static void Capture(State &state) {
+  // Padding too, so equal states store equal bytes
+  memset(&state, 0, sizeof(state));
+  state.num_voices = MIDI::num_voices();
+  state.midi = MIDI::current_settings();
+  const CLOCK::Engine &engine = CLOCK::engine();
+  for (size_t i = 0; i < CLOCK::kNumOutputs; ++i) {
+    state.outputs[i].channel = CLOCK::output_channel(i);
+    state.outputs[i].num = engine.num(i);
+    state.outputs[i].den = engine.den(i);
+  }
+  state.pulse_width_us = CLOCK::pulse_width();
+  for (size_t channel = 0; channel < DAC::kNumChannels; ++channel) {
+    state.rate[channel] = DAC::rate(channel);
+    state.dither[channel] = DAC::dither(channel);
+  }
+}
+
+// Only what changed, so running clock outputs, dither modulators and MIDI
+// voices that a preset leaves alone aren't reset
+static void FASTRUN Apply(const State &state) {
+  MIDI::ApplyRecall(state.num_voices);
+  const CLOCK::Engine &engine = CLOCK::engine();
+  for (size_t i = 0; i < CLOCK::kNumOutputs; ++i) {
+    const auto &output = state.outputs[i];
+    if (output.channel != CLOCK::output_channel(i) || output.num != engine.num(i) ||
+        output.den != engine.den(i))
+      CLOCK::set_output(i, output.channel, output.num, output.den);
+  }
+  CLOCK::set_pulse_width(state.pulse_width_us);
+  for (size_t channel = 0; channel < DAC::kNumChannels; ++channel) {
+    if (state.rate[channel] != DAC::rate(channel))
+      DAC::set_rate(channel, static_cast<DAC::RateClass>(state.rate[channel]));
+    if (state.dither[channel] != DAC::dither(channel))
+      DAC::set_dither(channel, static_cast<DAC::DitherMode>(state.dither[channel]));
+  }
+}
+
+void Init() {
+  log_.Init(&flash, 0);
+  State startup;
+  Capture(startup);
+  // A firmware image grown into the region is never read, erased or written
+  full = kFlashStart + reinterpret_cast<uintptr_t>(&_flashimagelen) > kFlashBase;
+  valid_mask = 0;
+  if (!full) {
+    valid_mask = log_.Scan();
+    log_.Reclaim(kSectorSize);
+  }
+  for (size_t preset = 0; preset < kNumPresets; ++preset) {
+    if (!log_.Load(preset, &images[preset]))
+      images[preset] = startup;
+  }
+  queued = 0;
+  ResetStats();
+}
+
+void FASTRUN Tick() {
+  // Writes are placed between ticks, so this should stay at zero
+  const uint64_t now = CORE::tick_cycles();
+  if (writing && last_tick)
+    save_tick_lateness.Push(static_cast<int32_t>(now - last_tick - CORE::kCyclesPerTick));
+  last_tick = now;
+
+  const State *state = __atomic_exchange_n(&pending, nullptr, __ATOMIC_ACQUIRE);
+  if (state) {
+    Apply(*state);
+    recall_cycles.Push(ARM_DWT_CYCCNT - recall_start);
+  }
+}
+
+void Recall(size_t preset) {
+  if (preset >= kNumPresets)
+    return;
+  State *state = &handoff[next_handoff];
+  next_handoff ^= 1;
+  *state = images[preset];
+  MIDI::StageRecall(state->midi, state->num_voices);
+
+  recall_start = ARM_DWT_CYCCNT;
+  __atomic_store_n(&pending, state, __ATOMIC_RELEASE);
+  ++recalls;
+}
+
+void Save(size_t preset) {
+  if (preset >= kNumPresets)
+    return;
+  // A recall works on its own copy, so this can't change one in flight
+  Capture(images[preset]);
+
+  uint32_t bit = 1UL << preset;
+  if (queued & bit)
+    ++coalesced;
+  queued |= bit;
+}
+
+void Poll() {
+  if (!log_.busy()) {
+    if (!queued || full)
+      return;
+    saving = __builtin_ctz(queued);
+    // The log copies the image, so the preset can be saved again meanwhile.
+    // With no erased slot left, saves wait for the reclaim at the next boot.
+    if (!log_.Begin(saving, &images[saving])) {
+      full = true;
+      return;
+    }
+    queued &= ~(1UL << saving);
+    save_start = micros();
+    writing = true;
+  }
+
+  uint32_t start = ARM_DWT_CYCCNT;
+  bool done = log_.Step(kBytesPerPoll);
+  step_cycles.Push(ARM_DWT_CYCCNT - start);
+  if (done) {
+    save_us.Push(micros() - save_start);
+    valid_mask |= 1UL << saving;
+    writing = false;
+  }
+}
+
+bool valid(size_t preset) {
+  return preset < kNumPresets && (valid_mask & (1UL << preset));
+}
+
+size_t num_slots() {
+  return Log::kStorageSize / Log::kSlotSize;
+}
+
+Stats stats() {
+  const Log::Stats &log_stats = log_.stats();
+  return { recalls, log_stats.saves, coalesced, queued, valid_mask, log_stats.discarded,
+           static_cast<uint32_t>(log_.next_slot()), static_cast<uint32_t>(log_.erased_slots()),
+           log_stats.erases, full };
+}
+
+void ResetStats() {
+  noInterrupts();
+  recall_cycles.Reset();
+  save_tick_lateness.Reset();
+  interrupts();
+  save_us.Reset();
+  step_cycles.Reset();
+  recalls = 0;
+  coalesced = 0;
+}
+
+}; // namespace PRESET
+}; // namespace OC
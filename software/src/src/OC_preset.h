@@ -0,0 +1,108 @@
+// OC_preset.h - Preset save and recall
+//
+// The settings that make up a patch (MIDI voices and mapping, clock outputs,
+// DAC rate classes and dither) are gathered in a compact State struct. Every
+// preset has a prebuilt image in RAM, loaded from flash at startup, so a
+// recall doesn't read or convert anything: Recall() copies the image into a
+// handoff buffer and the next tick applies all of it at once, MIDI voices
+// included, before any output is computed. The MIDI settings are published
+// through their seqlock from the UI loop, but the core ISR only takes them
+// up in the tick that applies the rest of the preset.
+//
+// The handoff buffers alternate, so Save() can capture into the preset's
+// image while a recall of it is still pending. Saves are queued and written
+// in the background by Poll() from loop(), a byte per call, through a
+// wear-leveled record log (util/util_record_log.h). Saving the same preset
+// again before its write starts just updates the queued image.
+//
+// Flash is programmed with interrupts disabled, so the presets don't use the
+// EEPROM emulation, which erases sectors in the middle of a write. They have
+// a 64 KB region of their own below it, in write-once mode: Init() erases
+// the sectors without a live preset before the core timer starts, and a save
+// only programs erased bytes, one at a time right after a core tick, so each
+// program is done before the next tick is due. Once the erased slots run out
+// (about a thousand saves), saves wait for the next boot. The core tick
+// lateness while a save is being written is measured; it should stay at zero.
+//
+// Recall latency (Recall() to applied) and save duration are measured.
+
+#ifndef OC_PRESET_H_
+#define OC_PRESET_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "OC_clock.h"
+#include "OC_DAC.h"
+#include "OC_midi.h"
+#include "util/util_stats.h"
+
+// Bytes written per Poll(); each waits for the start of a core tick
+#ifndef OC_PRESET_BYTES_PER_POLL
+#define OC_PRESET_BYTES_PER_POLL 1
+#endif
+
+namespace OC {
+namespace PRESET {
+
+static constexpr size_t kNumPresets = 8;
+static constexpr size_t kBytesPerPoll = OC_PRESET_BYTES_PER_POLL;
+
+struct State {
+  uint8_t num_voices;
+  MIDI::Settings midi;
+  struct {
+    int8_t channel;  // -1: off
+    uint8_t reserved;
+    int16_t num, den;
+  } outputs[CLOCK::kNumOutputs];
+  uint16_t pulse_width_us;
+  uint8_t rate[DAC::kNumChannels];    // DAC::RateClass
+  uint8_t dither[DAC::kNumChannels];  // DAC::DitherMode
+};
+
+struct Stats {
+  uint32_t recalls;
+  uint32_t saves;      // Written to flash
+  uint32_t coalesced;  // Saves that updated an image still queued
+  uint32_t pending;    // Mask of presets waiting to be written
+  uint32_t valid;      // Mask of presets found in or written to flash
+  uint32_t discarded;  // Corrupt slots found at startup
+  uint32_t next_slot;  // Where the next save goes, out of num_slots()
+  uint32_t free_slots; // Erased, i.e. saves left until the next boot
+  uint32_t erases;     // Sectors erased at startup
+  bool full;           // Saves wait for the next boot
+};
+
+// Cycles from Recall() to the state being applied by the core ISR
+extern util::RunningStats recall_cycles;
+// Microseconds from a save's first write to its last
+extern util::RunningStats save_us;
+// Cycles per Poll() write step, i.e. the longest the UI loop is held up
+extern util::RunningStats step_cycles;
+// Cycles by which core ticks came late while a save was being written
+extern util::RunningStats save_tick_lateness;
+
+// Load the stored presets and erase unused flash. Called by CORE::Init()
+// after the other modules, as presets that were never saved start out as the
+// current state, and before the core timer starts, as erases take a while.
+void Init();
+
+// Called from the core ISR before the outputs are updated
+void Tick();
+
+// UI loop. Presets without a stored image recall the startup state.
+void Recall(size_t preset);
+void Save(size_t preset);
+
+// Write queued saves; call from loop()
+void Poll();
+
+bool valid(size_t preset);
+size_t num_slots();
+Stats stats();
+void ResetStats();
+
+}; // namespace PRESET
+}; // namespace OC
+
+#endif // OC_PRESET_H_
@@ -0,0 +1,182 @@
+// OC_profile.cpp - Statistical sampling profiler implementation
+
+#include <Arduino.h>
+#include <string.h>
+#include "OC_packet.h"
+#include "OC_profile.h"
+
+namespace OC {
+namespace PROFILE {
+
+// GPT1 runs from the peripheral clock, which the Teensy 4 startup code sets
+// to the 24 MHz oscillator
+static constexpr uint32_t kTimerClock = 24000000;
+static constexpr uint32_t kMinRate = 100;
+static constexpr uint32_t kMaxRate = 100000;
+// Probes before a sample counts as dropped
+static constexpr size_t kMaxProbes = 16;
+
+util::RunningStats sample_cycles;
+
+static Entry table[kTableSize];
+static volatile uint32_t samples;
+static volatile uint32_t dropped;
+static volatile uint32_t entries;
+static bool running_;
+static bool record_lr;
+static uint32_t rate_;
+
+// Exception frame pushed on entry: r0-r3, r12, lr, pc, xpsr
+static void FASTRUN Sample(const uint32_t *frame) {
+  uint32_t start = ARM_DWT_CYCCNT;
+  GPT1_SR = GPT_SR_OF1;
+
+  const uint32_t pc = frame[6];
+  const uint32_t lr = record_lr ? frame[5] & ~1UL : 0;
+  uint32_t hash = ((pc >> 1) ^ (lr * 31)) * 2654435761UL >> (32 - kTableBits);
+  for (size_t probe = 0; probe < kMaxProbes; ++probe, ++hash) {
+    Entry &entry = table[hash & (kTableSize - 1)];
+    if (!entry.count) {
+      entry.pc = pc;
+      entry.lr = lr;
+      ++entries;
+    } else if (entry.pc != pc || entry.lr != lr) {
+      continue;
+    }
+    ++entry.count;
+    ++samples;
+    sample_cycles.Push(ARM_DWT_CYCCNT - start);
+    // The status flag has to be clear before the return, or it re-enters
+    asm volatile("dsb");
+    return;
+  }
+  ++dropped;
+  sample_cycles.Push(ARM_DWT_CYCCNT - start);
+  asm volatile("dsb");
+}
+
+// Hands Sample() the frame of the stack that was in use when the interrupt
+// came; its return is the exception return
+static void __attribute__((naked)) FASTRUN PROFILE_sample_ISR() {
+  asm volatile(
+      "tst lr, #4\n"
+      "ite eq\n"
+      "mrseq r0, msp\n"
+      "mrsne r0, psp\n"
+      "b %c0\n"
+      : : "i"(Sample));
+}
+
+void Start(uint32_t rate_hz, bool lr) {
+  Stop();
+  if (rate_hz < kMinRate) rate_hz = kMinRate;
+  if (rate_hz > kMaxRate) rate_hz = kMaxRate;
+  rate_ = rate_hz;
+  record_lr = lr;
+  ResetStats();
+
+  CCM_CCGR1 |= CCM_CCGR1_GPT1_BUS(CCM_CCGR_ON) | CCM_CCGR1_GPT1_SERIAL(CCM_CCGR_ON);
+  GPT1_CR = 0;
+  GPT1_PR = 0;
+  GPT1_SR = 0x3F;
+  GPT1_OCR1 = kTimerClock / rate_hz - 1;
+  GPT1_IR = GPT_IR_OF1IE;
+  attachInterruptVector(IRQ_GPT1, PROFILE_sample_ISR);
+  // Above the core timer, so ISRs are sampled too
+  NVIC_SET_PRIORITY(IRQ_GPT1, 0);
+  NVIC_ENABLE_IRQ(IRQ_GPT1);
+  // Peripheral clock, counter restarts at the compare
+  GPT1_CR = GPT_CR_EN | GPT_CR_ENMOD | GPT_CR_CLKSRC(1);
+  running_ = true;
+}
+
+void Stop() {
+  if (!running_)
+    return;
+  GPT1_CR = 0;
+  NVIC_DISABLE_IRQ(IRQ_GPT1);
+  GPT1_SR = 0x3F;
+  running_ = false;
+}
+
+bool running() {
+  return running_;
+}
+
+uint32_t rate() {
+  return rate_;
+}
+
+void Dump() {
+  Stop();
+  if (!Serial)
+    return;
+
+  struct __attribute__((packed)) {
+    uint32_t cpu_hz;
+    uint32_t rate_hz;
+    uint32_t samples;
+    uint32_t dropped;
+    uint32_t sample_cycles;
+    uint16_t entries;
+    uint8_t flags;
+  } header = { F_CPU, rate_, samples, dropped, static_cast<uint32_t>(sample_cycles.mean()),
+               static_cast<uint16_t>(entries), static_cast<uint8_t>(record_lr ? kFlagLR : 0) };
+  PACKET::Write(PACKET::PROFILE_HEADER, &header, sizeof(header));
+
+  // Blocking writes: the host asked for it and nothing is being sampled
+  Entry packet[kEntriesPerPacket];
+  size_t count = 0;
+  for (const Entry &entry : table) {
+    if (!entry.count)
+      continue;
+    packet[count++] = entry;
+    if (count == kEntriesPerPacket) {
+      PACKET::Write(PACKET::PROFILE_ENTRIES, packet, sizeof(packet));
+      count = 0;
+    }
+  }
+  if (count)
+    PACKET::Write(PACKET::PROFILE_ENTRIES, packet, count * sizeof(Entry));
+  Serial.flush();
+}
+
+void ResetStats() {
+  noInterrupts();
+  memset(table, 0, sizeof(table));
+  samples = 0;
+  dropped = 0;
+  entries = 0;
+  sample_cycles.Reset();
+  interrupts();
+}
+
+Stats stats() {
+  return { samples, dropped, entries };
+}
+
+float overhead() {
+  return static_cast<float>(sample_cycles.mean() * rate_ / F_CPU);
+}
+
+size_t Top(Entry *top, size_t count) {
+  size_t found = 0;
+  for (const Entry &entry : table) {
+    Entry copy = entry;  // A sample may update it meanwhile
+    if (!copy.count)
+      continue;
+    // Insert into the sorted list, dropping the smallest once full
+    size_t i = found < count ? found++ : count;
+    while (i > 0 && top[i - 1].count < copy.count) {
+      if (i < count)
+        top[i] = top[i - 1];
+      --i;
+    }
+    if (i < count)
+      top[i] = copy;
+  }
+  return found;
+}
+
+}; // namespace PROFILE
+}; // namespace OC
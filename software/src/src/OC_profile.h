@@ -0,0 +1,83 @@
+// OC_profile.h - Statistical sampling profiler
+//
+// While running, a GPT1 compare interrupt at the highest priority takes the
+// return address from the exception frame it pushed, i.e. the PC it
+// interrupted, and optionally LR, which for a leaf function is its caller.
+// Each (PC, LR) pair is counted in a fixed hash table, so memory doesn't
+// grow with the run time. Since the sampler preempts the core timer and the
+// DMA completions, time spent in ISRs shows up too. Samples that find the
+// table full are only counted as dropped.
+//
+// The overhead is set by the rate: the sampler's own cycles are measured and
+// reported as a share of the CPU (plus about 30 cycles of exception entry
+// and exit per sample, which it can't see).
+//
+// Dump() sends the table to the host as packets (OC_packet.h):
+// PROFILE_HEADER: uint32 cpu_hz, rate_hz, samples, dropped, sample cycles
+//                 (mean), uint16 entries, uint8 flags (kFlagLR)
+// PROFILE_ENTRIES: up to kEntriesPerPacket of uint32 pc, lr, count
+// tools/profile_report.py symbolizes the dump against firmware.elf into a
+// flat profile.
+
+#ifndef OC_PROFILE_H_
+#define OC_PROFILE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "util/util_stats.h"
+
+#ifndef OC_PROFILE_RATE_HZ
+#define OC_PROFILE_RATE_HZ 10000
+#endif
+
+// Also record LR, so leaf functions can be charged to their callers
+#ifndef OC_PROFILE_LR
+#define OC_PROFILE_LR 1
+#endif
+
+namespace OC {
+namespace PROFILE {
+
+static constexpr uint8_t kFlagLR = 0x01;
+static constexpr size_t kTableBits = 10;
+static constexpr size_t kTableSize = 1 << kTableBits;
+static constexpr size_t kEntriesPerPacket = 64;
+
+struct Entry {
+  uint32_t pc;
+  uint32_t lr;
+  uint32_t count;
+};
+
+struct Stats {
+  uint32_t samples;  // Counted in the table
+  uint32_t dropped;  // Table full
+  uint32_t entries;  // Distinct (PC, LR) pairs
+};
+
+// Cycles spent in the sampler per sample
+extern util::RunningStats sample_cycles;
+
+// Clears the table and starts sampling at `rate_hz` (100 Hz - 100 kHz)
+void Start(uint32_t rate_hz = OC_PROFILE_RATE_HZ, bool lr = OC_PROFILE_LR);
+void Stop();
+bool running();
+uint32_t rate();
+
+// Stop sampling and send the table to the host
+void Dump();
+
+// Clears the table too
+void ResetStats();
+Stats stats();
+
+// Share of the CPU taken by the sampler at the current rate, 0-1
+float overhead();
+
+// The `count` most frequent entries, most frequent first; returns how many
+size_t Top(Entry *entries, size_t count);
+
+}; // namespace PROFILE
+}; // namespace OC
+
+#endif // OC_PROFILE_H_
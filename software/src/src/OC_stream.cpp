@@ -0,0 +1,347 @@
+// OC_stream.cpp - CV streaming from the host implementation
+
+#include <Arduino.h>
+#include "OC_stream.h"
+#include "OC_events.h"
+#include "OC_packet.h"
+#include "util/util_ringbuffer.h"
+
+namespace OC {
+namespace STREAM {
+
+struct Frame {
+  uint16_t values[DAC::kNumChannels];
+};
+
+static constexpr size_t kFrameBytes = sizeof(Frame);
+
+// Shared with the core ISR
+static util::RingBuffer<Frame, kBufferFrames> frames;
+static volatile State state_ = STATE_IDLE;
+static volatile uint32_t target_;
+// Fill to start playing at. Blocks top the fill up, then it drains over a
+// block, so this puts the average fill at the target from the start.
+static volatile uint32_t start_;
+static uint32_t nominal_increment;
+static uint32_t increment;
+static uint32_t phase;
+static int32_t fill_q8;
+static int32_t ppm_per_frame;
+static volatile int32_t correction;
+static uint32_t frames_played;
+static uint32_t underruns;
+static uint32_t skipped;
+
+// Receiver state, loop() only
+enum ParserState : uint8_t {
+  PARSE_SYNC,
+  PARSE_HEADER,
+  PARSE_PAYLOAD,
+  PARSE_SKIP,
+};
+
+static ParserState parser_state = PARSE_SYNC;
+static uint8_t header[3];
+static size_t header_pos;
+static size_t payload_length;
+static size_t payload_pos;
+static uint8_t field[4];
+static Frame frame;
+static size_t frame_pos;
+
+static uint32_t sample_rate_;
+static bool have_reference;
+static uint32_t next_timestamp;
+static uint32_t last_arrival;
+static uint32_t last_timestamp;
+static float jitter_cycles;
+static size_t skip_frames;
+static Frame last_frame;
+
+static util::RunningStats arrival_;
+static uint32_t blocks;
+static uint32_t overruns;
+static uint32_t lost;
+static uint32_t late;
+static uint32_t errors;
+
+static inline uint32_t ReadU32(const uint8_t *data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+void Init() {
+  frames.Init();
+  state_ = STATE_IDLE;
+  parser_state = PARSE_SYNC;
+  sample_rate_ = 0;
+  correction = 0;
+  ResetStats();
+}
+
+void FASTRUN Tick() {
+  State state = state_;
+  if (state == STATE_IDLE)
+    return;
+
+  if (state == STATE_BUFFERING) {
+    if (frames.readable() < start_)
+      return;
+    // Blocks that arrived in a burst would take the trim up to a minute to
+    // play off, so drop the oldest frames instead
+    Frame excess;
+    while (frames.readable() > start_ && frames.Read(excess))
+      ++skipped;
+    state_ = STATE_PLAYING;
+    fill_q8 = target_ << 8;
+    phase = 0 - increment;  // First frame plays this tick
+  }
+
+  uint32_t next_phase = phase + increment;
+  bool due = next_phase < phase;
+  phase = next_phase;
+  if (!due)
+    return;
+
+  Frame next;
+  if (!frames.Read(next)) {
+    ++underruns;
+    state_ = STATE_BUFFERING;
+    EVENTS::Post(EVENTS::EVENT_UNDERRUN, EVENTS::SOURCE_STREAM);
+    return;
+  }
+  for (size_t channel = 0; channel < DAC::kNumChannels; ++channel)
+    DAC::set(channel, next.values[channel]);
+  ++frames_played;
+
+  // Trim the playback rate to hold the (smoothed) fill at the target
+  fill_q8 += ((static_cast<int32_t>(frames.readable()) << 8) - fill_q8) >> 10;
+  int64_t ppm = (static_cast<int64_t>(fill_q8 - static_cast<int32_t>(target_ << 8)) * ppm_per_frame) >> 8;
+  if (ppm > kMaxCorrectionPpm)
+    ppm = kMaxCorrectionPpm;
+  else if (ppm < -kMaxCorrectionPpm)
+    ppm = -kMaxCorrectionPpm;
+  correction = ppm;
+  increment = nominal_increment + static_cast<int64_t>(nominal_increment) * ppm / 1000000;
+}
+
+static void UpdateTarget(size_t block_frames) {
+  float jitter_frames = jitter_cycles * sample_rate_ / F_CPU;
+  size_t target = block_frames + static_cast<size_t>(4.f * jitter_frames) + kMinMarginFrames;
+  if (target > kBufferFrames - kMaxBlockFrames)
+    target = kBufferFrames - kMaxBlockFrames;
+  target_ = target;
+  start_ = target + block_frames / 2;
+}
+
+static void Start(uint32_t sample_rate) {
+  if (!sample_rate || sample_rate > kMaxSampleRate) {
+    ++errors;
+    return;
+  }
+
+  noInterrupts();
+  state_ = STATE_IDLE;
+  frames.Init();
+  interrupts();
+
+  sample_rate_ = sample_rate;
+  // From the tick period, as kTickRate is rounded down (by 40 ppm)
+  nominal_increment = ((static_cast<uint64_t>(sample_rate) << 32) * CORE::kTickUs) / 1000000;
+  increment = nominal_increment;
+  ppm_per_frame = 1000000 / (sample_rate * kCorrectionSeconds);
+  if (!ppm_per_frame)
+    ppm_per_frame = 1;
+  correction = 0;
+
+  have_reference = false;
+  skip_frames = 0;
+  jitter_cycles = kInitialJitterUs * CORE::kCyclesPerUs;
+  for (size_t channel = 0; channel < DAC::kNumChannels; ++channel)
+    last_frame.values[channel] = DAC::value(channel);
+  UpdateTarget(kMaxBlockFrames / 2);
+
+  state_ = STATE_BUFFERING;
+}
+
+static void Stop() {
+  state_ = STATE_IDLE;
+  sample_rate_ = 0;
+}
+
+static void PushFrame(const Frame &value) {
+  if (skip_frames) {
+    --skip_frames;
+    ++late;
+    return;
+  }
+  if (!frames.Write(value))
+    ++overruns;
+  last_frame = value;
+}
+
+static void BeginBlock(uint32_t timestamp, size_t block_frames) {
+  uint32_t now = ARM_DWT_CYCCNT;
+  ++blocks;
+
+  if (have_reference) {
+    // Interarrival deviation D and smoothed |D| as in RFC 3550; only the
+    // relative timing of neighbouring blocks matters, so clock drift
+    // doesn't accumulate into the estimate.
+    int32_t expected = static_cast<int32_t>(
+        static_cast<int64_t>(static_cast<int32_t>(timestamp - last_timestamp)) * F_CPU / sample_rate_);
+    int32_t deviation = static_cast<int32_t>(now - last_arrival) - expected;
+    // A pause longer than the buffer is a restart rather than jitter
+    if (fabsf(deviation) < static_cast<float>(kBufferFrames) * F_CPU / sample_rate_) {
+      arrival_.Push(deviation);
+      jitter_cycles += (fabsf(deviation) - jitter_cycles) / 16.f;
+    }
+
+    int32_t gap = static_cast<int32_t>(timestamp - next_timestamp);
+    if (gap > 0) {
+      // Hold the last frame over missing ones to keep later frames on time
+      lost += gap;
+      if (static_cast<size_t>(gap) < kBufferFrames) {
+        for (int32_t i = 0; i < gap; ++i)
+          PushFrame(last_frame);
+      }
+    } else if (gap < 0) {
+      skip_frames = -gap;
+    }
+  }
+
+  have_reference = true;
+  last_arrival = now;
+  last_timestamp = timestamp;
+  next_timestamp = timestamp + block_frames;
+  UpdateTarget(block_frames);
+}
+
+// Check the packet header and decide how to handle the payload
+static void EndHeader() {
+  uint8_t type = header[0];
+  payload_length = header[1] | (header[2] << 8);
+  payload_pos = 0;
+  frame_pos = 0;
+
+  bool valid = false;
+  switch (type) {
+    case PACKET::STREAM_START:
+      valid = payload_length == 4;
+      break;
+    case PACKET::STREAM_DATA:
+      valid = payload_length >= 4 && !((payload_length - 4) % kFrameBytes) &&
+              (payload_length - 4) / kFrameBytes <= kMaxBlockFrames;
+      if (valid && state_ == STATE_IDLE) {
+        // Data without a START; drop it and wait for the next packet
+        ++errors;
+        parser_state = PARSE_SKIP;
+        return;
+      }
+      break;
+    case PACKET::STREAM_STOP:
+      valid = !payload_length;
+      break;
+    default:
+      break;
+  }
+
+  if (!valid) {
+    // Can't trust the length either, so hunt for the next sync byte
+    ++errors;
+    parser_state = PARSE_SYNC;
+  } else if (type == PACKET::STREAM_STOP) {
+    Stop();
+    parser_state = PARSE_SYNC;
+  } else {
+    parser_state = PARSE_PAYLOAD;
+  }
+}
+
+static void PayloadByte(uint8_t byte) {
+  const uint8_t type = header[0];
+  if (payload_pos < 4) {
+    field[payload_pos] = byte;
+    if (payload_pos == 3) {
+      if (type == PACKET::STREAM_START)
+        Start(ReadU32(field));
+      else
+        BeginBlock(ReadU32(field), (payload_length - 4) / kFrameBytes);
+    }
+  } else {
+    reinterpret_cast<uint8_t *>(&frame)[frame_pos++] = byte;
+    if (frame_pos == kFrameBytes) {
+      PushFrame(frame);
+      frame_pos = 0;
+    }
+  }
+
+  if (++payload_pos == payload_length)
+    parser_state = PARSE_SYNC;
+}
+
+bool Parse(uint8_t byte) {
+  switch (parser_state) {
+    case PARSE_SYNC:
+      if (byte != PACKET::kSync)
+        return false;
+      header_pos = 0;
+      parser_state = PARSE_HEADER;
+      break;
+    case PARSE_HEADER:
+      header[header_pos++] = byte;
+      if (header_pos == sizeof(header))
+        EndHeader();
+      break;
+    case PARSE_PAYLOAD:
+      PayloadByte(byte);
+      break;
+    case PARSE_SKIP:
+      if (++payload_pos == payload_length)
+        parser_state = PARSE_SYNC;
+      break;
+  }
+  return true;
+}
+
+State state() {
+  return state_;
+}
+
+uint32_t sample_rate() {
+  return sample_rate_;
+}
+
+size_t fill() {
+  return frames.readable();
+}
+
+size_t target() {
+  return target_;
+}
+
+float jitter() {
+  return jitter_cycles / CORE::kCyclesPerUs;
+}
+
+int32_t correction_ppm() {
+  return correction;
+}
+
+const util::RunningStats &arrival() {
+  return arrival_;
+}
+
+Stats stats() {
+  return { blocks, frames_played, underruns, skipped, overruns, lost, late, errors };
+}
+
+void ResetStats() {
+  noInterrupts();
+  frames_played = underruns = skipped = 0;
+  interrupts();
+  arrival_.Reset();
+  blocks = overruns = lost = late = errors = 0;
+}
+
+}; // namespace STREAM
+}; // namespace OC
@@ -0,0 +1,83 @@
+// OC_stream.h - CV streaming from the host over USB serial
+//
+// The host sends timestamped blocks of 8-channel frames; they are collected in
+// a jitter buffer from loop() and played out by the core ISR at the stream's
+// sample rate. Playback starts once the buffer holds a target depth that
+// follows the measured arrival jitter (RFC 3550 style estimate), and the
+// playback rate is trimmed (by kMaxCorrectionPpm at most) to hold the fill at
+// that target, which absorbs the drift between host and Teensy clocks.
+//
+// Packets (OC_packet.h):
+// STREAM_START: uint32 sample rate (Hz, up to kMaxSampleRate)
+// STREAM_DATA: uint32 timestamp of the first frame (in frames), then frames of
+//              DAC::kNumChannels uint16 codes
+// STREAM_STOP: no payload
+// Bytes outside a packet are left to the debug commands. See
+// tools/cv_stream.py for a host-side sender.
+
+#ifndef OC_STREAM_H_
+#define OC_STREAM_H_
+
+#include <stdint.h>
+#include "OC_core.h"
+#include "OC_DAC.h"
+#include "util/util_stats.h"
+
+namespace OC {
+namespace STREAM {
+
+static constexpr uint32_t kMaxSampleRate = CORE::kTickRate / 2;
+static constexpr size_t kBufferFrames = 1024;
+// Upper bound on a DATA packet, which also bounds the target depth
+static constexpr size_t kMaxBlockFrames = 256;
+// Extra frames kept on top of one block and 4x the arrival jitter
+static constexpr size_t kMinMarginFrames = 8;
+// Fill errors are corrected over this time, up to kMaxCorrectionPpm
+static constexpr int32_t kCorrectionSeconds = 30;
+static constexpr int32_t kMaxCorrectionPpm = 1000;
+// Jitter assumed before the first measurements, covers a display refresh
+static constexpr float kInitialJitterUs = 2000.f;
+
+enum State : uint8_t {
+  STATE_IDLE,
+  STATE_BUFFERING,
+  STATE_PLAYING,
+};
+
+struct Stats {
+  uint32_t blocks;
+  uint32_t frames;      // Frames played
+  uint32_t underruns;   // Buffer ran empty while playing
+  uint32_t skipped;     // Frames over the start depth, dropped on starting
+  uint32_t overruns;    // Frames discarded because the buffer was full
+  uint32_t lost;        // Frames missing from timestamp gaps (held)
+  uint32_t late;        // Frames older than already buffered ones (dropped)
+  uint32_t errors;      // Malformed packets
+};
+
+void Init();
+
+// Called from the core ISR before the DAC update
+void Tick();
+
+// Feed one received byte; returns false if it isn't part of a packet.
+bool Parse(uint8_t byte);
+
+State state();
+uint32_t sample_rate();
+size_t fill();
+size_t target();
+// Jitter estimate in microseconds
+float jitter();
+// Current rate trim
+int32_t correction_ppm();
+
+// Deviation of block arrival from the timestamps, in cycles
+const util::RunningStats &arrival();
+Stats stats();
+void ResetStats();
+
+}; // namespace STREAM
+}; // namespace OC
+
+#endif // OC_STREAM_H_
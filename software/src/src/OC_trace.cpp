@@ -0,0 +1,108 @@
+// OC_trace.cpp - Timeline trace implementation
+
+#include <Arduino.h>
+#include <string.h>
+#include "OC_packet.h"
+#include "OC_trace.h"
+
+namespace OC {
+namespace TRACE {
+
+// The records are only touched by the CPU, so the cached OCRAM is fine and
+// leaves the tightly coupled RAM to the code that needs it
+DMAMEM Record records[kNumRecords];
+volatile uint32_t head;
+volatile bool recording;
+
+static uint32_t record_cycles;
+
+struct EventInfo {
+  const char *name;
+  const char *track;
+};
+
+static constexpr EventInfo kEvents[] = {
+  { "core tick", "core ISR" },
+  { "audio render", "audio ISR" },
+  { "UI render", "main loop" },
+  { "display DMA", "display SPI" },
+  { "DAC write", "DAC on SPI" },
+  { "DAC write", "DAC on SPI1" },
+  { "DAC write", "DAC on SPI2" },
+};
+static_assert(sizeof(kEvents) / sizeof(kEvents[0]) == EVENT_LAST, "An entry per event");
+
+void Start() {
+  static constexpr uint32_t kCalibrationRecords = 64;
+  recording = false;
+  head = 0;
+  // Time a few records; they are dropped with the reset below
+  recording = true;
+  uint32_t start = ARM_DWT_CYCCNT;
+  for (uint32_t i = 0; i < kCalibrationRecords; ++i)
+    Instant(EVENT_CORE_TICK);
+  record_cycles = (ARM_DWT_CYCCNT - start) / kCalibrationRecords;
+  recording = false;
+  head = 0;
+  recording = true;
+}
+
+void Stop() {
+  recording = false;
+}
+
+bool running() {
+  return recording;
+}
+
+Stats stats() {
+  uint32_t written = head;
+  uint32_t count = written < kNumRecords ? written : kNumRecords;
+  uint32_t span = 0;
+  if (count) {
+    span = records[(written - 1) & (kNumRecords - 1)].cycles -
+           records[(written - count) & (kNumRecords - 1)].cycles;
+  }
+  return { count, written - count, span, record_cycles };
+}
+
+void Dump() {
+  static constexpr size_t kRecordsPerPacket = 256;
+  Stop();
+  if (!Serial)
+    return;
+  // A record claimed just before the stop may still be written
+  delayMicroseconds(10);
+
+  Stats trace = stats();
+  const uint32_t header[4] = { F_CPU, trace.records, trace.lost, trace.record_cycles };
+  PACKET::Write(PACKET::TRACE_HEADER, header, sizeof(header));
+
+  char names[256];
+  size_t length = 0;
+  for (const EventInfo &event : kEvents) {
+    size_t name = strlen(event.name) + 1;
+    size_t track = strlen(event.track) + 1;
+    if (length + name + track > sizeof(names))
+      break;
+    memcpy(names + length, event.name, name);
+    memcpy(names + length + name, event.track, track);
+    length += name + track;
+  }
+  PACKET::Write(PACKET::TRACE_NAMES, names, length);
+
+  // Oldest first; blocking writes, nothing is recording
+  uint32_t first = head - trace.records;
+  for (uint32_t sent = 0; sent < trace.records;) {
+    uint32_t index = (first + sent) & (kNumRecords - 1);
+    uint32_t count = trace.records - sent;
+    if (count > kRecordsPerPacket) count = kRecordsPerPacket;
+    if (count > kNumRecords - index) count = kNumRecords - index;
+    PACKET::Write(PACKET::TRACE_RECORDS, records + index, count * sizeof(Record));
+    sent += count;
+  }
+  Serial.flush();
+}
+
+}; // namespace TRACE
+}; // namespace OC
@@ -0,0 +1,120 @@
+// OC_trace.h - Timeline trace of tasks, ISRs and bus transactions
+//
+// Begin() / End() / Instant() record an event with an ARM_DWT_CYCCNT
+// timestamp into a ring buffer that keeps the last kNumRecords. A record is
+// claimed with a single atomic increment of the write position, so any
+// interrupt priority can record without locks or waiting; recording costs
+// about 20 cycles, and a load and a branch while stopped. Building with
+// OC_TRACE=0 removes the calls altogether.
+//
+// Each event has a fixed name and a track (core ISR, main loop, display SPI,
+// ...). Begin/End pairs on one track must not overlap, except that an event
+// may begin in one context and end in another (a DMA started from the main
+// loop ends in its completion interrupt).
+//
+// Dump() stops recording and sends the ring as packets (OC_packet.h):
+// TRACE_HEADER: uint32 cpu_hz, records, lost (overwritten), record cycles
+// TRACE_NAMES: per event id, its name and track, each NUL terminated
+// TRACE_RECORDS: records as below, oldest first
+// tools/trace_export.py turns a dump into Chrome trace JSON for Perfetto.
+
+#ifndef OC_TRACE_H_
+#define OC_TRACE_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef OC_TRACE
+#define OC_TRACE 1
+#endif
+
+#ifndef OC_TRACE_RECORDS
+#define OC_TRACE_RECORDS 16384
+#endif
+
+namespace OC {
+namespace TRACE {
+
+enum Event : uint8_t {
+  EVENT_CORE_TICK,
+  EVENT_AUDIO_RENDER,
+  EVENT_UI_RENDER,
+  EVENT_DISPLAY_DMA,  // arg: page, strip or panel slice
+  EVENT_DAC_BUS0,     // One per bus, arg: words
+  EVENT_DAC_BUS1,
+  EVENT_DAC_BUS2,
+  EVENT_LAST
+};
+
+enum Phase : uint8_t {
+  PHASE_BEGIN,
+  PHASE_END,
+  PHASE_INSTANT,
+};
+
+struct Record {
+  uint32_t cycles;
+  uint8_t phase;
+  uint8_t event;
+  uint16_t arg;
+};
+
+static constexpr size_t kNumRecords = OC_TRACE_RECORDS;
+static_assert(!(kNumRecords & (kNumRecords - 1)), "Records are a power of two");
+
+extern Record records[kNumRecords];
+extern volatile uint32_t head;
+extern volatile bool recording;
+
+static inline void Add(Event event, Phase phase, uint16_t arg) __attribute__((always_inline));
+static inline void Add(Event event, Phase phase, uint16_t arg) {
+#if OC_TRACE
+  if (!recording)
+    return;
+  uint32_t index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+  Record &record = records[index & (kNumRecords - 1)];
+  record.cycles = ARM_DWT_CYCCNT;
+  record.phase = phase;
+  record.event = event;
+  record.arg = arg;
+#else
+  (void)event;
+  (void)phase;
+  (void)arg;
+#endif
+}
+
+static inline void Begin(Event event, uint16_t arg = 0) {
+  Add(event, PHASE_BEGIN, arg);
+}
+
+static inline void End(Event event, uint16_t arg = 0) {
+  Add(event, PHASE_END, arg);
+}
+
+static inline void Instant(Event event, uint16_t arg = 0) {
+  Add(event, PHASE_INSTANT, arg);
+}
+
+struct Stats {
+  uint32_t records;        // In the ring
+  uint32_t lost;           // Overwritten
+  uint32_t span_cycles;    // From the oldest record to the newest
+  uint32_t record_cycles;  // Cost of one record, measured by Start()
+};
+
+// Clears the ring and starts recording
+void Start();
+void Stop();
+bool running();
+
+// Stop recording and send the ring to the host
+void Dump();
+
+Stats stats();
+
+}; // namespace TRACE
+}; // namespace OC
+
+#endif // OC_TRACE_H_
@@ -0,0 +1,211 @@
+// DAC8568_driver.cpp - TI DAC8568 driver implementation
+//
+// Initialization sequence follows the dac8568_test bring-up: software reset,
+// internal reference on, all channels powered up. It runs as a coroutine
+// task, so setup() carries on during the waits; DAC::Update() holds the
+// outputs until it has finished.
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "DAC8568_driver.h"
+#include "../OC_coro.h"
+#include "../OC_trace.h"
+
+// O_C uses SPI_MODE2 (CPOL=1, CPHA=0) for the DAC8568
+static SPISettings dac_spi_settings(DAC_SPI_CLOCK, MSBFIRST, SPI_MODE2);
+
+static_assert(OC::TRACE::EVENT_DAC_BUS0 + DAC8568_Driver::kNumBuses <= OC::TRACE::EVENT_LAST,
+              "A trace event per bus");
+
+static inline OC::TRACE::Event BusEvent(size_t bus) {
+  return static_cast<OC::TRACE::Event>(OC::TRACE::EVENT_DAC_BUS0 + bus);
+}
+
+// SPI is LPSPI4, SPI1 is LPSPI3 and SPI2 is LPSPI1 on Teensy 4
+static SPIClass *const spi_buses[DAC8568_Driver::kNumBuses] = { &SPI, &SPI1, &SPI2 };
+static IMXRT_LPSPI_t *const lpspi_ports[DAC8568_Driver::kNumBuses] = {
+  &IMXRT_LPSPI4_S, &IMXRT_LPSPI3_S, &IMXRT_LPSPI1_S
+};
+
+struct DeviceConfig {
+  uint8_t cs_pin;
+  uint8_t bus;
+};
+
+static constexpr DeviceConfig device_config[] = {
+  { DAC_CS_PIN, DAC_SPI_BUS },
+  { DAC1_CS_PIN, DAC1_SPI_BUS },
+  { DAC2_CS_PIN, DAC2_SPI_BUS },
+};
+
+static DAC8568_Driver::DeviceStats device_stats[DAC8568_Driver::kNumDevices];
+static volatile bool powered_up = false;
+
+struct PowerUpStep {
+  uint8_t command;
+  uint16_t data;
+  uint32_t wait_us;  // Before the next step
+};
+
+static constexpr PowerUpStep kPowerUpSequence[] = {
+  { DAC8568_Driver::CMD_RESET, 0x0000, 10000 },
+  { DAC8568_Driver::CMD_REFERENCE, 0x0001, 20000 },
+  { DAC8568_Driver::CMD_POWER, 0x0000, 5000 },
+};
+
+static void WriteStep(const PowerUpStep &step) {
+  for (size_t device = 0; device < DAC8568_Driver::kNumDevices; ++device)
+    DAC8568_Driver::Write(device, step.command, 0x00, step.data);
+}
+
+static OC::CORO::Task PowerUp() {
+  for (const PowerUpStep &step : kPowerUpSequence) {
+    WriteStep(step);
+    co_await OC::CORO::Sleep(step.wait_us);
+  }
+  DAC8568_Driver::ResetStats();
+  powered_up = true;
+}
+
+/*static*/
+void DAC8568_Driver::Init() {
+  uint32_t buses = 0;
+  for (size_t device = 0; device < kNumDevices; ++device) {
+    const DeviceConfig &config = device_config[device];
+    if (!(buses & (1UL << config.bus)))
+      spi_buses[config.bus]->begin();
+    buses |= 1UL << config.bus;
+
+    pinMode(config.cs_pin, OUTPUT);
+    digitalWriteFast(config.cs_pin, HIGH);  // /SYNC is active LOW
+  }
+
+  powered_up = false;
+  if (OC::CORO::Spawn(PowerUp()))
+    return;
+
+  // No coroutine frame: the same sequence, blocking
+  for (const PowerUpStep &step : kPowerUpSequence) {
+    WriteStep(step);
+    delayMicroseconds(step.wait_us);
+  }
+  ResetStats();
+  powered_up = true;
+}
+
+/*static*/
+bool DAC8568_Driver::ready() {
+  return powered_up;
+}
+
+/*static*/
+uint8_t DAC8568_Driver::bus(size_t device) {
+  return device_config[device].bus;
+}
+
+/*static*/
+uint32_t DAC8568_Driver::bus_devices(size_t device) {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < kNumDevices; ++i) {
+    if (device_config[i].bus == device_config[device].bus)
+      mask |= 1UL << i;
+  }
+  return mask;
+}
+
+/*static*/
+void FASTRUN DAC8568_Driver::Write(size_t device, uint8_t command, uint8_t address, uint16_t data) {
+  WriteWord(device, Pack(command, address, data));
+}
+
+/*static*/
+void FASTRUN DAC8568_Driver::WriteWord(size_t device, uint32_t word) {
+  const DeviceConfig &config = device_config[device];
+  SPIClass &spi = *spi_buses[config.bus];
+  uint32_t start = ARM_DWT_CYCCNT;
+  OC::TRACE::Begin(BusEvent(config.bus), 1);
+  spi.beginTransaction(dac_spi_settings);
+  digitalWriteFast(config.cs_pin, LOW);
+  spi.transfer32(word);
+  digitalWriteFast(config.cs_pin, HIGH);
+  spi.endTransaction();
+  OC::TRACE::End(BusEvent(config.bus));
+  ++device_stats[device].words;
+  device_stats[device].busy_cycles += ARM_DWT_CYCCNT - start;
+}
+
+/*static*/
+void FASTRUN DAC8568_Driver::WriteParallel(const uint32_t *words, uint32_t device_mask) {
+  uint32_t buses = 0;
+  uint16_t bus_words[kNumBuses] = {};
+  for (uint32_t pending = device_mask; pending; pending &= pending - 1) {
+    const uint8_t bus = device_config[__builtin_ctz(pending)].bus;
+    buses |= 1UL << bus;
+    ++bus_words[bus];
+  }
+  uint32_t tcr[kNumBuses];
+  for (size_t bus = 0; bus < kNumBuses; ++bus) {
+    if (buses & (1UL << bus)) {
+      OC::TRACE::Begin(BusEvent(bus), bus_words[bus]);
+      spi_buses[bus]->beginTransaction(dac_spi_settings);
+      tcr[bus] = lpspi_ports[bus]->TCR;
+    }
+  }
+
+  // Each round starts one word on every bus that has one pending, the same
+  // as SPIClass::transfer32() but without waiting in between.
+  uint32_t pending = device_mask;
+  while (pending) {
+    uint8_t active[kNumBuses];
+    uint32_t round_buses = 0;
+    uint32_t start = ARM_DWT_CYCCNT;
+    for (uint32_t candidates = pending; candidates; candidates &= candidates - 1) {
+      size_t device = __builtin_ctz(candidates);
+      const DeviceConfig &config = device_config[device];
+      if (round_buses & (1UL << config.bus))
+        continue;
+      round_buses |= 1UL << config.bus;
+      active[config.bus] = device;
+      pending &= ~(1UL << device);
+
+      IMXRT_LPSPI_t &port = *lpspi_ports[config.bus];
+      digitalWriteFast(config.cs_pin, LOW);
+      port.TCR = (tcr[config.bus] & 0xfffff000) | LPSPI_TCR_FRAMESZ(31);
+      port.TDR = words[device];
+    }
+
+    for (size_t bus = 0; bus < kNumBuses; ++bus) {
+      if (!(round_buses & (1UL << bus)))
+        continue;
+      IMXRT_LPSPI_t &port = *lpspi_ports[bus];
+      while (port.RSR & LPSPI_RSR_RXEMPTY) {
+      }
+      port.TCR = tcr[bus];
+      (void)port.RDR;
+      size_t device = active[bus];
+      digitalWriteFast(device_config[device].cs_pin, HIGH);
+      ++device_stats[device].words;
+      device_stats[device].busy_cycles += ARM_DWT_CYCCNT - start;
+    }
+  }
+
+  for (size_t bus = 0; bus < kNumBuses; ++bus) {
+    if (buses & (1UL << bus)) {
+      spi_buses[bus]->endTransaction();
+      OC::TRACE::End(BusEvent(bus));
+    }
+  }
+}
+
+/*static*/
+DAC8568_Driver::DeviceStats DAC8568_Driver::stats(size_t device) {
+  return device_stats[device];
+}
+
+/*static*/
+void DAC8568_Driver::ResetStats() {
+  noInterrupts();
+  for (auto &stats : device_stats)
+    stats = { 0, 0 };
+  interrupts();
+}
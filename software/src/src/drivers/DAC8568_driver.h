@@ -0,0 +1,119 @@
+// DAC8568_driver.h - TI DAC8568 8-channel 16-bit DAC driver
+//
+// The first DAC sits on SPI1 (MOSI=26, SCK=27 on Teensy 4.1) with /SYNC on a
+// GPIO. /LDAC is tied to GND and /CLR to 5V as on the O_C hardware, so every
+// write-and-update command takes effect immediately.
+//
+// Up to three DACs are supported (DAC_NUM_DEVICES), each with its own /SYNC
+// and on SPI1 or SPI2. Channel n is channel n % 8 of device n / 8. Devices
+// on different buses can be written concurrently with WriteParallel(); the
+// transfers overlap in the LPSPI FIFOs, so the time per round is that of the
+// busiest bus rather than the sum.
+//
+// Frames use the O_C-style 32-bit word: (cmd<<24)|(addr<<20)|(data<<4)
+// See DAC8568_Technical_Reference.md for the command set.
+
+#ifndef DAC8568_DRIVER_H_
+#define DAC8568_DRIVER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Pin definitions - can be overridden in platformio.ini
+#ifndef DAC_NUM_DEVICES
+#define DAC_NUM_DEVICES 1
+#endif
+
+#ifndef DAC_CS_PIN
+#define DAC_CS_PIN 16
+#endif
+
+#ifndef DAC1_CS_PIN
+#define DAC1_CS_PIN 17
+#endif
+
+#ifndef DAC2_CS_PIN
+#define DAC2_CS_PIN 36
+#endif
+
+// Bus per device: 1 = SPI1, 2 = SPI2
+#ifndef DAC_SPI_BUS
+#define DAC_SPI_BUS 1
+#endif
+
+#ifndef DAC1_SPI_BUS
+#define DAC1_SPI_BUS 1
+#endif
+
+#ifndef DAC2_SPI_BUS
+#define DAC2_SPI_BUS 2
+#endif
+
+// Bus 0 (SPI) belongs to the display, whose driver keeps its SPI transaction
+// open while a page goes out by DMA; a DAC write from the core tick would
+// reconfigure the bus and interleave its words with the page.
+#if DAC_SPI_BUS == 0 || (DAC_NUM_DEVICES > 1 && DAC1_SPI_BUS == 0) || \
+    (DAC_NUM_DEVICES > 2 && DAC2_SPI_BUS == 0)
+#error "DACs can't share SPI (bus 0) with the display; use SPI1 or SPI2"
+#endif
+
+#ifndef DAC_SPI_CLOCK
+#define DAC_SPI_CLOCK 20000000
+#endif
+
+struct DAC8568_Driver {
+  static constexpr size_t kChannelsPerDevice = 8;
+  static constexpr size_t kNumDevices = DAC_NUM_DEVICES;
+  static constexpr size_t kNumChannels = kChannelsPerDevice * kNumDevices;
+  static constexpr size_t kNumBuses = 3;
+  static_assert(kNumDevices >= 1 && kNumDevices <= 3, "1 to 3 DAC8568 devices supported");
+
+  enum Command : uint8_t {
+    CMD_WRITE_INPUT      = 0x00, // Write to input register only
+    CMD_UPDATE_DAC       = 0x01, // Update DAC register from input register
+    CMD_WRITE_UPDATE_ALL = 0x02, // Write input register, update all DACs
+    CMD_WRITE_UPDATE     = 0x03, // Write input register and update DAC
+    CMD_POWER            = 0x04, // Power down/up control
+    CMD_CLEAR            = 0x05, // Clear code register
+    CMD_LDAC             = 0x06, // LDAC register
+    CMD_RESET            = 0x07, // Software reset
+    CMD_REFERENCE        = 0x08, // Internal reference setup
+  };
+
+  static constexpr uint8_t kAddressAll = 0x0F;
+
+  struct DeviceStats {
+    uint32_t words;
+    uint32_t busy_cycles;  // Time with /SYNC low, including FIFO waits
+  };
+
+  // Starts the power-up sequence, which completes in the background (~35 ms)
+  static void Init();
+  // Power-up done; no channel writes before this
+  static bool ready();
+
+  static uint8_t bus(size_t device);
+
+  // Bitmask of the devices sharing `device`'s bus
+  static uint32_t bus_devices(size_t device);
+
+  static void Write(size_t device, uint8_t command, uint8_t address, uint16_t data);
+  static void WriteWord(size_t device, uint32_t word);
+
+  static inline void WriteChannel(size_t channel, uint16_t value) {
+    WriteWord(channel / kChannelsPerDevice, Pack(CMD_WRITE_UPDATE, channel % kChannelsPerDevice, value));
+  }
+
+  // Write words[device] to every device in `device_mask`; devices on
+  // different buses transfer at the same time, devices sharing a bus in turn.
+  static void WriteParallel(const uint32_t *words, uint32_t device_mask);
+
+  static inline uint32_t Pack(uint8_t command, uint8_t address, uint16_t data) {
+    return ((uint32_t)command << 24) | ((uint32_t)address << 20) | ((uint32_t)data << 4);
+  }
+
+  static DeviceStats stats(size_t device);
+  static void ResetStats();
+};
+
+#endif // DAC8568_DRIVER_H_
@@ -1,35 +1,308 @@
 // ILI9341_Driver.cpp - ILI9341 TFT Display Driver Implementation
-// 
+//
 // This driver provides an interface compatible with the original SH1106 OLED driver
 // but outputs to an ILI9341 320x240 TFT display.
 //
+// ILI9341_t3 handles the controller init sequence and the static border. Pages
+// are written directly: a blocking address window setup, then the scaled
+// pixels with an asynchronous SPI DMA transfer. Status panel slices go the
+// same way through the same pixel buffer, which is free whenever the bus is.
+// PRESENT_BEAM strips too; they are held back in Poll() until the beam
+// prediction says they can go.
+//
 // Copyright (c) 2024
 
+#include "SH1106_128x64_driver.h"
+
+#ifdef USE_ILI9341_DISPLAY
+
 #include <Arduino.h>
-#include "ILI9341_Driver.h"
+#include "../OC_trace.h"
+#include "../util/util_beam.h"
 
 // Global ILI9341 display instance
 static ILI9341_t3 tft(ILI9341_CS_PIN, ILI9341_DC_PIN, ILI9341_RST_PIN);
 
-// Frame buffer for page-based updates
-static uint8_t page_buffer[ILI9341_Driver::kNumPages][ILI9341_Driver::kPageSize];
-static bool page_dirty[ILI9341_Driver::kNumPages];
+static SPISettings spi_settings(ILI9341_SPI_CLOCK, MSBFIRST, SPI_MODE0);
+static SPISettings read_settings(ILI9341_SPI_READ_CLOCK, MSBFIRST, SPI_MODE0);
+static uint32_t spi_clock = ILI9341_SPI_CLOCK;
+
+static constexpr uint8_t kGetScanline = 0x45;
+static constexpr uint8_t kFrameRateControl = 0xB1;
+// FRMCTR1 clocks per line: ILI9341_t3's init value, and what can be set
+static constexpr uint8_t kDefaultClocksPerLine = 0x18;
+static constexpr uint8_t kMinClocksPerLine = 0x10;
+static constexpr uint8_t kMaxClocksPerLine = 0x1F;
+static EventResponder dma_event;
+
+// Scaled page in display byte order (RGB565 big-endian). Written by the CPU
+// only while no transfer is in flight; the SPI library flushes the cache.
+static DMAMEM uint16_t page_pixels[ILI9341_Driver::kPagePixels] __attribute__((aligned(32)));
+
+// Last page sent, to skip unchanged pages
+static uint8_t page_cache[ILI9341_Driver::kNumPages][ILI9341_Driver::kPageSize];
+static uint32_t page_valid;  // Bit per page: page_cache matches the display
+
+// Status panel: latest content, what the display shows, and a bit per slice
+// that differs
+static uint8_t panel[ILI9341_Driver::kPanelSize];
+static uint8_t panel_shown[ILI9341_Driver::kPanelSize];
+static uint32_t panel_dirty;
+static_assert(ILI9341_Driver::kPanelSlices <= 32, "Dirty slices are a 32-bit mask");
+static_assert(8 % ILI9341_Driver::kPanelSliceRows == 0, "Slices don't straddle pages");
+
+// PRESENT_BEAM: the frame being presented, the pages of it received so far,
+// and a bit per strip still to send
+static uint8_t strip_frame[ILI9341_Driver::kNumPages][ILI9341_Driver::kPageSize];
+static uint32_t strip_pages;
+static uint32_t strips_dirty;
+static bool strips_sync;  // Read the beam position before the next strip
+static bool strips_started;  // The first strip of the frame is out
+static bool strips_in_pass;  // All strips are Behind the pass at strips_pass
+static uint32_t strips_pass;
+static uint32_t strips_stale;  // Pages recolored while the strips go out
+static util::BeamTracker beam;
+static ILI9341_Driver::PresentMode present_mode_ = ILI9341_Driver::PRESENT_PAGES;
+static uint8_t clocks_per_line = kDefaultClocksPerLine;
+static_assert(ILI9341_Driver::kStripPixels <= ILI9341_Driver::kPagePixels, "Strips use the page buffer");
+
+static constexpr uint32_t kAllPages = (1UL << ILI9341_Driver::kNumPages) - 1;
+
+static volatile bool dma_busy = false;
+static bool dma_panel;  // The transfer in flight is a panel slice
+static uint32_t dma_start;
+static ILI9341_Driver::Stats transfer_stats;
 static bool display_initialized = false;
 static bool flip_mode = false;
 
+static inline uint16_t swap_bytes(uint16_t color) {
+  return (color << 8) | (color >> 8);
+}
+
+// Two 2x-scaled pixels of `color` as they go out on the bus
+static inline uint32_t PixelPair(uint16_t color) {
+  return swap_bytes(color) * 0x10001UL;
+}
+
+// Palettes as [background, foreground] pixel pairs, and the palette of each
+// cell of the scaled view
+static uint32_t palettes[ILI9341_Driver::kNumPalettes][2];
+static uint8_t palette_map[ILI9341_Driver::kNumPages][ILI9341_Driver::kPaletteCells];
+static_assert(ILI9341_Driver::kPaletteCellWidth == 8, "Cells are one page tall and as wide");
+static_assert(ILI9341_Driver::kStripColumns % ILI9341_Driver::kPaletteCellWidth == 0,
+              "Strips don't straddle cells");
+
+// Pages that show as all `bg` when blank
+static uint32_t BlankPages(uint16_t bg) {
+  uint32_t pages = 0;
+  for (size_t page = 0; page < ILI9341_Driver::kNumPages; page++) {
+    bool blank = true;
+    for (size_t cell = 0; cell < ILI9341_Driver::kPaletteCells && blank; cell++)
+      blank = palettes[palette_map[page][cell]][0] == PixelPair(bg);
+    if (blank)
+      pages |= 1UL << page;
+  }
+  return pages;
+}
+
+static void DMAComplete(EventResponderRef) {
+  digitalWriteFast(ILI9341_CS_PIN, HIGH);
+  SPI.endTransaction();
+  if (dma_panel)
+    ++transfer_stats.panel_slices;
+  else
+    ++transfer_stats.pages;
+  transfer_stats.busy_cycles += ARM_DWT_CYCCNT - dma_start;
+  OC::TRACE::End(OC::TRACE::EVENT_DISPLAY_DMA);
+  dma_busy = false;
+}
+
+static void WaitIdle() {
+  while (dma_busy) {
+  }
+}
+
+// Command bytes go out with DC low, parameters with DC high. The blocking
+// transfers return after the last bit, so DC can be switched right away.
+static void WriteCommand(uint8_t command) {
+  digitalWriteFast(ILI9341_DC_PIN, LOW);
+  SPI.transfer(command);
+  digitalWriteFast(ILI9341_DC_PIN, HIGH);
+}
+
+static void SetWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+  WriteCommand(ILI9341_CASET);
+  SPI.transfer16(x0);
+  SPI.transfer16(x1);
+  WriteCommand(ILI9341_PASET);
+  SPI.transfer16(y0);
+  SPI.transfer16(y1);
+  WriteCommand(ILI9341_RAMWR);
+}
+
+// Expand page `index` (bit 0 of each byte is the top pixel) to
+// DISPLAY_SCALE x DISPLAY_SCALE blocks in the colors of its cells
+static void RenderPage(size_t index, const uint8_t *data) {
+  static_assert(DISPLAY_SCALE == 2, "Pixel pairs are written as 32-bit words");
+  constexpr size_t kRowWords = ILI9341_Driver::kSourceWidth;
+  constexpr size_t kCellWidth = ILI9341_Driver::kPaletteCellWidth;
+
+  uint32_t *row = reinterpret_cast<uint32_t *>(page_pixels);
+  for (int bit = 0; bit < 8; bit++) {
+    for (size_t cell = 0; cell < ILI9341_Driver::kPaletteCells; cell++) {
+      const uint32_t *lut = palettes[palette_map[index][cell]];
+      const uint8_t *column = data + cell * kCellWidth;
+      uint32_t *out = row + cell * kCellWidth;
+      for (size_t col = 0; col < kCellWidth; col++)
+        out[col] = lut[(column[col] >> bit) & 1];
+    }
+    memcpy(row + kRowWords, row, kRowWords * sizeof(uint32_t));
+    row += kRowWords * DISPLAY_SCALE;
+  }
+}
+
+// Expand kPanelSliceRows rows of the panel, starting at source row `row`
+static size_t RenderPanelSlice(size_t row) {
+  const uint32_t fg = PixelPair(ILI9341_FG_COLOR);
+  const uint32_t bg = PixelPair(ILI9341_BG_COLOR);
+  constexpr size_t kRowWords = ILI9341_Driver::kPanelWidth;
+
+  const uint8_t *data = panel + (row / 8) * ILI9341_Driver::kPanelWidth;
+  uint32_t *out = reinterpret_cast<uint32_t *>(page_pixels);
+  for (size_t bit = row % 8; bit < row % 8 + ILI9341_Driver::kPanelSliceRows; bit++) {
+    for (size_t col = 0; col < ILI9341_Driver::kPanelWidth; col++)
+      out[col] = (data[col] >> bit) & 1 ? fg : bg;
+    memcpy(out + kRowWords, out, kRowWords * sizeof(uint32_t));
+    out += kRowWords * DISPLAY_SCALE;
+  }
+  return ILI9341_Driver::kPanelWidth * ILI9341_Driver::kPanelSliceRows * DISPLAY_SCALE * DISPLAY_SCALE;
+}
+
+// Expand source columns [strip * kStripColumns, +kStripColumns) of all rows
+static void RenderStrip(size_t strip) {
+  constexpr size_t kRowWords = ILI9341_Driver::kStripColumns;
+  constexpr size_t kCellWidth = ILI9341_Driver::kPaletteCellWidth;
+
+  const size_t first = strip * ILI9341_Driver::kStripColumns;
+  uint32_t *row = reinterpret_cast<uint32_t *>(page_pixels);
+  for (size_t y = 0; y < ILI9341_Driver::kSourceHeight; y++) {
+    const uint8_t bit = y % 8;
+    for (size_t col = 0; col < ILI9341_Driver::kStripColumns; col += kCellWidth) {
+      const uint32_t *lut = palettes[palette_map[y / 8][(first + col) / kCellWidth]];
+      const uint8_t *column = strip_frame[y / 8] + first + col;
+      for (size_t i = 0; i < kCellWidth; i++)
+        row[col + i] = lut[(column[i] >> bit) & 1];
+    }
+    memcpy(row + kRowWords, row, kRowWords * sizeof(uint32_t));
+    row += kRowWords * DISPLAY_SCALE;
+  }
+}
+
+// Refresh lines a strip covers. With MV set (landscape) the gate lines run
+// along x; rotation 3 also mirrors x.
+static void StripLines(size_t strip, uint32_t &first, uint32_t &last) {
+  uint32_t x0 = DISPLAY_OFFSET_X + strip * ILI9341_Driver::kStripColumns * DISPLAY_SCALE;
+  uint32_t x1 = x0 + ILI9341_Driver::kStripColumns * DISPLAY_SCALE - 1;
+  if (flip_mode) {
+    first = ILI9341_Driver::kNativeWidth - 1 - x1;
+    last = ILI9341_Driver::kNativeWidth - 1 - x0;
+  } else {
+    first = x0;
+    last = x1;
+  }
+}
+
+// Bus time of one strip including the window setup
+static uint32_t StripCycles() {
+  constexpr uint32_t kBytes = ILI9341_Driver::kStripPixels * sizeof(uint16_t) + 16;
+  return static_cast<uint64_t>(kBytes) * 8 * F_CPU / spi_clock;
+}
+
+static uint32_t LineCycles(uint8_t clocks) {
+  return static_cast<uint64_t>(F_CPU) * clocks / ILI9341_Driver::kOscHz;
+}
+
+// Blocking read of the line being refreshed; the bus must be free
+static uint32_t ReadScanline() {
+  SPI.beginTransaction(read_settings);
+  digitalWriteFast(ILI9341_CS_PIN, LOW);
+  WriteCommand(kGetScanline);
+  SPI.transfer(0);  // Dummy
+  uint32_t high = SPI.transfer(0);
+  uint32_t low = SPI.transfer(0);
+  digitalWriteFast(ILI9341_CS_PIN, HIGH);
+  SPI.endTransaction();
+  return ((high & 0x03) << 8) | low;
+}
+
+// The whole frame is in; mark the strips that differ from the display
+static void QueueStrips() {
+  uint32_t dirty = 0;
+  for (size_t strip = 0; strip < ILI9341_Driver::kNumStrips; strip++) {
+    const size_t first = strip * ILI9341_Driver::kStripColumns;
+    bool changed = page_valid != kAllPages;
+    for (size_t page = 0; page < ILI9341_Driver::kNumPages && !changed; page++)
+      changed = memcmp(strip_frame[page] + first, page_cache[page] + first, ILI9341_Driver::kStripColumns);
+    if (changed)
+      dirty |= 1UL << strip;
+    else
+      ++transfer_stats.skipped;
+  }
+  strips_dirty = dirty;
+  strips_sync = dirty != 0;
+  strips_started = false;
+  strips_stale = 0;
+}
+
+// The colors of `pages` changed; send them again even if unchanged
+static void RecolorPages(uint32_t pages) {
+  page_valid &= ~pages;
+  strips_stale |= pages;
+}
+
+// Open the transaction, set the window and start the DMA of `pixels`;
+// `index` is the page, strip or panel slice, for the trace
+static void StartTransfer(uint16_t x0, uint16_t y0, uint16_t w, uint16_t h, size_t pixels, bool panel_slice,
+                          size_t index) {
+  dma_busy = true;
+  dma_panel = panel_slice;
+  dma_start = ARM_DWT_CYCCNT;
+  OC::TRACE::Begin(OC::TRACE::EVENT_DISPLAY_DMA, index);
+  SPI.beginTransaction(spi_settings);
+  digitalWriteFast(ILI9341_CS_PIN, LOW);
+  SetWindow(x0, y0, x0 + w - 1, y0 + h - 1);
+  // CS stays low and the transaction open until DMAComplete
+  SPI.transfer(page_pixels, nullptr, pixels * sizeof(uint16_t), dma_event);
+}
+
 /*static*/
 void ILI9341_Driver::Init() {
   // Initialize the ILI9341 display
   tft.begin();
-  tft.setRotation(flip_mode ? 2 : 0);  // 0 or 2 for portrait, 1 or 3 for landscape
+  tft.setRotation(flip_mode ? 3 : 1);  // Landscape, 320x240
+  for (auto &palette : palettes) {
+    palette[0] = PixelPair(ILI9341_BG_COLOR);
+    palette[1] = PixelPair(ILI9341_FG_COLOR);
+  }
+  memset(palette_map, 0, sizeof(palette_map));
   tft.fillScreen(ILI9341_BG_COLOR);
-  
-  // Clear page tracking
-  memset(page_dirty, false, sizeof(page_dirty));
-  memset(page_buffer, 0, sizeof(page_buffer));
-  
+  memset(page_cache, 0, sizeof(page_cache));
+  page_valid = (1UL << kNumPages) - 1;
+  memset(panel, 0, sizeof(panel));
+  memset(panel_shown, 0, sizeof(panel_shown));
+  panel_dirty = 0;
+  strip_pages = 0;
+  strips_dirty = 0;
+  beam.Init(kScanLines, LineCycles(clocks_per_line));
+  present_mode_ = ILI9341_TEAR_FREE ? PRESENT_BEAM : PRESENT_PAGES;
+
+  dma_event.attachImmediate(DMAComplete);
+  dma_busy = false;
+  ResetStats();
   display_initialized = true;
-  
+  if (ILI9341_REFRESH_HZ)
+    SetRefreshRate(ILI9341_REFRESH_HZ);
+
   // Draw border around the active area for visual reference
   int x = DISPLAY_OFFSET_X - 1;
   int y = DISPLAY_OFFSET_Y - 1;
@@ -41,95 +314,200 @@ void ILI9341_Driver::Init() {
 /*static*/
 void ILI9341_Driver::Clear() {
   if (!display_initialized) return;
-  
+  WaitIdle();
+
   // Clear only the content area (more efficient than full screen clear)
-  tft.fillRect(DISPLAY_OFFSET_X, DISPLAY_OFFSET_Y, 
-               kSourceWidth * DISPLAY_SCALE, 
-               kSourceHeight * DISPLAY_SCALE, 
+  tft.fillRect(DISPLAY_OFFSET_X, DISPLAY_OFFSET_Y,
+               kSourceWidth * DISPLAY_SCALE,
+               kSourceHeight * DISPLAY_SCALE,
                ILI9341_BG_COLOR);
-               
-  memset(page_buffer, 0, sizeof(page_buffer));
-  memset(page_dirty, false, sizeof(page_dirty));
+  memset(page_cache, 0, sizeof(page_cache));
+  page_valid = BlankPages(ILI9341_BG_COLOR);
 }
 
 /*static*/
 void ILI9341_Driver::Flush() {
-  // For ILI9341, flush is handled by the display library
-  // Nothing special needed here
-}
-
-/*static*/
-void ILI9341_Driver::DrawScaledPixel(int x, int y, bool on) {
-  // Apply flip if needed
-  if (flip_mode) {
-    x = kSourceWidth - 1 - x;
-    y = kSourceHeight - 1 - y;
-  }
-  
-  // Scale and offset
-  int screen_x = DISPLAY_OFFSET_X + x * DISPLAY_SCALE;
-  int screen_y = DISPLAY_OFFSET_Y + y * DISPLAY_SCALE;
-  
-  uint16_t color = on ? ILI9341_FG_COLOR : ILI9341_BG_COLOR;
-  
-  // Draw scaled pixel (2x2 block for DISPLAY_SCALE=2)
-  tft.fillRect(screen_x, screen_y, DISPLAY_SCALE, DISPLAY_SCALE, color);
+  // Pages are complete once their DMA finishes, nothing to push here
 }
 
 /*static*/
 bool ILI9341_Driver::SendPage(uint_fast8_t index, const uint8_t *data) {
   if (!display_initialized) return false;
   if (index >= kNumPages) return false;
-  
-  // Store page data and mark as dirty
-  memcpy(page_buffer[index], data, kPageSize);
-  page_dirty[index] = true;
-  
-  // Convert page-based format to pixels and draw
-  // Each page is 128 bytes wide, 8 pixels tall
-  // Bit 0 of each byte is the top pixel
-  
-  int page_y_start = index * 8;  // Each page is 8 pixels tall
-  
-  for (int col = 0; col < 128; col++) {
-    uint8_t byte = data[col];
-    for (int bit = 0; bit < 8; bit++) {
-      int y = page_y_start + bit;
-      bool pixel_on = (byte >> bit) & 1;
-      DrawScaledPixel(col, y, pixel_on);
+
+  uint32_t bit = 1UL << index;
+  if (present_mode_ == PRESENT_BEAM) {
+    // Collect the frame; Poll() sends it once all pages are in
+    if (strips_dirty) return false;
+    memcpy(strip_frame[index], data, kPageSize);
+    strip_pages |= bit;
+    if (strip_pages == kAllPages) {
+      strip_pages = 0;
+      QueueStrips();
     }
+    return true;
   }
-  
+
+  // Skipping needs no bus, so it doesn't have to wait for a transfer
+  if ((page_valid & bit) && !memcmp(page_cache[index], data, kPageSize)) {
+    ++transfer_stats.skipped;
+    return true;
+  }
+  if (dma_busy) return false;
+
+  memcpy(page_cache[index], data, kPageSize);
+  page_valid |= bit;
+  RenderPage(index, data);
+
+  StartTransfer(DISPLAY_OFFSET_X, DISPLAY_OFFSET_Y + index * 8 * DISPLAY_SCALE,
+                kSourceWidth * DISPLAY_SCALE, 8 * DISPLAY_SCALE, kPagePixels, false, index);
   return true;
 }
 
+/*static*/
+void ILI9341_Driver::Poll() {
+  if (!strips_dirty || dma_busy || !display_initialized) return;
+
+  if (strips_sync) {
+    beam.Sync(ReadScanline(), ARM_DWT_CYCCNT);
+    strips_sync = false;
+  }
+
+  // The dirty strips in scan order; rotation 3 reverses it
+  const uint32_t now = ARM_DWT_CYCCNT;
+  const uint32_t cycles = StripCycles();
+  util::BeamTracker::Span spans[kNumStrips];
+  uint8_t order[kNumStrips];
+  size_t count = 0;
+  for (size_t i = 0; i < kNumStrips; i++) {
+    size_t strip = flip_mode ? kNumStrips - 1 - i : i;
+    if (!(strips_dirty & (1UL << strip))) continue;
+    uint32_t first, last;
+    StripLines(strip, first, last);
+    spans[count] = { static_cast<uint16_t>(first), static_cast<uint16_t>(last) };
+    order[count++] = strip;
+  }
+
+  // Start the frame in a pass that has room for all of it, so one refresh
+  // shows all of it. If no pass can hold it at this rate, each strip goes
+  // out as soon as the beam is clear of it; each one is still whole.
+  if (!strips_started) {
+    strips_in_pass = beam.Fits(spans, count, cycles, now);
+    if (!strips_in_pass && beam.CanFit(spans, count, cycles)) {
+      ++transfer_stats.beam_waits;
+      return;
+    }
+    strips_pass = beam.pass(now);
+  }
+  if (strips_in_pass && beam.Missed(spans[0].first, cycles, strips_pass, now))
+    strips_in_pass = false;
+
+  // In scan order, which is also deadline order
+  int next = -1;
+  if (strips_in_pass) {
+    if (beam.Behind(spans[0].first, spans[0].last, cycles, strips_pass, now))
+      next = order[0];
+  } else {
+    for (size_t i = 0; i < count && next < 0; i++) {
+      if (beam.Behind(spans[i].first, spans[i].last, cycles, now))
+        next = order[i];
+    }
+  }
+  if (next < 0) {
+    ++transfer_stats.beam_waits;
+    return;
+  }
+
+  strips_started = true;
+  strips_dirty &= ~(1UL << next);
+  RenderStrip(next);
+  const size_t first = next * kStripColumns;
+  for (size_t page = 0; page < kNumPages; page++)
+    memcpy(page_cache[page] + first, strip_frame[page] + first, kStripColumns);
+  if (!strips_dirty)
+    page_valid = kAllPages & ~strips_stale;
+  StartTransfer(DISPLAY_OFFSET_X + first * DISPLAY_SCALE, DISPLAY_OFFSET_Y,
+                kStripColumns * DISPLAY_SCALE, kSourceHeight * DISPLAY_SCALE, kStripPixels, false, next);
+}
+
+/*static*/
+void ILI9341_Driver::Idle() {
+  if (!display_initialized || dma_busy || strips_dirty || !panel_dirty) return;
+
+  // Top to bottom; slices are short, so there's no need to round-robin
+  size_t slice = __builtin_ctz(panel_dirty);
+  panel_dirty &= ~(1UL << slice);
+  size_t row = slice * kPanelSliceRows;
+  size_t pixels = RenderPanelSlice(row);
+  StartTransfer(PANEL_OFFSET_X, PANEL_OFFSET_Y + row * DISPLAY_SCALE,
+                kPanelWidth * DISPLAY_SCALE, kPanelSliceRows * DISPLAY_SCALE, pixels, true, slice);
+  // The slice is on its way; later changes to it mark it again
+  const uint8_t mask = ((1 << kPanelSliceRows) - 1) << (row % 8);
+  uint8_t *shown = panel_shown + (row / 8) * kPanelWidth;
+  const uint8_t *data = panel + (row / 8) * kPanelWidth;
+  for (size_t col = 0; col < kPanelWidth; col++)
+    shown[col] = (shown[col] & ~mask) | (data[col] & mask);
+}
+
+/*static*/
+void ILI9341_Driver::SetPanel(const uint8_t *data) {
+  memcpy(panel, data, kPanelSize);
+  uint32_t dirty = 0;
+  for (size_t slice = 0; slice < kPanelSlices; slice++) {
+    size_t row = slice * kPanelSliceRows;
+    const uint8_t mask = ((1 << kPanelSliceRows) - 1) << (row % 8);
+    const uint8_t *shown = panel_shown + (row / 8) * kPanelWidth;
+    const uint8_t *next = panel + (row / 8) * kPanelWidth;
+    for (size_t col = 0; col < kPanelWidth; col++) {
+      if ((shown[col] ^ next[col]) & mask) {
+        dirty |= 1UL << slice;
+        break;
+      }
+    }
+  }
+  panel_dirty = dirty;
+}
+
 /*static*/
 void ILI9341_Driver::UpdateDisplay(const uint8_t* frame_buffer) {
   if (!display_initialized) return;
-  
-  // Process entire frame at once (more efficient than page-by-page)
-  // Frame buffer is organized as 8 pages, each 128 bytes (128x8 pixels)
-  
-  for (int page = 0; page < kNumPages; page++) {
-    const uint8_t* page_data = frame_buffer + (page * kPageSize);
-    int page_y_start = page * 8;
-    
-    for (int col = 0; col < 128; col++) {
-      uint8_t byte = page_data[col];
-      for (int bit = 0; bit < 8; bit++) {
-        int y = page_y_start + bit;
-        bool pixel_on = (byte >> bit) & 1;
-        DrawScaledPixel(col, y, pixel_on);
-      }
+
+  for (uint_fast8_t page = 0; page < kNumPages; page++) {
+    while (!SendPage(page, frame_buffer + page * kPageSize)) {
+      Poll();
     }
   }
+  while (strips_dirty)
+    Poll();
+  WaitIdle();
 }
 
 /*static*/
-void ILI9341_Driver::SPI_send([[maybe_unused]] void *bufr, [[maybe_unused]] size_t n) {
-  // This method is provided for API compatibility
-  // ILI9341_t3 library handles SPI internally
-  // If needed for other purposes, implement direct SPI transfer here
+void ILI9341_Driver::SPI_send(void *bufr, size_t n) {
+  // Raw parameter/pixel bytes for the current window, blocking
+  WaitIdle();
+  SPI.beginTransaction(spi_settings);
+  digitalWriteFast(ILI9341_CS_PIN, LOW);
+  SPI.transfer(bufr, n);
+  digitalWriteFast(ILI9341_CS_PIN, HIGH);
+  SPI.endTransaction();
+}
+
+/*static*/
+bool ILI9341_Driver::busy() {
+  return dma_busy;
+}
+
+/*static*/
+ILI9341_Driver::Stats ILI9341_Driver::stats() {
+  return transfer_stats;
+}
+
+/*static*/
+void ILI9341_Driver::ResetStats() {
+  noInterrupts();
+  transfer_stats = { 0, 0, 0, 0, 0 };
+  interrupts();
 }
 
 /*static*/
@@ -138,16 +516,103 @@ void ILI9341_Driver::AdjustOffset([[maybe_unused]] uint8_t offset) {
 }
 
 /*static*/
-void ILI9341_Driver::ChangeSpeed([[maybe_unused]] uint32_t speed) {
-  // SPI speed is managed by ILI9341_t3 library
+void ILI9341_Driver::ChangeSpeed(uint32_t speed) {
+  WaitIdle();
+  spi_settings = SPISettings(speed, MSBFIRST, SPI_MODE0);
+  spi_clock = speed;
 }
 
 /*static*/
 void ILI9341_Driver::SetFlipMode(bool flip180) {
   flip_mode = flip180;
   if (display_initialized) {
-    tft.setRotation(flip180 ? 2 : 0);
+    WaitIdle();
+    tft.setRotation(flip180 ? 3 : 1);
+    page_valid = 0;
+    panel_dirty = (1UL << kPanelSlices) - 1;
+  }
+}
+
+/*static*/
+void ILI9341_Driver::SetPalette(uint8_t index, uint16_t fg, uint16_t bg) {
+  if (index >= kNumPalettes) return;
+  if (palettes[index][0] == PixelPair(bg) && palettes[index][1] == PixelPair(fg)) return;
+  palettes[index][0] = PixelPair(bg);
+  palettes[index][1] = PixelPair(fg);
+  uint32_t pages = 0;
+  for (size_t page = 0; page < kNumPages; page++) {
+    if (memchr(palette_map[page], index, kPaletteCells))
+      pages |= 1UL << page;
+  }
+  RecolorPages(pages);
+}
+
+/*static*/
+void ILI9341_Driver::SetPaletteRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t index) {
+  if (index >= kNumPalettes || x >= kSourceWidth || y >= kSourceHeight || !w || !h) return;
+  const size_t right = x + w < kSourceWidth ? x + w : kSourceWidth;
+  const size_t bottom = y + h < kSourceHeight ? y + h : kSourceHeight;
+  const size_t first_cell = x / kPaletteCellWidth;
+  const size_t last_cell = (right - 1) / kPaletteCellWidth;
+  const size_t first_page = y / 8;
+  const size_t last_page = (bottom - 1) / 8;
+  uint32_t pages = 0;
+  for (size_t page = first_page; page <= last_page; page++) {
+    for (size_t cell = first_cell; cell <= last_cell; cell++) {
+      if (palette_map[page][cell] != index) {
+        palette_map[page][cell] = index;
+        pages |= 1UL << page;
+      }
+    }
+  }
+  RecolorPages(pages);
+}
+
+/*static*/
+void ILI9341_Driver::SetPresentMode(PresentMode mode) {
+  WaitIdle();
+  // A frame half sent as strips is left to the next one; page_cache holds
+  // what the display shows either way
+  strip_pages = 0;
+  strips_dirty = 0;
+  present_mode_ = mode;
+}
+
+/*static*/
+ILI9341_Driver::PresentMode ILI9341_Driver::present_mode() {
+  return present_mode_;
+}
+
+/*static*/
+uint32_t ILI9341_Driver::SetRefreshRate(uint32_t hz) {
+  uint32_t clocks = hz ? (kOscHz + hz * kScanLines / 2) / (hz * kScanLines) : kDefaultClocksPerLine;
+  if (clocks < kMinClocksPerLine) clocks = kMinClocksPerLine;
+  if (clocks > kMaxClocksPerLine) clocks = kMaxClocksPerLine;
+
+  if (display_initialized) {
+    WaitIdle();
+    SPI.beginTransaction(spi_settings);
+    digitalWriteFast(ILI9341_CS_PIN, LOW);
+    WriteCommand(kFrameRateControl);
+    SPI.transfer(0x00);  // DIVA: fosc
+    SPI.transfer(clocks);
+    digitalWriteFast(ILI9341_CS_PIN, HIGH);
+    SPI.endTransaction();
   }
+  clocks_per_line = clocks;
+  beam.Init(kScanLines, LineCycles(clocks));
+  strips_sync = true;
+  return refresh_rate();
+}
+
+/*static*/
+uint32_t ILI9341_Driver::refresh_rate() {
+  return kOscHz / (clocks_per_line * kScanLines);
+}
+
+/*static*/
+uint32_t ILI9341_Driver::line_cycles() {
+  return beam.line_cycles();
 }
 
 /*static*/
@@ -155,3 +620,5 @@ void ILI9341_Driver::SetContrast([[maybe_unused]] uint8_t contrast) {
   // ILI9341 doesn't have contrast control like OLED
   // Could potentially adjust brightness through backlight if connected
 }
+
+#endif // USE_ILI9341_DISPLAY
@@ -14,6 +14,37 @@
 // - SCK → Pin 13 (SPI CLK)
 // - MISO → Pin 12 (optional, for read operations)
 //
+// Pages are expanded to RGB565 and sent with DMA on SPI (LPSPI4), so the main
+// loop is not blocked by the transfer and the DAC buses (SPI1/SPI2, written
+// from the core timer) keep running alongside it. SendPage() returns false
+// while the previous page is still in flight, and PagedDisplayDriver retries
+// it from the next display::Update(). Pages that are unchanged since they
+// were last sent are skipped.
+//
+// The band below the scaled view holds a status panel: a 128x24 surface in
+// the same page layout, scaled 2x. SetPanel() only marks the rows that
+// changed. Idle() sends them in small slices, and is only called when no main
+// frame is pending, so the panel uses bus time the main view leaves free and
+// a new frame waits for one slice at most.
+//
+// In PRESENT_BEAM mode the scaled view is sent as vertical strips instead of
+// pages. In landscape the panel refreshes along x, so each strip covers a
+// narrow band of refresh lines. A strip is only sent when the refresh beam
+// is clear of it and won't reach it before the transfer ends, so it never
+// shows half written. A frame only starts in a pass that has room for all
+// of its strips, so a refresh shows one frame. The beam position is read
+// over MISO (Get Scanline) once per frame and predicted from the cycle
+// counter in between (util_beam.h). Strips carry the same pixels as pages
+// and unchanged ones are skipped, so the bus time is the same.
+// SetRefreshRate() sets the panel frame rate through FRMCTR1, which gives
+// the beam more passes to fit a strip into.
+//
+// The scaled view can be colored per region: each 8x8 source cell picks one
+// of kNumPalettes foreground/background pairs. A palette is kept as the two
+// 32-bit words the expansion writes for a pixel pair, so a colored pixel
+// costs the same table lookup as a monochrome one, and the frame stays 1bpp.
+// Changing a palette or a region resends only the pages it covers.
+//
 // Copyright (c) 2024
 
 #ifndef ILI9341_DRIVER_H_
@@ -49,16 +80,40 @@
 #define ILI9341_MISO_PIN 12
 #endif
 
+#ifndef ILI9341_SPI_CLOCK
+#define ILI9341_SPI_CLOCK 30000000
+#endif
+
+// Reads are slower than writes on the ILI9341
+#ifndef ILI9341_SPI_READ_CLOCK
+#define ILI9341_SPI_READ_CLOCK 6000000
+#endif
+
+// Start in PRESENT_BEAM mode (requires MISO)
+#ifndef ILI9341_TEAR_FREE
+#define ILI9341_TEAR_FREE 0
+#endif
+
+// Panel refresh rate in Hz, 0 keeps the controller's init value
+#ifndef ILI9341_REFRESH_HZ
+#define ILI9341_REFRESH_HZ 0
+#endif
+
 // Color definitions for monochrome emulation
 #define ILI9341_BG_COLOR ILI9341_BLACK
 #define ILI9341_FG_COLOR ILI9341_WHITE
 
-// Scaling factor for displaying 128x64 content on 320x240
+// Scaling factor for displaying 128x64 content on 320x240 (landscape)
 // Using 2x scale centers nicely: 128*2=256 (centered in 320), 64*2=128 (centered in 240)
 #define DISPLAY_SCALE 2
 #define DISPLAY_OFFSET_X ((320 - 128 * DISPLAY_SCALE) / 2)
 #define DISPLAY_OFFSET_Y ((240 - 64 * DISPLAY_SCALE) / 2)
 
+// Status panel, centered in the band below the border
+#define PANEL_OFFSET_X DISPLAY_OFFSET_X
+#define PANEL_OFFSET_Y (DISPLAY_OFFSET_Y + 64 * DISPLAY_SCALE + \
+                        (DISPLAY_OFFSET_Y - 24 * DISPLAY_SCALE) / 2)
+
 // This struct provides API compatibility with SH1106_128x64_Driver
 struct ILI9341_Driver {
   // Frame buffer dimensions compatible with SH1106
@@ -75,28 +130,90 @@ struct ILI9341_Driver {
   static constexpr size_t kSourceWidth = 128;
   static constexpr size_t kSourceHeight = 64;
 
+  // One scaled page in RGB565
+  static constexpr size_t kPagePixels = kSourceWidth * DISPLAY_SCALE * 8 * DISPLAY_SCALE;
+
+  // PRESENT_BEAM strips: kStripColumns source columns, all rows
+  static constexpr size_t kStripColumns = 16;
+  static constexpr size_t kNumStrips = kSourceWidth / kStripColumns;
+  static constexpr size_t kStripPixels = kStripColumns * DISPLAY_SCALE * kSourceHeight * DISPLAY_SCALE;
+
+  // Refresh lines including the porches, and the oscillator that FRMCTR1
+  // divides (frame rate = kOscHz / (clocks per line * kScanLines))
+  static constexpr uint32_t kScanLines = 320 + 4;
+  static constexpr uint32_t kOscHz = 615000;
+
+  enum PresentMode : uint8_t {
+    PRESENT_PAGES,  // Pages as soon as the bus is free
+    PRESENT_BEAM,   // Strips timed to stay clear of the refresh beam
+  };
+
+  // Status panel surface, in the frame's page layout
+  static constexpr size_t kPanelWidth = kSourceWidth;
+  static constexpr size_t kPanelHeight = 24;
+  static constexpr size_t kPanelPages = kPanelHeight / 8;
+  static constexpr size_t kPanelSize = kPanelWidth * kPanelPages;
+  // Source rows per panel transfer, which bounds the delay of a new frame
+  static constexpr size_t kPanelSliceRows = 2;
+  static constexpr size_t kPanelSlices = kPanelHeight / kPanelSliceRows;
+
+  // Per-region colors of the scaled view; every cell starts in palette 0,
+  // which starts as ILI9341_FG_COLOR/ILI9341_BG_COLOR
+  static constexpr size_t kNumPalettes = 8;
+  static constexpr size_t kPaletteCellWidth = 8;
+  static constexpr size_t kPaletteCells = kSourceWidth / kPaletteCellWidth;
+
+  struct Stats {
+    uint32_t pages;        // Pages or strips sent
+    uint32_t skipped;      // Unchanged pages or strips not sent
+    uint32_t busy_cycles;  // From the window setup to the end of the DMA
+    uint32_t panel_slices; // Status panel transfers
+    uint32_t beam_waits;   // Polls that held a strip back for the beam
+  };
+
   static void Init();
   static void Clear();
   static void Flush();
   static bool SendPage(uint_fast8_t index, const uint8_t *data);
   static void SPI_send(void *bufr, size_t n);
 
+  // Sends PRESENT_BEAM strips when the beam allows
+  static void Poll();
+
+  // No frame pending: send a changed status panel slice if the bus is free
+  static void Idle();
+
+  // Copy the status panel (kPanelSize bytes) and mark the rows that changed
+  static void SetPanel(const uint8_t *panel);
+
+  // Set the RGB565 colors of palette `index`
+  static void SetPalette(uint8_t index, uint16_t fg, uint16_t bg);
+  // Use palette `index` for source pixels [x, x + w) x [y, y + h), widened to
+  // whole cells
+  static void SetPaletteRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t index);
+
+  static void SetPresentMode(PresentMode mode);
+  static PresentMode present_mode();
+
+  // Nearest rate FRMCTR1 can set (about 61-119 Hz); returns the rate set
+  static uint32_t SetRefreshRate(uint32_t hz);
+  static uint32_t refresh_rate();
+  // Measured refresh line period in cycles
+  static uint32_t line_cycles();
+
+  // A page transfer is in flight
+  static bool busy();
+  static Stats stats();
+  static void ResetStats();
+
   // Compatibility methods
   static void AdjustOffset(uint8_t offset);
   static void ChangeSpeed(uint32_t speed);
   static void SetFlipMode(bool flip180);
   static void SetContrast(uint8_t contrast);
   
-  // Full frame update method for better performance
+  // Send a whole frame and wait for the transfer to finish
   static void UpdateDisplay(const uint8_t* frame_buffer);
-  
-private:
-  static void DrawScaledPixel(int x, int y, bool on);
 };
 
-// Alias for compatibility with existing code that references SH1106
-#ifdef USE_ILI9341_DISPLAY
-using SH1106_128x64_Driver = ILI9341_Driver;
-#endif
-
 #endif // ILI9341_DRIVER_H_
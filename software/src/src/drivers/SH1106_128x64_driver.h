@@ -1,8 +1,10 @@
 // SH1106_128x64_driver.h - Display Driver Selection Header
 //
-// This header provides compatibility by selecting either:
-// - Original SH1106 OLED driver
-// - ILI9341 TFT driver (when USE_ILI9341_DISPLAY is defined)
+// This header provides compatibility by selecting the display behind
+// SH1106_128x64_Driver:
+// - Original SH1106 OLED driver (USE_SH1106_DISPLAY, the default)
+// - ILI9341 TFT driver (USE_ILI9341_DISPLAY)
+// - Both, with every frame mirrored to the OLED and the TFT (both defined)
 //
 // Copyright (c) 2016 Patrick Dowling (original SH1106)
 // Copyright (c) 2024 (ILI9341 adaptation)
@@ -13,35 +15,26 @@
 #include <stdint.h>
 #include <string.h>
 
-#ifdef USE_ILI9341_DISPLAY
+#if !defined(USE_ILI9341_DISPLAY) && !defined(USE_SH1106_DISPLAY)
+#define USE_SH1106_DISPLAY
+#endif
 
-// Use ILI9341 TFT display driver
-#include "ILI9341_Driver.h"
+#ifdef USE_SH1106_DISPLAY
+#include "SH1106_driver.h"
+#endif
 
+#ifdef USE_ILI9341_DISPLAY
+#include "ILI9341_Driver.h"
+#endif
+
+#if defined(USE_SH1106_DISPLAY) && defined(USE_ILI9341_DISPLAY)
+#include "composite_display_driver.h"
+// The OLED goes first so its short pages never wait behind a TFT page
+using SH1106_128x64_Driver = CompositeDisplayDriver<SH1106_Driver, ILI9341_Driver>;
+#elif defined(USE_ILI9341_DISPLAY)
+using SH1106_128x64_Driver = ILI9341_Driver;
 #else
-
-// Original SH1106 OLED driver structure
-struct SH1106_128x64_Driver {
-  static constexpr size_t kFrameSize = 128 * 64 / 8;
-  static constexpr size_t kNumPages = 8;
-  static constexpr size_t kPageSize = kFrameSize / kNumPages;
-  static constexpr uint8_t kDefaultOffset = 2;
-
-  static void Init();
-  static void Clear();
-  static void Flush();
-  static bool SendPage(uint_fast8_t index, const uint8_t *data);
-  static void SPI_send(void *bufr, size_t n);
-
-  // SH1106 ram is 132x64, so it needs an offset to center data in display.
-  // However at least one display (mine) uses offset 0 so it's minimally
-  // configurable
-  static void AdjustOffset(uint8_t offset);
-  static void ChangeSpeed(uint32_t speed);
-  static void SetFlipMode(bool flip180);
-  static void SetContrast(uint8_t contrast);
-};
-
-#endif // USE_ILI9341_DISPLAY
+using SH1106_128x64_Driver = SH1106_Driver;
+#endif
 
 #endif // SH1106_128X64_DRIVER_H_
@@ -0,0 +1,286 @@
+// SH1106_driver.cpp - SH1106 OLED driver implementation
+//
+// Copyright (c) 2016 Patrick Dowling (original SH1106)
+//
+// Commands are written with blocking transfers and DC low; page data with an
+// asynchronous SPI DMA transfer and DC high. A copy of every page sent is
+// kept, both as the DMA source (the frame buffer is released as soon as the
+// last page has been handed over) and to skip pages that haven't changed.
+//
+// Init() starts the reset and setup as a coroutine task: the reset waits
+// and the clearing of display RAM (a DMA transfer per page) don't hold up
+// setup(). The driver reports busy until the display is on.
+
+#include "SH1106_128x64_driver.h"
+
+#ifdef USE_SH1106_DISPLAY
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "../OC_clock.h"
+#include "../OC_coro.h"
+#include "../OC_trace.h"
+
+// The clock input interrupt would take every OLED transfer for clock edges
+#if SH1106_CS_PIN == CLOCK_IN_PIN || SH1106_DC_PIN == CLOCK_IN_PIN || SH1106_RST_PIN == CLOCK_IN_PIN
+#error "SH1106 pins overlap CLOCK_IN_PIN"
+#endif
+
+// Command bytes, see the SH1106 datasheet
+static constexpr uint8_t kCmdColumnLow = 0x00;
+static constexpr uint8_t kCmdColumnHigh = 0x10;
+static constexpr uint8_t kCmdContrast = 0x81;
+static constexpr uint8_t kCmdSegmentNormal = 0xA0;
+static constexpr uint8_t kCmdSegmentRemap = 0xA1;
+static constexpr uint8_t kCmdDisplayOff = 0xAE;
+static constexpr uint8_t kCmdDisplayOn = 0xAF;
+static constexpr uint8_t kCmdPageAddress = 0xB0;
+static constexpr uint8_t kCmdComScanUp = 0xC0;
+static constexpr uint8_t kCmdComScanDown = 0xC8;
+
+static constexpr uint8_t kDefaultContrast = 0x80;
+static constexpr size_t kRamWidth = 132;
+
+static const uint8_t init_sequence[] = {
+  kCmdDisplayOff,
+  0xD5, 0x80,  // Clock divide ratio / oscillator frequency
+  0xA8, 0x3F,  // Multiplex ratio 1/64
+  0xD3, 0x00,  // Display offset
+  0x40,        // Display start line 0
+  0xAD, 0x8B,  // DC-DC converter on
+  0x32,        // Pump voltage 8.0V
+  0xDA, 0x12,  // COM pins, alternative configuration
+  0xD9, 0x22,  // Pre-charge/discharge period
+  0xDB, 0x35,  // VCOM deselect level
+  0xA4,        // Output follows RAM
+  0xA6,        // Normal (not inverted)
+};
+
+static SPISettings spi_settings(SH1106_SPI_CLOCK, MSBFIRST, SPI_MODE0);
+static EventResponder dma_event;
+static OC::CORO::Completion dma_done;
+
+// All 132 columns of a page, including the ones outside the visible area
+static uint8_t blank_page[kRamWidth];
+
+static uint8_t page_cache[SH1106_Driver::kNumPages][SH1106_Driver::kPageSize];
+static uint32_t page_valid;  // Bit per page: page_cache matches the display
+
+static volatile bool dma_busy = false;
+static uint32_t dma_start;
+static SH1106_Driver::Stats transfer_stats;
+static uint8_t column_offset = SH1106_Driver::kDefaultOffset;
+static bool flip_mode = false;
+static uint8_t contrast = kDefaultContrast;
+static bool display_initialized = false;
+
+static void DMAComplete(EventResponderRef) {
+  digitalWriteFast(SH1106_CS_PIN, HIGH);
+  SPI.endTransaction();
+  ++transfer_stats.pages;
+  transfer_stats.busy_cycles += ARM_DWT_CYCCNT - dma_start;
+  OC::TRACE::End(OC::TRACE::EVENT_DISPLAY_DMA);
+  dma_busy = false;
+  dma_done.Signal();
+}
+
+static void WaitIdle() {
+  while (dma_busy) {
+  }
+}
+
+static void BeginCommands() {
+  SPI.beginTransaction(spi_settings);
+  digitalWriteFast(SH1106_CS_PIN, LOW);
+  digitalWriteFast(SH1106_DC_PIN, LOW);
+}
+
+static void EndCommands() {
+  digitalWriteFast(SH1106_CS_PIN, HIGH);
+  SPI.endTransaction();
+}
+
+// Blocking transfers return after the last bit, so DC can be switched after
+static void SetPageAddress(uint_fast8_t page, uint8_t column) {
+  SPI.transfer(kCmdPageAddress | page);
+  SPI.transfer(kCmdColumnLow | (column & 0x0F));
+  SPI.transfer(kCmdColumnHigh | (column >> 4));
+}
+
+static void WriteSettings() {
+  BeginCommands();
+  SPI.transfer(flip_mode ? kCmdSegmentNormal : kCmdSegmentRemap);
+  SPI.transfer(flip_mode ? kCmdComScanUp : kCmdComScanDown);
+  SPI.transfer(kCmdContrast);
+  SPI.transfer(contrast);
+  EndCommands();
+}
+
+static void SendInitSequence() {
+  BeginCommands();
+  for (uint8_t command : init_sequence)
+    SPI.transfer(command);
+  EndCommands();
+}
+
+// Settings last, so changes made while the task ran are applied
+static void TurnOn() {
+  WriteSettings();
+  BeginCommands();
+  SPI.transfer(kCmdDisplayOn);
+  EndCommands();
+  SH1106_Driver::ResetStats();
+  display_initialized = true;
+}
+
+static OC::CORO::Task Start() {
+  digitalWriteFast(SH1106_RST_PIN, HIGH);
+  co_await OC::CORO::Sleep(1000);
+  digitalWriteFast(SH1106_RST_PIN, LOW);
+  co_await OC::CORO::Sleep(10000);
+  digitalWriteFast(SH1106_RST_PIN, HIGH);
+  co_await OC::CORO::Sleep(10000);
+
+  SendInitSequence();
+  for (uint_fast8_t page = 0; page < SH1106_Driver::kNumPages; ++page) {
+    dma_done.Reset();
+    dma_start = ARM_DWT_CYCCNT;
+    OC::TRACE::Begin(OC::TRACE::EVENT_DISPLAY_DMA, page);
+    BeginCommands();
+    SetPageAddress(page, 0);
+    digitalWriteFast(SH1106_DC_PIN, HIGH);
+    SH1106_Driver::SPI_send(blank_page, kRamWidth);
+    co_await OC::CORO::Wait(dma_done);
+  }
+  memset(page_cache, 0, sizeof(page_cache));
+  page_valid = (1UL << SH1106_Driver::kNumPages) - 1;
+  TurnOn();
+}
+
+/*static*/
+void SH1106_Driver::Init() {
+  pinMode(SH1106_CS_PIN, OUTPUT);
+  pinMode(SH1106_DC_PIN, OUTPUT);
+  pinMode(SH1106_RST_PIN, OUTPUT);
+  digitalWriteFast(SH1106_CS_PIN, HIGH);
+  SPI.begin();
+
+  dma_event.attachImmediate(DMAComplete);
+  dma_busy = false;
+  display_initialized = false;
+  if (OC::CORO::Spawn(Start()))
+    return;
+
+  // No coroutine frame: the same steps, blocking
+  digitalWriteFast(SH1106_RST_PIN, HIGH);
+  delay(1);
+  digitalWriteFast(SH1106_RST_PIN, LOW);
+  delay(10);
+  digitalWriteFast(SH1106_RST_PIN, HIGH);
+  delay(10);
+  SendInitSequence();
+  Clear();
+  TurnOn();
+}
+
+/*static*/
+void SH1106_Driver::Clear() {
+  WaitIdle();
+  for (uint_fast8_t page = 0; page < kNumPages; ++page) {
+    BeginCommands();
+    SetPageAddress(page, 0);
+    digitalWriteFast(SH1106_DC_PIN, HIGH);
+    for (size_t column = 0; column < kRamWidth; ++column)
+      SPI.transfer(0);
+    EndCommands();
+  }
+  memset(page_cache, 0, sizeof(page_cache));
+  page_valid = (1UL << kNumPages) - 1;
+}
+
+/*static*/
+void SH1106_Driver::Flush() {
+  // Pages are complete once their DMA finishes and the data was copied, so
+  // the frame can be released right away
+}
+
+/*static*/
+bool SH1106_Driver::SendPage(uint_fast8_t index, const uint8_t *data) {
+  if (!display_initialized || index >= kNumPages)
+    return false;
+
+  // Skipping needs no bus, so it doesn't have to wait for a transfer
+  uint32_t bit = 1UL << index;
+  if ((page_valid & bit) && !memcmp(page_cache[index], data, kPageSize)) {
+    ++transfer_stats.skipped;
+    return true;
+  }
+  if (dma_busy)
+    return false;
+  memcpy(page_cache[index], data, kPageSize);
+  page_valid |= bit;
+
+  dma_start = ARM_DWT_CYCCNT;
+  OC::TRACE::Begin(OC::TRACE::EVENT_DISPLAY_DMA, index);
+  BeginCommands();
+  SetPageAddress(index, column_offset);
+  digitalWriteFast(SH1106_DC_PIN, HIGH);
+  SPI_send(page_cache[index], kPageSize);
+  return true;
+}
+
+/*static*/
+void SH1106_Driver::SPI_send(void *bufr, size_t n) {
+  dma_busy = true;
+  SPI.transfer(bufr, nullptr, n, dma_event);
+}
+
+/*static*/
+void SH1106_Driver::AdjustOffset(uint8_t offset) {
+  WaitIdle();
+  column_offset = offset;
+  page_valid = 0;
+}
+
+/*static*/
+void SH1106_Driver::ChangeSpeed(uint32_t speed) {
+  WaitIdle();
+  spi_settings = SPISettings(speed, MSBFIRST, SPI_MODE0);
+}
+
+/*static*/
+void SH1106_Driver::SetFlipMode(bool flip180) {
+  WaitIdle();
+  flip_mode = flip180;
+  if (display_initialized)
+    WriteSettings();
+  // Segment remap only applies to data written afterwards
+  page_valid = 0;
+}
+
+/*static*/
+void SH1106_Driver::SetContrast(uint8_t value) {
+  WaitIdle();
+  contrast = value;
+  if (display_initialized)
+    WriteSettings();
+}
+
+/*static*/
+bool SH1106_Driver::busy() {
+  return dma_busy || !display_initialized;
+}
+
+/*static*/
+SH1106_Driver::Stats SH1106_Driver::stats() {
+  return transfer_stats;
+}
+
+/*static*/
+void SH1106_Driver::ResetStats() {
+  noInterrupts();
+  transfer_stats = { 0, 0, 0 };
+  interrupts();
+}
+
+#endif // USE_SH1106_DISPLAY
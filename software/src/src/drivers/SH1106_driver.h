@@ -0,0 +1,80 @@
+// SH1106_driver.h - SH1106 128x64 OLED driver
+//
+// Copyright (c) 2016 Patrick Dowling (original SH1106)
+//
+// The OLED sits on SPI (MOSI=11, SCK=13) with the pins of the O_C
+// hardware. Pages go out with SPI DMA: SendPage() writes the three page
+// address commands, then hands the page to SPI_send(), which returns while
+// the transfer runs. Pages that are unchanged since they were last sent are
+// skipped, so a mostly static screen costs almost no bus time.
+
+#ifndef SH1106_DRIVER_H_
+#define SH1106_DRIVER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Pin definitions - can be overridden in platformio.ini
+#ifndef SH1106_CS_PIN
+#define SH1106_CS_PIN 8
+#endif
+
+#ifndef SH1106_DC_PIN
+#define SH1106_DC_PIN 6
+#endif
+
+#ifndef SH1106_RST_PIN
+#define SH1106_RST_PIN 7
+#endif
+
+#ifndef SH1106_SPI_CLOCK
+#define SH1106_SPI_CLOCK 24000000
+#endif
+
+struct SH1106_Driver {
+  static constexpr size_t kFrameSize = 128 * 64 / 8;
+  static constexpr size_t kNumPages = 8;
+  static constexpr size_t kPageSize = kFrameSize / kNumPages;
+  static constexpr uint8_t kDefaultOffset = 2;
+
+  struct Stats {
+    uint32_t pages;
+    uint32_t skipped;      // Unchanged pages not sent
+    uint32_t busy_cycles;  // From the page commands to the end of the DMA
+  };
+
+  // Returns while the reset and setup continue from OC::CORO::Poll()
+  static void Init();
+  static void Clear();
+  static void Flush();
+  static bool SendPage(uint_fast8_t index, const uint8_t *data);
+
+  // Start a DMA transfer of n data bytes inside the current page write; the
+  // completion raises /CS and ends the SPI transaction. bufr must stay valid
+  // until busy() returns false.
+  static void SPI_send(void *bufr, size_t n);
+
+  // SH1106 ram is 132x64, so it needs an offset to center data in display.
+  // However at least one display (mine) uses offset 0 so it's minimally
+  // configurable
+  static void AdjustOffset(uint8_t offset);
+  static void ChangeSpeed(uint32_t speed);
+  static void SetFlipMode(bool flip180);
+  static void SetContrast(uint8_t contrast);
+
+  // Monochrome panel
+  static inline void SetPalette(uint8_t, uint16_t, uint16_t) {}
+  static inline void SetPaletteRegion(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t) {}
+
+  // Transfers only start from SendPage()
+  static inline void Poll() {}
+  // Nothing to send between frames
+  static inline void Idle() {}
+
+  // A page transfer is in flight, or the display isn't on yet
+  static bool busy();
+  static Stats stats();
+  static void ResetStats();
+};
+
+#endif // SH1106_DRIVER_H_
@@ -0,0 +1,213 @@
+// composite_display_driver.h - Mirror one frame to several display drivers
+//
+// CompositeDisplayDriver<A, B, ...> has the same static interface as a single
+// driver, so it can stand in for SH1106_128x64_Driver behind
+// PagedDisplayDriver. SendPage() only copies the page and marks it pending
+// for every backend. Poll() then hands pending pages to each backend at its
+// own pace. A backend that is still busy keeps its pages pending, and later
+// gets the latest content of each page, so it drops frames instead of
+// holding back the others.
+//
+// All backends share the SPI bus, so only one transfer runs at a time.
+// Backends are served in template order at page granularity, so list the
+// fastest first. Each backend skips its own unchanged pages.
+//
+// Single-display builds use the driver directly and don't pay for any of
+// this.
+
+#ifndef COMPOSITE_DISPLAY_DRIVER_H_
+#define COMPOSITE_DISPLAY_DRIVER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <tuple>
+#include <utility>
+
+template <typename Primary, typename... Others>
+struct CompositeDisplayDriver {
+  static constexpr size_t kFrameSize = Primary::kFrameSize;
+  static constexpr size_t kNumPages = Primary::kNumPages;
+  static constexpr size_t kPageSize = Primary::kPageSize;
+  static constexpr uint8_t kDefaultOffset = Primary::kDefaultOffset;
+  static constexpr size_t kNumBackends = 1 + sizeof...(Others);
+
+  static_assert(((Others::kFrameSize == kFrameSize && Others::kNumPages == kNumPages) && ...),
+                "Backends must share the frame layout");
+  static_assert(kNumPages <= 32, "Pending pages are a 32-bit mask");
+
+  struct Stats {
+    uint32_t pages;
+    uint32_t skipped;
+    uint32_t busy_cycles;
+  };
+
+  static void Init() {
+    Primary::Init();
+    (Others::Init(), ...);
+    memset(frame_, 0, sizeof(frame_));
+    for (size_t i = 0; i < kNumBackends; ++i) {
+      pending_[i] = 0;
+      next_page_[i] = 0;
+    }
+  }
+
+  static void Clear() {
+    Primary::Clear();
+    (Others::Clear(), ...);
+    memset(frame_, 0, sizeof(frame_));
+    for (size_t i = 0; i < kNumBackends; ++i)
+      pending_[i] = 0;
+  }
+
+  static void Flush() {
+    Primary::Flush();
+    (Others::Flush(), ...);
+    Poll();
+  }
+
+  static bool SendPage(uint_fast8_t index, const uint8_t *data) {
+    if (index >= kNumPages)
+      return false;
+    memcpy(frame_[index], data, kPageSize);
+    for (size_t i = 0; i < kNumBackends; ++i)
+      pending_[i] |= 1UL << index;
+    Poll();
+    return true;
+  }
+
+  static void Poll() {
+    if (busy_backends())
+      return;
+    // Backends that time their own transfers first
+    if (PollOwn<Primary, Others...>())
+      return;
+    PollBackends(std::index_sequence_for<Primary, Others...>());
+  }
+
+  // Background content once every backend has the current frame. Backends
+  // are asked in order; the first one to take the bus ends the round.
+  static void Idle() {
+    if (busy())
+      return;
+    IdleBackends<Primary, Others...>();
+  }
+
+  // Raw data for the primary display
+  static void SPI_send(void *bufr, size_t n) {
+    Primary::SPI_send(bufr, n);
+  }
+
+  static void AdjustOffset(uint8_t offset) {
+    Primary::AdjustOffset(offset);
+    (Others::AdjustOffset(offset), ...);
+  }
+
+  static void ChangeSpeed(uint32_t speed) {
+    Primary::ChangeSpeed(speed);
+    (Others::ChangeSpeed(speed), ...);
+  }
+
+  static void SetFlipMode(bool flip180) {
+    Primary::SetFlipMode(flip180);
+    (Others::SetFlipMode(flip180), ...);
+  }
+
+  static void SetContrast(uint8_t contrast) {
+    Primary::SetContrast(contrast);
+    (Others::SetContrast(contrast), ...);
+  }
+
+  static void SetPalette(uint8_t index, uint16_t fg, uint16_t bg) {
+    Primary::SetPalette(index, fg, bg);
+    (Others::SetPalette(index, fg, bg), ...);
+  }
+
+  static void SetPaletteRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t index) {
+    Primary::SetPaletteRegion(x, y, w, h, index);
+    (Others::SetPaletteRegion(x, y, w, h, index), ...);
+  }
+
+  // A transfer is in flight or a backend still has pages to send
+  static bool busy() {
+    if (busy_backends())
+      return true;
+    for (size_t i = 0; i < kNumBackends; ++i) {
+      if (pending_[i])
+        return true;
+    }
+    return false;
+  }
+
+  // Pages still to be sent to backend `index` (in template order)
+  static uint32_t pending(size_t index) {
+    return pending_[index];
+  }
+
+  // Totals over all backends
+  static Stats stats() {
+    Stats total = { 0, 0, 0 };
+    Add<Primary>(total);
+    (Add<Others>(total), ...);
+    return total;
+  }
+
+  static void ResetStats() {
+    Primary::ResetStats();
+    (Others::ResetStats(), ...);
+  }
+
+private:
+  static inline uint8_t frame_[kNumPages][kPageSize];
+  static inline uint32_t pending_[kNumBackends];
+  static inline uint8_t next_page_[kNumBackends];
+
+  static bool busy_backends() {
+    return Primary::busy() || (Others::busy() || ...);
+  }
+
+  template <typename Backend>
+  static void Add(Stats &total) {
+    typename Backend::Stats stats = Backend::stats();
+    total.pages += stats.pages;
+    total.skipped += stats.skipped;
+    total.busy_cycles += stats.busy_cycles;
+  }
+
+  template <typename... Backends>
+  static bool PollOwn() {
+    return ((Backends::Poll(), Backends::busy()) || ...);
+  }
+
+  template <typename... Backends>
+  static void IdleBackends() {
+    ((Backends::Idle(), Backends::busy()) || ...);
+  }
+
+  template <size_t... I>
+  static void PollBackends(std::index_sequence<I...>) {
+    // Stops at the first backend that takes the bus
+    (PollBackend<I, Primary, Others...>() || ...);
+  }
+
+  template <size_t I, typename... Backends>
+  static bool PollBackend() {
+    using Backend = std::tuple_element_t<I, std::tuple<Backends...>>;
+    // Round-robin from where this backend left off, so with frames arriving
+    // faster than it can send, every page still gets its turn
+    uint32_t &pending = pending_[I];
+    while (pending) {
+      size_t page = next_page_[I];
+      while (!(pending & (1UL << page)))
+        page = (page + 1) % kNumPages;
+      if (!Backend::SendPage(page, frame_[page]))
+        return true;
+      pending &= ~(1UL << page);
+      next_page_[I] = (page + 1) % kNumPages;
+      if (Backend::busy())
+        return true;
+    }
+    return false;
+  }
+};
+
+#endif // COMPOSITE_DISPLAY_DRIVER_H_
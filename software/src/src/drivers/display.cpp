@@ -9,6 +9,7 @@ namespace display {
 
 FrameBuffer<SH1106_128x64_Driver::kFrameSize, 2> frame_buffer;
 PagedDisplayDriver<SH1106_128x64_Driver> driver;
+PresentHook present_hook = nullptr;
 
 void Init() {
   frame_buffer.Init();
@@ -27,6 +28,14 @@ void SetContrast(uint8_t contrast) {
   SH1106_128x64_Driver::SetContrast(contrast);
 }
 
+void SetPalette(uint8_t index, uint16_t fg, uint16_t bg) {
+  SH1106_128x64_Driver::SetPalette(index, fg, bg);
+}
+
+void SetPaletteRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t index) {
+  SH1106_128x64_Driver::SetPaletteRegion(x, y, w, h, index);
+}
+
 }; // namespace display
 
 weegfx::Graphics graphics;
@@ -16,11 +16,19 @@ namespace display {
 extern FrameBuffer<SH1106_128x64_Driver::kFrameSize, 2> frame_buffer;
 extern PagedDisplayDriver<SH1106_128x64_Driver> driver;
 
+// Called with each frame as it starts going out to the display
+typedef void (*PresentHook)(const uint8_t *frame);
+extern PresentHook present_hook;
+
 void Init();
 void AdjustOffset(uint8_t offset);
 void SetFlipMode(bool flip180);
 void SetContrast(uint8_t contrast);
 
+// Per-region colors on color displays (RGB565); ignored on the OLED
+void SetPalette(uint8_t index, uint16_t fg, uint16_t bg);
+void SetPaletteRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t index);
+
 static inline void Flush() __attribute__((always_inline));
 static inline void Flush() {
   if (driver.Flush())
@@ -29,11 +37,17 @@ static inline void Flush() {
 
 static inline void Update() __attribute__((always_inline));
 static inline void Update() {
+  driver.Poll();
   if (driver.frame_valid()) {
     driver.Update();
   } else {
-    if (frame_buffer.readable())
+    if (frame_buffer.readable()) {
+      if (present_hook)
+        present_hook(frame_buffer.readable_frame());
       driver.Begin(frame_buffer.readable_frame());
+    } else {
+      driver.Idle();
+    }
   }
 }
 
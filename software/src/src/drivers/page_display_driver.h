@@ -17,29 +17,49 @@ public:
     display_driver::Init();
     frame_ = nullptr;
     page_ = 0;
+    done_ = false;
   }
 
+  // True once for each frame whose pages have all been handed to the driver,
+  // so the caller can release it. Safe to call with no frame in progress.
   bool Flush() {
     display_driver::Flush();
-    return frame_ == nullptr;
+    bool done = done_;
+    done_ = false;
+    return done;
   }
 
   void Begin(const uint8_t *frame) {
     frame_ = frame;
     page_ = 0;
+    done_ = false;
   }
 
   bool frame_valid() const {
     return frame_ != nullptr;
   }
 
+  // Lets drivers that send outside SendPage() (e.g. when mirroring to
+  // several displays) move on between frames
+  void Poll() {
+    display_driver::Poll();
+  }
+
+  // No frame to send: drivers may use the bus for background content
+  void Idle() {
+    if (!frame_)
+      display_driver::Idle();
+  }
+
   void Update() {
     if (frame_) {
       if (display_driver::SendPage(page_, frame_)) {
         frame_ += kPageSize;
         ++page_;
-        if (page_ >= kNumPages)
+        if (page_ >= kNumPages) {
           frame_ = nullptr;
+          done_ = true;
+        }
       }
     }
   }
@@ -47,6 +67,7 @@ public:
 private:
   const uint8_t *frame_;
   size_t page_;
+  bool done_;
 };
 
 #endif // PAGE_DISPLAY_DRIVER_H_
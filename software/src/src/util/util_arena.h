@@ -0,0 +1,89 @@
+// util_arena.h - Fixed-size bump allocator
+//
+// Allocations take the next aligned bytes of a static buffer and are never
+// freed one by one; Reset() releases all of them at once in constant time.
+// That suits state that lives exactly as long as something else (an applet
+// between two switches), without heap fragmentation or allocation latency.
+// Objects are not destroyed by Reset(), so only trivially destructible types
+// can be created with New().
+//
+// Not thread safe; allocate from one context (the UI loop).
+
+#ifndef UTIL_ARENA_H_
+#define UTIL_ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace util {
+
+template <size_t size>
+class Arena {
+public:
+  static constexpr size_t kSize = size;
+
+  void Init() {
+    used_ = 0;
+    high_water_ = 0;
+    failures_ = 0;
+  }
+
+  // Returns nullptr (and counts a failure) if the arena is full
+  void *Allocate(size_t bytes, size_t alignment = alignof(max_align_t)) {
+    size_t start = (used_ + alignment - 1) & ~(alignment - 1);
+    if (start > kSize || bytes > kSize - start) {
+      ++failures_;
+      return nullptr;
+    }
+    used_ = start + bytes;
+    if (used_ > high_water_)
+      high_water_ = used_;
+    return storage_ + start;
+  }
+
+  template <typename T, typename... Args>
+  T *New(Args &&... args) {
+    static_assert(std::is_trivially_destructible<T>::value, "Reset() doesn't run destructors");
+    void *memory = Allocate(sizeof(T), alignof(T));
+    return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+  }
+
+  template <typename T>
+  T *NewArray(size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value, "Reset() doesn't run destructors");
+    if (count > kSize / sizeof(T)) {
+      ++failures_;
+      return nullptr;
+    }
+    void *memory = Allocate(sizeof(T) * count, alignof(T));
+    return memory ? new (memory) T[count]() : nullptr;
+  }
+
+  // Release everything allocated since Init()
+  void Reset() {
+    used_ = 0;
+  }
+
+  size_t used() const { return used_; }
+  size_t available() const { return kSize - used_; }
+  size_t high_water() const { return high_water_; }
+  uint32_t failures() const { return failures_; }
+
+  void ResetStats() {
+    high_water_ = used_;
+    failures_ = 0;
+  }
+
+private:
+  alignas(max_align_t) uint8_t storage_[kSize];
+  size_t used_ = 0;
+  size_t high_water_ = 0;
+  uint32_t failures_ = 0;
+};
+
+}; // namespace util
+
+#endif // UTIL_ARENA_H_
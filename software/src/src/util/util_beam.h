@@ -0,0 +1,150 @@
+// util_beam.h - Refresh beam prediction for panels that scan line by line
+//
+// The beam position is read from the panel now and then (Sync) and
+// predicted from the cycle counter in between, so a transfer can be timed
+// without reading the panel each time. Each Sync also refines the line
+// period from the lines counted since the previous one, so the prediction
+// follows the panel's actual oscillator rather than the nominal rate. Syncs
+// may be several refreshes apart as long as the period estimate is within
+// about a sixth of the real one.
+//
+// A write to lines [first, last] doesn't tear if it starts after the beam
+// has passed those lines and ends before the beam comes round to them again
+// (Behind). The next refresh then shows it whole. A frame made of several
+// such writes only shows up whole in a single refresh if they are all Behind
+// the same pass of the beam, which Fits() checks before the first one. The
+// later writes may go out after the beam has wrapped, ahead of it.
+
+#ifndef UTIL_BEAM_H_
+#define UTIL_BEAM_H_
+
+#include <stdint.h>
+
+namespace util {
+
+class BeamTracker {
+public:
+  // Lines of prediction error allowed for in Behind() and Fits()
+  static constexpr uint32_t kMarginLines = 2;
+
+  void Init(uint32_t num_lines, uint32_t line_cycles) {
+    num_lines_ = num_lines;
+    line_cycles_q8_ = line_cycles << 8;
+    synced_ = false;
+  }
+
+  // Panel reported `line` at cycle count `now`
+  void Sync(uint32_t line, uint32_t now) {
+    if (synced_) {
+      uint32_t elapsed = now - anchor_time_;
+      uint32_t delta = (line + num_lines_ - anchor_line_) % num_lines_;
+      // Whole refreshes in between, from the current estimate
+      uint64_t estimate = (static_cast<uint64_t>(elapsed) << 8) / line_cycles_q8_;
+      uint32_t wraps = estimate > delta ? (estimate - delta + num_lines_ / 2) / num_lines_ : 0;
+      uint64_t lines = delta + static_cast<uint64_t>(wraps) * num_lines_;
+      if (lines >= num_lines_ / 4) {
+        uint32_t measured_q8 = (static_cast<uint64_t>(elapsed) << 8) / lines;
+        line_cycles_q8_ += (static_cast<int32_t>(measured_q8 - line_cycles_q8_)) / 4;
+      }
+    }
+    anchor_line_ = line;
+    anchor_time_ = now;
+    synced_ = true;
+  }
+
+  bool synced() const {
+    return synced_;
+  }
+
+  // Lines counted from the start of the anchor's pass, without wrapping
+  uint32_t position(uint32_t now) const {
+    return anchor_line_ + (static_cast<uint64_t>(now - anchor_time_) << 8) / line_cycles_q8_;
+  }
+
+  uint32_t line(uint32_t now) const {
+    return position(now) % num_lines_;
+  }
+
+  // position() at the start of the pass the beam is in
+  uint32_t pass(uint32_t now) const {
+    return position(now) - line(now);
+  }
+
+  // Lines the beam moves in `cycles`, rounded up
+  uint32_t lines(uint32_t cycles) const {
+    return ((static_cast<uint64_t>(cycles) << 8) + line_cycles_q8_ - 1) / line_cycles_q8_;
+  }
+
+  struct Span {
+    uint16_t first;
+    uint16_t last;
+  };
+
+  // The beam has passed [first, last] in the pass starting at `pass`, and a
+  // write taking `cycles` started now ends before the next pass gets there.
+  // The write then shows up in the refresh after that pass.
+  bool Behind(uint32_t first, uint32_t last, uint32_t cycles, uint32_t pass, uint32_t now) const {
+    uint32_t beam = position(now) - pass;
+    return beam > last + kMarginLines && beam + lines(cycles) + kMarginLines <= num_lines_ + first;
+  }
+
+  bool Behind(uint32_t first, uint32_t last, uint32_t cycles, uint32_t now) const {
+    return Behind(first, last, cycles, pass(now), now);
+  }
+
+  // Too late for a write to [first, last] to make the refresh after `pass`
+  bool Missed(uint32_t first, uint32_t cycles, uint32_t pass, uint32_t now) const {
+    return position(now) - pass + lines(cycles) + kMarginLines > num_lines_ + first;
+  }
+
+  // Writes to `spans` (in scan order, `cycles` each) started now, one after
+  // the other, each once Behind() the current pass, can all make the next
+  // refresh. The first one has to be Behind() now.
+  bool Fits(const Span *spans, size_t count, uint32_t cycles, uint32_t now) const {
+    return FitsFrom(spans, count, cycles, line(now));
+  }
+
+  // Fits() with the beam just past the first span, the best case. If this
+  // fails, the writes can't all make the same refresh at this rate.
+  bool CanFit(const Span *spans, size_t count, uint32_t cycles) const {
+    return count && FitsFrom(spans, count, cycles, spans[0].last + kMarginLines + 1);
+  }
+
+  uint32_t line_cycles() const {
+    return line_cycles_q8_ >> 8;
+  }
+
+  uint32_t num_lines() const {
+    return num_lines_;
+  }
+
+private:
+  uint32_t num_lines_ = 1;
+  uint32_t line_cycles_q8_ = 1 << 8;
+  bool synced_ = false;
+  uint32_t anchor_line_ = 0;
+  uint32_t anchor_time_ = 0;
+
+  bool FitsFrom(const Span *spans, size_t count, uint32_t cycles, uint32_t beam) const {
+    const uint32_t duration = lines(cycles) + kMarginLines;
+    uint32_t time = 0;  // In lines from now
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t passed = spans[i].last + kMarginLines + 1;
+      uint32_t start = time;
+      if (beam < passed) {
+        if (!i)
+          return false;
+        if (passed - beam > start)
+          start = passed - beam;
+      }
+      time = start + duration;
+      if (time + beam > num_lines_ + spans[i].first)
+        return false;
+    }
+    return true;
+  }
+};
+
+}; // namespace util
+
+#endif // UTIL_BEAM_H_
@@ -0,0 +1,209 @@
+// util_block_player.h - Double-buffered block reader for streamed CV files
+//
+// CV/waveform files are laid out for direct block reads: a 512-byte header
+// followed by fixed-size blocks of interleaved 16-bit frames, each block
+// padded to a whole number of frames. A producer context (loop()) reads whole
+// blocks into whichever buffer the consumer has finished with; the consumer
+// (an ISR) only indexes into the ready buffer, so there's no parsing or file
+// access on the hot path and a slow read only eats into the other buffer's
+// playing time.
+//
+// Device is anything with
+//   bool Read(uint32_t offset, void *dst, size_t length);
+// reading `length` bytes at byte `offset`, e.g. an SD file or, in host
+// builds, a plain file with injected latency.
+
+#ifndef UTIL_BLOCK_PLAYER_H_
+#define UTIL_BLOCK_PLAYER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace util {
+
+static constexpr uint32_t kCVFileMagic = 0x5643434F;  // "OCCV"
+static constexpr uint16_t kCVFileVersion = 1;
+static constexpr size_t kCVFileHeaderSize = 512;
+static constexpr size_t kCVFileMaxChannels = 8;
+
+struct CVFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t num_channels;
+  uint32_t sample_rate;
+  uint32_t num_frames;
+  uint32_t block_size;        // Bytes, multiple of 512
+  uint32_t frames_per_block;  // Rest of the block is padding
+  uint8_t channels[kCVFileMaxChannels];  // Output channel per file channel
+};
+
+template <typename Device, size_t buffer_size>
+class BlockPlayer {
+public:
+  static constexpr size_t kNumBuffers = 2;
+  static constexpr size_t kBufferSize = buffer_size;
+  static_assert(!(buffer_size % 512), "Buffer size must be whole sectors");
+
+  enum Error {
+    ERROR_NONE,
+    ERROR_READ,
+    ERROR_FORMAT,
+    ERROR_BLOCK_SIZE,
+  };
+
+  // Read and check the header; nothing is buffered until Prefetch(). Sizes
+  // are checked without overflow, so a corrupt header can't make a block
+  // overrun the buffer or its offset wrap around.
+  Error Open(Device *device) {
+    device_ = nullptr;
+    uint8_t header[kCVFileHeaderSize];
+    if (!device->Read(0, header, sizeof(header)))
+      return ERROR_READ;
+    memcpy(&header_, header, sizeof(header_));
+    if (header_.magic != kCVFileMagic || header_.version != kCVFileVersion ||
+        !header_.num_channels || header_.num_channels > kCVFileMaxChannels ||
+        !header_.sample_rate || !header_.frames_per_block ||
+        header_.frames_per_block > header_.block_size / frame_bytes())
+      return ERROR_FORMAT;
+    if (header_.block_size > kBufferSize || header_.block_size % 512)
+      return ERROR_BLOCK_SIZE;
+    const uint32_t num_blocks = header_.num_frames / header_.frames_per_block +
+                                (header_.num_frames % header_.frames_per_block != 0);
+    // Prefetch() reads at 32-bit offsets, up to the end of the last block
+    if (static_cast<uint64_t>(num_blocks) * header_.block_size + kCVFileHeaderSize > UINT32_MAX)
+      return ERROR_FORMAT;
+
+    device_ = device;
+    num_blocks_ = num_blocks;
+    loop_ = false;
+    Rewind();
+    return ERROR_NONE;
+  }
+
+  // Only while the consumer is stopped
+  void Rewind() {
+    for (auto &buffer : buffers_)
+      buffer.frames = 0;
+    next_block_ = 0;
+    fill_index_ = play_index_ = 0;
+    play_pos_ = 0;
+    end_ = !num_blocks_;
+    underruns_ = blocks_read_ = read_errors_ = 0;
+  }
+
+  void set_loop(bool loop) {
+    loop_ = loop;
+  }
+
+  // Producer: read blocks into free buffers. Returns the number read.
+  size_t Prefetch() {
+    size_t count = 0;
+    while (device_ && !end_) {
+      Buffer &buffer = buffers_[fill_index_];
+      if (buffer.frames)
+        break;
+
+      uint32_t offset = kCVFileHeaderSize + next_block_ * header_.block_size;
+      if (!device_->Read(offset, buffer.data, header_.block_size)) {
+        ++read_errors_;
+        end_ = true;
+        break;
+      }
+      uint32_t first = next_block_ * header_.frames_per_block;
+      uint32_t frames = header_.num_frames - first;
+      if (frames > header_.frames_per_block)
+        frames = header_.frames_per_block;
+
+      if (++next_block_ == num_blocks_) {
+        if (loop_)
+          next_block_ = 0;
+        else
+          end_ = true;
+      }
+
+      __sync_synchronize();
+      buffer.frames = frames;  // Hands the buffer to the consumer
+      fill_index_ = (fill_index_ + 1) % kNumBuffers;
+      ++blocks_read_;
+      ++count;
+    }
+    return count;
+  }
+
+  // Consumer: pointer to the next frame of num_channels() values, or nullptr
+  // if none is ready (counted as an underrun unless the file has ended).
+  const uint16_t *Next() {
+    Buffer &buffer = buffers_[play_index_];
+    uint32_t frames = buffer.frames;
+    if (!frames) {
+      if (!end_)
+        ++underruns_;
+      return nullptr;
+    }
+    __sync_synchronize();
+    const uint16_t *frame = reinterpret_cast<const uint16_t *>(buffer.data) + play_pos_ * header_.num_channels;
+    if (++play_pos_ == frames) {
+      // Still valid until the producer gets to run
+      play_pos_ = 0;
+      buffer.frames = 0;
+      play_index_ = (play_index_ + 1) % kNumBuffers;
+    }
+    return frame;
+  }
+
+  // File ended and everything buffered has been played
+  bool finished() const {
+    return end_ && !buffers_[play_index_].frames;
+  }
+
+  const CVFileHeader &header() const {
+    return header_;
+  }
+
+  size_t frame_bytes() const {
+    return header_.num_channels * sizeof(uint16_t);
+  }
+
+  // Frames ready for the consumer
+  uint32_t buffered() const {
+    uint32_t frames = buffers_[play_index_].frames;
+    uint32_t ready = frames ? frames - play_pos_ : 0;
+    for (size_t i = 1; i < kNumBuffers; ++i)
+      ready += buffers_[(play_index_ + i) % kNumBuffers].frames;
+    return ready;
+  }
+
+  uint32_t underruns() const { return underruns_; }
+  uint32_t blocks_read() const { return blocks_read_; }
+  uint32_t read_errors() const { return read_errors_; }
+
+  void ResetStats() {
+    underruns_ = 0;
+  }
+
+private:
+  struct Buffer {
+    uint8_t data[kBufferSize] __attribute__((aligned(32)));
+    volatile uint32_t frames;  // Non-zero while owned by the consumer
+  };
+
+  Device *device_ = nullptr;
+  CVFileHeader header_;
+  Buffer buffers_[kNumBuffers];
+  uint32_t num_blocks_ = 0;
+  uint32_t next_block_ = 0;
+  size_t fill_index_ = 0;
+  size_t play_index_ = 0;
+  uint32_t play_pos_ = 0;
+  volatile bool end_ = true;
+  bool loop_ = false;
+
+  volatile uint32_t underruns_ = 0;
+  uint32_t blocks_read_ = 0;
+  uint32_t read_errors_ = 0;
+};
+
+}; // namespace util
+
+#endif // UTIL_BLOCK_PLAYER_H_
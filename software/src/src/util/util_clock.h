@@ -0,0 +1,345 @@
+// util_clock.h - Clock tracking and multiplication/division
+//
+// ClockTracker follows an external pulse clock from timestamped edges using a
+// second-order (PLL-like) phase/period estimator. ClockEngine derives
+// multiplied or divided clocks from the tracker's continuous beat position,
+// so output edges are placed from the smoothed estimate rather than from the
+// jittery input edges themselves.
+//
+// Everything here operates on unwrapped 64-bit timestamps in arbitrary units
+// (cycle counts on the device) and has no hardware dependencies, so it can be
+// driven from synthetic, jittered edge sequences on a host.
+
+#ifndef UTIL_CLOCK_H_
+#define UTIL_CLOCK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "util_stats.h"
+
+namespace util {
+
+static inline int64_t floor_div(int64_t a, int64_t b) {
+  int64_t q = a / b;
+  if ((a % b) && ((a < 0) != (b < 0)))
+    --q;
+  return q;
+}
+
+static inline int32_t clamp_int32(int64_t value) {
+  if (value > INT32_MAX) return INT32_MAX;
+  if (value < INT32_MIN) return INT32_MIN;
+  return static_cast<int32_t>(value);
+}
+
+class ClockTracker {
+public:
+  // Phase and period are kept with 8 fractional bits so the small
+  // corrections of a slow loop aren't truncated away.
+  static constexpr int kFracBits = 8;
+
+  // Input is considered stopped after this many periods without an edge.
+  static constexpr int64_t kTimeoutPeriods = 4;
+
+  // After locking, the loop starts with wide gains and narrows them by one
+  // step (halving) every kGearPulses edges until the configured gains are
+  // reached, so a slow loop still converges quickly.
+  static constexpr int kGearPulses = 8;
+
+  // ppqn: input pulses per beat; phase_shift/freq_shift set the loop gains
+  // as 1/2^n of the phase error applied to phase and period respectively.
+  // Edges further than period/2^relock_shift from the prediction are taken
+  // as a tempo change and cause an immediate relock.
+  void Init(uint32_t ppqn, uint8_t phase_shift, uint8_t freq_shift, uint8_t relock_shift = 2) {
+    ppqn_ = ppqn ? ppqn : 1;
+    phase_shift_ = phase_shift;
+    freq_shift_ = freq_shift;
+    relock_shift_ = relock_shift;
+    Reset();
+  }
+
+  void Reset() {
+    locked_ = false;
+    have_last_edge_ = false;
+    cued_ = false;
+    last_edge_ = 0;
+    phase_ = 0;
+    period_ = 0;
+    pulse_count_ = 0;
+    cue_pulse_ = 0;
+    locked_pulses_ = 0;
+    relocks_ = 0;
+    epoch_ = 0;
+    phase_error_.Reset();
+  }
+
+  // The next edge will be pulse number `pulse`, e.g. 0 on a transport start.
+  // The period estimate is kept, and if the input had stopped the next edge
+  // locks immediately.
+  void Cue(int64_t pulse) {
+    cue_pulse_ = pulse;
+    cued_ = true;
+  }
+
+  void Rewind() {
+    Cue(0);
+  }
+
+  // Feed one input pulse at time t.
+  void Edge(int64_t t) {
+    if (!have_last_edge_) {
+      have_last_edge_ = true;
+      last_edge_ = t;
+      if (period_ && cued_) {
+        // Period known from before a stop, resume immediately
+        Lock(t, period_ >> kFracBits, true);
+      } else if (cued_) {
+        // This edge was the cued pulse; the lock on the next one counts on
+        ++cue_pulse_;
+      }
+      return;
+    }
+
+    int64_t raw_period = t - last_edge_;
+    last_edge_ = t;
+    if (raw_period <= 0)
+      return;
+
+    if (!locked_) {
+      Lock(t, raw_period, true);
+      return;
+    }
+
+    int64_t predicted = phase_ + period_;
+    int64_t error = (t << kFracBits) - predicted;
+    int64_t threshold = period_ >> relock_shift_;
+    if (error > threshold || error < -threshold) {
+      ++relocks_;
+      Lock(t, raw_period, false);
+      return;
+    }
+
+    int gear = locked_pulses_ / kGearPulses;
+    phase_ = predicted + (error >> (phase_shift_ < gear + 1 ? phase_shift_ : gear + 1));
+    period_ += error >> (freq_shift_ < gear + 2 ? freq_shift_ : gear + 2);
+    ++locked_pulses_;
+    NextPulse();
+    phase_error_.Push(clamp_int32(error >> kFracBits));
+  }
+
+  // Check for input timeout; call periodically with the current time.
+  void Update(int64_t now) {
+    if (locked_ && ((now << kFracBits) - phase_) > period_ * kTimeoutPeriods) {
+      locked_ = false;
+      have_last_edge_ = false;
+    }
+  }
+
+  bool locked() const { return locked_; }
+  // Waiting for the cued edge; the position is not meaningful until then.
+  bool cued() const { return cued_; }
+  uint32_t ppqn() const { return ppqn_; }
+  uint32_t relocks() const { return relocks_; }
+  int64_t pulse_count() const { return pulse_count_; }
+  // Incremented whenever the pulse count is repositioned
+  uint32_t epoch() const { return epoch_; }
+
+  // Filtered pulse period and beat period
+  int64_t period() const { return period_ >> kFracBits; }
+  int64_t beat_period() const { return (period_ * ppqn_) >> kFracBits; }
+
+  // Beat position at time t as Q16 beats, extrapolated from the filtered
+  // phase of the last pulse. Only meaningful while locked.
+  int64_t position(int64_t t) const {
+    int64_t offset = floor_div(((t << kFracBits) - phase_) << 16, period_);
+    return floor_div((pulse_count_ << 16) + offset, ppqn_);
+  }
+
+  // Inverse of position(): time at which the beat position is reached.
+  int64_t time_at(int64_t position) const {
+    int64_t pulses = position * ppqn_ - (pulse_count_ << 16);
+    return (phase_ + ((pulses * period_) >> 16)) >> kFracBits;
+  }
+
+  // Deviation of raw input edges from the prediction (input jitter)
+  const RunningStats &phase_error() const { return phase_error_; }
+  void ResetStats() { phase_error_.Reset(); }
+
+private:
+  uint32_t ppqn_ = 1;
+  uint8_t phase_shift_ = 2;
+  uint8_t freq_shift_ = 4;
+  uint8_t relock_shift_ = 2;
+
+  bool locked_ = false;
+  bool have_last_edge_ = false;
+  bool cued_ = false;
+  int64_t last_edge_ = 0;
+  int64_t phase_ = 0;  // Filtered time of pulse pulse_count_
+  int64_t period_ = 0;
+  int64_t pulse_count_ = 0;
+  int64_t cue_pulse_ = 0;
+  int32_t locked_pulses_ = 0;
+  uint32_t relocks_ = 0;
+  uint32_t epoch_ = 0;
+  RunningStats phase_error_;
+
+  void NextPulse() {
+    if (cued_) {
+      pulse_count_ = cue_pulse_;
+      cued_ = false;
+      ++epoch_;
+    } else {
+      ++pulse_count_;
+    }
+  }
+
+  // A fresh lock starts counting beats from this edge unless a position was
+  // cued, a relock after a tempo change keeps the count.
+  void Lock(int64_t t, int64_t period, bool restart) {
+    phase_ = t << kFracBits;
+    period_ = period << kFracBits;
+    locked_pulses_ = 0;
+    if (restart && !cued_)
+      Cue(0);
+    NextPulse();
+    locked_ = true;
+  }
+};
+
+template <size_t num_outputs>
+class ClockEngine {
+public:
+  static constexpr size_t kNumOutputs = num_outputs;
+  static_assert(kNumOutputs <= 32, "Output mask is 32 bits");
+
+  void Init(const ClockTracker *source) {
+    source_ = source;
+    for (auto &output : outputs_) {
+      output.num = output.den = 1;
+      output.enabled = false;
+      output.running = false;
+      output.last_index = 0;
+      output.last_edge = 0;
+      output.jitter.Reset();
+      output.period.Reset();
+    }
+  }
+
+  void set_source(const ClockTracker *source) {
+    source_ = source;
+    Sync();
+  }
+
+  // Edges per beat = num/den, e.g. 4/1 multiplies by 4, 1/3 divides by 3.
+  void set_ratio(size_t output, int32_t num, int32_t den) {
+    if (output >= kNumOutputs || num <= 0 || den <= 0)
+      return;
+    outputs_[output].num = num;
+    outputs_[output].den = den;
+    outputs_[output].running = false;
+  }
+
+  void enable(size_t output, bool enabled) {
+    if (output < kNumOutputs) {
+      outputs_[output].enabled = enabled;
+      outputs_[output].running = false;
+    }
+  }
+
+  // Re-derive output indices from the current position, e.g. after the
+  // source was rewound. The first edge after a sync only fires if it is due
+  // in the current tick, otherwise outputs wait for the next one. After the
+  // source was repositioned, edges up to one source pulse old still fire, as
+  // the pulse that carried the new position is only picked up after it
+  // arrived (e.g. the first MIDI clock after a start).
+  void Sync() {
+    for (auto &output : outputs_)
+      output.running = false;
+  }
+
+  // Evaluate outputs for the tick starting at `now` and lasting
+  // `tick_length`. Edges are rounded to the nearest tick, and the returned
+  // mask has a bit set for each output that has an edge in this tick.
+  uint32_t Process(int64_t now, int64_t tick_length) {
+    if (!source_ || !source_->locked()) {
+      Sync();
+      return 0;
+    }
+
+    int64_t late_limit = tick_length;
+    if (epoch_ != source_->epoch()) {
+      epoch_ = source_->epoch();
+      Sync();
+      if (source_->period() > late_limit)
+        late_limit = source_->period();
+    }
+
+    uint32_t mask = 0;
+    int64_t position = source_->position(now + tick_length / 2);
+    for (size_t i = 0; i < kNumOutputs; ++i) {
+      Output &output = outputs_[i];
+      if (!output.enabled)
+        continue;
+
+      int64_t index = floor_div(position * output.num, int64_t(output.den) << 16);
+      int64_t ideal = source_->time_at(floor_div((index * output.den) << 16, output.num));
+      if (!output.running) {
+        output.running = true;
+        output.last_index = (now - ideal) < late_limit ? index - 1 : index;
+        output.last_edge = 0;
+      }
+      if (index > output.last_index) {
+        output.jitter.Push(clamp_int32(now - ideal));
+        if (output.last_edge && index == output.last_index + 1)
+          output.period.Push(clamp_int32(now - output.last_edge));
+        output.last_edge = now;
+        output.last_index = index;
+        mask |= 1UL << i;
+      }
+    }
+    return mask;
+  }
+
+  // Expected interval between edges of an output, 0 if not locked
+  int64_t output_period(size_t output) const {
+    if (!source_ || !source_->locked() || output >= kNumOutputs)
+      return 0;
+    return source_->beat_period() * outputs_[output].den / outputs_[output].num;
+  }
+
+  bool enabled(size_t output) const { return outputs_[output].enabled; }
+  int32_t num(size_t output) const { return outputs_[output].num; }
+  int32_t den(size_t output) const { return outputs_[output].den; }
+
+  // Emitted edge time minus ideal edge time
+  const RunningStats &jitter(size_t output) const { return outputs_[output].jitter; }
+  // Interval between consecutive emitted edges
+  const RunningStats &period(size_t output) const { return outputs_[output].period; }
+
+  void ResetStats() {
+    for (auto &output : outputs_) {
+      output.jitter.Reset();
+      output.period.Reset();
+    }
+  }
+
+private:
+  struct Output {
+    int32_t num, den;
+    bool enabled;
+    bool running;
+    int64_t last_index;
+    int64_t last_edge;
+    RunningStats jitter;
+    RunningStats period;
+  };
+
+  const ClockTracker *source_ = nullptr;
+  uint32_t epoch_ = 0;
+  Output outputs_[kNumOutputs];
+};
+
+}; // namespace util
+
+#endif // UTIL_CLOCK_H_
@@ -0,0 +1,280 @@
+// util_coro.h - Minimal C++20 coroutine runtime for non-blocking sequences
+//
+// Multi-step hardware sequences (reset, wait, configure, wait, ...) read as
+// straight-line code when written as coroutines:
+//
+//   Task PowerUp() {
+//     Reset();
+//     co_await scheduler.SleepUntil(now + 10000);
+//     Configure();
+//     co_await scheduler.Wait(dma_done);  // Signal()ed by the DMA ISR
+//   }
+//
+// Task<Frames> is the coroutine type. Its frames come from Frames, a class
+// with static `void *Allocate(size_t)` and `void Free(void *)` (a fixed pool
+// on the device), never from the heap; if Allocate() returns nullptr the
+// Task is empty and nothing runs. A task is either awaited by another task,
+// which resumes when it returns, or handed to Scheduler::Spawn(), after
+// which it frees its own frame when it returns.
+//
+// The scheduler resumes suspended tasks from Poll(), so task bodies only ever
+// run in the context that calls Poll() (the UI loop). Interrupts take part
+// through Completion: the ISR calls Signal(), which is a single atomic store,
+// and the waiting task resumes on the next Poll(). There is no ready queue to
+// overflow; waiting tasks are linked through the awaiter objects that live
+// in their own frames.
+//
+// Not thread safe apart from Completion::Signal(); spawn, await and poll
+// from one context.
+
+#ifndef UTIL_CORO_H_
+#define UTIL_CORO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <coroutine>
+
+namespace util {
+
+template <typename Frames>
+class Task {
+public:
+  struct promise_type;
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  // Hands control to the awaiting task, or frees a spawned one
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+      promise_type &promise = handle.promise();
+      std::coroutine_handle<> next = promise.continuation;
+      if (promise.detached)
+        handle.destroy();
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  struct promise_type {
+    std::coroutine_handle<> continuation;
+    bool detached = false;
+
+    static void *operator new(size_t bytes) noexcept { return Frames::Allocate(bytes); }
+    static void operator delete(void *frame) noexcept { Frames::Free(frame); }
+    static Task get_return_object_on_allocation_failure() noexcept { return Task(); }
+
+    Task get_return_object() noexcept { return Task(Handle::from_promise(*this)); }
+    // Nothing runs until the task is awaited or spawned
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept {}
+  };
+
+  Task() = default;
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  Task(Task &&other) noexcept : handle_(other.handle_) {
+    other.handle_ = nullptr;
+  }
+
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = other.handle_;
+      other.handle_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~Task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  // False if no frame could be allocated
+  explicit operator bool() const { return static_cast<bool>(handle_); }
+
+  // Run the task and resume the awaiting one when it returns. An empty task
+  // returns at once.
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      Handle handle;
+      bool await_ready() const noexcept { return !handle; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+      }
+      void await_resume() const noexcept {}
+    };
+    return Awaiter{ handle_ };
+  }
+
+  // Give up ownership; the frame is freed when the task returns
+  std::coroutine_handle<> Detach() {
+    if (!handle_)
+      return nullptr;
+    handle_.promise().detached = true;
+    std::coroutine_handle<> handle = handle_;
+    handle_ = nullptr;
+    return handle;
+  }
+
+private:
+  explicit Task(Handle handle) : handle_(handle) {}
+
+  Handle handle_;
+};
+
+// Set from any context (e.g. a DMA completion ISR), awaited by a task
+class Completion {
+public:
+  // Before starting the operation that will signal it
+  void Reset() { __atomic_store_n(&done_, false, __ATOMIC_RELAXED); }
+  void Signal() { __atomic_store_n(&done_, true, __ATOMIC_RELEASE); }
+  bool done() const { return __atomic_load_n(&done_, __ATOMIC_ACQUIRE); }
+
+private:
+  bool done_ = false;
+};
+
+class Scheduler {
+public:
+  struct Stats {
+    uint32_t spawned;
+    uint32_t resumes;
+    uint32_t waiting;
+    uint32_t max_waiting;
+    uint32_t max_late_us;  // Of a sleep, i.e. the longest gap between polls
+  };
+
+  class Awaiter {
+  public:
+    bool await_ready() const noexcept {
+      return kind_ == WAIT_COMPLETION ? completion_->done() : false;
+    }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      handle_ = handle;
+      scheduler_->Add(this);
+    }
+    void await_resume() const noexcept {}
+
+  private:
+    friend class Scheduler;
+
+    enum Kind : uint8_t {
+      WAIT_SLEEP,
+      WAIT_YIELD,
+      WAIT_COMPLETION,
+    };
+
+    Awaiter(Scheduler *scheduler, Kind kind, uint32_t deadline, const Completion *completion)
+    : scheduler_(scheduler), kind_(kind), deadline_(deadline), completion_(completion) {}
+
+    Scheduler *scheduler_;
+    Kind kind_;
+    uint32_t deadline_;
+    const Completion *completion_;
+    std::coroutine_handle<> handle_;
+    Awaiter *next_ = nullptr;
+  };
+
+  void Init() {
+    head_ = nullptr;
+    tail_ = &head_;
+    stats_ = { 0, 0, 0, 0, 0 };
+  }
+
+  // Run the task up to its first co_await; the rest runs from Poll(). Returns
+  // false if the task is empty (no frame).
+  template <typename Frames>
+  bool Spawn(Task<Frames> &&task) {
+    std::coroutine_handle<> handle = task.Detach();
+    if (!handle)
+      return false;
+    ++stats_.spawned;
+    ++stats_.resumes;
+    handle.resume();
+    return true;
+  }
+
+  // Resume every task whose wait is over; `now` in microseconds. Tasks that
+  // start a new wait while being resumed are looked at on the next call.
+  void Poll(uint32_t now) {
+    Awaiter *pending = head_;
+    head_ = nullptr;
+    tail_ = &head_;
+    Awaiter *kept = nullptr;
+    Awaiter **kept_tail = &kept;
+    while (pending) {
+      Awaiter *awaiter = pending;
+      pending = awaiter->next_;
+      awaiter->next_ = nullptr;
+      if (!Due(*awaiter, now)) {
+        *kept_tail = awaiter;
+        kept_tail = &awaiter->next_;
+        continue;
+      }
+      if (awaiter->kind_ == Awaiter::WAIT_SLEEP && now - awaiter->deadline_ > stats_.max_late_us)
+        stats_.max_late_us = now - awaiter->deadline_;
+      --stats_.waiting;
+      ++stats_.resumes;
+      // The awaiter lives in the task's frame, which may be gone after this
+      awaiter->handle_.resume();
+    }
+    if (kept) {
+      *kept_tail = head_;
+      if (!head_)
+        tail_ = kept_tail;
+      head_ = kept;
+    }
+  }
+
+  // Awaitables, for tasks run by this scheduler
+  Awaiter SleepUntil(uint32_t deadline) {
+    return Awaiter(this, Awaiter::WAIT_SLEEP, deadline, nullptr);
+  }
+
+  Awaiter Yield() {
+    return Awaiter(this, Awaiter::WAIT_YIELD, 0, nullptr);
+  }
+
+  Awaiter Wait(const Completion &completion) {
+    return Awaiter(this, Awaiter::WAIT_COMPLETION, 0, &completion);
+  }
+
+  const Stats &stats() const { return stats_; }
+
+  void ResetStats() {
+    stats_.spawned = 0;
+    stats_.resumes = 0;
+    stats_.max_waiting = stats_.waiting;
+    stats_.max_late_us = 0;
+  }
+
+private:
+  Awaiter *head_ = nullptr;
+  Awaiter **tail_ = &head_;
+  Stats stats_ = { 0, 0, 0, 0, 0 };
+
+  void Add(Awaiter *awaiter) {
+    *tail_ = awaiter;
+    tail_ = &awaiter->next_;
+    if (++stats_.waiting > stats_.max_waiting)
+      stats_.max_waiting = stats_.waiting;
+  }
+
+  static bool Due(const Awaiter &awaiter, uint32_t now) {
+    switch (awaiter.kind_) {
+      case Awaiter::WAIT_SLEEP: return static_cast<int32_t>(now - awaiter.deadline_) >= 0;
+      case Awaiter::WAIT_COMPLETION: return awaiter.completion_->done();
+      default: return true;
+    }
+  }
+};
+
+}; // namespace util
+
+#endif // UTIL_CORO_H_
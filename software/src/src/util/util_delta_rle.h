@@ -0,0 +1,91 @@
+// util_delta_rle.h - XOR delta + run-length coding of 1bpp frames
+//
+// The frame is XORed with a reference (the last frame the receiver has, or
+// nothing for a key frame), so unchanged bytes become zero, and the result is
+// run-length coded with one control byte per run:
+//   0x00-0x7F  literal: the next (c + 1) bytes, 1-128
+//   0x80-0xFF  repeat: the next byte (c - 0x80 + kMinRepeat) times, 3-130
+// A static frame codes to a few bytes, and the worst case is
+// MaxEncodedSize(size), slightly over the raw size.
+
+#ifndef UTIL_DELTA_RLE_H_
+#define UTIL_DELTA_RLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace util {
+
+struct DeltaRLE {
+  static constexpr size_t kMaxLiteral = 128;
+  static constexpr size_t kMinRepeat = 3;
+  static constexpr size_t kMaxRepeat = 127 + kMinRepeat;
+
+  static constexpr size_t MaxEncodedSize(size_t size) {
+    return size + (size + kMaxLiteral - 1) / kMaxLiteral;
+  }
+
+  // Code frame ^ reference (reference may be null) into out, which must hold
+  // MaxEncodedSize(size) bytes. Returns the number of bytes written.
+  static size_t Encode(const uint8_t *frame, const uint8_t *reference, size_t size, uint8_t *out) {
+    size_t length = 0;
+    size_t literal_pos = 0;
+    size_t literal = 0;
+    size_t i = 0;
+    while (i < size) {
+      uint8_t value = Delta(frame, reference, i);
+      size_t run = 1;
+      while (i + run < size && run < kMaxRepeat && Delta(frame, reference, i + run) == value)
+        ++run;
+      if (run >= kMinRepeat) {
+        out[length++] = 0x80 | (run - kMinRepeat);
+        out[length++] = value;
+        literal = 0;
+        i += run;
+      } else {
+        if (!literal)
+          literal_pos = length++;
+        out[length++] = value;
+        out[literal_pos] = literal++;
+        if (literal == kMaxLiteral)
+          literal = 0;
+        ++i;
+      }
+    }
+    return length;
+  }
+
+  // XOR the coded delta into frame. Returns false if the data is malformed or
+  // doesn't cover exactly `size` bytes.
+  static bool Decode(const uint8_t *in, size_t length, uint8_t *frame, size_t size) {
+    size_t pos = 0;
+    size_t i = 0;
+    while (i < length) {
+      uint8_t control = in[i++];
+      if (control & 0x80) {
+        size_t run = (control & 0x7F) + kMinRepeat;
+        if (i >= length || pos + run > size)
+          return false;
+        uint8_t value = in[i++];
+        while (run--)
+          frame[pos++] ^= value;
+      } else {
+        size_t run = control + 1;
+        if (i + run > length || pos + run > size)
+          return false;
+        while (run--)
+          frame[pos++] ^= in[i++];
+      }
+    }
+    return pos == size;
+  }
+
+private:
+  static inline uint8_t Delta(const uint8_t *frame, const uint8_t *reference, size_t i) {
+    return reference ? frame[i] ^ reference[i] : frame[i];
+  }
+};
+
+}; // namespace util
+
+#endif // UTIL_DELTA_RLE_H_
@@ -0,0 +1,63 @@
+// util_dither.h - Sigma-delta requantizer for sub-LSB DAC resolution
+//
+// Reduces a value with kFracBits extra bits of resolution to 16-bit DAC codes
+// one sample at a time, carrying the quantization error into the next
+// sample. The output toggles between neighbouring codes so that its average
+// matches the fine value; the output filter (or the VCO's own response) does
+// the averaging.
+//
+// First order feedback has a spectrum that follows the fractional part;
+// second order pushes the toggling noise up towards the update rate, which is
+// better for slow fractions at the cost of wider (+-2 LSB) excursions.
+
+#ifndef UTIL_DITHER_H_
+#define UTIL_DITHER_H_
+
+#include <stdint.h>
+
+namespace util {
+
+class SigmaDelta {
+public:
+  static constexpr int kFracBits = 8;
+  static constexpr int32_t kOne = 1 << kFracBits;
+  static constexpr int32_t kMaxCode = 0xFFFF;
+
+  void Init() {
+    error1_ = error2_ = 0;
+  }
+
+  // value is a 16.8 fixed-point code (i.e. 24-bit)
+  inline uint16_t FirstOrder(uint32_t value) {
+    int32_t sum = static_cast<int32_t>(value) + error1_;
+    int32_t code = Clamp(sum >> kFracBits);
+    error1_ = ClampError(sum - (code << kFracBits));
+    return code;
+  }
+
+  inline uint16_t SecondOrder(uint32_t value) {
+    int32_t sum = static_cast<int32_t>(value) + 2 * error1_ - error2_;
+    int32_t code = Clamp((sum + kOne / 2) >> kFracBits);
+    error2_ = error1_;
+    error1_ = ClampError(sum - (code << kFracBits));
+    return code;
+  }
+
+private:
+  int32_t error1_ = 0;
+  int32_t error2_ = 0;
+
+  static inline int32_t Clamp(int32_t code) {
+    return code < 0 ? 0 : (code > kMaxCode ? kMaxCode : code);
+  }
+
+  // At the rails the error can't be paid back; bound it so the modulator
+  // recovers as soon as the value moves away again.
+  static inline int32_t ClampError(int32_t error) {
+    return error < -2 * kOne ? -2 * kOne : (error > 2 * kOne ? 2 * kOne : error);
+  }
+};
+
+}; // namespace util
+
+#endif // UTIL_DITHER_H_
@@ -0,0 +1,204 @@
+// util_math.h - Fixed-point sine, exp2, log2 and reciprocal from lookup tables
+//
+// Per-sample modulation and pitch code can't afford sinf()/powf() for every
+// channel on every tick. These functions interpolate linearly between the
+// entries of small tables instead, in a handful of integer instructions and
+// without touching the FPU. The tables are built at compile time, so they
+// need no Init() and are safe to use from any context, including ISRs. As
+// const data they total about 7 KB, which the Teensy 4 keeps in DTCM.
+//
+// Formats follow the rest of the firmware: phases are the full uint32 range
+// of a phase accumulator (2^32 = one turn), pitch and levels are Q16.16
+// (octaves for 1V/oct, 65536 = 1.0), and waveforms are Q15.
+//
+// Error bounds, checked against libm over the whole input range by
+// tools/fixed_math_test.cpp:
+//   sin_q15, cos_q15  at most 1 LSB (1/32767)
+//   exp2_q16          relative error below 1e-6 (0.0017 cents), plus
+//   scale_exp2        rounding to the nearest output step
+//   log2_q16          at most 1 LSB (1/65536 octave)
+//   reciprocal_q32    at most 1 from round(2^32 / x)
+
+#ifndef UTIL_MATH_H_
+#define UTIL_MATH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+
+namespace util {
+
+namespace math_tables {
+
+static constexpr size_t kSineBits = 10;   // Segments per turn, as a power of two
+static constexpr size_t kOctaveBits = 8;  // Segments per octave for exp2 and log2
+
+static constexpr double kPi = 3.14159265358979323846;
+static constexpr double kLn2 = 0.69314718055994530942;
+
+// Series good to double precision over the ranges they are used for; only
+// ever evaluated by the compiler
+static constexpr double series_sin(double x) {
+  while (x > kPi)
+    x -= 2 * kPi;
+  double term = x, sum = x;
+  for (int n = 1; n < 20; ++n) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+static constexpr double series_exp2(double x) {  // x in [0, 1]
+  double term = 1, sum = 1;
+  for (int n = 1; n < 30; ++n) {
+    term *= x * kLn2 / n;
+    sum += term;
+  }
+  return sum;
+}
+
+static constexpr double series_log2(double x) {  // x in [1, 2]
+  // ln(x) = 2 atanh(z), z = (x - 1) / (x + 1) <= 1/3
+  const double z = (x - 1) / (x + 1);
+  double power = z, sum = 0;
+  for (int n = 1; n < 60; n += 2) {
+    sum += power / n;
+    power *= z * z;
+  }
+  return 2 * sum / kLn2;
+}
+
+static constexpr int64_t round_to_int(double x) {
+  return static_cast<int64_t>(x < 0 ? x - 0.5 : x + 0.5);
+}
+
+// Every table has a guard entry at the end so the interpolation never wraps
+
+// 32767 sin(2 pi i / 1024) with 8 more fractional bits, so only the result
+// is rounded to Q15
+static constexpr std::array<int32_t, (1 << kSineBits) + 1> MakeSine() {
+  std::array<int32_t, (1 << kSineBits) + 1> table{};
+  for (size_t i = 0; i < table.size(); ++i)
+    table[i] = round_to_int(32767 * 256 * series_sin(2 * kPi * i / (1 << kSineBits)));
+  return table;
+}
+
+// 2^(i / 256), Q30
+static constexpr std::array<uint32_t, (1 << kOctaveBits) + 1> MakeExp2() {
+  std::array<uint32_t, (1 << kOctaveBits) + 1> table{};
+  for (size_t i = 0; i < table.size(); ++i)
+    table[i] = round_to_int(series_exp2(static_cast<double>(i) / (1 << kOctaveBits)) * (1 << 30));
+  return table;
+}
+
+// log2(1 + i / 256), Q30
+static constexpr std::array<uint32_t, (1 << kOctaveBits) + 1> MakeLog2() {
+  std::array<uint32_t, (1 << kOctaveBits) + 1> table{};
+  for (size_t i = 0; i < table.size(); ++i)
+    table[i] = round_to_int(series_log2(1 + static_cast<double>(i) / (1 << kOctaveBits)) * (1 << 30));
+  return table;
+}
+
+// 1 / (1 + i / 256), Q31; exact integer division
+static constexpr std::array<uint32_t, (1 << kOctaveBits) + 1> MakeReciprocal() {
+  std::array<uint32_t, (1 << kOctaveBits) + 1> table{};
+  for (size_t i = 0; i < table.size(); ++i) {
+    const uint64_t divisor = (1ULL << 31) + (static_cast<uint64_t>(i) << 23);
+    table[i] = ((1ULL << 62) + divisor / 2) / divisor;
+  }
+  return table;
+}
+
+inline constexpr std::array<int32_t, (1 << kSineBits) + 1> kSine = MakeSine();
+inline constexpr std::array<uint32_t, (1 << kOctaveBits) + 1> kExp2 = MakeExp2();
+inline constexpr std::array<uint32_t, (1 << kOctaveBits) + 1> kLog2 = MakeLog2();
+inline constexpr std::array<uint32_t, (1 << kOctaveBits) + 1> kReciprocal = MakeReciprocal();
+
+}; // namespace math_tables
+
+// Sine of a phase accumulator value, in [-32767, 32767]
+static inline int32_t sin_q15(uint32_t phase) {
+  const uint32_t index = phase >> (32 - math_tables::kSineBits);
+  const int32_t frac = (phase >> (17 - math_tables::kSineBits)) & 0x7FFF;
+  const int32_t a = math_tables::kSine[index];
+  const int32_t b = math_tables::kSine[index + 1];
+  return (a + (((b - a) * frac) >> 15) + 0x80) >> 8;
+}
+
+static inline int32_t cos_q15(uint32_t phase) {
+  return sin_q15(phase + 0x40000000UL);
+}
+
+// value * 2^(octaves / 65536), rounded, saturating at UINT32_MAX. Scales a
+// frequency or phase increment by a 1V/oct pitch, or a level by an
+// exponential envelope, with the full precision of value.
+static inline uint32_t scale_exp2(uint32_t value, int32_t octaves) {
+  const int32_t exponent = octaves >> 16;  // Floor, also for negative pitch
+  const uint32_t index = (octaves >> (16 - math_tables::kOctaveBits)) & ((1 << math_tables::kOctaveBits) - 1);
+  const uint32_t frac = octaves & ((1 << (16 - math_tables::kOctaveBits)) - 1);
+  const uint32_t a = math_tables::kExp2[index];
+  const uint32_t b = math_tables::kExp2[index + 1];
+  const uint32_t mantissa = a + (((b - a) * frac + (1 << (15 - math_tables::kOctaveBits))) >> (16 - math_tables::kOctaveBits));
+
+  // value * 2^fraction in Q30
+  const uint64_t product = static_cast<uint64_t>(value) * mantissa;
+  const int32_t shift = 30 - exponent;
+  if (shift <= 0) {
+    if (shift <= -32 || product > (UINT32_MAX >> -shift))
+      return value ? UINT32_MAX : 0;
+    return static_cast<uint32_t>(product << -shift);
+  }
+  if (shift >= 64)
+    return 0;
+  const uint64_t rounded = ((product >> (shift - 1)) + 1) >> 1;
+  return rounded > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(rounded);
+}
+
+// 2^(octaves / 65536) in Q16.16; saturates from 16 octaves up
+static inline uint32_t exp2_q16(int32_t octaves) {
+  return scale_exp2(1UL << 16, octaves);
+}
+
+// log2(x / 65536) in Q16.16, i.e. octaves above 1.0; INT32_MIN for 0
+static inline int32_t log2_q16(uint32_t x) {
+  if (!x)
+    return INT32_MIN;
+  const int32_t exponent = 31 - __builtin_clz(x);
+  const uint32_t normalized = x << (31 - exponent);  // 1.xxx in Q31
+  const uint32_t index = (normalized >> (31 - math_tables::kOctaveBits)) & ((1 << math_tables::kOctaveBits) - 1);
+  const uint32_t frac = normalized & ((1UL << (31 - math_tables::kOctaveBits)) - 1);
+  const uint32_t a = math_tables::kLog2[index];
+  const uint32_t b = math_tables::kLog2[index + 1];
+  const uint32_t mantissa = a + static_cast<uint32_t>((static_cast<uint64_t>(b - a) * frac) >> (31 - math_tables::kOctaveBits));
+  return (exponent - 16) * 65536 + static_cast<int32_t>((mantissa + (1 << 13)) >> 14);
+}
+
+// 2^32 / x, i.e. 1/x in Q32, for x >= 2; UINT32_MAX below that. Turns a
+// division by x into a multiplication:
+//   value / x ~= (static_cast<uint64_t>(value) * reciprocal_q32(x)) >> 32
+// The Cortex-M7 divides 32-bit integers in hardware, but this replaces the
+// 64-bit library division that 2^32 / x would otherwise need.
+static inline uint32_t reciprocal_q32(uint32_t x) {
+  if (x < 2)
+    return UINT32_MAX;
+  const int32_t leading_zeros = __builtin_clz(x);
+  const uint32_t normalized = x << leading_zeros;  // In [2^31, 2^32)
+  const uint32_t index = (normalized >> (31 - math_tables::kOctaveBits)) & ((1 << math_tables::kOctaveBits) - 1);
+  const uint32_t frac = normalized & ((1UL << (31 - math_tables::kOctaveBits)) - 1);
+  const uint32_t a = math_tables::kReciprocal[index];
+  const uint32_t b = math_tables::kReciprocal[index + 1];
+  // r ~= 2^62 / normalized, good to about 18 bits
+  uint32_t r = a - static_cast<uint32_t>((static_cast<uint64_t>(a - b) * frac) >> (31 - math_tables::kOctaveBits));
+  // One Newton-Raphson step, r += r * (1 - normalized * r / 2^62), squares
+  // the error
+  const int64_t error = static_cast<int64_t>((1ULL << 62) - static_cast<uint64_t>(normalized) * r);
+  r += static_cast<int32_t>((static_cast<int64_t>(r) * (error >> 20)) >> 42);
+  // 2^32 / x = r * 2^(leading_zeros - 30)
+  const int32_t shift = 30 - leading_zeros;
+  return shift ? (r + (1UL << (shift - 1))) >> shift : r;
+}
+
+}; // namespace util
+
+#endif // UTIL_MATH_H_
@@ -0,0 +1,203 @@
+// util_midi.h - MIDI message parsing and voice allocation
+//
+// No hardware dependencies: the parser turns a raw MIDI byte stream into
+// messages, the allocator maps notes onto a fixed number of voices.
+
+#ifndef UTIL_MIDI_H_
+#define UTIL_MIDI_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace util {
+
+enum MidiStatus : uint8_t {
+  MIDI_NOTE_OFF         = 0x80,
+  MIDI_NOTE_ON          = 0x90,
+  MIDI_POLY_PRESSURE    = 0xA0,
+  MIDI_CONTROL_CHANGE   = 0xB0,
+  MIDI_PROGRAM_CHANGE   = 0xC0,
+  MIDI_CHANNEL_PRESSURE = 0xD0,
+  MIDI_PITCH_BEND       = 0xE0,
+  MIDI_SYSEX            = 0xF0,
+  MIDI_SONG_POSITION    = 0xF2,
+  MIDI_SYSEX_END        = 0xF7,
+  MIDI_CLOCK            = 0xF8,
+  MIDI_START            = 0xFA,
+  MIDI_CONTINUE         = 0xFB,
+  MIDI_STOP             = 0xFC,
+};
+
+struct MidiMessage {
+  uint8_t status;
+  uint8_t data1;
+  uint8_t data2;
+
+  uint8_t type() const { return status < 0xF0 ? (status & 0xF0) : status; }
+  uint8_t channel() const { return status & 0x0F; }
+
+  // Pitch bend and song position as 14-bit value
+  uint16_t data14() const { return (uint16_t(data2) << 7) | data1; }
+};
+
+// Number of data bytes following a status byte
+static inline uint8_t midi_data_length(uint8_t status) {
+  switch (status & 0xF0) {
+    case MIDI_PROGRAM_CHANGE:
+    case MIDI_CHANNEL_PRESSURE:
+      return 1;
+    case 0xF0:
+      switch (status) {
+        case 0xF1: case 0xF3: return 1;
+        case MIDI_SONG_POSITION: return 2;
+        default: return 0;
+      }
+    default:
+      return 2;
+  }
+}
+
+// Byte stream parser with running status. Realtime bytes may be interleaved
+// anywhere and are returned immediately; sysex content is skipped.
+class MidiParser {
+public:
+  void Reset() {
+    running_status_ = 0;
+    count_ = 0;
+    in_sysex_ = false;
+  }
+
+  // Returns true when `byte` completes a message
+  bool Parse(uint8_t byte, MidiMessage &message) {
+    if (byte >= 0xF8) {
+      message.status = byte;
+      message.data1 = message.data2 = 0;
+      return true;
+    }
+
+    if (byte & 0x80) {
+      in_sysex_ = (byte == MIDI_SYSEX);
+      count_ = 0;
+      if (byte >= 0xF0) {
+        running_status_ = 0;
+        if (!in_sysex_ && !midi_data_length(byte) && byte != MIDI_SYSEX_END) {
+          message.status = byte;
+          message.data1 = message.data2 = 0;
+          return true;
+        }
+        system_status_ = byte;
+      } else {
+        running_status_ = byte;
+      }
+      return false;
+    }
+
+    if (in_sysex_)
+      return false;
+
+    uint8_t status = running_status_ ? running_status_ : system_status_;
+    if (!status)
+      return false;
+
+    data_[count_++] = byte;
+    if (count_ < midi_data_length(status))
+      return false;
+
+    message.status = status;
+    message.data1 = data_[0];
+    message.data2 = count_ > 1 ? data_[1] : 0;
+    count_ = 0;
+    if (!running_status_)
+      system_status_ = 0;
+    return true;
+  }
+
+private:
+  uint8_t running_status_ = 0;
+  uint8_t system_status_ = 0;
+  uint8_t data_[2];
+  uint8_t count_ = 0;
+  bool in_sysex_ = false;
+};
+
+// Note-to-voice allocation: a retriggered note reuses its voice, otherwise
+// the least recently released free voice is used, and if all voices are busy
+// the oldest note is stolen.
+template <size_t max_voices>
+class VoiceAllocator {
+public:
+  static constexpr size_t kMaxVoices = max_voices;
+  static constexpr uint8_t kNoNote = 0xFF;
+
+  void Init(size_t num_voices) {
+    num_voices_ = num_voices < kMaxVoices ? num_voices : kMaxVoices;
+    counter_ = 0;
+    for (auto &voice : voices_) {
+      voice.note = kNoNote;
+      voice.active = false;
+      voice.age = 0;
+    }
+  }
+
+  size_t num_voices() const { return num_voices_; }
+
+  // Returns voice index for the note
+  size_t NoteOn(uint8_t note) {
+    size_t best = 0;
+    uint32_t best_age = UINT32_MAX;
+    bool best_free = false;
+    for (size_t i = 0; i < num_voices_; ++i) {
+      Voice &voice = voices_[i];
+      if (voice.note == note) {
+        best = i;
+        break;
+      }
+      bool free = !voice.active;
+      if ((free && !best_free) || (free == best_free && voice.age < best_age)) {
+        best = i;
+        best_age = voice.age;
+        best_free = free;
+      }
+    }
+    voices_[best].note = note;
+    voices_[best].active = true;
+    voices_[best].age = ++counter_;
+    return best;
+  }
+
+  // Returns voice index that was playing the note, or -1
+  int NoteOff(uint8_t note) {
+    for (size_t i = 0; i < num_voices_; ++i) {
+      Voice &voice = voices_[i];
+      if (voice.active && voice.note == note) {
+        voice.active = false;
+        voice.age = ++counter_;
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  void AllOff() {
+    for (auto &voice : voices_)
+      voice.active = false;
+  }
+
+  bool active(size_t voice) const { return voices_[voice].active; }
+  uint8_t note(size_t voice) const { return voices_[voice].note; }
+
+private:
+  struct Voice {
+    uint8_t note;
+    bool active;
+    uint32_t age;
+  };
+
+  size_t num_voices_ = kMaxVoices;
+  uint32_t counter_ = 0;
+  Voice voices_[kMaxVoices];
+};
+
+}; // namespace util
+
+#endif // UTIL_MIDI_H_
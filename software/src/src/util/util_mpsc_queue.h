@@ -0,0 +1,115 @@
+// util_mpsc_queue.h - Bounded lock-free multi-producer, single-consumer queue
+//
+// Each cell carries a sequence number (D. Vyukov's bounded queue), so
+// producers only contend on a single compare-and-swap of the write position
+// and never wait for each other. Safe to push from any number of interrupt
+// priorities and the main loop as long as only one context pops.
+//
+// A producer that is preempted between claiming a cell and publishing it
+// hides the cells behind it from the consumer until it resumes; Pop() then
+// reports empty rather than blocking.
+
+#ifndef UTIL_MPSC_QUEUE_H_
+#define UTIL_MPSC_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace util {
+
+template <typename T, size_t size>
+class MpscQueue {
+public:
+  static_assert(size >= 2 && !(size & (size - 1)), "Size must be a power of two");
+  static constexpr size_t kSize = size;
+
+  void Init() {
+    for (size_t i = 0; i < kSize; ++i)
+      cells_[i].sequence = i;
+    write_pos_ = 0;
+    read_pos_ = 0;
+    overflows_ = 0;
+  }
+
+  // Returns false (and counts an overflow) if the queue is full
+  bool Push(const T &value) {
+    uint32_t pos = __atomic_load_n(&write_pos_, __ATOMIC_RELAXED);
+    Cell *cell;
+    for (;;) {
+      cell = &cells_[pos & (kSize - 1)];
+      uint32_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+      int32_t diff = static_cast<int32_t>(sequence - pos);
+      if (!diff) {
+        if (__atomic_compare_exchange_n(&write_pos_, &pos, pos + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+          break;
+      } else if (diff < 0) {
+        __atomic_fetch_add(&overflows_, 1, __ATOMIC_RELAXED);
+        return false;
+      } else {
+        pos = __atomic_load_n(&write_pos_, __ATOMIC_RELAXED);
+      }
+    }
+    cell->value = value;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Consumer only
+  bool Pop(T &value) {
+    Cell &cell = cells_[read_pos_ & (kSize - 1)];
+    uint32_t sequence = __atomic_load_n(&cell.sequence, __ATOMIC_ACQUIRE);
+    if (static_cast<int32_t>(sequence - (read_pos_ + 1)) < 0)
+      return false;
+    value = cell.value;
+    __atomic_store_n(&cell.sequence, read_pos_ + kSize, __ATOMIC_RELEASE);
+    ++read_pos_;
+    return true;
+  }
+
+  // Consumer only: pop up to `max` values in order; stops at the first cell
+  // that isn't published yet. Returns how many were popped.
+  size_t Pop(T *values, size_t max) {
+    size_t count = 0;
+    uint32_t pos = read_pos_;
+    while (count < max) {
+      Cell &cell = cells_[pos & (kSize - 1)];
+      uint32_t sequence = __atomic_load_n(&cell.sequence, __ATOMIC_ACQUIRE);
+      if (static_cast<int32_t>(sequence - (pos + 1)) < 0)
+        break;
+      values[count++] = cell.value;
+      __atomic_store_n(&cell.sequence, pos + kSize, __ATOMIC_RELEASE);
+      ++pos;
+    }
+    read_pos_ = pos;
+    return count;
+  }
+
+  // Approximate number of queued elements
+  size_t readable() const {
+    return __atomic_load_n(&write_pos_, __ATOMIC_RELAXED) - read_pos_;
+  }
+
+  uint32_t overflows() const {
+    return __atomic_load_n(&overflows_, __ATOMIC_RELAXED);
+  }
+
+  void ResetOverflows() {
+    __atomic_store_n(&overflows_, 0, __ATOMIC_RELAXED);
+  }
+
+private:
+  struct Cell {
+    uint32_t sequence;
+    T value;
+  };
+
+  Cell cells_[kSize];
+  uint32_t write_pos_ = 0;
+  uint32_t read_pos_ = 0;
+  uint32_t overflows_ = 0;
+};
+
+}; // namespace util
+
+#endif // UTIL_MPSC_QUEUE_H_
@@ -0,0 +1,99 @@
+// util_oscillator.h - Phase accumulator oscillator for audio-rate DAC output
+//
+// Renders unipolar 16-bit DAC codes centred on mid-scale, so a full level
+// swing covers the whole output range. Output can be interleaved with other
+// channels via the stride argument of Render().
+
+#ifndef UTIL_OSCILLATOR_H_
+#define UTIL_OSCILLATOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "util_math.h"
+
+namespace util {
+
+class Oscillator {
+public:
+  enum Shape : uint8_t {
+    SHAPE_SINE,
+    SHAPE_TRIANGLE,
+    SHAPE_SAW,
+    SHAPE_SQUARE,
+  };
+
+  void Init(uint32_t sample_rate) {
+    sample_rate_ = sample_rate;
+    phase_ = 0;
+    shape_ = SHAPE_SINE;
+    level_ = 0xFFFF;
+    set_frequency(110.f);
+  }
+
+  void set_sample_rate(uint32_t sample_rate) {
+    sample_rate_ = sample_rate;
+    set_frequency(frequency_);
+  }
+
+  void set_frequency(float hz) {
+    frequency_ = hz;
+    phase_increment_ = static_cast<uint32_t>(hz * 4294967296.f / sample_rate_);
+  }
+
+  void set_shape(Shape shape) {
+    shape_ = shape;
+  }
+
+  // Peak-to-peak level, 0xFFFF is full scale
+  void set_level(uint16_t level) {
+    level_ = level;
+  }
+
+  float frequency() const {
+    return frequency_;
+  }
+
+  Shape shape() const {
+    return shape_;
+  }
+
+  void Render(uint16_t *out, size_t stride, size_t count) {
+    uint32_t phase = phase_;
+    const uint32_t increment = phase_increment_;
+    const int32_t level = level_;
+    for (size_t i = 0; i < count; ++i, out += stride) {
+      *out = 32768 + ((Sample(phase) * level) >> 16);
+      phase += increment;
+    }
+    phase_ = phase;
+  }
+
+private:
+  uint32_t sample_rate_ = 48000;
+  uint32_t phase_ = 0;
+  uint32_t phase_increment_ = 0;
+  float frequency_ = 0.f;
+  Shape shape_ = SHAPE_SINE;
+  uint16_t level_ = 0;
+
+  // Bipolar sample in [-32768, 32767]
+  inline int32_t Sample(uint32_t phase) const {
+    switch (shape_) {
+      case SHAPE_TRIANGLE: {
+        int32_t ramp = static_cast<int32_t>(phase) >> 15;  // +-65536
+        return (ramp < 0 ? -ramp : ramp) - 32768 - (ramp == -65536);
+      }
+      case SHAPE_SAW:
+        return static_cast<int32_t>(phase) >> 16;
+      case SHAPE_SQUARE:
+        return phase < 0x80000000UL ? 32767 : -32768;
+      case SHAPE_SINE:
+      default:
+        return sin_q15(phase);
+    }
+  }
+};
+
+}; // namespace util
+
+#endif // UTIL_OSCILLATOR_H_
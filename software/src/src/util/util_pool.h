@@ -0,0 +1,90 @@
+// util_pool.h - Fixed-size object pool
+//
+// Storage for `count` objects of one type with a free list threaded through
+// the unused slots, so New() and Delete() are constant time and the memory
+// never fragments. When the pool is empty New() returns nullptr and counts
+// a failure; the caller decides what to drop.
+//
+// Not thread safe; allocate and free from one context (the UI loop).
+
+#ifndef UTIL_POOL_H_
+#define UTIL_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <utility>
+
+namespace util {
+
+struct PoolStats {
+  uint32_t capacity;
+  uint32_t in_use;
+  uint32_t high_water;
+  uint32_t failures;  // New() with every slot taken
+};
+
+template <typename T, size_t count>
+class Pool {
+public:
+  static_assert(count > 0, "Empty pool");
+  static constexpr size_t kCount = count;
+
+  void Init() {
+    for (size_t i = 0; i < kCount; ++i)
+      slots_[i].next = i + 1 < kCount ? &slots_[i + 1] : nullptr;
+    free_ = &slots_[0];
+    stats_ = { kCount, 0, 0, 0 };
+  }
+
+  template <typename... Args>
+  T *New(Args &&... args) {
+    Slot *slot = free_;
+    if (!slot) {
+      ++stats_.failures;
+      return nullptr;
+    }
+    free_ = slot->next;
+    if (++stats_.in_use > stats_.high_water)
+      stats_.high_water = stats_.in_use;
+    return new (slot->storage) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T *object) {
+    if (!object)
+      return;
+    object->~T();
+    Slot *slot = reinterpret_cast<Slot *>(object);
+    slot->next = free_;
+    free_ = slot;
+    --stats_.in_use;
+  }
+
+  bool contains(const T *object) const {
+    const uint8_t *address = reinterpret_cast<const uint8_t *>(object);
+    const uint8_t *first = reinterpret_cast<const uint8_t *>(slots_);
+    return address >= first && address < first + sizeof(slots_) &&
+           !((address - first) % sizeof(Slot));
+  }
+
+  const PoolStats &stats() const { return stats_; }
+
+  void ResetStats() {
+    stats_.high_water = stats_.in_use;
+    stats_.failures = 0;
+  }
+
+private:
+  union Slot {
+    Slot *next;
+    alignas(T) uint8_t storage[sizeof(T)];
+  };
+
+  Slot slots_[kCount];
+  Slot *free_ = nullptr;
+  PoolStats stats_ = { kCount, 0, 0, 0 };
+};
+
+}; // namespace util
+
+#endif // UTIL_POOL_H_
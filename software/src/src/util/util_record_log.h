@@ -0,0 +1,314 @@
+// util_record_log.h - Wear-leveled record storage for small non-volatile memories
+//
+// Stores up to `num_records` fixed-size records (presets) in a ring of slots,
+// each slot holding one version of one record:
+//
+//   magic (2) | index (1) | size (1) | sequence (4) | payload | crc16 (2)
+//
+// A save never overwrites the live version of a record: it goes to the next
+// slot in ring order that isn't live, with a sequence number one higher than
+// any before it, so writes are spread over the whole memory and the old
+// version stays valid until the new one is complete. At startup Scan() keeps
+// the valid version with the highest sequence for each index and continues
+// the ring after the newest slot.
+//
+// Writes are split into steps of a few bytes, so a save can run in the
+// background of the UI loop without holding it up. A slot's magic is cleared
+// first and written last; a slot that was cut off by a power loss fails the
+// magic or CRC check and is ignored, leaving the previous version live.
+//
+// Device is anything with
+//   void Read(uint32_t address, void *dst, size_t length);
+//   void Write(uint32_t address, uint8_t value);
+// e.g. the Teensy EEPROM (whose update() skips unchanged bytes) or, in host
+// builds, an array that counts writes per address.
+//
+// With write_once, the device is flash that can only be programmed after an
+// erase (erased bytes read 0xFF), and also has
+//   void Erase(uint32_t address);  // One sector
+// A save then only goes to an erased slot, and its magic is left erased
+// (and so invalid) until it is written last. Reclaim() erases the sectors
+// that hold no live version; running it at startup leaves the erases out of
+// the saves. When no erased slot is left, Begin() refuses saves until the
+// next Reclaim().
+//
+// Not thread safe; use from one context (the UI loop).
+
+#ifndef UTIL_RECORD_LOG_H_
+#define UTIL_RECORD_LOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace util {
+
+static constexpr uint16_t kRecordLogMagic = 0x4C52;  // "RL"
+static constexpr size_t kRecordLogHeaderSize = 8;
+
+// Bytes per slot, to size the ring for a given memory
+static constexpr size_t RecordLogSlotSize(size_t payload_size) {
+  return kRecordLogHeaderSize + payload_size + 2;
+}
+
+// CRC-16/CCITT-FALSE
+static inline uint16_t crc16(const void *data, size_t length, uint16_t crc = 0xFFFF) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  while (length--) {
+    crc ^= static_cast<uint16_t>(*bytes++) << 8;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+template <typename Device, size_t payload_size, size_t num_records, size_t num_slots,
+          bool write_once = false>
+class RecordLog {
+public:
+  static_assert(payload_size <= 255, "Payload size is stored in a byte");
+  static_assert(num_records <= 255, "Record index is stored in a byte");
+  static_assert(num_slots > num_records, "Saves need a slot that isn't live");
+
+  static constexpr size_t kHeaderSize = kRecordLogHeaderSize;
+  static constexpr size_t kSlotSize = RecordLogSlotSize(payload_size);
+  static constexpr size_t kStorageSize = kSlotSize * num_slots;
+  static constexpr size_t kNone = ~static_cast<size_t>(0);
+
+  struct Stats {
+    uint32_t saves;      // Completed
+    uint32_t bytes;      // Written, whether or not the device skipped them
+    uint32_t discarded;  // Slots with a bad CRC or size found by Scan()
+    uint32_t erases;     // Sectors erased by Reclaim()
+  };
+
+  void Init(Device *device, uint32_t base_address) {
+    device_ = device;
+    base_ = base_address;
+    for (size_t &slot : live_)
+      slot = kNone;
+    next_slot_ = 0;
+    next_sequence_ = 1;
+    erased_ = 0;
+    position_ = kIdle;
+    stats_ = { 0, 0, 0, 0 };
+  }
+
+  // Find the newest version of each record. Returns a mask of the indices
+  // that have one.
+  uint32_t Scan() {
+    uint32_t sequences[num_records] = { 0 };
+    uint32_t newest = 0;
+    erased_ = 0;
+    for (size_t slot = 0; slot < num_slots; ++slot) {
+      uint8_t image[kSlotSize];
+      device_->Read(address(slot), image, kSlotSize);
+      if (ReadU16(image) != kRecordLogMagic) {
+        erased_ += write_once && IsErased(image, kSlotSize);
+        continue;
+      }
+      uint32_t sequence = ReadU32(image + 4);
+      if (image[2] >= num_records || image[3] != payload_size ||
+          ReadU16(image + kSlotSize - 2) != crc16(image, kSlotSize - 2)) {
+        ++stats_.discarded;
+        continue;
+      }
+      if (live_[image[2]] == kNone || static_cast<int32_t>(sequence - sequences[image[2]]) > 0) {
+        live_[image[2]] = slot;
+        sequences[image[2]] = sequence;
+      }
+      if (sequence >= newest) {
+        newest = sequence;
+        next_slot_ = (slot + 1) % num_slots;
+      }
+    }
+    next_sequence_ = newest + 1;
+
+    uint32_t mask = 0;
+    for (size_t index = 0; index < num_records; ++index) {
+      if (live_[index] != kNone)
+        mask |= 1UL << index;
+    }
+    return mask;
+  }
+
+  // Copy the live version of a record. Returns false if there is none.
+  bool Load(size_t index, void *payload) const {
+    if (index >= num_records || live_[index] == kNone)
+      return false;
+    device_->Read(address(live_[index]) + kHeaderSize, payload, payload_size);
+    return true;
+  }
+
+  // Write-once devices: erase every sector of `sector_size` bytes that holds
+  // no live version and isn't erased yet. The storage must start on a sector
+  // boundary and own all the sectors it touches. Returns the sectors erased.
+  size_t Reclaim(size_t sector_size) {
+    static_assert(write_once, "Only write-once devices are erased");
+    if (busy())
+      return 0;
+    size_t erased = 0;
+    for (size_t begin = 0; begin < kStorageSize; begin += sector_size) {
+      const size_t end = begin + sector_size < kStorageSize ? begin + sector_size : kStorageSize;
+      bool in_use = false;
+      for (size_t live : live_)
+        in_use |= live != kNone && live * kSlotSize < end && (live + 1) * kSlotSize > begin;
+      if (in_use || IsErased(begin, end))
+        continue;
+      device_->Erase(base_ + begin);
+      ++erased;
+      ++stats_.erases;
+    }
+    erased_ = 0;
+    for (size_t slot = 0; slot < num_slots; ++slot)
+      erased_ += IsErased(slot * kSlotSize, (slot + 1) * kSlotSize);
+    return erased;
+  }
+
+  // Start saving a record; the payload is copied, so it may change before
+  // the save completes. Returns false if a save is already in progress, or
+  // for write-once devices, if no slot is erased.
+  bool Begin(size_t index, const void *payload) {
+    if (busy() || index >= num_records)
+      return false;
+    size_t slot = next_slot_;
+    if (write_once) {
+      if (!erased_)
+        return false;
+      while (!IsErased(slot * kSlotSize, (slot + 1) * kSlotSize))
+        slot = (slot + 1) % num_slots;
+      --erased_;
+    } else {
+      while (IsLive(slot))
+        slot = (slot + 1) % num_slots;
+    }
+    slot_ = slot;
+    index_ = index;
+
+    WriteU16(image_, kRecordLogMagic);
+    image_[2] = index;
+    image_[3] = payload_size;
+    WriteU32(image_ + 4, next_sequence_);
+    memcpy(image_ + kHeaderSize, payload, payload_size);
+    WriteU16(image_ + kSlotSize - 2, crc16(image_, kSlotSize - 2));
+    // An erased magic is already invalid
+    position_ = write_once ? 2 : 0;
+    return true;
+  }
+
+  // Write up to `max_bytes` of the save in progress. Returns true when the
+  // save has completed (or if there was none).
+  bool Step(size_t max_bytes) {
+    while (busy() && max_bytes--) {
+      // Clear the magic, then write everything after it, then the magic
+      size_t offset;
+      uint8_t value;
+      if (position_ < 2) {
+        offset = position_;
+        value = 0;
+      } else if (position_ < kSlotSize) {
+        offset = position_;
+        value = image_[offset];
+      } else {
+        offset = position_ - kSlotSize;
+        value = image_[offset];
+      }
+      device_->Write(address(slot_) + offset, value);
+      ++stats_.bytes;
+      if (++position_ == kSlotSize + 2)
+        Finish();
+    }
+    return !busy();
+  }
+
+  bool busy() const { return position_ != kIdle; }
+
+  // Write-once devices: slots that can take a save
+  size_t erased_slots() const { return erased_; }
+
+  // Where record `index` lives, for tests and the usage report
+  size_t live_slot(size_t index) const { return index < num_records ? live_[index] : kNone; }
+  size_t next_slot() const { return next_slot_; }
+  uint32_t next_sequence() const { return next_sequence_; }
+  const Stats &stats() const { return stats_; }
+
+private:
+  static constexpr size_t kIdle = ~static_cast<size_t>(0);
+
+  Device *device_ = nullptr;
+  uint32_t base_ = 0;
+  size_t live_[num_records];
+  size_t next_slot_ = 0;
+  uint32_t next_sequence_ = 1;
+  size_t erased_ = 0;
+  Stats stats_ = { 0, 0, 0, 0 };
+
+  // Save in progress
+  uint8_t image_[kSlotSize];
+  size_t slot_ = 0;
+  size_t index_ = 0;
+  size_t position_ = kIdle;  // Bytes written, including the cleared magic
+
+  uint32_t address(size_t slot) const {
+    return base_ + slot * kSlotSize;
+  }
+
+  static bool IsErased(const uint8_t *bytes, size_t length) {
+    while (length--) {
+      if (*bytes++ != 0xFF)
+        return false;
+    }
+    return true;
+  }
+
+  // Storage offsets [begin, end)
+  bool IsErased(size_t begin, size_t end) const {
+    uint8_t chunk[32];
+    while (begin < end) {
+      const size_t length = end - begin < sizeof(chunk) ? end - begin : sizeof(chunk);
+      device_->Read(base_ + begin, chunk, length);
+      if (!IsErased(chunk, length))
+        return false;
+      begin += length;
+    }
+    return true;
+  }
+
+  bool IsLive(size_t slot) const {
+    for (size_t live : live_) {
+      if (live == slot)
+        return true;
+    }
+    return false;
+  }
+
+  void Finish() {
+    live_[index_] = slot_;
+    next_slot_ = (slot_ + 1) % num_slots;
+    ++next_sequence_;
+    position_ = kIdle;
+    ++stats_.saves;
+  }
+
+  static uint16_t ReadU16(const uint8_t *bytes) {
+    return bytes[0] | bytes[1] << 8;
+  }
+
+  static uint32_t ReadU32(const uint8_t *bytes) {
+    return ReadU16(bytes) | static_cast<uint32_t>(ReadU16(bytes + 2)) << 16;
+  }
+
+  static void WriteU16(uint8_t *bytes, uint16_t value) {
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+  }
+
+  static void WriteU32(uint8_t *bytes, uint32_t value) {
+    WriteU16(bytes, value);
+    WriteU16(bytes + 2, value >> 16);
+  }
+};
+
+}; // namespace util
+
+#endif // UTIL_RECORD_LOG_H_
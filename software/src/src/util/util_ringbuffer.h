@@ -0,0 +1,70 @@
+// util_ringbuffer.h - Single-producer, single-consumer ring buffer
+//
+// Lock-free as long as there is exactly one writer context and one reader
+// context (e.g. a pin ISR feeding the core ISR). Size must be a power of two.
+
+#ifndef UTIL_RINGBUFFER_H_
+#define UTIL_RINGBUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace util {
+
+template <typename T, size_t size>
+class RingBuffer {
+public:
+  static_assert(size && !(size & (size - 1)), "Size must be a power of two");
+  static constexpr size_t kSize = size;
+
+  void Init() {
+    write_ptr_ = read_ptr_ = 0;
+  }
+
+  size_t readable() const {
+    return write_ptr_ - read_ptr_;
+  }
+
+  size_t writable() const {
+    return kSize - readable();
+  }
+
+  bool Write(const T &value) {
+    size_t w = write_ptr_;
+    if (w - read_ptr_ >= kSize)
+      return false;
+    buffer_[w & (kSize - 1)] = value;
+    __sync_synchronize();
+    write_ptr_ = w + 1;
+    return true;
+  }
+
+  bool Read(T &value) {
+    size_t r = read_ptr_;
+    if (write_ptr_ == r)
+      return false;
+    value = buffer_[r & (kSize - 1)];
+    __sync_synchronize();
+    read_ptr_ = r + 1;
+    return true;
+  }
+
+  // Access to the oldest element without consuming it; only valid if
+  // readable() > 0.
+  const T &Peek() const {
+    return buffer_[read_ptr_ & (kSize - 1)];
+  }
+
+  void Flush() {
+    read_ptr_ = write_ptr_;
+  }
+
+private:
+  T buffer_[kSize];
+  volatile size_t write_ptr_ = 0;
+  volatile size_t read_ptr_ = 0;
+};
+
+}; // namespace util
+
+#endif // UTIL_RINGBUFFER_H_
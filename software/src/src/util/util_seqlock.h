@@ -0,0 +1,109 @@
+// util_seqlock.h - Consistent snapshots of a parameter block for readers in ISRs
+//
+// A sequence counter with two copies of the block (the "latch" variant of a
+// seqlock). The writer bumps the sequence and updates copy 0 while readers
+// use copy 1, then bumps it again and updates copy 1 while readers use copy
+// 0, so one copy is always complete and a reader never has to wait for the
+// writer to finish.
+//
+// A reader retries only if the writer ran while it was copying. On a single
+// core that can't happen to a reader in an ISR above the writer's priority,
+// so for the intended use (UI loop writes, core ISR reads) reads are
+// wait-free and never retry, and neither side disables interrupts. Readers
+// in lower priority contexts, or on other threads in host tests, may retry;
+// retries are counted.
+//
+// There must only be one writer at a time. T is copied with memcpy, so it
+// should be a small, trivially copyable struct.
+
+#ifndef UTIL_SEQLOCK_H_
+#define UTIL_SEQLOCK_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace util {
+
+template <typename T>
+class Seqlock {
+public:
+  static_assert(std::is_trivially_copyable<T>::value, "Blocks are copied with memcpy");
+
+  void Init(const T &value) {
+    memcpy(&copies_[0], &value, sizeof(T));
+    memcpy(&copies_[1], &value, sizeof(T));
+    sequence_ = 0;
+    ResetStats();
+  }
+
+  // Single writer
+  void Write(const T &value) {
+    uint32_t sequence = __atomic_load_n(&sequence_, __ATOMIC_RELAXED);
+    // Odd: readers use copy 1 while copy 0 is updated
+    __atomic_store_n(&sequence_, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&copies_[0], &value, sizeof(T));
+    // Even: back to copy 0 while copy 1 catches up
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&sequence_, sequence + 2, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&copies_[1], &value, sizeof(T));
+    __atomic_fetch_add(&writes_, 1, __ATOMIC_RELAXED);
+  }
+
+  // Any number of readers, any context
+  void Read(T &value) const {
+    uint32_t retries = 0;
+    for (;;) {
+      uint32_t sequence = __atomic_load_n(&sequence_, __ATOMIC_ACQUIRE);
+      memcpy(&value, &copies_[sequence & 1], sizeof(T));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&sequence_, __ATOMIC_RELAXED) == sequence)
+        break;
+      ++retries;
+    }
+    __atomic_fetch_add(&reads_, 1, __ATOMIC_RELAXED);
+    if (retries) {
+      __atomic_fetch_add(&retries_, retries, __ATOMIC_RELAXED);
+      if (retries > __atomic_load_n(&max_retries_, __ATOMIC_RELAXED))
+        __atomic_store_n(&max_retries_, retries, __ATOMIC_RELAXED);
+    }
+  }
+
+  T Read() const {
+    T value;
+    Read(value);
+    return value;
+  }
+
+  // Number of completed writes, e.g. to tell whether a cached copy is stale
+  uint32_t version() const {
+    return __atomic_load_n(&sequence_, __ATOMIC_ACQUIRE) >> 1;
+  }
+
+  uint32_t writes() const { return __atomic_load_n(&writes_, __ATOMIC_RELAXED); }
+  uint32_t reads() const { return __atomic_load_n(&reads_, __ATOMIC_RELAXED); }
+  uint32_t retries() const { return __atomic_load_n(&retries_, __ATOMIC_RELAXED); }
+  // Most retries of a single read
+  uint32_t max_retries() const { return __atomic_load_n(&max_retries_, __ATOMIC_RELAXED); }
+
+  void ResetStats() {
+    __atomic_store_n(&writes_, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&reads_, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&retries_, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&max_retries_, 0, __ATOMIC_RELAXED);
+  }
+
+private:
+  T copies_[2];
+  uint32_t sequence_ = 0;
+  mutable uint32_t reads_ = 0;
+  mutable uint32_t retries_ = 0;
+  mutable uint32_t max_retries_ = 0;
+  uint32_t writes_ = 0;
+};
+
+}; // namespace util
+
+#endif // UTIL_SEQLOCK_H_
@@ -0,0 +1,64 @@
+// util_stats.h - Running statistics for timing measurements
+//
+// Accumulates count/min/max/mean/rms of integer samples (typically cycle
+// counts) without storing the samples. Cheap enough to update from an ISR.
+
+#ifndef UTIL_STATS_H_
+#define UTIL_STATS_H_
+
+#include <stdint.h>
+#include <math.h>
+
+namespace util {
+
+class RunningStats {
+public:
+  void Reset() {
+    count_ = 0;
+    min_ = INT32_MAX;
+    max_ = INT32_MIN;
+    sum_ = 0;
+    sum_sq_ = 0.0;
+  }
+
+  void Push(int32_t value) {
+    ++count_;
+    if (value < min_) min_ = value;
+    if (value > max_) max_ = value;
+    sum_ += value;
+    sum_sq_ += static_cast<double>(value) * value;
+  }
+
+  uint32_t count() const { return count_; }
+  int32_t min() const { return count_ ? min_ : 0; }
+  int32_t max() const { return count_ ? max_ : 0; }
+  int64_t sum() const { return sum_; }
+
+  double mean() const {
+    return count_ ? static_cast<double>(sum_) / count_ : 0.0;
+  }
+
+  // Root-mean-square of the samples, i.e. the error magnitude when samples
+  // are deviations from an ideal value.
+  double rms() const {
+    return count_ ? sqrt(sum_sq_ / count_) : 0.0;
+  }
+
+  double stddev() const {
+    if (count_ < 2) return 0.0;
+    double m = mean();
+    double var = sum_sq_ / count_ - m * m;
+    return var > 0.0 ? sqrt(var) : 0.0;
+  }
+
+private:
+  uint32_t count_ = 0;
+  int32_t min_ = INT32_MAX;
+  int32_t max_ = INT32_MIN;
+  int64_t sum_ = 0;
+  double sum_sq_ = 0.0;
+};
+
+}; // namespace util
+
+#endif // UTIL_STATS_H_
@@ -0,0 +1,55 @@
+// audio_bench.cpp - Host benchmark for audio block rendering
+//
+// Times util::Oscillator block rendering the way OC::AUDIO drives it
+// (interleaved frames, one oscillator per channel) and reports the cost per
+// block against the block period. Host numbers are only a relative measure;
+// the 'a' debug command reports the render load on the Teensy itself.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -o audio_bench tools/audio_bench.cpp && ./audio_bench
+
+#include <chrono>
+#include <stdio.h>
+#include "../src/src/util/util_oscillator.h"
+
+static constexpr size_t kBlockSize = 128;
+static constexpr size_t kNumChannels = 2;
+static constexpr size_t kIterations = 20000;
+
+static const char *const kShapeNames[] = { "sine", "triangle", "saw", "square" };
+
+int main() {
+  static const uint32_t kSampleRates[] = { 32000, 48000 };
+  uint16_t frames[kBlockSize * kNumChannels];
+  uint32_t checksum = 0;
+
+  for (uint32_t sample_rate : kSampleRates) {
+    double block_ns = 1e9 * kBlockSize / sample_rate;
+    printf("%lu Hz, %u x %u-sample blocks (%.0f us per block)\n",
+           (unsigned long)sample_rate, (unsigned)kNumChannels, (unsigned)kBlockSize, block_ns / 1000.0);
+
+    for (int shape = util::Oscillator::SHAPE_SINE; shape <= util::Oscillator::SHAPE_SQUARE; ++shape) {
+      util::Oscillator oscillators[kNumChannels];
+      for (size_t i = 0; i < kNumChannels; ++i) {
+        oscillators[i].Init(sample_rate);
+        oscillators[i].set_frequency(110.f * (i + 1));
+        oscillators[i].set_shape(static_cast<util::Oscillator::Shape>(shape));
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      for (size_t n = 0; n < kIterations; ++n) {
+        for (size_t i = 0; i < kNumChannels; ++i)
+          oscillators[i].Render(frames + i, kNumChannels, kBlockSize);
+        checksum += frames[n % (kBlockSize * kNumChannels)];
+      }
+      auto end = std::chrono::steady_clock::now();
+
+      double ns = std::chrono::duration<double, std::nano>(end - start).count() / kIterations;
+      printf("  %-8s %8.0f ns/block %6.2f ns/sample %6.3f%% of block period\n",
+             kShapeNames[shape], ns, ns / (kBlockSize * kNumChannels), 100.0 * ns / block_ns);
+    }
+  }
+
+  printf("checksum %08x\n", (unsigned)checksum);
+  return 0;
+}
@@ -0,0 +1,398 @@
+// clock_sim.cpp - Host test of clock tracking with jittered synthetic clocks
+//
+// Feeds util::ClockTracker the edges of a clock with Gaussian or uniform
+// jitter and tempo steps, with the firmware's input loop gains, and runs a
+// ClockEngine (x1 and x4 outputs) on the 16.667 kHz core tick, edges being
+// timestamped on arrival and picked up at the next tick as on the device.
+// For each tempo segment it reports:
+// - the lock time, until the period estimate stays within 1% of the tempo
+// - the input jitter (tracker phase error, and edge arrival against the
+//   ideal clock)
+// - the output edge jitter against the ideal clock, and the engine's output
+//   edge and period statistics
+// and fails unless the clock locks within the first half of each segment and
+// the outputs jitter less than the input.
+//
+// Then MIDI clock goes through OC_midi.cpp and OC_clock.cpp, with the 24
+// PPQN tracker settings, as the core tick runs them: 0xF8 at 120 BPM sent
+// with up to 1 ms of host jitter and delivered in 1 ms USB frames. The bytes
+// are fed to MIDI::Inject() as they arrive, so each clock is stamped with its
+// arrival time, and MIDI::Tick() hands them on at the next tick. It checks that the tracker locks without relocking, that the outputs
+// stay in phase with much less jitter than the arrivals, that outputs stop
+// on Stop, that Continue after a Song Position resumes at that position, and
+// that Start restarts at beat 0.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -Itools/host -o clock_sim tools/clock_sim.cpp src/src/OC_clock.cpp
+//       src/src/OC_midi.cpp src/src/OC_output_queue.cpp src/src/OC_DAC.cpp
+//       tools/host/DAC8568_emulated.cpp
+//   ./clock_sim [seed]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+#include "../src/src/OC_clock.h"
+#include "../src/src/OC_core.h"
+#include "../src/src/OC_DAC.h"
+#include "../src/src/OC_events.h"
+#include "../src/src/OC_midi.h"
+#include "../src/src/OC_output_queue.h"
+#include "../src/src/util/util_clock.h"
+#include "../src/src/util/util_midi.h"
+
+using namespace OC;
+
+static constexpr int64_t kCyclesPerUs = CORE::kCyclesPerUs;
+static constexpr int64_t kCyclesPerTick = CORE::kCyclesPerTick;
+
+// Loop gains of the clock input (OC_clock.cpp)
+static constexpr uint8_t kInputPhaseShift = 2;
+static constexpr uint8_t kInputFreqShift = 4;
+
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("  FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+static double us(double cycles) {
+  return cycles / kCyclesPerUs;
+}
+
+enum Jitter { JITTER_GAUSSIAN, JITTER_UNIFORM };
+
+struct Segment {
+  double bpm;
+  int beats;
+};
+
+struct Scenario {
+  const char *name;
+  Jitter jitter;
+  double jitter_us;  // Standard deviation, or half width if uniform
+  std::vector<Segment> segments;
+};
+
+static void Run(const Scenario &scenario, std::mt19937 &rng) {
+  printf("%s\n", scenario.name);
+  std::normal_distribution<double> gaussian(0.0, scenario.jitter_us * kCyclesPerUs);
+  std::uniform_real_distribution<double> uniform(-scenario.jitter_us * kCyclesPerUs,
+                                                 scenario.jitter_us * kCyclesPerUs);
+
+  util::ClockTracker tracker;
+  tracker.Init(1, kInputPhaseShift, kInputFreqShift);
+  util::ClockEngine<2> engine;
+  engine.Init(&tracker);
+  engine.set_ratio(0, 1, 1);
+  engine.set_ratio(1, 4, 1);
+  engine.enable(0, true);
+  engine.enable(1, true);
+
+  // Ideal and jittered edges of every segment, the first a beat in
+  struct Edge {
+    int64_t ideal, arrival;
+  };
+  std::vector<Edge> edges;
+  std::vector<size_t> segment_start;  // First edge of each segment
+  int64_t t = 60 * kCyclesPerUs * 1000000 / static_cast<int64_t>(scenario.segments[0].bpm);
+  for (const Segment &segment : scenario.segments) {
+    const int64_t period = llround(60.0 * kCyclesPerUs * 1e6 / segment.bpm);
+    segment_start.push_back(edges.size());
+    for (int beat = 0; beat < segment.beats; ++beat, t += period) {
+      double jitter = scenario.jitter == JITTER_GAUSSIAN ? gaussian(rng) : uniform(rng);
+      edges.push_back({ t, t + llround(jitter) });
+    }
+  }
+  segment_start.push_back(edges.size());
+
+  size_t next_edge = 0;
+  int64_t now = 0;
+  for (size_t s = 0; s < scenario.segments.size(); ++s) {
+    const Segment &segment = scenario.segments[s];
+    const int64_t period = llround(60.0 * kCyclesPerUs * 1e6 / segment.bpm);
+    const int64_t start = edges[segment_start[s]].ideal;
+    const int64_t settle = edges[segment_start[s] + segment.beats / 2].ideal;
+    const int64_t end = segment_start[s + 1] < edges.size() ? edges[segment_start[s + 1]].ideal
+                                                              : edges.back().ideal + period / 2;
+
+    util::RunningStats arrival_error, output_error, input_period;
+    int64_t last_unlocked = start;
+    int64_t last_arrival = 0;
+    bool measuring = false;
+
+    for (; now < end; now += kCyclesPerTick) {
+      if (!measuring && now >= settle) {
+        measuring = true;
+        tracker.ResetStats();
+        engine.ResetStats();
+      }
+      // Edges timestamped by the pin ISR, picked up by the next tick
+      while (next_edge < edges.size() && edges[next_edge].arrival < now) {
+        const Edge &edge = edges[next_edge++];
+        tracker.Edge(edge.arrival);
+        if (measuring) {
+          arrival_error.Push(util::clamp_int32(edge.arrival - edge.ideal));
+          if (last_arrival)
+            input_period.Push(util::clamp_int32(edge.arrival - last_arrival));
+        }
+        last_arrival = edge.arrival;
+      }
+      tracker.Update(now);
+      const uint32_t mask = engine.Process(now, kCyclesPerTick);
+
+      if (!tracker.locked() || llabs(tracker.period() - period) * 100 > period)
+        last_unlocked = now;
+      if (measuring && (mask & 1)) {
+        // Against the nearest ideal beat
+        int64_t nearest = edges[segment_start[s]].ideal +
+                          util::floor_div(now - start + period / 2, period) * period;
+        output_error.Push(util::clamp_int32(now - nearest));
+      }
+    }
+
+    const double lock_ms = us(last_unlocked - start) / 1000.0;
+    printf("  %5.1f BPM: lock %7.1f ms (%.1f beats)\n", segment.bpm, lock_ms,
+           static_cast<double>(last_unlocked - start) / period);
+    printf("    input   phase error sd %7.1f us, arrival sd %7.1f us, period sd %7.1f us\n",
+           us(tracker.phase_error().stddev()), us(arrival_error.stddev()), us(input_period.stddev()));
+    printf("    output  edge error sd %7.1f us (mean %+6.1f), x1 period sd %7.1f us, x4 period sd %7.1f us\n",
+           us(output_error.stddev()), us(output_error.mean()), us(engine.period(0).stddev()),
+           us(engine.period(1).stddev()));
+    printf("            engine edge vs ideal: x1 %5.1f us max %5.1f us, x4 %5.1f us max %5.1f us\n",
+           us(engine.jitter(0).stddev()), us(engine.jitter(0).max() - engine.jitter(0).min()),
+           us(engine.jitter(1).stddev()), us(engine.jitter(1).max() - engine.jitter(1).min()));
+
+    Check(last_unlocked < settle, "locks within the first half of the segment");
+    Check(output_error.count() >= static_cast<uint32_t>(segment.beats / 2 - 2), "outputs running");
+    Check(output_error.stddev() < arrival_error.stddev(), "output edges jitter less than the input");
+    Check(engine.period(0).stddev() < input_period.stddev(), "output period jitters less than the input");
+    Check(fabs(output_error.mean()) < arrival_error.stddev(), "outputs in phase with the clock");
+  }
+}
+
+// Stand-ins for the core tick and event bus used by OC_clock.cpp and OC_midi.cpp
+static int64_t tick_start;
+volatile uint32_t CORE::ticks = 0;
+uint64_t CORE::tick_cycles() { return tick_start; }
+bool EVENTS::Post(EVENTS::Type, uint8_t, uint16_t) { return true; }
+
+struct MidiMessage {
+  int64_t ideal, arrival;
+  uint8_t status;
+  uint16_t value;
+};
+
+static constexpr int64_t kUsbFrame = 1000 * kCyclesPerUs;
+static constexpr size_t kBeatChannel = 6;     // Output 0, x1
+static constexpr size_t kQuarterChannel = 7;  // Output 1, x4
+
+static void RunMidi(std::mt19937 &rng) {
+  printf("MIDI clock, 120 BPM, up to 1 ms host jitter, 1 ms USB frames\n");
+  const int64_t period = llround(60.0 * kCyclesPerUs * 1e6 / (120 * 24));
+  std::uniform_real_distribution<double> host_jitter(0, 1000.0 * kCyclesPerUs);
+  const int64_t frame_phase = rng() % kUsbFrame;
+
+  std::vector<MidiMessage> messages;
+  int64_t t = 100 * 1000 * kCyclesPerUs;
+  auto send = [&](uint8_t status, uint16_t value = 0) {
+    messages.push_back({ t, 0, status, value });
+  };
+  auto clocks = [&](int beats) {
+    for (int i = 0; i < 24 * beats; ++i, t += period)
+      send(util::MIDI_CLOCK);
+  };
+
+  // Start and 32 beats, 4 beats stopped, continue from sixteenth 37 for 16
+  // beats, then start again for 8 beats
+  send(util::MIDI_START);
+  const size_t start_clock = messages.size();
+  clocks(32);
+  const int64_t measure_from = messages[start_clock + 16 * 24].ideal;
+  const int64_t measure_to = t;
+  send(util::MIDI_STOP);
+  const size_t stop = messages.size() - 1;
+  clocks(4);
+  send(util::MIDI_SONG_POSITION, 37);
+  send(util::MIDI_CONTINUE);
+  const size_t continue_clock = messages.size();
+  clocks(16);
+  send(util::MIDI_STOP);
+  send(util::MIDI_START);
+  const size_t restart_clock = messages.size();
+  clocks(8);
+
+  // Scheduled by the host, sent in the next USB frame, in order
+  int64_t last = 0;
+  for (MidiMessage &message : messages) {
+    int64_t sent = message.ideal + llround(host_jitter(rng));
+    int64_t frame = util::floor_div(sent - frame_phase + kUsbFrame - 1, kUsbFrame);
+    message.arrival = std::max(frame * kUsbFrame + frame_phase, last);
+    last = message.arrival;
+  }
+
+  DAC::Init();
+  OutputQueue::Init();
+  CLOCK::Init();
+  MIDI::Init();
+  uint16_t gates[2] = { DAC::kGateLow, DAC::kGateLow };
+  std::vector<int64_t> beat_edges, quarter_edges;
+  // x1 pulses, from rise to the fall the output queue applied
+  util::RunningStats beat_pulse_ticks;
+  int64_t beat_rise = -1;
+  util::RunningStats arrival_error, arrival_period, output_error;
+  int64_t last_arrival = 0, locked_at = -1;
+  int64_t stopped_at = -1, continued_at = -1;
+  uint32_t edges_while_stopped = 0;
+  int64_t continue_pulse = -1, restart_pulse = -1;
+  bool followed = true;
+
+  size_t next = 0;
+  for (int64_t now = 0; now < t + 4 * 24 * period; now += kCyclesPerTick) {
+    // Bytes that arrived since the last tick, stamped as they come in
+    const size_t first = next;
+    for (; next < messages.size() && messages[next].arrival < now; ++next) {
+      const MidiMessage &message = messages[next];
+      const uint8_t bytes[] = { message.status, static_cast<uint8_t>(message.value & 0x7F),
+                                static_cast<uint8_t>(message.value >> 7) };
+      ARM_DWT_CYCCNT = static_cast<uint32_t>(message.arrival);
+      MIDI::Inject(bytes, message.status == util::MIDI_SONG_POSITION ? 3 : 1);
+      if (message.status == util::MIDI_CLOCK && message.ideal >= measure_from && message.ideal < measure_to) {
+        arrival_error.Push(util::clamp_int32(message.arrival - message.ideal));
+        if (last_arrival)
+          arrival_period.Push(util::clamp_int32(message.arrival - last_arrival));
+      }
+      if (message.status == util::MIDI_CLOCK)
+        last_arrival = message.arrival;
+    }
+
+    // The core tick: MIDI::Tick() after CLOCK::Tick()
+    tick_start = now;
+    ARM_DWT_CYCCNT = static_cast<uint32_t>(now);
+    OutputQueue::Apply(CORE::ticks);
+    CLOCK::Tick(now);
+    MIDI::Tick();
+
+    for (int i = 0; i < 2; ++i) {
+      const size_t channel = i ? kQuarterChannel : kBeatChannel;
+      const uint16_t gate = DAC::value(channel);
+      if (gate != gates[i] && gate == DAC::kGateHigh) {
+        (i ? quarter_edges : beat_edges).push_back(now);
+        if (stopped_at >= 0 && continued_at < 0)
+          ++edges_while_stopped;
+        if (!i)
+          beat_rise = now;
+      } else if (gate != gates[i] && !i && beat_rise >= 0) {
+        beat_pulse_ticks.Push((now - beat_rise) / kCyclesPerTick);
+      }
+      gates[i] = gate;
+    }
+    ++CORE::ticks;
+
+    for (size_t index = first; index < next; ++index) {
+      if (index == continue_clock)
+        continue_pulse = CLOCK::midi_tracker().pulse_count();
+      if (index == restart_clock)
+        restart_pulse = CLOCK::midi_tracker().pulse_count();
+      if (messages[index].status == util::MIDI_CONTINUE)
+        continued_at = now;
+      if (index == stop)
+        stopped_at = now;
+    }
+
+    // Lock time until the measurement, then MIDI must stay the source
+    const int64_t tracked = CLOCK::midi_tracker().period();
+    if (now < measure_from) {
+      if (!CLOCK::midi_tracker().locked() || llabs(tracked - period) * 100 > period)
+        locked_at = -1;
+      else if (locked_at < 0)
+        locked_at = now;
+    } else if (now < measure_to && !CLOCK::midi_active()) {
+      followed = false;
+    }
+    if (now == measure_from - measure_from % kCyclesPerTick) {
+      CLOCK::ResetStats();
+      arrival_period.Reset();
+    }
+  }
+
+  // Beats between the measurement points against the ideal beat times
+  const int64_t first_beat = messages[start_clock].ideal;
+  for (int64_t edge : beat_edges) {
+    if (edge >= measure_from && edge < measure_to) {
+      int64_t beat = util::floor_div(edge - first_beat + 12 * period, 24 * period);
+      output_error.Push(util::clamp_int32(edge - first_beat - beat * 24 * period));
+    }
+  }
+  const CLOCK::Engine &engine = CLOCK::engine();
+  printf("  lock %.1f ms after start, %u relocks\n",
+         us(locked_at - messages[start_clock].arrival) / 1000.0, CLOCK::midi_tracker().relocks());
+  printf("    input   arrival error sd %6.1f us (mean %+6.1f), clock period sd %6.1f us\n",
+         us(arrival_error.stddev()), us(arrival_error.mean()), us(arrival_period.stddev()));
+  printf("    output  beat error sd %6.1f us (mean %+6.1f, max %6.1f), x1 period sd %6.1f us, x4 period sd %6.1f us\n",
+         us(output_error.stddev()), us(output_error.mean()),
+         us(std::max(-output_error.min(), output_error.max())), us(engine.period(0).stddev()),
+         us(engine.period(1).stddev()));
+
+  Check(locked_at >= 0 && followed, "MIDI clock locked and followed");
+  Check(!CLOCK::midi_tracker().relocks(), "no relocks");
+  Check(output_error.count() >= 15, "beats while running");
+  Check(output_error.stddev() < arrival_error.stddev() / 2, "beat jitter well below the arrival jitter");
+  Check(engine.period(1).stddev() < arrival_period.stddev() / 2, "x4 period jitter well below the clock's");
+  Check(fabs(output_error.mean()) < arrival_error.mean() + 1000 * kCyclesPerUs, "beats in phase");
+  Check(!MIDI::dropped_count() && MIDI::message_count() == messages.size(), "every message through MIDI::Inject()");
+  Check(!edges_while_stopped, "no output while stopped");
+
+  // Falls come from the output queue, at the pulse width
+  const int32_t width_ticks = CLOCK::kDefaultPulseWidthUs / CORE::kTickUs;
+  const OutputQueue::Stats queue = OutputQueue::stats();
+  printf("  x1 pulses %u to %u ticks (%d expected), %u falls queued, %u late\n",
+         static_cast<unsigned>(beat_pulse_ticks.min()), static_cast<unsigned>(beat_pulse_ticks.max()),
+         width_ticks, queue.applied, queue.late);
+  Check(beat_pulse_ticks.count() > 0 && beat_pulse_ticks.min() == width_ticks &&
+        beat_pulse_ticks.max() == width_ticks, "gate falls at the pulse width");
+  Check(!queue.late && !queue.overflows && !queue.dropped, "falls applied on their tick");
+
+  // Sixteenth 37 is pulse 222, so the next beat is 18 clocks on
+  printf("  continue at pulse %lld, start at pulse %lld\n", static_cast<long long>(continue_pulse),
+         static_cast<long long>(restart_pulse));
+  Check(continue_pulse == 37 * 6, "song position restored on continue");
+  Check(restart_pulse == 0, "start at pulse 0");
+  auto first_after = [](const std::vector<int64_t> &edges, int64_t from) {
+    for (int64_t edge : edges) {
+      if (edge >= from)
+        return edge;
+    }
+    return INT64_MAX;
+  };
+  const int64_t tolerance = 3000 * kCyclesPerUs;
+  const int64_t continued_beat = first_after(beat_edges, continued_at);
+  const int64_t restarted_beat = first_after(beat_edges, messages[restart_clock].ideal);
+  printf("  first beat %.1f ms after the 18th clock from continue, %.1f ms after the first clock from start\n",
+         us(continued_beat - messages[continue_clock + 18].ideal) / 1000.0,
+         us(restarted_beat - messages[restart_clock].ideal) / 1000.0);
+  Check(llabs(continued_beat - messages[continue_clock + 18].ideal) < tolerance, "first beat after continue on the beat");
+  Check(first_after(quarter_edges, continued_at) < messages[continue_clock + 1].ideal, "x4 resumes on the first clock");
+  Check(llabs(restarted_beat - messages[restart_clock].ideal) < tolerance, "first beat after start on the first clock");
+}
+
+int main(int argc, char **argv) {
+  std::mt19937 rng(argc > 1 ? atoi(argv[1]) : 1);
+  const std::vector<Scenario> scenarios = {
+    { "gaussian jitter, sd 1 ms", JITTER_GAUSSIAN, 1000,
+      { { 120, 64 }, { 150, 64 }, { 90, 64 }, { 93, 64 } } },
+    { "uniform jitter, +-3 ms", JITTER_UNIFORM, 3000,
+      { { 120, 64 }, { 180, 64 }, { 60, 64 } } },
+    { "gaussian jitter, sd 2 ms, fast clock", JITTER_GAUSSIAN, 2000,
+      { { 480, 128 }, { 400, 128 } } },
+  };
+  for (const Scenario &scenario : scenarios)
+    Run(scenario, rng);
+  RunMidi(rng);
+  printf("%s\n", failures ? "FAILED" : "outputs lock and jitter less than the input");
+  return failures ? 1 : 0;
+}
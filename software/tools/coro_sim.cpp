@@ -0,0 +1,147 @@
+// coro_sim.cpp - Host test of the coroutine runtime (util_coro.h, OC_coro.cpp)
+//
+// Runs task sequences the way the firmware does, with loop() polling the
+// scheduler every 10 us of emulated time:
+// - sleeps resume in deadline order, no earlier than asked and at most one
+//   poll late
+// - a task awaiting another resumes when it returns
+// - a Completion signalled from another thread (standing in for a DMA ISR)
+//   resumes its waiter, over many rounds
+// - spawning with every frame taken fails without running the task
+// - every frame is back in the pool at the end, and the largest frame fits
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++20 -Wno-volatile -pthread -Itools/host -o coro_sim
+//       tools/coro_sim.cpp src/src/OC_coro.cpp
+//   ./coro_sim [rounds]
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Arduino.h>
+#include "../src/src/OC_coro.h"
+
+static constexpr uint32_t kLoopCycles = F_CPU / 100000;  // 10 us main loop
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+static void Loop(uint32_t us) {
+  for (uint32_t t = 0; t < us; t += 10) {
+    ARM_DWT_CYCCNT += kLoopCycles;
+    OC::CORO::Poll();
+  }
+}
+
+static std::vector<int> order;
+static uint32_t worst_early = 0, worst_late = 0;
+
+static OC::CORO::Task Sleeper(int id, uint32_t us) {
+  uint32_t start = micros();
+  co_await OC::CORO::Sleep(us);
+  uint32_t slept = micros() - start;
+  if (slept < us)
+    worst_early = us - slept > worst_early ? us - slept : worst_early;
+  else if (slept - us > worst_late)
+    worst_late = slept - us;
+  order.push_back(id);
+}
+
+static OC::CORO::Task Step(int *counter) {
+  co_await OC::CORO::Yield();
+  ++*counter;
+  co_await OC::CORO::Sleep(100);
+  ++*counter;
+}
+
+static OC::CORO::Task Sequence(int *counter, bool *done) {
+  co_await Step(counter);
+  co_await Step(counter);
+  *done = *counter == 4;
+}
+
+static OC::CORO::Completion completion;
+static std::atomic<uint32_t> started{0};
+
+static OC::CORO::Task Transfers(uint32_t rounds, uint32_t *completed) {
+  for (uint32_t round = 0; round < rounds; ++round) {
+    completion.Reset();
+    started.store(round + 1, std::memory_order_release);
+    co_await OC::CORO::Wait(completion);
+    ++*completed;
+  }
+}
+
+int main(int argc, char **argv) {
+  const uint32_t rounds = argc > 1 ? atoi(argv[1]) : 20000;
+  OC::CORO::Init();
+
+  // Sleeps
+  static const uint32_t kSleeps[] = { 500, 120, 2000, 40, 1000 };
+  for (size_t i = 0; i < 5; ++i)
+    OC::CORO::Spawn(Sleeper(i, kSleeps[i]));
+  Loop(3000);
+  Check(order == std::vector<int>({ 3, 1, 0, 4, 2 }), "sleeps in deadline order");
+  Check(!worst_early && worst_late <= 10, "sleeps on time");
+  printf("sleep: 5 tasks in deadline order, at most %u us late\n", worst_late);
+
+  // Nested tasks
+  int counter = 0;
+  bool done = false;
+  OC::CORO::Spawn(Sequence(&counter, &done));
+  Loop(1000);
+  Check(done, "awaited tasks ran in turn");
+
+  // Completions from another thread
+  uint32_t completed = 0;
+  std::atomic<bool> stop{false};
+  std::thread isr([&] {
+    uint32_t signalled = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      uint32_t round = started.load(std::memory_order_acquire);
+      if (round != signalled) {
+        signalled = round;
+        completion.Signal();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  OC::CORO::Spawn(Transfers(rounds, &completed));
+  for (uint32_t polls = 0; completed < rounds && polls < 100 * rounds; ++polls) {
+    ARM_DWT_CYCCNT += kLoopCycles;
+    OC::CORO::Poll();
+    if (!(polls & 15))
+      std::this_thread::yield();
+  }
+  stop.store(true);
+  isr.join();
+  Check(completed == rounds, "every completion resumed its waiter");
+  printf("completion: %u of %u transfers signalled from another thread\n", completed, rounds);
+
+  // Pool exhaustion
+  bool spawned = true;
+  for (size_t i = 0; i < OC::CORO::kNumFrames; ++i)
+    spawned = OC::CORO::Spawn(Sleeper(100, 1000)) && spawned;
+  bool extra = OC::CORO::Spawn(Sleeper(101, 1000));
+  Check(spawned && !extra, "spawn fails with every frame taken");
+  Check(OC::CORO::frame_stats().failures == 1, "failed spawn counted");
+  Loop(2000);
+
+  OC::CORO::Stats stats = OC::CORO::stats();
+  const util::PoolStats &frames = OC::CORO::frame_stats();
+  Check(!frames.in_use && !stats.scheduler.waiting, "every frame returned");
+  Check(!stats.too_large, "frames fit");
+  printf("frames: largest %u of %u bytes, high water %u of %u; %u resumes\n",
+         stats.max_frame_size, static_cast<unsigned>(OC::CORO::kFrameSize), frames.high_water,
+         frames.capacity, stats.scheduler.resumes);
+  printf("%s\n", failures ? "FAILED" : "all tasks ran as sequenced");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""cv_file.py - Convert CSV frames into the SD player's block file format
+
+Each CSV line is one frame with up to 8 DAC codes (0-65535). The output is
+a 512-byte header followed by fixed-size blocks of interleaved little-endian
+uint16 frames, padded to whole blocks, as read by util::BlockPlayer
+(src/src/util/util_block_player.h).
+
+Examples:
+  # 4-channel CV sequence at 500 Hz on DAC channels 1-4
+  tools/cv_file.py seq.csv play.ocv --rate 500
+
+  # Mono 48 kHz waveform on DAC channel 5
+  tools/cv_file.py wave.csv play.ocv --rate 48000 --channels 4
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+MAGIC = 0x5643434F  # "OCCV"
+VERSION = 1
+HEADER_SIZE = 512
+MAX_CHANNELS = 8
+MAX_BLOCK_SIZE = 16384  # OC::PLAYER::kBufferSize
+
+
+def read_frames(path):
+    frames = []
+    with open(path, newline="") as f:
+        for row in csv.reader(f):
+            if not row or row[0].startswith("#"):
+                continue
+            frames.append([max(0, min(65535, int(float(v)))) for v in row])
+    return frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="CSV file, one frame per line")
+    parser.add_argument("output")
+    parser.add_argument("--rate", type=int, required=True, help="sample rate in Hz")
+    parser.add_argument("--channels", help="comma-separated DAC channel (0-7) per column, default 0,1,...")
+    parser.add_argument("--block-size", type=int, default=MAX_BLOCK_SIZE, help="bytes per block, multiple of 512")
+    args = parser.parse_args()
+
+    frames = read_frames(args.input)
+    if not frames:
+        sys.exit("no frames in input")
+    num_channels = max(len(frame) for frame in frames)
+    if num_channels > MAX_CHANNELS:
+        sys.exit(f"at most {MAX_CHANNELS} columns")
+    channels = [int(c) for c in args.channels.split(",")] if args.channels else list(range(num_channels))
+    if len(channels) != num_channels or any(not 0 <= c < MAX_CHANNELS for c in channels):
+        sys.exit(f"need {num_channels} DAC channels in 0-{MAX_CHANNELS - 1}")
+    if args.block_size % 512 or not 0 < args.block_size <= MAX_BLOCK_SIZE:
+        sys.exit(f"block size must be a multiple of 512 up to {MAX_BLOCK_SIZE}")
+
+    frame_format = "<%dH" % num_channels
+    frames_per_block = args.block_size // struct.calcsize(frame_format)
+
+    header = struct.pack("<IHHIIII8B", MAGIC, VERSION, num_channels, args.rate, len(frames),
+                         args.block_size, frames_per_block, *(channels + [0] * (MAX_CHANNELS - num_channels)))
+    with open(args.output, "wb") as out:
+        out.write(header.ljust(HEADER_SIZE, b"\0"))
+        for first in range(0, len(frames), frames_per_block):
+            block = b"".join(struct.pack(frame_format, *(frame + [0] * (num_channels - len(frame))))
+                             for frame in frames[first:first + frames_per_block])
+            out.write(block.ljust(args.block_size, b"\0"))
+
+    print(f"{len(frames)} frames x {num_channels} channels @ {args.rate} Hz, "
+          f"{frames_per_block} frames per {args.block_size}-byte block")
+
+
+if __name__ == "__main__":
+    main()
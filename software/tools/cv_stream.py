@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""cv_stream.py - Stream 8-channel CV to the module over USB serial
+
+Sends the packets described in src/src/OC_stream.h: a START with the sample
+rate, timestamped DATA blocks paced by the host clock, then a STOP.
+
+Examples:
+  # Eight slow sine LFOs at 1 kHz for 60 s
+  tools/cv_stream.py /dev/ttyACM0 --rate 1000 --seconds 60
+
+  # Play a CSV file, one frame per line with 8 DAC codes (0-65535)
+  tools/cv_stream.py /dev/ttyACM0 --rate 500 --csv automation.csv
+
+Send 's' on the serial monitor to see fill, jitter and drift correction.
+Requires pyserial.
+"""
+
+import argparse
+import csv
+import math
+import struct
+import sys
+import time
+
+import serial
+
+# Framing and packet types as in src/src/OC_packet.h
+SYNC = 0xA5
+PACKET_START = 1
+PACKET_DATA = 2
+PACKET_STOP = 3
+NUM_CHANNELS = 8  # DAC::kNumChannels, 8 per DAC8568
+MAX_BLOCK_FRAMES = 256
+
+
+def packet(packet_type, payload=b""):
+    return struct.pack("<BBH", SYNC, packet_type, len(payload)) + payload
+
+
+def lfo_frames(rate, seconds, num_channels):
+    for n in range(int(rate * seconds)):
+        t = n / rate
+        yield [int(32767.5 + 32767 * math.sin(2 * math.pi * 0.1 * (channel + 1) * t))
+               for channel in range(num_channels)]
+
+
+def csv_frames(path, num_channels):
+    with open(path, newline="") as f:
+        for row in csv.reader(f):
+            if not row or row[0].startswith("#"):
+                continue
+            values = [max(0, min(65535, int(float(v)))) for v in row[:num_channels]]
+            yield values + [0] * (num_channels - len(values))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port")
+    parser.add_argument("--rate", type=int, default=1000, help="sample rate in Hz")
+    parser.add_argument("--block", type=int, default=32, help="frames per packet")
+    parser.add_argument("--seconds", type=float, default=30.0, help="length of the LFO test signal")
+    parser.add_argument("--csv", help="play frames from a CSV file instead")
+    parser.add_argument("--channels", type=int, default=NUM_CHANNELS,
+                        help="channels per frame, must match the firmware's DAC channel count")
+    parser.add_argument("--lead", type=float, default=0.05, help="seconds to send ahead of playback")
+    args = parser.parse_args()
+
+    if not 0 < args.block <= MAX_BLOCK_FRAMES:
+        sys.exit(f"block must be 1..{MAX_BLOCK_FRAMES} frames")
+
+    if args.channels <= 0 or args.channels % 8:
+        sys.exit("channels must be a multiple of 8")
+
+    frames = csv_frames(args.csv, args.channels) if args.csv else lfo_frames(args.rate, args.seconds, args.channels)
+    frame_format = "<%dH" % args.channels
+
+    with serial.Serial(args.port) as port:
+        port.write(packet(PACKET_START, struct.pack("<I", args.rate)))
+        start = time.monotonic()
+        timestamp = 0
+        done = False
+        try:
+            while not done:
+                block = []
+                for values in frames:
+                    block.append(struct.pack(frame_format, *values))
+                    if len(block) == args.block:
+                        break
+                else:
+                    done = True
+                if not block:
+                    break
+
+                # Pace by the host clock; the module trims its playback rate to match
+                delay = start + timestamp / args.rate - args.lead - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                port.write(packet(PACKET_DATA, struct.pack("<I", timestamp) + b"".join(block)))
+                timestamp += len(block)
+        except KeyboardInterrupt:
+            pass
+        port.write(packet(PACKET_STOP))
+
+    print(f"Sent {timestamp} frames")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,188 @@
+// cv_stream_sim.cpp - Host simulation of the CV stream jitter buffer
+//
+// Builds OC_stream.cpp and sends it a 1 kHz stream in 32-frame DATA blocks,
+// as tools/cv_stream.py would, for two minutes per scenario. The host clock
+// runs +100 or -300 ppm off the Teensy clock, and blocks arrive with
+// exponentially distributed delays (mean 1 or 3 ms), kept in order as on a
+// serial port. Packets are parsed at their arrival time, and the core tick
+// runs at its real rate in between.
+//
+// For each scenario it reports the jitter estimate, target depth, fill and
+// rate trim. It fails if the buffer underruns or overruns once playing,
+// frames are lost, repeated or played out of order, or the trim averaged
+// over the last minute isn't within 50 ppm of the host clock offset. The
+// trim settles with a 30 s time constant (kCorrectionSeconds) and follows
+// the target as the jitter estimate moves it, so it is never exact.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -Itools/host -o cv_stream_sim tools/cv_stream_sim.cpp
+//       src/src/OC_stream.cpp src/src/OC_DAC.cpp tools/host/DAC8568_emulated.cpp
+//   ./cv_stream_sim [seed]
+
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "../src/src/OC_core.h"
+#include "../src/src/OC_DAC.h"
+#include "../src/src/OC_events.h"
+#include "../src/src/OC_packet.h"
+#include "../src/src/OC_stream.h"
+
+using namespace OC;
+
+// The sim reads underruns from the stream stats
+bool EVENTS::Post(EVENTS::Type, uint8_t, uint16_t) { return true; }
+
+static constexpr uint32_t kSampleRate = 1000;
+static constexpr size_t kBlockFrames = 32;
+static constexpr double kSeconds = 120;
+static constexpr double kSettledSeconds = 60;  // Trim averaged over the end
+static constexpr double kMaxTrimErrorPpm = 50;
+
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("  FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+struct Packet {
+  uint64_t arrival;  // Teensy cycles
+  std::vector<uint8_t> bytes;
+};
+
+static void AppendU16(std::vector<uint8_t> &bytes, uint32_t value) {
+  bytes.push_back(value & 0xFF);
+  bytes.push_back((value >> 8) & 0xFF);
+}
+
+static void AppendU32(std::vector<uint8_t> &bytes, uint32_t value) {
+  AppendU16(bytes, value & 0xFFFF);
+  AppendU16(bytes, value >> 16);
+}
+
+static std::vector<uint8_t> MakePacket(PACKET::Type type, const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> bytes = { PACKET::kSync, type };
+  AppendU16(bytes, payload.size());
+  bytes.insert(bytes.end(), payload.begin(), payload.end());
+  return bytes;
+}
+
+// Frame n carries its own number in channels 0 and 1
+static std::vector<uint8_t> MakeBlock(uint32_t first) {
+  std::vector<uint8_t> payload;
+  AppendU32(payload, first);
+  for (uint32_t n = first; n < first + kBlockFrames; ++n) {
+    for (size_t channel = 0; channel < DAC::kNumChannels; ++channel)
+      AppendU16(payload, channel == 0 ? n & 0xFFFF : channel == 1 ? n >> 16 : channel * 0x1000);
+  }
+  return MakePacket(PACKET::STREAM_DATA, payload);
+}
+
+static void Deliver(const Packet &packet) {
+  ARM_DWT_CYCCNT = static_cast<uint32_t>(packet.arrival);
+  for (uint8_t byte : packet.bytes) {
+    if (!STREAM::Parse(byte)) {
+      Check(false, "packet byte left to the debug commands");
+      return;
+    }
+  }
+}
+
+static void Run(std::mt19937 &rng, int32_t host_ppm, double mean_delay_ms) {
+  printf("host clock %+d ppm, exponential delay mean %.0f ms\n", host_ppm, mean_delay_ms);
+  STREAM::Init();
+
+  // Blocks leave the host as its clock reaches their end, and the serial
+  // port keeps them in order
+  std::exponential_distribution<double> delay(1.0 / (mean_delay_ms * 1e-3));
+  const double host_rate = kSampleRate * (1 + host_ppm * 1e-6);
+  const size_t num_blocks = static_cast<size_t>(kSeconds * kSampleRate / kBlockFrames);
+  std::vector<Packet> packets;
+  std::vector<uint8_t> start;
+  AppendU32(start, kSampleRate);
+  packets.push_back({ 0, MakePacket(PACKET::STREAM_START, start) });
+  uint64_t last_arrival = 0;
+  for (size_t block = 0; block < num_blocks; ++block) {
+    const double sent = (block + 1) * kBlockFrames / host_rate;
+    uint64_t arrival = static_cast<uint64_t>((sent + delay(rng)) * F_CPU);
+    if (arrival < last_arrival)
+      arrival = last_arrival;
+    last_arrival = arrival;
+    packets.push_back({ arrival, MakeBlock(block * kBlockFrames) });
+  }
+
+  // Run until the tick after the last block arrived
+  const uint64_t end_tick = last_arrival / CORE::kCyclesPerTick + 2;
+  const uint64_t settled_tick = end_tick - static_cast<uint64_t>(kSettledSeconds * CORE::kTickRate);
+  size_t next_packet = 0;
+  uint32_t last_played = 0;
+  uint32_t played = 0;
+  uint32_t out_of_order = 0;
+  uint64_t first_tick = 0;
+  double trim_sum = 0, fill_sum = 0;
+  uint64_t settled_ticks = 0;
+  int32_t trim_min = INT32_MAX, trim_max = INT32_MIN;
+  for (uint64_t tick = 0; tick < end_tick; ++tick) {
+    const uint64_t now = tick * CORE::kCyclesPerTick;
+    while (next_packet < packets.size() && packets[next_packet].arrival <= now)
+      Deliver(packets[next_packet++]);
+
+    ARM_DWT_CYCCNT = static_cast<uint32_t>(now);
+    STREAM::Tick();
+    const uint32_t frames = STREAM::stats().frames;
+    if (frames != played) {
+      const uint32_t n = DAC::value(0) | (DAC::value(1) << 16);
+      if (!played)
+        first_tick = tick;
+      else if (n != last_played + 1)
+        ++out_of_order;
+      last_played = n;
+      played = frames;
+    }
+
+    if (tick >= settled_tick) {
+      const int32_t trim = STREAM::correction_ppm();
+      trim_sum += trim;
+      fill_sum += STREAM::fill();
+      trim_min = trim < trim_min ? trim : trim_min;
+      trim_max = trim > trim_max ? trim : trim_max;
+      ++settled_ticks;
+    }
+  }
+
+  const STREAM::Stats stats = STREAM::stats();
+  const util::RunningStats &arrival = STREAM::arrival();
+  const double trim = trim_sum / settled_ticks;
+  printf("  %u blocks, %u frames played, playing after %.1f ms\n", stats.blocks, stats.frames,
+         first_tick * 1000.0 / CORE::kTickRate);
+  printf("  arrival deviation sd %.2f ms max %.2f ms, jitter estimate %.2f ms\n",
+         arrival.stddev() / F_CPU * 1000, static_cast<double>(arrival.max()) / F_CPU * 1000,
+         STREAM::jitter() / 1000);
+  printf("  target %u frames, mean fill %.1f over the last %.0f s\n", (unsigned)STREAM::target(),
+         fill_sum / settled_ticks, kSettledSeconds);
+  printf("  trim %.1f ppm (%d to %d) over the last %.0f s\n", trim, trim_min, trim_max, kSettledSeconds);
+  printf("  underruns %u skipped %u overruns %u lost %u late %u errors %u out of order %u\n",
+         stats.underruns, stats.skipped, stats.overruns, stats.lost, stats.late, stats.errors, out_of_order);
+
+  Check(STREAM::state() == STREAM::STATE_PLAYING, "still playing");
+  Check(!stats.underruns, "no underruns");
+  Check(!stats.overruns && !stats.lost && !stats.late && !stats.errors, "every frame buffered");
+  Check(!out_of_order, "frames played in order");
+  Check(stats.blocks == num_blocks, "every block received");
+  Check(fabs(trim - host_ppm) < kMaxTrimErrorPpm, "trim settles at the host clock offset");
+}
+
+int main(int argc, char **argv) {
+  std::mt19937 rng(argc > 1 ? atoi(argv[1]) : 1);
+  DAC::Init();
+  for (int32_t host_ppm : { 100, -300 }) {
+    for (double mean_delay_ms : { 1.0, 3.0 })
+      Run(rng, host_ppm, mean_delay_ms);
+  }
+  printf("%s\n", failures ? "FAILED" : "no underruns, trim follows the host clock");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// dither_error.cpp - Host check of the sigma-delta DAC requantizer
+//
+// Runs util::SigmaDelta on fine (16.8) values and reports how far the output
+// averaged over a window is from the fine value, in 16-bit LSBs, compared to
+// plain truncation. Also follows a slow ramp (one LSB per 4096 updates) the
+// way a long envelope or a fine-tune sweep would look.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -o dither_error tools/dither_error.cpp && ./dither_error
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/src/util/util_dither.h"
+
+static constexpr int kFracBits = util::SigmaDelta::kFracBits;
+static constexpr double kOne = 1 << kFracBits;
+
+enum Mode { MODE_TRUNCATE, MODE_FIRST_ORDER, MODE_SECOND_ORDER, MODE_LAST };
+static const char *const kModeNames[] = { "truncate", "1st order", "2nd order" };
+
+static uint16_t Next(util::SigmaDelta &modulator, Mode mode, uint32_t value) {
+  switch (mode) {
+    case MODE_FIRST_ORDER: return modulator.FirstOrder(value);
+    case MODE_SECOND_ORDER: return modulator.SecondOrder(value);
+    default: return value >> kFracBits;
+  }
+}
+
+// Worst-case error of the windowed average for static fine values
+static void StaticError(size_t window) {
+  static constexpr int kValues = 2000;
+  printf("  window %4u:", (unsigned)window);
+  for (int mode = 0; mode < MODE_LAST; ++mode) {
+    srand(1);
+    double max_error = 0.0;
+    for (int n = 0; n < kValues; ++n) {
+      uint32_t value = (1000 + rand() % 60000) * (1 << kFracBits) + rand() % (1 << kFracBits);
+      util::SigmaDelta modulator;
+      modulator.Init();
+      // Let the second order loop settle before measuring
+      for (size_t i = 0; i < 16; ++i)
+        Next(modulator, static_cast<Mode>(mode), value);
+      double sum = 0.0;
+      for (size_t i = 0; i < window; ++i)
+        sum += Next(modulator, static_cast<Mode>(mode), value);
+      double error = fabs(sum / window - value / kOne);
+      if (error > max_error)
+        max_error = error;
+    }
+    printf("  %s %.4f", kModeNames[mode], max_error);
+  }
+  printf(" LSB\n");
+}
+
+// RMS error of a moving average against a ramp of one LSB per `ticks_per_lsb`
+static void RampError(size_t ticks_per_lsb, size_t window) {
+  static constexpr size_t kSteps = 16;
+  const size_t length = kSteps * ticks_per_lsb;
+  printf("  ramp 1 LSB/%u, window %u:", (unsigned)ticks_per_lsb, (unsigned)window);
+  for (int mode = 0; mode < MODE_LAST; ++mode) {
+    util::SigmaDelta modulator;
+    modulator.Init();
+    const uint32_t start = 32768u << kFracBits;
+    double history[4096] = { 0 };
+    double sum = 0.0, squares = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i) {
+      uint32_t value = start + static_cast<uint32_t>(i * kOne / ticks_per_lsb);
+      double out = Next(modulator, static_cast<Mode>(mode), value);
+      sum += out - history[i % window];
+      history[i % window] = out;
+      if (i >= window) {
+        // Moving average is centred half a window back
+        double ideal = (start + (i - (window - 1) / 2.0) * kOne / ticks_per_lsb) / kOne;
+        double error = sum / window - ideal;
+        squares += error * error;
+        ++count;
+      }
+    }
+    printf("  %s %.4f", kModeNames[mode], sqrt(squares / count));
+  }
+  printf(" LSB rms\n");
+}
+
+int main() {
+  printf("Averaged error, static values:\n");
+  static const size_t kWindows[] = { 16, 64, 256, 1024 };
+  for (size_t window : kWindows)
+    StaticError(window);
+
+  printf("Averaged error, slow ramp:\n");
+  RampError(4096, 64);
+  RampError(4096, 256);
+  return 0;
+}
@@ -0,0 +1,159 @@
+// event_bus_stress.cpp - Multithreaded host stress test of the event bus
+//
+// Runs OC::EVENTS with several producer threads posting bursts of events
+// (standing in for ISRs at different priorities, which can preempt each other
+// between any two instructions) and one consumer thread draining in batches
+// of random size. On a single core the threads are still preempted at
+// arbitrary points, which is the case that matters on the Teensy. Each
+// producer numbers its events and remembers which posts were accepted; the
+// consumer checks that it gets exactly those, in order per producer, with
+// nothing lost or duplicated. The bus counters have to add up to the same
+// totals. A second run drains slowly so the queue overflows.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -pthread -Itools/host -o event_bus_stress
+//       tools/event_bus_stress.cpp src/src/OC_events.cpp
+//   ./event_bus_stress [producers] [events_per_producer]
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/src/OC_events.h"
+
+using namespace OC;
+
+struct Producer {
+  std::vector<uint32_t> accepted;
+  uint32_t rejected = 0;
+};
+
+struct Result {
+  uint64_t received = 0;
+  uint64_t rejected = 0;
+  uint64_t errors = 0;
+  uint32_t max_batch = 0;
+};
+
+static Result Run(size_t num_producers, uint32_t events, int drain_pause_us) {
+  EVENTS::Init();
+  std::vector<Producer> producers(num_producers);
+  std::vector<std::vector<uint16_t>> received(num_producers);
+  std::atomic<size_t> done{0};
+  std::atomic<bool> go{false};
+
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < num_producers; ++p) {
+    threads.emplace_back([&, p] {
+      Producer &producer = producers[p];
+      const EVENTS::Type type = static_cast<EVENTS::Type>(p % EVENTS::EVENT_LAST);
+      std::mt19937 rng(p + 2);
+      while (!go.load())
+        std::this_thread::yield();
+      for (uint32_t seq = 0; seq < events;) {
+        for (uint32_t burst = 1 + rng() % 8; burst && seq < events; --burst, ++seq) {
+          if (EVENTS::Post(type, p, seq & 0xFFFF))
+            producer.accepted.push_back(seq);
+          else
+            ++producer.rejected;
+        }
+        std::this_thread::yield();
+      }
+      done.fetch_add(1);
+    });
+  }
+
+  Result result;
+  std::thread consumer([&] {
+    std::mt19937 rng(1);
+    EVENTS::Event batch[32];
+    go.store(true);
+    for (;;) {
+      // Producers finished before this drain started leave nothing behind it
+      bool last = done.load() == num_producers;
+      size_t count;
+      while ((count = EVENTS::Drain(batch, 1 + rng() % 32)) > 0) {
+        if (count > result.max_batch)
+          result.max_batch = count;
+        for (size_t i = 0; i < count; ++i) {
+          if (batch[i].source >= num_producers) {
+            ++result.errors;
+            continue;
+          }
+          received[batch[i].source].push_back(batch[i].value);
+          ++result.received;
+        }
+      }
+      if (last)
+        break;
+      if (drain_pause_us)
+        std::this_thread::sleep_for(std::chrono::microseconds(drain_pause_us));
+    }
+  });
+
+  for (auto &thread : threads)
+    thread.join();
+  consumer.join();
+
+  uint64_t accepted = 0;
+  for (size_t p = 0; p < num_producers; ++p) {
+    const Producer &producer = producers[p];
+    accepted += producer.accepted.size();
+    result.rejected += producer.rejected;
+    if (received[p].size() != producer.accepted.size()) {
+      printf("  producer %zu: %zu received, %zu accepted\n", p, received[p].size(), producer.accepted.size());
+      ++result.errors;
+      continue;
+    }
+    for (size_t i = 0; i < received[p].size(); ++i) {
+      if (received[p][i] != (producer.accepted[i] & 0xFFFF)) {
+        printf("  producer %zu: event %zu out of order\n", p, i);
+        ++result.errors;
+        break;
+      }
+    }
+  }
+
+  EVENTS::Stats stats = EVENTS::stats();
+  uint64_t type_overflows = 0;
+  for (size_t type = 0; type < EVENTS::EVENT_LAST; ++type)
+    type_overflows += EVENTS::overflows(static_cast<EVENTS::Type>(type));
+  if (stats.posted != accepted || stats.drained != result.received || stats.overflows != result.rejected ||
+      type_overflows != result.rejected) {
+    printf("  counters: posted=%u drained=%u overflows=%u (by type %llu), expected %llu/%llu/%llu\n",
+           stats.posted, stats.drained, stats.overflows, static_cast<unsigned long long>(type_overflows),
+           static_cast<unsigned long long>(accepted), static_cast<unsigned long long>(result.received),
+           static_cast<unsigned long long>(result.rejected));
+    ++result.errors;
+  }
+  return result;
+}
+
+static void Report(const char *label, const Result &result) {
+  printf("%-10s %10llu received, %10llu overflowed, largest batch %2u: %llu errors\n", label,
+         static_cast<unsigned long long>(result.received), static_cast<unsigned long long>(result.rejected),
+         result.max_batch, static_cast<unsigned long long>(result.errors));
+}
+
+int main(int argc, char **argv) {
+  size_t producers = argc > 1 ? atoi(argv[1]) : 4;
+  uint32_t events = argc > 2 ? atoi(argv[2]) : 100000;
+  if (producers < 1 || producers > 255) {
+    fprintf(stderr, "1-255 producers\n");
+    return 1;
+  }
+
+  Result fast = Run(producers, events, 0);
+  Report("fast", fast);
+  Result slow = Run(producers, events / 10, 50);
+  Report("slow", slow);
+  if (!slow.rejected)
+    printf("warning: the slow consumer never let the queue overflow\n");
+
+  bool ok = !fast.errors && !slow.errors;
+  printf("%s\n", ok ? "all events delivered in order" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// fixed_math_test.cpp - Host accuracy check and benchmark for util_math.h
+//
+// Compares every fixed-point function against libm in double precision:
+// - exp2_q16 and log2_q16 over every Q16.16 input in their useful range, and
+//   log2_q16 and reciprocal_q32 at every power of two and its neighbours
+// - sin_q15 and the rest at 2^24 evenly spread and random inputs
+// and fails if any error exceeds the bound documented in util_math.h. Then
+// times each function against the float libm call or division it replaces.
+// Host numbers are only a relative measure; the 'f' debug command reports
+// cycles per call on the Teensy itself.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -o fixed_math_test tools/fixed_math_test.cpp
+//   ./fixed_math_test
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "../src/src/util/util_math.h"
+
+static int failures = 0;
+volatile uint32_t benchmark_sink;
+
+static void Report(const char *name, double error, double bound, const char *unit) {
+  const bool ok = error <= bound;
+  printf("  %-16s max error %10.3g %-4s (bound %g)%s\n", name, error, unit, bound,
+         ok ? "" : "  FAILED");
+  failures += !ok;
+}
+
+static double ExactSin(uint32_t phase) {
+  return 32767.0 * sin(phase * (2 * M_PI / 4294967296.0));
+}
+
+static double ExactScaleExp2(uint32_t value, int32_t octaves) {
+  return value * exp2(octaves / 65536.0);
+}
+
+static std::vector<uint32_t> Inputs(std::mt19937 &rng) {
+  std::vector<uint32_t> inputs;
+  for (uint32_t i = 0; i < (1 << 23); ++i)
+    inputs.push_back(i << 9);
+  for (uint32_t i = 0; i < (1 << 23); ++i)
+    inputs.push_back(rng());
+  for (uint32_t bit = 0; bit < 32; ++bit) {
+    for (int32_t offset = -2; offset <= 2; ++offset)
+      inputs.push_back((1UL << bit) + offset);
+  }
+  return inputs;
+}
+
+static void CheckAccuracy() {
+  std::mt19937 rng(1);
+  const std::vector<uint32_t> inputs = Inputs(rng);
+  printf("accuracy against libm\n");
+
+  double sin_error = 0, cos_error = 0;
+  for (uint32_t phase : inputs) {
+    sin_error = fmax(sin_error, fabs(util::sin_q15(phase) - ExactSin(phase)));
+    cos_error = fmax(cos_error, fabs(util::cos_q15(phase) - ExactSin(phase + 0x40000000UL)));
+  }
+  Report("sin_q15", sin_error, 1, "LSB");
+  Report("cos_q15", cos_error, 1, "LSB");
+
+  // Relative error beyond the rounding step once the output has enough bits
+  // to show it, otherwise the rounding step
+  double exp2_relative = 0, exp2_lsb = 0;
+  for (int32_t octaves = -17 * 65536; octaves < 16 * 65536; ++octaves) {
+    const double exact = exp2(octaves / 65536.0) * 65536.0;
+    const double error = fabs(util::exp2_q16(octaves) - exact);
+    if (exact >= 1 << 21)
+      exp2_relative = fmax(exp2_relative, (error - 0.5) / exact);
+    else
+      exp2_lsb = fmax(exp2_lsb, error - 1e-6 * exact);
+  }
+  Report("exp2_q16", exp2_relative, 1e-6, "rel");
+  Report("exp2_q16 small", exp2_lsb, 0.5, "LSB");
+  if (util::exp2_q16(16 * 65536) != UINT32_MAX || util::exp2_q16(INT32_MIN) != 0) {
+    printf("  exp2_q16 doesn't saturate  FAILED\n");
+    ++failures;
+  }
+
+  double scale_relative = 0;
+  for (size_t i = 0; i < inputs.size(); i += 4) {
+    const uint32_t value = inputs[i] | 0x80000000UL;  // Full precision values
+    const int32_t octaves = -static_cast<int32_t>(inputs[i + 1] % (8 << 16));
+    const double exact = ExactScaleExp2(value, octaves);
+    scale_relative = fmax(scale_relative, (fabs(util::scale_exp2(value, octaves) - exact) - 0.5) / exact);
+  }
+  Report("scale_exp2", scale_relative, 1e-6, "rel");
+
+  double log2_error = 0;
+  for (uint32_t x = 1; x < (1UL << 24); ++x)
+    log2_error = fmax(log2_error, fabs(util::log2_q16(x) - 65536.0 * log2(x / 65536.0)));
+  for (uint32_t x : inputs) {
+    if (x)
+      log2_error = fmax(log2_error, fabs(util::log2_q16(x) - 65536.0 * log2(x / 65536.0)));
+  }
+  Report("log2_q16", log2_error, 1, "LSB");
+
+  double reciprocal_error = 0;
+  for (uint32_t x = 2; x < (1UL << 20); ++x)
+    reciprocal_error = fmax(reciprocal_error, fabs(util::reciprocal_q32(x) - round(4294967296.0 / x)));
+  for (uint32_t x : inputs) {
+    if (x >= 2)
+      reciprocal_error = fmax(reciprocal_error, fabs(util::reciprocal_q32(x) - round(4294967296.0 / x)));
+  }
+  Report("reciprocal_q32", reciprocal_error, 1, "LSB");
+}
+
+template <typename Function>
+static double NsPerCall(const std::vector<uint32_t> &inputs, Function function) {
+  uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < 8; ++pass) {
+    for (uint32_t input : inputs)
+      sink += function(input);
+  }
+  auto end = std::chrono::steady_clock::now();
+  benchmark_sink = sink;
+  return std::chrono::duration<double, std::nano>(end - start).count() / (8 * inputs.size());
+}
+
+static void Benchmark() {
+  std::mt19937 rng(2);
+  std::vector<uint32_t> inputs(1 << 16);
+  for (uint32_t &input : inputs)
+    input = rng() | 2;
+  printf("ns per call, fixed point vs float libm\n");
+
+  const double sin_fixed = NsPerCall(inputs, [](uint32_t x) { return util::sin_q15(x); });
+  const double sin_libm = NsPerCall(inputs, [](uint32_t x) {
+    return static_cast<int32_t>(32767.f * sinf(x * (6.28318531f / 4294967296.f)));
+  });
+  printf("  sin       %6.2f vs %6.2f (sinf)\n", sin_fixed, sin_libm);
+
+  const double exp2_fixed = NsPerCall(inputs, [](uint32_t x) {
+    return util::exp2_q16(static_cast<int32_t>(x) >> 12);
+  });
+  const double exp2_libm = NsPerCall(inputs, [](uint32_t x) {
+    return static_cast<uint32_t>(65536.f * exp2f((static_cast<int32_t>(x) >> 12) / 65536.f));
+  });
+  printf("  exp2      %6.2f vs %6.2f (exp2f)\n", exp2_fixed, exp2_libm);
+
+  const double log2_fixed = NsPerCall(inputs, [](uint32_t x) { return util::log2_q16(x); });
+  const double log2_libm = NsPerCall(inputs, [](uint32_t x) {
+    return static_cast<int32_t>(65536.f * log2f(x / 65536.f));
+  });
+  printf("  log2      %6.2f vs %6.2f (log2f)\n", log2_fixed, log2_libm);
+
+  const double reciprocal_fixed = NsPerCall(inputs, [](uint32_t x) { return util::reciprocal_q32(x); });
+  const double reciprocal_divide = NsPerCall(inputs, [](uint32_t x) {
+    return static_cast<uint32_t>((1ULL << 32) / x);
+  });
+  // x86 divides 64-bit integers in hardware; the Cortex-M7 calls a library
+  // routine
+  printf("  1/x       %6.2f vs %6.2f (64-bit division)\n", reciprocal_fixed, reciprocal_divide);
+}
+
+int main() {
+  CheckAccuracy();
+  Benchmark();
+  printf("%s\n", failures ? "FAILED" : "every function within its documented bound");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+// Arduino.h - Minimal host stand-in for building firmware modules in tools/
+//
+// Only covers what the modules built by the host tools use. Interrupt masking
+// is a no-op, the tools are single-threaded where firmware state is shared.
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef F_CPU
+#define F_CPU 600000000
+#endif
+
+// The host tools don't record a trace, so they needn't link OC_trace.cpp
+#ifndef OC_TRACE
+#define OC_TRACE 0
+#endif
+
+#define FASTRUN
+#define DMAMEM
+#define PROGMEM
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define RISING 3
+#define FALLING 2
+
+// Advanced by the emulated peripherals
+inline volatile uint32_t ARM_DWT_CYCCNT = 0;
+
+// Output pin levels, for emulated devices that look at /CS or D/C
+inline uint8_t host_pins[64];
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWriteFast(uint8_t pin, uint8_t value) { host_pins[pin] = value; }
+inline void digitalWrite(uint8_t pin, uint8_t value) { host_pins[pin] = value; }
+inline void delay(uint32_t) {}
+
+// Pin interrupts are never raised; tools call the handlers themselves
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+
+// Follows the emulated cycle counter (so it wraps after ~7 s)
+inline uint32_t micros() { return ARM_DWT_CYCCNT / (F_CPU / 1000000); }
+
+#endif // HOST_ARDUINO_H_
@@ -0,0 +1,92 @@
+// DAC8568_emulated.cpp - Host replacement for drivers/DAC8568_driver.cpp
+//
+// Implements the DAC8568_Driver interface on top of DAC8568Model devices and
+// advances ARM_DWT_CYCCNT by the modelled transfer time, with transfers on
+// different buses overlapping as they do in the LPSPI FIFOs.
+
+#include <Arduino.h>
+#include "../../src/src/drivers/DAC8568_driver.h"
+#include "dac8568_model.h"
+
+DAC8568Model dac8568_models[DAC8568_Driver::kNumDevices];
+
+// 32 clocks plus transaction and /SYNC overhead
+static constexpr uint32_t kWordCycles =
+    static_cast<uint32_t>(32.0 * F_CPU / DAC_SPI_CLOCK) + F_CPU / 4000000;
+
+static const uint8_t device_bus[] = { DAC_SPI_BUS, DAC1_SPI_BUS, DAC2_SPI_BUS };
+static DAC8568_Driver::DeviceStats device_stats[DAC8568_Driver::kNumDevices];
+
+/*static*/
+void DAC8568_Driver::Init() {
+  for (size_t device = 0; device < kNumDevices; ++device) {
+    Write(device, CMD_RESET, 0x00, 0x0000);
+    Write(device, CMD_REFERENCE, 0x00, 0x0001);
+    Write(device, CMD_POWER, 0x00, 0x0000);
+  }
+  ResetStats();
+}
+
+/*static*/
+bool DAC8568_Driver::ready() {
+  return true;
+}
+
+/*static*/
+uint8_t DAC8568_Driver::bus(size_t device) {
+  return device_bus[device];
+}
+
+/*static*/
+uint32_t DAC8568_Driver::bus_devices(size_t device) {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < kNumDevices; ++i) {
+    if (device_bus[i] == device_bus[device])
+      mask |= 1UL << i;
+  }
+  return mask;
+}
+
+/*static*/
+void DAC8568_Driver::Write(size_t device, uint8_t command, uint8_t address, uint16_t data) {
+  WriteWord(device, Pack(command, address, data));
+}
+
+/*static*/
+void DAC8568_Driver::WriteWord(size_t device, uint32_t word) {
+  dac8568_models[device].Write(word);
+  ARM_DWT_CYCCNT += kWordCycles;
+  ++device_stats[device].words;
+  device_stats[device].busy_cycles += kWordCycles;
+}
+
+/*static*/
+void DAC8568_Driver::WriteParallel(const uint32_t *words, uint32_t device_mask) {
+  // Same grouping as the LPSPI implementation: one word per bus per round
+  uint32_t pending = device_mask;
+  while (pending) {
+    uint32_t round_buses = 0;
+    for (uint32_t candidates = pending; candidates; candidates &= candidates - 1) {
+      size_t device = __builtin_ctz(candidates);
+      if (round_buses & (1UL << device_bus[device]))
+        continue;
+      round_buses |= 1UL << device_bus[device];
+      pending &= ~(1UL << device);
+      dac8568_models[device].Write(words[device]);
+      ++device_stats[device].words;
+      device_stats[device].busy_cycles += kWordCycles;
+    }
+    ARM_DWT_CYCCNT += kWordCycles;
+  }
+}
+
+/*static*/
+DAC8568_Driver::DeviceStats DAC8568_Driver::stats(size_t device) {
+  return device_stats[device];
+}
+
+/*static*/
+void DAC8568_Driver::ResetStats() {
+  for (auto &stats : device_stats)
+    stats = { 0, 0 };
+}
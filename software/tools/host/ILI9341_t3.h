@@ -0,0 +1,30 @@
+// ILI9341_t3.h - Host stand-in for the ILI9341_t3 library
+//
+// The driver only uses the library for the controller init, rotation and the
+// static border, which the host tools don't check. Pages and panel slices go
+// through SPI.h and can be decoded with ili9341_model.h.
+
+#ifndef HOST_ILI9341_T3_H_
+#define HOST_ILI9341_T3_H_
+
+#include "Arduino.h"
+
+#define ILI9341_BLACK 0x0000
+#define ILI9341_WHITE 0xFFFF
+#define ILI9341_DARKGREY 0x7BEF
+
+#define ILI9341_CASET 0x2A
+#define ILI9341_PASET 0x2B
+#define ILI9341_RAMWR 0x2C
+
+class ILI9341_t3 {
+public:
+  ILI9341_t3(uint8_t, uint8_t, uint8_t = 255) {}
+  void begin() {}
+  void setRotation(uint8_t) {}
+  void fillScreen(uint16_t) {}
+  void fillRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+  void drawRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+};
+
+#endif // HOST_ILI9341_T3_H_
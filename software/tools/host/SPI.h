@@ -0,0 +1,103 @@
+// SPI.h - Host stand-in for the Teensy SPI library
+//
+// Every byte clocked out is passed to the attached device callback, and
+// ARM_DWT_CYCCNT advances by the transfer time at the transaction's clock.
+// Single-byte transfers return what the optional reader callback supplies.
+// Asynchronous (DMA) transfers complete before transfer() returns, so the
+// EventResponder fires from inside the call, as an immediate responder would
+// from the DMA interrupt.
+
+#ifndef HOST_SPI_H_
+#define HOST_SPI_H_
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class EventResponder;
+typedef EventResponder &EventResponderRef;
+
+class EventResponder {
+public:
+  typedef void (*Function)(EventResponderRef);
+
+  void attachImmediate(Function function) { function_ = function; }
+  void triggerEvent() {
+    if (function_)
+      function_(*this);
+  }
+
+private:
+  Function function_ = nullptr;
+};
+
+class SPISettings {
+public:
+  SPISettings() {}
+  SPISettings(uint32_t clock, uint8_t, uint8_t) : clock(clock) {}
+  uint32_t clock = 4000000;
+};
+
+class SPIClass {
+public:
+  typedef void (*Device)(uint8_t byte);
+  typedef uint8_t (*Reader)();
+
+  // Receives every byte written while a transaction is open
+  Device device = nullptr;
+  // Supplies the byte read back (MISO) by transfer(uint8_t)
+  Reader reader = nullptr;
+  uint32_t bytes = 0;
+
+  void begin() {}
+  void beginTransaction(SPISettings settings) {
+    byte_cycles_ = 8.0 * F_CPU / settings.clock;
+    in_transaction_ = true;
+  }
+  void endTransaction() { in_transaction_ = false; }
+
+  uint8_t transfer(uint8_t data) {
+    Clock(data);
+    return reader ? reader() : 0;
+  }
+  uint16_t transfer16(uint16_t data) {
+    Clock(data >> 8);
+    Clock(data & 0xFF);
+    return 0;
+  }
+  void transfer(void *buf, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+      Clock(static_cast<uint8_t *>(buf)[i]);
+  }
+  bool transfer(const void *buf, void *, size_t count, EventResponderRef event) {
+    for (size_t i = 0; i < count; ++i)
+      Clock(static_cast<const uint8_t *>(buf)[i]);
+    event.triggerEvent();
+    return true;
+  }
+
+  bool in_transaction() const { return in_transaction_; }
+
+private:
+  double byte_cycles_ = 0.0;
+  double cycles_ = 0.0;
+  bool in_transaction_ = false;
+
+  void Clock(uint8_t data) {
+    ++bytes;
+    cycles_ += byte_cycles_;
+    uint32_t whole = static_cast<uint32_t>(cycles_);
+    ARM_DWT_CYCCNT += whole;
+    cycles_ -= whole;
+    if (device)
+      device(data);
+  }
+};
+
+inline SPIClass SPI, SPI1, SPI2;
+
+#endif // HOST_SPI_H_
@@ -0,0 +1,74 @@
+// dac8568_model.h - Behavioural model of a TI DAC8568 for host tools
+//
+// Decodes 32-bit frames the way the device does (see
+// DAC8568_Technical_Reference.md) and keeps the input and DAC registers, so
+// tools can check what the outputs would actually be.
+
+#ifndef HOST_DAC8568_MODEL_H_
+#define HOST_DAC8568_MODEL_H_
+
+#include <stdint.h>
+
+class DAC8568Model {
+public:
+  static constexpr int kNumChannels = 8;
+
+  void Reset() {
+    for (int i = 0; i < kNumChannels; ++i)
+      input_[i] = dac_[i] = 0;
+    reference_ = false;
+    powered_down_ = 0;
+  }
+
+  void Write(uint32_t word) {
+    ++words_;
+    uint8_t command = (word >> 24) & 0x0F;
+    uint8_t address = (word >> 20) & 0x0F;
+    uint16_t data = (word >> 4) & 0xFFFF;
+    switch (command) {
+      case 0x00: SetInput(address, data); break;
+      case 0x01: Update(address); break;
+      case 0x02: SetInput(address, data); Update(0x0F); break;
+      case 0x03: SetInput(address, data); Update(address); break;
+      case 0x04: PowerControl(data); break;
+      case 0x07: Reset(); break;
+      case 0x08: reference_ = data & 1; break;
+      default: break;
+    }
+  }
+
+  uint16_t output(int channel) const { return dac_[channel]; }
+  bool reference() const { return reference_; }
+  bool powered_up() const { return !powered_down_; }
+  uint32_t words() const { return words_; }
+
+private:
+  uint16_t input_[kNumChannels] = { 0 };
+  uint16_t dac_[kNumChannels] = { 0 };
+  bool reference_ = false;
+  uint8_t powered_down_ = 0xFF;
+  uint32_t words_ = 0;
+
+  void SetInput(uint8_t address, uint16_t data) {
+    for (int i = 0; i < kNumChannels; ++i) {
+      if (address == 0x0F || address == i)
+        input_[i] = data;
+    }
+  }
+
+  // Control data in the same field as the driver packs it (Pack() shifts
+  // by 4): bits 9-8 select the mode (00 = power up), bits 7-0 the channels
+  void PowerControl(uint16_t data) {
+    uint8_t mode = (data >> 8) & 0x03;
+    powered_down_ = mode ? (powered_down_ | (data & 0xFF)) : 0;
+  }
+
+  void Update(uint8_t address) {
+    for (int i = 0; i < kNumChannels; ++i) {
+      if (address == 0x0F || address == i)
+        dac_[i] = input_[i];
+    }
+  }
+};
+
+#endif // HOST_DAC8568_MODEL_H_
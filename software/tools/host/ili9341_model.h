@@ -0,0 +1,141 @@
+// ili9341_model.h - Behavioural model of an ILI9341 TFT for host tools
+//
+// Decodes the column/page address commands and memory writes the way the
+// controller does: with D/C low a byte is a command, with D/C high it is a
+// parameter or, after RAMWR, half of an RGB565 pixel. Pixels fill the address
+// window row by row. Only bytes sent while /CS is low count.
+//
+// With Sync() called before each byte, the model also refreshes the panel
+// from its RAM line by line, at the rate set by FRMCTR1 from its own
+// oscillator. As in landscape (MV set), refresh line n shows column x = n.
+// Each completed refresh is kept as the image the panel showed and passed to
+// the refresh callback. Get Scanline (0x45) reads back the current line.
+
+#ifndef HOST_ILI9341_MODEL_H_
+#define HOST_ILI9341_MODEL_H_
+
+#include <stdint.h>
+#include "Arduino.h"
+
+class ILI9341Model {
+public:
+  static constexpr int kWidth = 320;
+  static constexpr int kHeight = 240;
+  static constexpr int kScanLines = kWidth + 4;  // Including the porches
+
+  typedef void (*RefreshCallback)(const ILI9341Model &model);
+
+  explicit ILI9341Model(uint32_t osc_hz = 615000) : osc_hz_(osc_hz) {
+    SetClocksPerLine(0x18);
+  }
+
+  RefreshCallback refresh = nullptr;
+
+  void Write(uint8_t byte, bool data) {
+    if (!data) {
+      command_ = byte;
+      count_ = 0;
+      if (command_ == 0x2C) {
+        x_ = x0_;
+        y_ = y0_;
+      } else if (command_ == 0x45) {
+        read_[0] = 0;
+        read_[1] = line_ >> 8;
+        read_[2] = line_ & 0xFF;
+        read_pos_ = -1;  // The command byte itself clocks in nothing
+      }
+      return;
+    }
+    switch (command_) {
+      case 0x2A: Parameter(byte, x0_, x1_); break;
+      case 0x2B: Parameter(byte, y0_, y1_); break;
+      case 0x2C:
+        if (!(count_++ & 1)) {
+          high_ = byte;
+          break;
+        }
+        if (x_ < kWidth && y_ < kHeight)
+          ram_[y_][x_] = (high_ << 8) | byte;
+        ++pixels_;
+        if (++x_ > x1_) {
+          x_ = x0_;
+          ++y_;
+        }
+        break;
+      case 0xB1:
+        if (count_++ == 1)
+          SetClocksPerLine(byte);
+        break;
+      default: break;
+    }
+  }
+
+  // MISO byte for the current read command
+  uint8_t Read() {
+    if (read_pos_ < 0) {
+      ++read_pos_;
+      return 0;
+    }
+    return read_pos_ < 3 ? read_[read_pos_++] : 0;
+  }
+
+  // Refresh the lines the beam has passed by cycle count `now`
+  void Sync(uint32_t now) {
+    while (static_cast<int32_t>(now - next_line_time_) >= 0) {
+      if (line_ < kWidth) {
+        for (int y = 0; y < kHeight; ++y)
+          shown_[y][line_] = ram_[y][line_];
+      }
+      next_line_time_ += line_cycles_;
+      if (++line_ == kScanLines) {
+        line_ = 0;
+        ++refreshes_;
+        if (refresh)
+          refresh(*this);
+      }
+    }
+  }
+
+  uint16_t pixel(int x, int y) const { return ram_[y][x]; }
+  // As shown by the last complete refresh
+  uint16_t shown(int x, int y) const { return shown_[y][x]; }
+  uint32_t pixels() const { return pixels_; }
+  uint32_t refreshes() const { return refreshes_; }
+  uint32_t line() const { return line_; }
+  uint32_t refresh_rate() const { return osc_hz_ / (clocks_per_line_ * kScanLines); }
+
+private:
+  uint32_t osc_hz_;
+  uint8_t command_ = 0;
+  int count_ = 0;
+  uint16_t x0_ = 0, x1_ = kWidth - 1, y0_ = 0, y1_ = kHeight - 1;
+  uint16_t x_ = 0, y_ = 0;
+  uint8_t high_ = 0;
+  uint32_t pixels_ = 0;
+  uint8_t read_[3] = {};
+  int read_pos_ = 3;
+  uint32_t clocks_per_line_ = 0;
+  uint32_t line_cycles_ = 1;
+  uint32_t next_line_time_ = 0;
+  uint32_t line_ = 0;
+  uint32_t refreshes_ = 0;
+  uint16_t ram_[kHeight][kWidth] = {};
+  uint16_t shown_[kHeight][kWidth] = {};
+
+  void SetClocksPerLine(uint8_t clocks) {
+    clocks_per_line_ = clocks & 0x1F;
+    line_cycles_ = static_cast<uint64_t>(F_CPU) * clocks_per_line_ / osc_hz_;
+  }
+
+  void Parameter(uint8_t byte, uint16_t &start, uint16_t &end) {
+    switch (count_++) {
+      case 0: start = byte << 8; break;
+      case 1: start |= byte; break;
+      case 2: end = byte << 8; break;
+      case 3: end |= byte; break;
+      default: break;
+    }
+  }
+};
+
+#endif // HOST_ILI9341_MODEL_H_
@@ -0,0 +1,72 @@
+// sh1106_model.h - Behavioural model of an SH1106 OLED for host tools
+//
+// Decodes the byte stream the way the controller does: with D/C low a byte is
+// a command (some take one parameter byte), with D/C high it is written to
+// the 132x64 display RAM at the current page and column, and the column
+// advances. Only bytes sent while /CS is low count.
+
+#ifndef HOST_SH1106_MODEL_H_
+#define HOST_SH1106_MODEL_H_
+
+#include <stdint.h>
+#include <string.h>
+
+class SH1106Model {
+public:
+  static constexpr int kRamWidth = 132;
+  static constexpr int kNumPages = 8;
+
+  void Write(uint8_t byte, bool data) {
+    if (data) {
+      ram_[page_][column_] = byte;
+      column_ = (column_ + 1) % kRamWidth;
+      ++data_bytes_;
+      return;
+    }
+    ++command_bytes_;
+    if (parameter_for_) {
+      if (parameter_for_ == 0x81)
+        contrast_ = byte;
+      parameter_for_ = 0;
+      return;
+    }
+    switch (byte) {
+      case 0x81: case 0xA8: case 0xAD: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        parameter_for_ = byte;
+        break;
+      case 0xAE: on_ = false; break;
+      case 0xAF: on_ = true; break;
+      default:
+        if ((byte & 0xF8) == 0xB0)
+          page_ = byte & 0x07;
+        else if ((byte & 0xF0) == 0x00)
+          column_ = (column_ & 0xF0) | (byte & 0x0F);
+        else if ((byte & 0xF0) == 0x10)
+          column_ = ((byte & 0x0F) << 4) | (column_ & 0x0F);
+        break;
+    }
+  }
+
+  // Visible pixel with the panel's columns starting at `offset` in RAM
+  bool pixel(int x, int y, int offset) const {
+    return (ram_[y / 8][(x + offset) % kRamWidth] >> (y % 8)) & 1;
+  }
+
+  const uint8_t *page(int index) const { return ram_[index]; }
+  bool on() const { return on_; }
+  uint8_t contrast() const { return contrast_; }
+  uint32_t data_bytes() const { return data_bytes_; }
+  uint32_t command_bytes() const { return command_bytes_; }
+
+private:
+  uint8_t ram_[kNumPages][kRamWidth] = {};
+  int page_ = 0;
+  int column_ = 0;
+  uint8_t parameter_for_ = 0;
+  uint8_t contrast_ = 0x80;
+  bool on_ = false;
+  uint32_t data_bytes_ = 0;
+  uint32_t command_bytes_ = 0;
+};
+
+#endif // HOST_SH1106_MODEL_H_
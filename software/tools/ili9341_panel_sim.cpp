@@ -0,0 +1,211 @@
+// ili9341_panel_sim.cpp - Host check of the ILI9341 status panel scheduling
+//
+// Runs the firmware's ILI9341 driver, display layer and weegfx against an
+// ILI9341 model fed from the host SPI stand-in, with the main loop of Main.cpp:
+// a new frame every 33 ms and a status panel redrawn every 250 ms. The same
+// frames run once without and once with the panel. The tool reports the
+// delay from a frame being ready to its last page being out and the panel
+// slices sent. It checks that the panel never delays a frame by more than
+// one slice compared to the run without it, and that both the scaled view and the panel on the model match
+// what was drawn. A third run colors a region of the view with a palette that
+// changes every few frames, and checks each cell against its colors.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -Itools/host -DUSE_ILI9341_DISPLAY -o ili9341_panel_sim
+//       tools/ili9341_panel_sim.cpp src/src/drivers/ILI9341_Driver.cpp
+//       src/src/drivers/display.cpp src/src/drivers/weegfx.cpp
+//   ./ili9341_panel_sim
+
+#include <stdio.h>
+#include <vector>
+#include <Arduino.h>
+#include <SPI.h>
+#include "../src/src/drivers/display.h"
+#include "host/ili9341_model.h"
+
+static constexpr uint32_t kFrameCycles = F_CPU / 1000 * 33;
+static constexpr uint32_t kPanelCycles = F_CPU / 1000 * 250;
+static constexpr uint32_t kLoopCycles = F_CPU / 100000;  // 10 us main loop
+
+static ILI9341Model tft;
+
+// Expected colors of each 8x8 cell of the scaled view
+static uint16_t cell_fg[8][16];
+static uint16_t cell_bg[8][16];
+
+static void OnByte(uint8_t byte) {
+  if (host_pins[ILI9341_CS_PIN] == LOW)
+    tft.Write(byte, host_pins[ILI9341_DC_PIN] == HIGH);
+}
+
+// Scaled 1bpp surface at (x0, y0) on the model, in the cell colors if
+// `cells` is set
+static int Compare(const uint8_t *surface, int width, int height, int x0, int y0, bool cells) {
+  int errors = 0;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      bool on = (surface[(y / 8) * width + x] >> (y % 8)) & 1;
+      uint16_t fg = cells ? cell_fg[y / 8][x / 8] : ILI9341_FG_COLOR;
+      uint16_t bg = cells ? cell_bg[y / 8][x / 8] : ILI9341_BG_COLOR;
+      uint16_t expected = on ? fg : bg;
+      for (int s = 0; s < DISPLAY_SCALE * DISPLAY_SCALE; ++s)
+        errors += tft.pixel(x0 + x * DISPLAY_SCALE + s % DISPLAY_SCALE,
+                            y0 + y * DISPLAY_SCALE + s / DISPLAY_SCALE) != expected;
+    }
+  }
+  return errors != 0;
+}
+
+struct Result {
+  uint32_t frames = 0;
+  uint32_t max_latency = 0;
+  uint64_t total_latency = 0;
+  uint32_t frame_errors = 0;
+  uint32_t panel_errors = 0;
+  uint32_t slices = 0;
+  std::vector<uint32_t> latencies;
+};
+
+static Result Run(bool panel, bool palette, int num_frames) {
+  static uint8_t expected[ILI9341_Driver::kFrameSize];
+  static uint8_t surface[weegfx::Graphics::kFrameSize];
+  static weegfx::Graphics panel_graphics;
+  static bool panel_drawn;
+  Result result;
+
+  ILI9341_Driver::ResetStats();
+  for (auto &row : cell_fg)
+    for (auto &color : row) color = ILI9341_FG_COLOR;
+  for (auto &row : cell_bg)
+    for (auto &color : row) color = ILI9341_BG_COLOR;
+  if (palette) {
+    // Rows 8-31, columns 16-79 in palette 1
+    ILI9341_Driver::SetPaletteRegion(20, 10, 58, 20, 1);
+  }
+  uint32_t next_frame = ARM_DWT_CYCCNT;
+  uint32_t next_panel = ARM_DWT_CYCCNT;
+  uint32_t due = 0;
+  bool presenting = false;
+  int ball_x = 64, ball_y = 32, ball_dx = 2, ball_dy = 1;
+  int frame_count = 0;
+  int panel_count = 0;
+  while (result.frames < static_cast<uint32_t>(num_frames)) {
+    if (!presenting && static_cast<int32_t>(ARM_DWT_CYCCNT - next_frame) >= 0) {
+      due = ARM_DWT_CYCCNT;
+      next_frame += kFrameCycles;
+      ball_x += ball_dx;
+      ball_y += ball_dy;
+      if (ball_x <= 4 || ball_x >= 123) ball_dx = -ball_dx;
+      if (ball_y <= 4 || ball_y >= 59) ball_dy = -ball_dy;
+      if (palette && frame_count % 10 == 0) {
+        const uint16_t fg = 0xF800 >> (frame_count / 10 % 3 * 5);
+        const uint16_t bg = 0x0010 + frame_count;
+        ILI9341_Driver::SetPalette(1, fg, bg);
+        for (int page = 1; page < 4; ++page) {
+          for (int cell = 2; cell < 10; ++cell) {
+            cell_fg[page][cell] = fg;
+            cell_bg[page][cell] = bg;
+          }
+        }
+      }
+      GRAPHICS_BEGIN_FRAME(true);
+      graphics.drawFrame(0, 0, 128, 64);
+      graphics.drawStr(20, 2, "O_C Phazerville");
+      graphics.drawCircle(ball_x, ball_y, 4);
+      graphics.setPrintPos(2, 54);
+      graphics.printf("Frame: %d", frame_count++);
+      memcpy(expected, frame, sizeof(expected));
+      GRAPHICS_END_FRAME();
+      presenting = true;
+    }
+
+    display::Flush();
+    display::Update();
+
+    if (panel && static_cast<int32_t>(ARM_DWT_CYCCNT - next_panel) >= 0) {
+      next_panel += kPanelCycles;
+      panel_graphics.Begin(surface, weegfx::CLEAR_FRAME_ENABLE);
+      panel_graphics.setPrintPos(0, 0);
+      panel_graphics.printf("CPU %4.1f%%", 10.0 + panel_count % 7);
+      for (int channel = 0; channel < 8; ++channel) {
+        int h = (panel_count * 3 + channel * 5) % 16;
+        panel_graphics.drawFrame(channel * 16, 9, 15, 15);
+        panel_graphics.drawRect(channel * 16, 24 - h, 15, h);
+      }
+      panel_graphics.End();
+      ++panel_count;
+      ILI9341_Driver::SetPanel(surface);
+      panel_drawn = true;
+    }
+
+    if (presenting && !display::driver.frame_valid() && !display::frame_buffer.readable()) {
+      uint32_t latency = ARM_DWT_CYCCNT - due;
+      result.latencies.push_back(latency);
+      result.total_latency += latency;
+      if (latency > result.max_latency)
+        result.max_latency = latency;
+      result.frame_errors += Compare(expected, 128, 64, DISPLAY_OFFSET_X, DISPLAY_OFFSET_Y, true);
+      ++result.frames;
+      presenting = false;
+    }
+    ARM_DWT_CYCCNT += kLoopCycles;
+  }
+
+  // Let the panel catch up with its last redraw
+  for (int i = 0; i < 1000; ++i) {
+    display::Update();
+    ARM_DWT_CYCCNT += kLoopCycles;
+  }
+  if (panel_drawn)
+    result.panel_errors = Compare(surface, ILI9341_Driver::kPanelWidth, ILI9341_Driver::kPanelHeight,
+                                  PANEL_OFFSET_X, PANEL_OFFSET_Y, false);
+  result.slices = ILI9341_Driver::stats().panel_slices;
+  if (palette)
+    ILI9341_Driver::SetPaletteRegion(0, 0, 128, 64, 0);
+  return result;
+}
+
+static void Report(const char *label, const Result &result) {
+  printf("%-9s %4u frames: latency mean %6.1f us, max %6.1f us; %4u panel slices; %u frame errors, %u panel errors\n",
+         label, (unsigned)result.frames, 1e6 * result.total_latency / result.frames / F_CPU,
+         1e6 * result.max_latency / F_CPU, (unsigned)result.slices,
+         (unsigned)result.frame_errors, (unsigned)result.panel_errors);
+}
+
+int main() {
+  SPI.device = OnByte;
+  display::Init();
+  int failures = 0;
+
+  Result plain = Run(false, false, 300);
+  Report("no panel", plain);
+  Result with_panel = Run(true, false, 300);
+  Report("panel", with_panel);
+  Result colored = Run(false, true, 300);
+  Report("palette", colored);
+
+  // One slice in flight when a frame arrives, plus loop granularity
+  const uint32_t slice_bytes = ILI9341_Driver::kPanelWidth * ILI9341_Driver::kPanelSliceRows *
+                               DISPLAY_SCALE * DISPLAY_SCALE * 2 + 16;
+  const uint32_t slice_cycles = 8ULL * F_CPU * slice_bytes / ILI9341_SPI_CLOCK;
+  uint32_t max_delay = 0;
+  for (size_t i = 0; i < plain.latencies.size(); ++i) {
+    int32_t delay = with_panel.latencies[i] - plain.latencies[i];
+    if (delay > static_cast<int32_t>(max_delay))
+      max_delay = delay;
+  }
+  printf("largest delay of a frame by the panel: %.1f us (one slice: %.1f us)\n",
+         1e6 * max_delay / F_CPU, 1e6 * slice_cycles / F_CPU);
+  if (max_delay > slice_cycles + kLoopCycles) {
+    printf("panel delayed a frame by more than one slice\n");
+    ++failures;
+  }
+  if (!with_panel.slices) {
+    printf("no panel slices sent\n");
+    ++failures;
+  }
+  failures += plain.frame_errors + with_panel.frame_errors + with_panel.panel_errors +
+              colored.frame_errors;
+  printf("%s\n", failures ? "FAILED" : "display matches");
+  return failures != 0;
+}
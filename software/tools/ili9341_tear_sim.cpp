@@ -0,0 +1,206 @@
+// ili9341_tear_sim.cpp - Host check of the ILI9341 tear-free present mode
+//
+// Runs the firmware's ILI9341 driver, display layer and weegfx against an
+// ILI9341 model that refreshes from its RAM line by line. The model's
+// oscillator is a few percent off the nominal one, so the driver has to
+// follow the real refresh rate. Frames come at 30 FPS with a fast ball as in
+// Main.cpp. After each panel refresh, every line of the scaled view is
+// compared with the recent frames.
+//   torn lines      a line that shows parts of two frames (a write raced the
+//                   beam)
+//   torn refreshes  a refresh that doesn't show one single frame
+// The same frames run in PRESENT_PAGES and PRESENT_BEAM mode, and in
+// PRESENT_BEAM mode at a raised refresh rate. PRESENT_BEAM must have no torn
+// lines and must not use more bus time than pages. At the default rate a
+// pass has room for a whole frame, so it must have no torn refreshes either.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -Itools/host -DUSE_ILI9341_DISPLAY -o ili9341_tear_sim
+//       tools/ili9341_tear_sim.cpp src/src/drivers/ILI9341_Driver.cpp
+//       src/src/drivers/display.cpp src/src/drivers/weegfx.cpp
+//   ./ili9341_tear_sim
+
+#include <stdio.h>
+#include <Arduino.h>
+#include <SPI.h>
+#include "../src/src/drivers/display.h"
+#include "host/ili9341_model.h"
+
+static constexpr size_t kFrameSize = ILI9341_Driver::kFrameSize;
+static constexpr uint32_t kFrameCycles = F_CPU / 1000 * 33;
+static constexpr uint32_t kLoopCycles = F_CPU / 100000;  // 10 us main loop
+static constexpr size_t kHistory = 8;
+
+static ILI9341Model tft(600000);  // 2.4% slow
+
+// Recently presented frames, newest at history[latest % kHistory]
+static uint8_t history[kHistory][kFrameSize];
+static uint32_t latest;
+static bool counting;
+
+struct Result {
+  uint32_t frames = 0;
+  uint32_t refreshes = 0;
+  uint32_t torn_refreshes = 0;
+  uint32_t torn_lines = 0;
+  uint64_t bytes = 0;
+  uint64_t total_latency = 0;
+  uint32_t max_latency = 0;
+};
+
+static Result result;
+
+static void OnByte(uint8_t byte) {
+  tft.Sync(ARM_DWT_CYCCNT);
+  if (host_pins[ILI9341_CS_PIN] == LOW)
+    tft.Write(byte, host_pins[ILI9341_DC_PIN] == HIGH);
+}
+
+static uint8_t OnRead() {
+  return tft.Read();
+}
+
+static bool ShownColumnMatches(const ILI9341Model &model, int x, const uint8_t *frame) {
+  int column = (x - DISPLAY_OFFSET_X) / DISPLAY_SCALE;
+  for (int y = 0; y < 64; ++y) {
+    bool on = (frame[(y / 8) * 128 + column] >> (y % 8)) & 1;
+    for (int s = 0; s < DISPLAY_SCALE; ++s) {
+      if ((model.shown(x, DISPLAY_OFFSET_Y + y * DISPLAY_SCALE + s) == ILI9341_FG_COLOR) != on)
+        return false;
+    }
+  }
+  return true;
+}
+
+// Each line of the scaled view against the frames that could be showing
+static void OnRefresh(const ILI9341Model &model) {
+  if (!counting || latest < kHistory)
+    return;
+  uint32_t single = (1UL << kHistory) - 1;  // Frames that match every line
+  for (int x = DISPLAY_OFFSET_X; x < DISPLAY_OFFSET_X + 128 * DISPLAY_SCALE; ++x) {
+    uint32_t matches = 0;
+    for (size_t age = 0; age < kHistory; ++age) {
+      if (ShownColumnMatches(model, x, history[(latest - age) % kHistory]))
+        matches |= 1UL << age;
+    }
+    if (!matches)
+      ++result.torn_lines;
+    single &= matches;
+  }
+  if (!single)
+    ++result.torn_refreshes;
+  ++result.refreshes;
+}
+
+static Result Run(ILI9341_Driver::PresentMode mode, uint32_t refresh_hz, int num_frames) {
+  ILI9341_Driver::SetPresentMode(mode);
+  ILI9341_Driver::SetRefreshRate(refresh_hz);
+  ILI9341_Driver::ResetStats();
+  result = Result();
+
+  uint32_t next_frame = ARM_DWT_CYCCNT;
+  uint32_t due = 0;
+  bool presenting = false;
+  int ball_x = 64, ball_y = 32, ball_dx = 5, ball_dy = 3;
+  int frame_count = 0;
+  // The first frames only fill the history
+  const int kWarmup = kHistory + 2;
+  uint32_t start_bytes = 0;
+  while (result.frames < static_cast<uint32_t>(num_frames)) {
+    if (!presenting && static_cast<int32_t>(ARM_DWT_CYCCNT - next_frame) >= 0) {
+      due = ARM_DWT_CYCCNT;
+      next_frame += kFrameCycles;
+      ball_x += ball_dx;
+      ball_y += ball_dy;
+      if (ball_x <= 8 || ball_x >= 119) ball_dx = -ball_dx;
+      if (ball_y <= 8 || ball_y >= 55) ball_dy = -ball_dy;
+      GRAPHICS_BEGIN_FRAME(true);
+      graphics.drawFrame(0, 0, 128, 64);
+      graphics.drawStr(20, 2, "O_C Phazerville");
+      graphics.drawRect(ball_x - 6, ball_y - 6, 12, 12);
+      graphics.setPrintPos(2, 54);
+      graphics.printf("Frame: %d", frame_count++);
+      ++latest;
+      memcpy(history[latest % kHistory], frame, kFrameSize);
+      GRAPHICS_END_FRAME();
+      presenting = true;
+      if (frame_count == kWarmup) {
+        counting = true;
+        start_bytes = SPI.bytes;
+      }
+    }
+
+    display::Flush();
+    display::Update();
+
+    if (presenting && !display::driver.frame_valid() && !display::frame_buffer.readable() &&
+        !ILI9341_Driver::busy()) {
+      // PRESENT_BEAM strips go out from Poll() after the pages are taken
+      display::Update();
+      if (!ILI9341_Driver::busy() || mode == ILI9341_Driver::PRESENT_PAGES) {
+        if (counting) {
+          uint32_t latency = ARM_DWT_CYCCNT - due;
+          result.total_latency += latency;
+          if (latency > result.max_latency)
+            result.max_latency = latency;
+          ++result.frames;
+        }
+        presenting = false;
+      }
+    }
+    ARM_DWT_CYCCNT += kLoopCycles;
+    tft.Sync(ARM_DWT_CYCCNT);
+  }
+  counting = false;
+  result.bytes = SPI.bytes - start_bytes;
+  return result;
+}
+
+static void Report(const char *label, const Result &result) {
+  ILI9341_Driver::Stats stats = ILI9341_Driver::stats();
+  printf("%-14s %3u frames, %4u refreshes: %4u torn refreshes, %5u torn lines; "
+         "%6.0f bytes/frame, latency mean %5.1f ms max %5.1f ms, %u beam waits\n",
+         label, (unsigned)result.frames, (unsigned)result.refreshes,
+         (unsigned)result.torn_refreshes, (unsigned)result.torn_lines,
+         static_cast<double>(result.bytes) / result.frames,
+         1e3 * result.total_latency / result.frames / F_CPU, 1e3 * result.max_latency / F_CPU,
+         (unsigned)stats.beam_waits);
+}
+
+int main() {
+  SPI.device = OnByte;
+  SPI.reader = OnRead;
+  tft.refresh = OnRefresh;
+  display::Init();
+  int failures = 0;
+
+  Result pages = Run(ILI9341_Driver::PRESENT_PAGES, 0, 300);
+  Report("pages 79Hz", pages);
+  Result beam = Run(ILI9341_Driver::PRESENT_BEAM, 0, 300);
+  Report("beam 79Hz", beam);
+  printf("  line period %.2f us measured, %.2f us actual\n",
+         1e6 * ILI9341_Driver::line_cycles() / F_CPU,
+         1e6 / (tft.refresh_rate() * ILI9341Model::kScanLines));
+  Result fast = Run(ILI9341_Driver::PRESENT_BEAM, 119, 300);
+  Report("beam 119Hz", fast);
+  if (tft.refresh_rate() < 110) {
+    printf("refresh rate not raised\n");
+    ++failures;
+  }
+
+  if (beam.torn_lines || fast.torn_lines) {
+    printf("beam mode tore a line\n");
+    ++failures;
+  }
+  if (beam.torn_refreshes) {
+    printf("beam mode showed two frames in one refresh\n");
+    ++failures;
+  }
+  // Strips carry the same pixels as pages, plus a scanline read per frame
+  if (beam.bytes > pages.bytes + 8 * beam.frames) {
+    printf("beam mode used more bus time\n");
+    ++failures;
+  }
+  printf("%s\n", failures ? "FAILED" : "no tearing in beam mode");
+  return failures != 0;
+}
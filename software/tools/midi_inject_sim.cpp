@@ -0,0 +1,218 @@
+// midi_inject_sim.cpp - Host test of the MIDI to CV/gate path
+//
+// Builds OC_midi.cpp and OC_DAC.cpp against an emulated DAC8568 and feeds
+// raw MIDI byte streams through MIDI::Inject(), running the core tick
+// sequence (MIDI::Tick(), DAC::Update(), MIDI::Written()) in between. After
+// each step the emulated DAC outputs must hold the expected pitch codes and
+// gates:
+// - notes, also with running status and realtime bytes in between
+// - voice stealing with all 8 channels taken by 4 voices, and the one-tick
+//   gate drop of a stolen voice
+// - note off as note on with velocity 0, all notes off
+// - pitch bend on every voice, CCs mapped to the channels voices don't use
+// - channel filtering, and a preset recall taking effect only once applied
+// Finally notes are injected at random points within a tick, and the
+// arrival to DAC write latency must stay within one tick.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -Itools/host -o midi_inject_sim tools/midi_inject_sim.cpp
+//       src/src/OC_midi.cpp src/src/OC_DAC.cpp tools/host/DAC8568_emulated.cpp
+//   ./midi_inject_sim
+
+#include <random>
+#include <stdio.h>
+#include <initializer_list>
+#include <vector>
+#include "../src/src/OC_core.h"
+#include "../src/src/OC_clock.h"
+#include "../src/src/OC_DAC.h"
+#include "../src/src/OC_events.h"
+#include "../src/src/OC_midi.h"
+#include "host/dac8568_model.h"
+
+using namespace OC;
+
+extern DAC8568Model dac8568_models[DAC8568_Driver::kNumDevices];
+
+// Stand-ins for the modules OC_midi.cpp reports to
+static uint32_t midi_clocks;
+void CLOCK::MidiClock(uint32_t) { ++midi_clocks; }
+void CLOCK::MidiStart() {}
+void CLOCK::MidiContinue() {}
+void CLOCK::MidiStop() {}
+void CLOCK::MidiSongPosition(uint16_t) {}
+bool EVENTS::Post(EVENTS::Type, uint8_t, uint16_t) { return true; }
+
+static uint32_t tick = 0;
+static uint32_t max_update_cycles = 0;
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+// One core tick, as OC_core.cpp runs it
+static void Tick() {
+  const uint32_t start = tick * CORE::kCyclesPerTick;
+  ARM_DWT_CYCCNT = start;
+  MIDI::Tick();
+  DAC::Update(tick);
+  MIDI::Written(ARM_DWT_CYCCNT);
+  if (ARM_DWT_CYCCNT - start > max_update_cycles)
+    max_update_cycles = ARM_DWT_CYCCNT - start;
+  ++tick;
+  ARM_DWT_CYCCNT = tick * CORE::kCyclesPerTick;
+}
+
+static void Send(std::initializer_list<uint8_t> bytes) {
+  std::vector<uint8_t> data(bytes);
+  MIDI::Inject(data.data(), data.size());
+  Tick();
+}
+
+static uint16_t output(size_t channel) {
+  return dac8568_models[channel / 8].output(channel % 8);
+}
+
+// 1V/oct at 13107 codes per octave from C1, computed here independently
+static int32_t pitch(int note, int32_t bend = 0) {
+  int32_t code = (note - 24) * 13107 / 12 + bend;
+  return code < 0 ? 0 : code > 0xFFFF ? 0xFFFF : code;
+}
+
+static void ExpectVoice(size_t voice, int note, bool gate, int32_t bend, const char *what) {
+  bool ok = output(2 * voice) == pitch(note, bend) &&
+            output(2 * voice + 1) == (gate ? DAC::kGateHigh : DAC::kGateLow);
+  if (!ok)
+    printf("voice %u: pitch %04x gate %04x, expected note %d (%04x) gate %d\n", (unsigned)voice,
+           output(2 * voice), output(2 * voice + 1), note, pitch(note, bend), gate);
+  Check(ok, what);
+}
+
+// The voice playing a note with its gate up, -1 if none
+static int VoiceWith(int note, size_t num_voices) {
+  for (size_t voice = 0; voice < num_voices; ++voice) {
+    if (output(2 * voice) == pitch(note) && output(2 * voice + 1) == DAC::kGateHigh)
+      return voice;
+  }
+  return -1;
+}
+
+int main() {
+  static_assert(DAC::kNumChannels == 8, "Build with one DAC");
+  DAC::Init();
+  MIDI::Init();
+  MIDI::set_voices(4);
+  Check(MIDI::num_voices() == 4, "4 voices on 8 channels");
+  Tick();
+
+  // Notes, then running status with a clock byte in the middle of a message
+  Send({ 0x90, 60, 100 });
+  ExpectVoice(0, 60, true, 0, "note on");
+  Send({ 0x90, 62, 100, 64, 0xF8, 100, 67, 100 });
+  ExpectVoice(1, 62, true, 0, "running status");
+  ExpectVoice(2, 64, true, 0, "realtime byte inside a message");
+  ExpectVoice(3, 67, true, 0, "running status after a realtime byte");
+  Check(midi_clocks == 1, "realtime byte passed on");
+
+  // All voices busy: the oldest note (60 on voice 0) is stolen, its gate
+  // drops for one tick
+  Send({ 0x90, 72, 100 });
+  ExpectVoice(0, 72, false, 0, "stolen voice gate drops");
+  Tick();
+  ExpectVoice(0, 72, true, 0, "stolen voice gate back up");
+  ExpectVoice(1, 62, true, 0, "other voices untouched");
+
+  // Note off as velocity 0 with running status, the freed voice is reused
+  Send({ 0x90, 62, 0 });
+  ExpectVoice(1, 62, false, 0, "note off by velocity 0");
+  Send({ 0x80, 64, 0, 0x90, 74, 90 });
+  ExpectVoice(2, 64, false, 0, "note off");
+  ExpectVoice(1, 74, true, 0, "least recently released voice reused");
+  // Same note again: retriggered on its own voice
+  Send({ 0x90, 74, 90 });
+  ExpectVoice(1, 74, false, 0, "retrigger drops the gate");
+  Tick();
+  ExpectVoice(1, 74, true, 0, "retrigger gate back up");
+
+  // Full bend up and down, +-2 semitones
+  const int32_t bend_up = ((16383 - 8192) * 2 * (13107 / 12)) >> 13;
+  const int32_t bend_down = ((0 - 8192) * 2 * (13107 / 12)) >> 13;
+  Send({ 0xE0, 0x7F, 0x7F });
+  ExpectVoice(0, 72, true, bend_up, "bend up");
+  ExpectVoice(3, 67, true, bend_up, "bend on every voice");
+  Send({ 0xE0, 0x00, 0x00 });
+  ExpectVoice(1, 74, true, bend_down, "bend down");
+  Send({ 0xE0, 0x00, 0x40 });
+  ExpectVoice(3, 67, true, 0, "bend centre");
+
+  // All notes off
+  Send({ 0xB0, 123, 0 });
+  for (size_t voice = 0; voice < 4; ++voice)
+    Check(output(2 * voice + 1) == DAC::kGateLow, "all notes off");
+
+  // With 3 voices, channels 7 and 8 follow CCs, also with running status
+  MIDI::set_voices(3);
+  MIDI::map_cc(6, 74);
+  MIDI::map_cc(7, 1);
+  MIDI::map_cc(0, 2);  // A voice channel, refused
+  Tick();
+  Send({ 0xB0, 74, 127, 1, 64, 2, 127 });
+  Check(output(6) == 0xFFFF, "CC to channel 7");
+  Check(output(7) == 64 * 0xFFFF / 127, "CC with running status to channel 8");
+  Check(output(0) != 0xFFFF, "CC refused on a voice channel");
+
+  // Only channel 2 once selected
+  MIDI::set_channel(1);
+  Send({ 0x90, 48, 100 });
+  Check(output(1) == DAC::kGateLow, "other channel ignored");
+  Send({ 0x91, 48, 100 });
+  ExpectVoice(0, 48, true, 0, "selected channel played");
+  Send({ 0x81, 48, 0 });
+  MIDI::set_channel(-1);
+  Tick();
+
+  // A preset recall: the staged settings are held back until ApplyRecall(),
+  // which the core ISR runs in the tick that applies the rest of the preset
+  MIDI::Settings recalled = MIDI::current_settings();
+  recalled.channel = 2;
+  MIDI::StageRecall(recalled, 2);
+  Send({ 0x90, 50, 100 });
+  Check(VoiceWith(50, 3) >= 0, "staged settings held back");
+  Check(MIDI::num_voices() == 3, "voices unchanged until applied");
+  MIDI::ApplyRecall(2);
+  Check(MIDI::num_voices() == 2, "voices set by the recall");
+  Send({ 0x90, 52, 100 });
+  Check(VoiceWith(50, 3) < 0, "recall released the gates");
+  Check(VoiceWith(52, 2) < 0, "other channel ignored after the recall");
+  Send({ 0x92, 52, 100 });
+  Check(VoiceWith(52, 2) >= 0, "recalled channel played");
+  Send({ 0x82, 52, 0 });
+  MIDI::set_channel(-1);
+
+  // Arrival to DAC write: injected anywhere within a tick
+  std::mt19937 rng(1);
+  MIDI::ResetStats();
+  for (int i = 0; i < 10000; ++i) {
+    uint8_t note = 36 + rng() % 48;
+    const uint8_t message[] = { 0x90, note, static_cast<uint8_t>(i & 1 ? 0 : 100) };
+    ARM_DWT_CYCCNT = (tick - 1) * CORE::kCyclesPerTick + max_update_cycles +
+                     rng() % (CORE::kCyclesPerTick - max_update_cycles);
+    MIDI::Inject(message, sizeof(message));
+    Tick();
+  }
+  const util::RunningStats &latency = MIDI::latency();
+  printf("latency: n=%u mean=%.1fus max=%.1fus (tick %uus, DAC update up to %.1fus)\n",
+         latency.count(), latency.mean() / CORE::kCyclesPerUs,
+         static_cast<double>(latency.max()) / CORE::kCyclesPerUs, (unsigned)CORE::kTickUs,
+         static_cast<double>(max_update_cycles) / CORE::kCyclesPerUs);
+  Check(latency.count() == 10000, "every message measured");
+  Check(static_cast<uint32_t>(latency.max()) <= CORE::kCyclesPerTick, "written within one tick of arrival");
+  Check(!MIDI::dropped_count(), "nothing dropped");
+
+  printf("%s\n", failures ? "FAILED" : "DAC codes and gates as expected");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+// mirror_bandwidth.cpp - Host check of the screen mirror coding
+//
+// Draws frames with weegfx the way Main.cpp does and codes each one with
+// util::DeltaRLE as OC::MIRROR would: a key frame every kKeyFrameInterval
+// frames, deltas against the previous frame otherwise. Reports the mean and
+// largest packet per frame and the link rate at 30 FPS, and decodes every
+// packet the way tools/screen_view.py does to check that the host ends up
+// with the same frame.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -Itools/host -o mirror_bandwidth tools/mirror_bandwidth.cpp
+//       src/src/drivers/weegfx.cpp
+//   ./mirror_bandwidth
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/src/drivers/weegfx.h"
+#include "../src/src/util/util_delta_rle.h"
+#include "../src/src/OC_mirror.h"
+
+static constexpr size_t kFrameSize = OC::MIRROR::kFrameSize;
+static constexpr size_t kPacketOverhead = 8;  // Header and sequence number
+static constexpr double kFramesPerSecond = 30.0;
+
+static weegfx::Graphics graphics;
+
+struct Result {
+  uint32_t frames = 0;
+  uint32_t bytes = 0;
+  uint32_t max_bytes = 0;
+  uint32_t mismatches = 0;
+};
+
+template <typename Draw>
+static Result Run(int num_frames, Draw draw) {
+  static uint8_t frame[kFrameSize];
+  static uint8_t reference[kFrameSize];
+  static uint8_t host[kFrameSize];
+  static uint8_t coded[util::DeltaRLE::MaxEncodedSize(kFrameSize)];
+  Result result;
+  for (int i = 0; i < num_frames; ++i) {
+    graphics.Begin(frame, weegfx::CLEAR_FRAME_ENABLE);
+    draw(i);
+    graphics.End();
+
+    bool key_frame = !(i % OC::MIRROR::kKeyFrameInterval);
+    size_t length = util::DeltaRLE::Encode(frame, key_frame ? nullptr : reference, kFrameSize, coded);
+    memcpy(reference, frame, kFrameSize);
+    if (key_frame)
+      memset(host, 0, kFrameSize);
+    if (!util::DeltaRLE::Decode(coded, length, host, kFrameSize) || memcmp(host, frame, kFrameSize))
+      ++result.mismatches;
+
+    uint32_t bytes = kPacketOverhead + length;
+    result.bytes += bytes;
+    if (bytes > result.max_bytes)
+      result.max_bytes = bytes;
+    ++result.frames;
+  }
+  return result;
+}
+
+static void Report(const char *label, const Result &result) {
+  double mean = static_cast<double>(result.bytes) / result.frames;
+  printf("%-8s %4u frames: %7.1f bytes/frame (raw %u), max %4u, %6.2f kB/s at %.0f FPS, %u mismatches\n",
+         label, (unsigned)result.frames, mean, (unsigned)kFrameSize, (unsigned)result.max_bytes,
+         mean * kFramesPerSecond / 1000.0, kFramesPerSecond, (unsigned)result.mismatches);
+}
+
+int main() {
+  int failures = 0;
+
+  // The Main.cpp demo screen
+  int ball_x = 64, ball_y = 32, ball_dx = 2, ball_dy = 1;
+  Result demo = Run(600, [&](int i) {
+    ball_x += ball_dx;
+    ball_y += ball_dy;
+    if (ball_x <= 4 || ball_x >= 123) ball_dx = -ball_dx;
+    if (ball_y <= 4 || ball_y >= 59) ball_dy = -ball_dy;
+    graphics.drawFrame(0, 0, 128, 64);
+    graphics.drawStr(20, 2, "O_C Phazerville");
+    graphics.drawStr(28, 12, "ILI9341 Demo");
+    graphics.setPrintPos(2, 44);
+    graphics.print("Clock: ---");
+    graphics.drawCircle(ball_x, ball_y, 4);
+    graphics.setPrintPos(2, 54);
+    graphics.printf("Frame: %d", i);
+  });
+  Report("demo", demo);
+
+  // Nothing changes
+  Result still = Run(600, [](int) {
+    graphics.drawFrame(0, 0, 128, 64);
+    graphics.drawStr(20, 2, "O_C Phazerville");
+  });
+  Report("static", still);
+
+  // Every pixel changes: the worst case
+  Result inverting = Run(120, [](int i) {
+    graphics.drawStr(2, 2, "invert");
+    for (int x = 0; x < 128; x += 3)
+      graphics.drawVLine(x, (i * 7 + x) % 32, 32);
+    if (i & 1)
+      graphics.invertRect(0, 0, 128, 64);
+  });
+  Report("invert", inverting);
+  if (inverting.max_bytes > kPacketOverhead + util::DeltaRLE::MaxEncodedSize(kFrameSize)) {
+    printf("packet larger than MaxEncodedSize\n");
+    ++failures;
+  }
+
+  failures += demo.mismatches + still.mismatches + inverting.mismatches;
+  printf("%s\n", failures ? "FAILED" : "host frames match");
+  return failures != 0;
+}
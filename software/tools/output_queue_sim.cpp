@@ -0,0 +1,277 @@
+// output_queue_sim.cpp - Multithreaded host test of the timestamped output queue
+//
+// Runs OC::OutputQueue with several producer threads posting value changes
+// for ticks out of order, some already past and many for the same tick, and
+// the consumer applying them one tick at a time as the core ISR does. Each
+// producer owns two DAC channels and numbers its values, so a reference model
+// can tell which value each channel must hold after every tick: the one
+// posted last for the latest due tick, applied in its tick, or in the next
+// one if it was posted late. The queue counters must add up to the model's.
+//
+// Then:
+// - a burst from all producer threads at once overflows the queue; only the
+//   posts that were accepted may arrive, and the last one per channel wins
+// - with the heap full of far-future events, events due now are still
+//   applied on their tick, and the furthest events are dropped and counted
+// - gate changes apply as gate levels
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -pthread -Itools/host -o output_queue_sim tools/output_queue_sim.cpp
+//       src/src/OC_output_queue.cpp src/src/OC_DAC.cpp tools/host/DAC8568_emulated.cpp
+//   ./output_queue_sim [ticks]
+
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/src/OC_DAC.h"
+#include "../src/src/OC_output_queue.h"
+
+using namespace OC;
+
+static constexpr size_t kNumProducers = 4;
+static constexpr int kMaxAhead = 12;  // Ticks
+static constexpr int kMaxLate = 3;
+
+static int failures = 0;
+
+static void Check(bool ok, const char *what) {
+  if (!ok) {
+    printf("  FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+// A post that was accepted, in the producer's order
+struct Posted {
+  uint32_t tick;
+  size_t channel;
+  uint16_t value;
+};
+
+// Producers post a round of events, then wait for the consumer's tick
+class Rounds {
+public:
+  void Start(size_t round) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    round_ = round;
+    done_ = 0;
+    cv_.notify_all();
+  }
+
+  size_t Wait(size_t last) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return round_ != last; });
+    return round_;
+  }
+
+  void Done() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (++done_ == kNumProducers)
+      cv_.notify_all();
+  }
+
+  void WaitDone() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return done_ == kNumProducers; });
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t round_ = 0;
+  size_t done_ = 0;
+};
+
+static constexpr size_t kStop = ~static_cast<size_t>(0);
+
+// Reference: the events each channel still has to apply, in posting order
+struct Model {
+  std::vector<Posted> pending[DAC::kNumChannels];
+  uint32_t applied = 0;
+  uint32_t late = 0;
+
+  // The value a channel holds after the tick, or -1 if unchanged
+  int32_t Apply(size_t channel, uint32_t tick) {
+    std::vector<Posted> &events = pending[channel];
+    const Posted *last = nullptr;
+    std::vector<Posted> left;
+    for (const Posted &event : events) {
+      const int32_t due = static_cast<int32_t>(tick - event.tick);
+      if (due < 0) {
+        left.push_back(event);
+        continue;
+      }
+      ++applied;
+      late += due > 0;
+      // Latest tick wins, then the last posted
+      if (!last || static_cast<int32_t>(event.tick - last->tick) >= 0)
+        last = &event;
+    }
+    const int32_t value = last ? last->value : -1;
+    events.swap(left);
+    return value;
+  }
+};
+
+static void RunThreads(uint32_t num_ticks) {
+  printf("%zu producers, %u ticks, events up to %d ticks ahead and %d late\n", kNumProducers,
+         num_ticks, kMaxAhead, kMaxLate);
+  DAC::Init();
+  OutputQueue::Init();
+
+  Rounds rounds;
+  volatile uint32_t current_tick = 0;
+  std::vector<std::vector<Posted>> accepted(kNumProducers);
+  std::vector<uint32_t> rejected(kNumProducers);
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kNumProducers; ++p) {
+    producers.emplace_back([&, p] {
+      std::mt19937 rng(p + 1);
+      uint16_t number = 0;
+      size_t round = 0;
+      while ((round = rounds.Wait(round)) != kStop) {
+        const uint32_t now = current_tick;
+        for (int n = rng() % 3; n; --n) {
+          const Posted event = { static_cast<uint32_t>(now - kMaxLate + rng() % (kMaxLate + kMaxAhead + 1)),
+                                 2 * p + rng() % 2, ++number };
+          if (OutputQueue::Post(event.tick, event.channel, event.value))
+            accepted[p].push_back(event);
+          else
+            ++rejected[p];
+        }
+        rounds.Done();
+      }
+    });
+  }
+
+  Model model;
+  std::vector<size_t> taken(kNumProducers);
+  uint32_t mismatches = 0;
+  for (uint32_t tick = 0; tick < num_ticks; ++tick) {
+    current_tick = tick;
+    rounds.Start(tick + 1);
+    rounds.WaitDone();
+    for (size_t p = 0; p < kNumProducers; ++p) {
+      for (; taken[p] < accepted[p].size(); ++taken[p])
+        model.pending[accepted[p][taken[p]].channel].push_back(accepted[p][taken[p]]);
+    }
+
+    std::vector<uint16_t> before(DAC::kNumChannels);
+    for (size_t channel = 0; channel < DAC::kNumChannels; ++channel)
+      before[channel] = DAC::value(channel);
+    OutputQueue::Apply(tick);
+    for (size_t channel = 0; channel < 2 * kNumProducers; ++channel) {
+      const int32_t value = model.Apply(channel, tick);
+      const uint16_t expected = value < 0 ? before[channel] : value;
+      if (DAC::value(channel) != expected && mismatches++ < 10)
+        printf("  tick %u channel %zu: %u, expected %u\n", tick, channel, DAC::value(channel), expected);
+    }
+  }
+  rounds.Start(kStop);
+  for (std::thread &producer : producers)
+    producer.join();
+
+  uint32_t posted = 0, overflows = 0;
+  for (size_t p = 0; p < kNumProducers; ++p) {
+    posted += accepted[p].size();
+    overflows += rejected[p];
+  }
+  const OutputQueue::Stats stats = OutputQueue::stats();
+  printf("  posted %u applied %u late %u overflows %u dropped %u, max pending %u\n", stats.posted,
+         stats.applied, stats.late, stats.overflows, stats.dropped, stats.max_pending);
+  Check(!mismatches, "every channel holds the latest due value after each tick");
+  Check(stats.posted == posted && stats.overflows == overflows, "posts counted");
+  Check(stats.applied == model.applied && stats.late == model.late, "applied and late as modelled");
+  Check(stats.late > 0, "late posts were made");
+  Check(OutputQueue::pending() == stats.posted - stats.applied, "the rest still pending");
+}
+
+static void RunOverflow() {
+  printf("burst of %zu posts from %zu threads into a %zu-entry queue\n", 2 * OutputQueue::kQueueSize,
+         kNumProducers, OutputQueue::kQueueSize);
+  DAC::Init();
+  OutputQueue::Init();
+  std::vector<std::vector<Posted>> accepted(kNumProducers);
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kNumProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (uint16_t number = 1; number <= 2 * OutputQueue::kQueueSize / kNumProducers; ++number) {
+        if (OutputQueue::Post(10, p, number))
+          accepted[p].push_back({ 10, p, number });
+      }
+    });
+  }
+  for (std::thread &producer : producers)
+    producer.join();
+
+  size_t total = 0;
+  for (const std::vector<Posted> &events : accepted)
+    total += events.size();
+  OutputQueue::Apply(9);
+  const bool early = !OutputQueue::stats().applied;
+  OutputQueue::Apply(10);
+  const OutputQueue::Stats stats = OutputQueue::stats();
+  printf("  accepted %zu, overflows %u, applied %u\n", total, stats.overflows, stats.applied);
+  Check(total == OutputQueue::kQueueSize, "the queue fills up");
+  Check(stats.overflows == 2 * OutputQueue::kQueueSize - total, "the rest counted as overflows");
+  Check(early && stats.applied == total && !stats.late && !stats.dropped, "applied on their tick");
+  for (size_t p = 0; p < kNumProducers; ++p) {
+    if (!accepted[p].empty())
+      Check(DAC::value(p) == accepted[p].back().value, "last accepted post wins the tie");
+  }
+}
+
+static void RunFullHeap() {
+  printf("%zu far-future events pending, then events due now\n", OutputQueue::kMaxPending);
+  DAC::Init();
+  OutputQueue::Init();
+  // Spread over ticks 1000..1127, posted across several ticks so the queue
+  // doesn't overflow
+  for (size_t i = 0; i < OutputQueue::kMaxPending; ++i) {
+    OutputQueue::Post(1000 + i, 0, i);
+    if (i % 32 == 31)
+      OutputQueue::Apply(i / 32);
+  }
+  OutputQueue::Apply(4);
+  Check(OutputQueue::pending() == OutputQueue::kMaxPending, "heap full");
+
+  for (uint16_t i = 0; i < 10; ++i)
+    OutputQueue::Post(5, 1, 100 + i);
+  OutputQueue::Post(2000, 2, 1);  // Later than everything pending
+  OutputQueue::Apply(5);
+  OutputQueue::Stats stats = OutputQueue::stats();
+  printf("  applied %u dropped %u pending %zu\n", stats.applied, stats.dropped, OutputQueue::pending());
+  Check(stats.applied == 10 && DAC::value(1) == 109, "due events applied on their tick");
+  Check(stats.dropped == 11, "the furthest events dropped");
+
+  // The 10 furthest pending events went, the latest post never got in
+  size_t kept = 0;
+  for (uint32_t tick = 1000; tick < 1000 + OutputQueue::kMaxPending; ++tick) {
+    OutputQueue::Apply(tick);
+    kept += DAC::value(0) == tick - 1000;
+  }
+  OutputQueue::Apply(2000);
+  Check(kept == OutputQueue::kMaxPending - 10 && DAC::value(0) == OutputQueue::kMaxPending - 11,
+        "the earliest far-future events kept, each on its tick");
+  Check(DAC::value(2) != 1, "an event later than a full heap is dropped");
+
+  OutputQueue::PostGate(1300, 3, true);
+  OutputQueue::PostGate(1301, 3, false);
+  OutputQueue::Apply(1300);
+  const bool high = DAC::value(3) == DAC::kGateHigh;
+  OutputQueue::Apply(1301);
+  Check(high && DAC::value(3) == DAC::kGateLow, "gate levels");
+}
+
+int main(int argc, char **argv) {
+  const uint32_t ticks = argc > 1 ? atoi(argv[1]) : 20000;
+  RunThreads(ticks);
+  RunOverflow();
+  RunFullHeap();
+  printf("%s\n", failures ? "FAILED" : "events applied on their tick, in order");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""profile_report.py - Flat profile from the module's sampling profiler
+
+Starts the profiler described in src/src/OC_profile.h with 'X', waits, sends
+'X' again and reads the dump. Each sampled PC is resolved to a function with
+nm on firmware.elf, and the functions are listed by the share of samples
+that landed in them (self time, including time in ISRs). If the firmware
+records LR, the callers of the hottest functions are listed too. LR is only
+the caller for leaf functions and for samples taken before a function saved
+it, so caller shares are a hint rather than a call graph.
+
+The sampler's own cost is reported from the dump: the mean cycles per sample
+at the sample rate, plus the exception entry and exit it can't measure.
+
+Examples:
+  tools/profile_report.py /dev/ttyACM0 --seconds 10
+
+  # Keep the raw dump and report it again later against another ELF
+  tools/profile_report.py /dev/ttyACM0 --save profile.bin
+  tools/profile_report.py --load profile.bin --elf firmware.elf --top 40
+
+Requires pyserial (not with --load) and nm from the ARM toolchain; the one
+PlatformIO installs is found automatically.
+"""
+
+import argparse
+import bisect
+import collections
+import glob
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import time
+
+# Framing and packet types as in src/src/OC_packet.h
+SYNC = 0xA5
+PACKET_HEADER = 0x20
+PACKET_ENTRIES = 0x21
+HEADER = struct.Struct("<IIIIIHB")
+ENTRY = struct.Struct("<III")
+FLAG_LR = 0x01
+EXCEPTION_CYCLES = 30  # Entry and exit, not seen by the sampler
+DEFAULT_ELF = ".pio/build/T41_ILI9341/firmware.elf"
+
+
+class Dump:
+    def __init__(self):
+        self.header = None
+        self.entries = []
+        self.text = bytearray()
+
+    def complete(self):
+        return self.header is not None and len(self.entries) >= self.header["entries"]
+
+    def parse(self, data):
+        """Parse a capture; bytes outside the profile packets are debug text."""
+        pos = 0
+        while pos < len(data):
+            if data[pos] != SYNC or pos + 4 > len(data):
+                self.text.append(data[pos])
+                pos += 1
+                continue
+            _, packet_type, length = struct.unpack_from("<BBH", data, pos)
+            if packet_type not in (PACKET_HEADER, PACKET_ENTRIES) or pos + 4 + length > len(data):
+                self.text.append(data[pos])
+                pos += 1
+                continue
+            payload = data[pos + 4:pos + 4 + length]
+            pos += 4 + length
+            if packet_type == PACKET_HEADER and length == HEADER.size:
+                names = ("cpu_hz", "rate_hz", "samples", "dropped", "sample_cycles", "entries", "flags")
+                self.header = dict(zip(names, HEADER.unpack(payload)))
+                self.entries = []
+            elif packet_type == PACKET_ENTRIES and self.header is not None:
+                self.entries += [ENTRY.unpack_from(payload, i) for i in range(0, length, ENTRY.size)]
+
+
+def capture(port_name, seconds):
+    import serial
+
+    port = serial.Serial(port_name, timeout=0.1)
+    port.reset_input_buffer()
+    port.write(b"X")
+    print("profiling for %.0f s..." % seconds, file=sys.stderr)
+    time.sleep(seconds)
+    port.reset_input_buffer()
+    port.write(b"X")
+    data = bytearray()
+    deadline = time.monotonic() + 5.0
+    while time.monotonic() < deadline:
+        data += port.read(port.in_waiting or 1)
+        dump = Dump()
+        dump.parse(bytes(data))
+        if dump.complete():
+            break
+    return bytes(data)
+
+
+def find_nm(path):
+    if path:
+        return path
+    if shutil.which("arm-none-eabi-nm"):
+        return "arm-none-eabi-nm"
+    pio = glob.glob(os.path.expanduser("~/.platformio/packages/toolchain-gccarmnoneeabi*/bin/arm-none-eabi-nm"))
+    if pio:
+        return sorted(pio)[-1]
+    return "nm"
+
+
+class Symbols:
+    """Function symbols of the ELF, for address lookup."""
+
+    def __init__(self, elf, nm):
+        out = subprocess.run([nm, "-n", "-C", "-S", "--defined-only", elf],
+                             check=True, capture_output=True, text=True).stdout
+        self.starts = []
+        self.symbols = []
+        for line in out.splitlines():
+            parts = line.split(maxsplit=3)
+            if len(parts) == 4:
+                address, size, kind, name = parts
+            elif len(parts) == 3:
+                address, kind, name = parts
+                size = "0"
+            else:
+                continue
+            if kind not in "tTwW":
+                continue
+            start = int(address, 16) & ~1
+            self.starts.append(start)
+            self.symbols.append((start, int(size, 16), name))
+
+    def lookup(self, address):
+        address &= ~1
+        i = bisect.bisect_right(self.starts, address) - 1
+        if i >= 0:
+            start, size, name = self.symbols[i]
+            # Without a size, only up to the next symbol
+            end = start + size if size else (self.starts[i + 1] if i + 1 < len(self.starts) else start)
+            if address < end:
+                return name
+        return "?? 0x%08x" % address
+
+
+def report(dump, symbols, top, callers):
+    header = dump.header
+    samples = max(header["samples"], 1)
+    overhead = (header["sample_cycles"] + EXCEPTION_CYCLES) * header["rate_hz"] / header["cpu_hz"]
+    print("%d samples at %d Hz (%.1f s), %d dropped, %d addresses" % (
+        header["samples"], header["rate_hz"], header["samples"] / header["rate_hz"],
+        header["dropped"], len(dump.entries)))
+    print("sampler: %d cycles per sample + ~%d exception entry/exit, %.2f%% of the CPU" % (
+        header["sample_cycles"], EXCEPTION_CYCLES, 100 * overhead))
+    if len(dump.entries) < header["entries"]:
+        print("warning: dump incomplete, %d of %d entries" % (len(dump.entries), header["entries"]))
+
+    self_counts = collections.Counter()
+    caller_counts = collections.defaultdict(collections.Counter)
+    for pc, lr, count in dump.entries:
+        function = symbols.lookup(pc)
+        self_counts[function] += count
+        if header["flags"] & FLAG_LR:
+            caller_counts[function][symbols.lookup(lr) if lr else "?"] += count
+
+    print()
+    print("%7s %7s  %s" % ("self%", "cumul%", "function"))
+    cumulative = 0
+    for function, count in self_counts.most_common(top):
+        cumulative += count
+        print("%6.2f%% %6.2f%%  %s" % (100 * count / samples, 100 * cumulative / samples, function))
+
+    if callers and header["flags"] & FLAG_LR:
+        print()
+        print("LR at the sample (the caller for leaf functions):")
+        for function, count in self_counts.most_common(callers):
+            print("  %s" % function)
+            for caller, caller_count in caller_counts[function].most_common(3):
+                print("    %5.1f%%  <- %s" % (100 * caller_count / count, caller))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", nargs="?")
+    parser.add_argument("--seconds", type=float, default=10.0, help="how long to profile")
+    parser.add_argument("--elf", default=DEFAULT_ELF, help="firmware ELF (default %(default)s)")
+    parser.add_argument("--nm", help="nm to use (default: arm-none-eabi-nm, PlatformIO's, then nm)")
+    parser.add_argument("--save", metavar="FILE", help="also write the raw capture to FILE")
+    parser.add_argument("--load", metavar="FILE", help="report a saved capture instead of profiling")
+    parser.add_argument("--top", type=int, default=25, help="functions to list")
+    parser.add_argument("--callers", type=int, default=5, help="functions to list callers for")
+    args = parser.parse_args()
+
+    if args.load:
+        with open(args.load, "rb") as f:
+            data = f.read()
+    elif args.port:
+        data = capture(args.port, args.seconds)
+    else:
+        parser.error("a port or --load is required")
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(data)
+
+    dump = Dump()
+    dump.parse(data)
+    if dump.header is None:
+        sys.exit("no profile in the capture")
+    report(dump, Symbols(args.elf, find_nm(args.nm)), args.top, args.callers)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,235 @@
+// record_log_sim.cpp - Host test of util::RecordLog wear leveling and power loss
+//
+// Saves random payloads for 8 preset-sized records into an emulated
+// 4284-byte EEPROM (the Teensy 4.1 size), a few bytes per step as the
+// firmware does. Every so often the power is "cut" part way through a save:
+// the log is rebuilt from the EEPROM contents alone, and every record must
+// read back as its last completed save. At the end, the spread of writes
+// over the addresses shows the wear leveling; with update() semantics only
+// changed bytes count.
+//
+// The same saves then go to an emulated 64 KB flash region in write-once
+// mode, as the firmware keeps its presets: programming can only clear bits,
+// and a byte programmed twice without an erase fails the test. Each reboot
+// (after a cut, or when no erased slot is left) runs Scan() and Reclaim(),
+// and the erases per 4 KB sector show the leveling.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -o record_log_sim tools/record_log_sim.cpp
+//   ./record_log_sim [saves]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "../src/src/util/util_record_log.h"
+
+static constexpr size_t kEepromSize = 4284;
+static constexpr size_t kPayloadSize = 54;  // sizeof(OC::PRESET::State), one DAC
+static constexpr size_t kNumRecords = 8;
+static constexpr size_t kNumSlots = kEepromSize / util::RecordLogSlotSize(kPayloadSize);
+
+struct Eeprom {
+  uint8_t bytes[kEepromSize];
+  uint32_t writes[kEepromSize];
+
+  Eeprom() {
+    memset(bytes, 0xFF, sizeof(bytes));
+    memset(writes, 0, sizeof(writes));
+  }
+
+  void Read(uint32_t address, void *dst, size_t length) {
+    memcpy(dst, bytes + address, length);
+  }
+
+  void Write(uint32_t address, uint8_t value) {
+    if (bytes[address] != value) {
+      bytes[address] = value;
+      ++writes[address];
+    }
+  }
+};
+
+typedef util::RecordLog<Eeprom, kPayloadSize, kNumRecords, kNumSlots> Log;
+
+static constexpr size_t kFlashSize = 65536;
+static constexpr size_t kSectorSize = 4096;
+static constexpr size_t kFlashSlots = kFlashSize / util::RecordLogSlotSize(kPayloadSize);
+
+struct Flash {
+  uint8_t bytes[kFlashSize];
+  uint32_t erases[kFlashSize / kSectorSize];
+  uint32_t overwrites;  // Bytes programmed again without an erase
+
+  Flash() {
+    memset(bytes, 0xFF, sizeof(bytes));
+    memset(erases, 0, sizeof(erases));
+    overwrites = 0;
+  }
+
+  void Read(uint32_t address, void *dst, size_t length) {
+    memcpy(dst, bytes + address, length);
+  }
+
+  void Write(uint32_t address, uint8_t value) {
+    if (bytes[address] != 0xFF)
+      ++overwrites;
+    bytes[address] &= value;
+  }
+
+  void Erase(uint32_t address) {
+    memset(bytes + address, 0xFF, kSectorSize);
+    ++erases[address / kSectorSize];
+  }
+};
+
+typedef util::RecordLog<Flash, kPayloadSize, kNumRecords, kFlashSlots, true> FlashLog;
+
+static uint32_t errors = 0;
+
+// Every record must read back as its last completed save
+template <typename Device, typename L>
+static void Verify(Device &device, uint32_t save, const std::vector<std::vector<uint8_t>> &expected) {
+  static L check;
+  check.Init(&device, 0);
+  uint32_t mask = check.Scan();
+  for (size_t i = 0; i < kNumRecords; ++i) {
+    std::vector<uint8_t> loaded(kPayloadSize);
+    bool have = check.Load(i, loaded.data());
+    if (have != !expected[i].empty() || (have && loaded != expected[i]) ||
+        have != !!(mask & (1u << i))) {
+      if (errors++ < 10)
+        printf("save %u: record %zu doesn't match its last save\n", save, i);
+    }
+  }
+}
+
+// Mostly small edits of the previous version, as with real presets
+static std::vector<uint8_t> MakePayload(std::mt19937 &rng, const std::vector<uint8_t> &previous) {
+  std::vector<uint8_t> payload(kPayloadSize);
+  if (!previous.empty() && rng() % 4) {
+    payload = previous;
+    payload[rng() % kPayloadSize] = rng();
+  } else {
+    for (uint8_t &byte : payload)
+      byte = rng();
+  }
+  return payload;
+}
+
+static void RunFlash(uint32_t saves) {
+  std::mt19937 rng(1);
+  static Flash flash;
+  static FlashLog log;
+  uint32_t reboots = 0;
+  auto reboot = [&] {
+    ++reboots;
+    log.Init(&flash, 0);
+    log.Scan();
+    log.Reclaim(kSectorSize);
+  };
+  reboot();
+
+  std::vector<std::vector<uint8_t>> expected(kNumRecords);
+  uint32_t cuts = 0, full = 0;
+  for (uint32_t save = 0; save < saves; ++save) {
+    size_t index = rng() % kNumRecords;
+    std::vector<uint8_t> payload = MakePayload(rng, expected[index]);
+    if (!log.Begin(index, payload.data())) {
+      // Out of erased slots: refused, and reclaimed at the next boot
+      ++full;
+      reboot();
+      if (!log.Begin(index, payload.data())) {
+        printf("save %u: no slot after a reclaim\n", save);
+        ++errors;
+        break;
+      }
+    }
+    // Rarer cuts than above, so the region also fills up between reboots
+    bool cut = !(rng() % 1024);
+    size_t cut_after = rng() % Log::kSlotSize;
+    size_t written = 0;
+    while (!log.Step(1)) {
+      if (cut && ++written >= cut_after)
+        break;
+    }
+    if (cut && log.busy()) {
+      ++cuts;
+      reboot();
+    } else {
+      expected[index] = payload;
+    }
+    Verify<Flash, FlashLog>(flash, save, expected);
+  }
+
+  uint32_t min_erases = UINT32_MAX, max_erases = 0;
+  for (uint32_t erases : flash.erases) {
+    min_erases = erases < min_erases ? erases : min_erases;
+    max_erases = erases > max_erases ? erases : max_erases;
+  }
+  printf("flash: %zu slots in %zu sectors, %u saves (%u cut), %u reboots (%u when full)\n",
+         kFlashSlots, kFlashSize / kSectorSize, saves, cuts, reboots, full);
+  printf("erases per sector: min=%u max=%u; bytes programmed twice: %u\n", min_erases, max_erases,
+         flash.overwrites);
+  if (flash.overwrites)
+    ++errors;
+}
+
+int main(int argc, char **argv) {
+  const uint32_t saves = argc > 1 ? atoi(argv[1]) : 20000;
+  std::mt19937 rng(1);
+
+  static Eeprom eeprom;
+  static Log log;
+  log.Init(&eeprom, 0);
+  log.Scan();
+
+  std::vector<std::vector<uint8_t>> expected(kNumRecords);
+  uint32_t cuts = 0, steps = 0;
+  for (uint32_t save = 0; save < saves; ++save) {
+    size_t index = rng() % kNumRecords;
+    std::vector<uint8_t> payload = MakePayload(rng, expected[index]);
+
+    log.Begin(index, payload.data());
+    bool cut = !(rng() % 16);
+    size_t cut_after = rng() % (Log::kSlotSize + 2);
+    size_t written = 0;
+    while (!log.Step(4)) {
+      ++steps;
+      written += 4;
+      if (cut && written >= cut_after)
+        break;
+    }
+
+    if (cut && log.busy()) {
+      // Power loss: start over from what the EEPROM holds
+      ++cuts;
+      log.Init(&eeprom, 0);
+      log.Scan();
+    } else {
+      expected[index] = payload;
+    }
+
+    // Check a fresh scan every time, as after a reboot
+    Verify<Eeprom, Log>(eeprom, save, expected);
+  }
+
+  uint32_t max_writes = 0, min_writes = UINT32_MAX;
+  uint64_t total = 0;
+  for (size_t address = 0; address < Log::kStorageSize; ++address) {
+    max_writes = eeprom.writes[address] > max_writes ? eeprom.writes[address] : max_writes;
+    min_writes = eeprom.writes[address] < min_writes ? eeprom.writes[address] : min_writes;
+    total += eeprom.writes[address];
+  }
+  const double mean = static_cast<double>(total) / Log::kStorageSize;
+
+  printf("%zu slots of %zu bytes, %u saves (%u cut), %u steps\n", kNumSlots, Log::kSlotSize,
+         saves, cuts, steps);
+  printf("writes per byte: min=%u max=%u mean=%.1f; without leveling ~%.0f\n", min_writes,
+         max_writes, mean, static_cast<double>(total) / (kNumRecords * Log::kSlotSize));
+
+  RunFlash(saves);
+  printf("%s\n", errors ? "FAILED" : "every record reads back as its last completed save");
+  return errors ? 1 : 0;
+}
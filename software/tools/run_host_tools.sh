@@ -0,0 +1,55 @@
+#!/bin/bash
+# run_host_tools.sh - Build and run every host tool, as CI does
+#
+# Each tools/*.cpp carries its own build command in its file header, after
+# "Build and run from the software/ directory". This script takes that
+# command, builds the tool into a temporary directory and runs it with its
+# default arguments. It stops at the first tool that fails to build or run.
+#
+# Run from the software/ directory:
+#   tools/run_host_tools.sh [tool ...]
+
+set -e
+
+if [ ! -d tools ] || [ ! -d src/src ]; then
+    echo "Error: run this script from the software/ directory"
+    exit 1
+fi
+
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+
+if [ $# -gt 0 ]; then
+    tools=("$@")
+else
+    tools=()
+    for source in tools/*.cpp; do
+        tools+=("$(basename "$source" .cpp)")
+    done
+fi
+
+for tool in "${tools[@]}"; do
+    source="tools/$tool.cpp"
+    # The g++ line and its indented continuation lines, up to any "&& ./tool"
+    command=$(awk '
+        /^\/\/   g\+\+ / { found = 1; sub(/^\/\/ +/, ""); line = $0; next }
+        found && /^\/\/       / { sub(/^\/\/ +/, ""); line = line " " $0; next }
+        found { exit }
+        END { print line }
+    ' "$source" | sed 's/ *&&.*$//')
+    if [ -z "$command" ]; then
+        echo "Error: no build command in $source"
+        exit 1
+    fi
+    command=${command/ -o $tool / -o $out/$tool }
+
+    echo "=================================================="
+    echo "$tool"
+    echo "=================================================="
+    echo "$command"
+    $command
+    "$out/$tool"
+    echo ""
+done
+
+echo "All host tools passed: ${tools[*]}"
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""screen_view.py - Show the module's screen on the host
+
+Reads the mirror packets described in src/src/OC_mirror.h from the USB serial
+port and draws the 128x64 screen in the terminal with half-block characters,
+along with the bytes per frame and the link rate. Text that isn't part of a
+packet (debug output) is printed below the screen.
+
+Mirroring is started with 'V' on the serial port. The viewer sends it if no
+frames arrive within a second.
+
+Examples:
+  tools/screen_view.py /dev/ttyACM0
+
+  # Also save every frame as a PBM image
+  tools/screen_view.py /dev/ttyACM0 --record frames/
+
+Requires pyserial.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+import serial
+
+# Framing and packet types as in src/src/OC_packet.h
+SYNC = 0xA5
+PACKET_KEY_FRAME = 0x10
+PACKET_DELTA_FRAME = 0x11
+WIDTH = 128
+HEIGHT = 64
+FRAME_SIZE = WIDTH * HEIGHT // 8
+MIN_REPEAT = 3
+
+
+def decode(data, frame):
+    """XOR the delta coded by util::DeltaRLE into frame; False if malformed."""
+    pos = 0
+    i = 0
+    while i < len(data):
+        control = data[i]
+        i += 1
+        if control & 0x80:
+            run = (control & 0x7F) + MIN_REPEAT
+            if i >= len(data) or pos + run > len(frame):
+                return False
+            value = data[i]
+            i += 1
+            for _ in range(run):
+                frame[pos] ^= value
+                pos += 1
+        else:
+            run = control + 1
+            if i + run > len(data) or pos + run > len(frame):
+                return False
+            for value in data[i:i + run]:
+                frame[pos] ^= value
+                pos += 1
+            i += run
+    return pos == len(frame)
+
+
+def pixel(frame, x, y):
+    return (frame[(y // 8) * WIDTH + x] >> (y % 8)) & 1
+
+
+def render(frame):
+    chars = " ▄▀█"  # neither, lower, upper, both
+    lines = []
+    for y in range(0, HEIGHT, 2):
+        lines.append("".join(chars[pixel(frame, x, y) * 2 + pixel(frame, x, y + 1)] for x in range(WIDTH)))
+    return "\n".join(lines)
+
+
+def write_pbm(path, frame):
+    rows = bytearray()
+    for y in range(HEIGHT):
+        for x in range(0, WIDTH, 8):
+            byte = 0
+            for bit in range(8):
+                byte |= pixel(frame, x + bit, y) << (7 - bit)
+            rows.append(byte)
+    with open(path, "wb") as f:
+        f.write(b"P4\n%d %d\n" % (WIDTH, HEIGHT) + bytes(rows))
+
+
+class Receiver:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.frame = bytearray(FRAME_SIZE)
+        self.synced = False   # a key frame has been received
+        self.sequence = None
+        self.frames = 0
+        self.missed = 0
+        self.errors = 0
+        self.last_bytes = 0
+        self.text = bytearray()
+
+    def feed(self, data):
+        """Parse received bytes; returns True if a new frame was decoded."""
+        self.buffer += data
+        updated = False
+        while self.buffer:
+            if self.buffer[0] != SYNC:
+                self.text.append(self.buffer.pop(0))
+                continue
+            if len(self.buffer) < 4:
+                break
+            _, packet_type, length = struct.unpack_from("<BBH", self.buffer)
+            if packet_type not in (PACKET_KEY_FRAME, PACKET_DELTA_FRAME):
+                self.text.append(self.buffer.pop(0))
+                continue
+            if len(self.buffer) < 4 + length:
+                break
+            payload = bytes(self.buffer[4:4 + length])
+            del self.buffer[:4 + length]
+            updated |= self.packet(packet_type, payload)
+        return updated
+
+    def packet(self, packet_type, payload):
+        if len(payload) < 4:
+            self.errors += 1
+            return False
+        (sequence,) = struct.unpack_from("<I", payload)
+        if packet_type == PACKET_KEY_FRAME:
+            self.frame = bytearray(FRAME_SIZE)
+            self.synced = True
+        elif not self.synced:
+            return False
+        if self.sequence is not None and sequence > self.sequence + 1:
+            self.missed += sequence - self.sequence - 1
+        self.sequence = sequence
+        if not decode(payload[4:], self.frame):
+            self.errors += 1
+            self.synced = False
+            return False
+        self.frames += 1
+        self.last_bytes = 4 + len(payload)
+        return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port")
+    parser.add_argument("--record", metavar="DIR", help="save each frame as DIR/frame_NNNNNN.pbm")
+    args = parser.parse_args()
+
+    if args.record:
+        os.makedirs(args.record, exist_ok=True)
+
+    port = serial.Serial(args.port, timeout=0.05)
+    receiver = Receiver()
+    start = time.monotonic()
+    total_bytes = 0
+    last_frame_time = start
+    requested = False
+
+    sys.stdout.write("\x1b[2J")
+    try:
+        while True:
+            data = port.read(port.in_waiting or 1)
+            total_bytes += len(data)
+            now = time.monotonic()
+            if receiver.feed(data):
+                last_frame_time = now
+                if args.record:
+                    write_pbm(os.path.join(args.record, "frame_%06d.pbm" % receiver.sequence), receiver.frame)
+                rate = total_bytes / max(now - start, 1e-3) / 1000
+                sys.stdout.write("\x1b[H" + render(receiver.frame) + "\n")
+                sys.stdout.write("frame %d: %4d bytes (raw %d), %.1f kB/s, missed %d, errors %d\x1b[K\n"
+                                 % (receiver.sequence, receiver.last_bytes, FRAME_SIZE, rate,
+                                    receiver.missed, receiver.errors))
+            if receiver.text and b"\n" in receiver.text:
+                lines, _, rest = bytes(receiver.text).rpartition(b"\n")
+                receiver.text = bytearray(rest)
+                # Latest debug output below the screen
+                sys.stdout.write("\x1b[%dH\x1b[J" % (HEIGHT // 2 + 3))
+                sys.stdout.write("\n".join(lines.decode("utf-8", "replace").splitlines()[-8:]) + "\n")
+            if not requested and now - last_frame_time > 1.0:
+                port.write(b"V")
+                requested = True
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print("\n%d frames, %d missed, %d errors" % (receiver.frames, receiver.missed, receiver.errors))
+
+
+if __name__ == "__main__":
+    main()
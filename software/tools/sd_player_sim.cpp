@@ -0,0 +1,208 @@
+// sd_player_sim.cpp - Host build of the SD block player with injected latency
+//
+// Writes a test file in the CV block format, then plays it with
+// util::BlockPlayer from a real-time consumer thread while a producer thread
+// prefetches through a file-backed block device that adds a read latency and
+// occasional long stalls (as SD cards do while erasing or remapping). Every
+// played frame is checked against the expected data, and underruns are
+// counted. First, Open() must refuse headers whose block size or block
+// offsets overflow 32 bits.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++17 -pthread -o sd_player_sim tools/sd_player_sim.cpp
+//   ./sd_player_sim [rate] [channels] [latency_ms] [stall_ms] [stall_percent] [loop_ms]
+// e.g. ./sd_player_sim 48000 2 2 60 2 40  (audio file, 40 ms display stalls)
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/src/util/util_block_player.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t kBufferSize = 16384;  // As OC::PLAYER::kBufferSize
+static const char kPath[] = "sd_player_sim.ocv";
+
+static inline uint16_t Expected(uint32_t frame, size_t channel) {
+  return static_cast<uint16_t>(frame * 8 + channel);
+}
+
+struct FileBlockDevice {
+  FILE *file = nullptr;
+  std::mt19937 rng{1};
+  double latency_ms = 0.0;
+  double stall_ms = 0.0;
+  double stall_probability = 0.0;
+  std::chrono::duration<double, std::milli> read_time{0};
+  uint32_t reads = 0;
+  double max_read_ms = 0.0;
+
+  bool Read(uint32_t offset, void *dst, size_t length) {
+    auto start = Clock::now();
+    double delay = latency_ms;
+    if (std::uniform_real_distribution<double>(0, 1)(rng) < stall_probability)
+      delay += stall_ms;
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delay));
+    bool ok = !fseek(file, offset, SEEK_SET) && fread(dst, 1, length, file) == length;
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    read_time += elapsed;
+    ++reads;
+    if (elapsed.count() > max_read_ms)
+      max_read_ms = elapsed.count();
+    return ok;
+  }
+};
+
+static bool WriteFile(uint32_t rate, size_t channels, uint32_t frames) {
+  util::CVFileHeader header = {};
+  header.magic = util::kCVFileMagic;
+  header.version = util::kCVFileVersion;
+  header.num_channels = channels;
+  header.sample_rate = rate;
+  header.num_frames = frames;
+  header.block_size = kBufferSize;
+  header.frames_per_block = kBufferSize / (channels * sizeof(uint16_t));
+  for (size_t i = 0; i < channels; ++i)
+    header.channels[i] = i;
+
+  FILE *file = fopen(kPath, "wb");
+  if (!file)
+    return false;
+  uint8_t sector[util::kCVFileHeaderSize] = {};
+  memcpy(sector, &header, sizeof(header));
+  fwrite(sector, 1, sizeof(sector), file);
+
+  static uint8_t block[kBufferSize];
+  for (uint32_t first = 0; first < frames; first += header.frames_per_block) {
+    memset(block, 0, sizeof(block));
+    uint16_t *samples = reinterpret_cast<uint16_t *>(block);
+    for (uint32_t i = 0; i < header.frames_per_block && first + i < frames; ++i) {
+      for (size_t channel = 0; channel < channels; ++channel)
+        samples[i * channels + channel] = Expected(first + i, channel);
+    }
+    fwrite(block, 1, sizeof(block), file);
+  }
+  return !fclose(file);
+}
+
+// Serves a header and nothing else
+struct HeaderDevice {
+  util::CVFileHeader header;
+
+  bool Read(uint32_t offset, void *dst, size_t length) {
+    memset(dst, 0, length);
+    if (!offset)
+      memcpy(dst, &header, sizeof(header) < length ? sizeof(header) : length);
+    return true;
+  }
+};
+
+static bool CheckHeaders() {
+  struct Case {
+    const char *what;
+    uint16_t num_channels;
+    uint32_t num_frames, block_size, frames_per_block;
+    bool valid;
+  };
+  static const Case cases[] = {
+    { "frames per block x frame size wraps to 16 bytes", 8, 1000, 16384, 0x80000001, false },
+    { "frames per block one over the block", 8, 1000, 16384, 1025, false },
+    { "last block offset past 4 GB", 1, 0xFFFFFFFF, 512, 256, false },
+    { "frame count rounding up past 32 bits", 1, 0xFFFFFFFF, 16384, 8192, false },
+    { "zero block size", 1, 1000, 0, 1, false },
+    { "largest file that fits", 1, (0xFFFFFFFFu / 16384 - 1) * 8192, 16384, 8192, true },
+  };
+  static util::BlockPlayer<HeaderDevice, kBufferSize> player;
+  bool ok = true;
+  for (const Case &test : cases) {
+    HeaderDevice device;
+    memset(&device.header, 0, sizeof(device.header));
+    device.header.magic = util::kCVFileMagic;
+    device.header.version = util::kCVFileVersion;
+    device.header.num_channels = test.num_channels;
+    device.header.sample_rate = 1000;
+    device.header.num_frames = test.num_frames;
+    device.header.block_size = test.block_size;
+    device.header.frames_per_block = test.frames_per_block;
+    const bool opened = player.Open(&device) == player.ERROR_NONE;
+    if (opened != test.valid) {
+      printf("FAILED: header with %s %s\n", test.what, opened ? "accepted" : "refused");
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (!CheckHeaders())
+    return 1;
+  uint32_t rate = argc > 1 ? atoi(argv[1]) : 1000;
+  size_t channels = argc > 2 ? atoi(argv[2]) : 8;
+  double seconds = 5.0;
+  uint32_t frames = rate * seconds;
+
+  FileBlockDevice device;
+  device.latency_ms = argc > 3 ? atof(argv[3]) : 2.0;
+  device.stall_ms = argc > 4 ? atof(argv[4]) : 100.0;
+  device.stall_probability = (argc > 5 ? atof(argv[5]) : 2.0) / 100.0;
+  double loop_ms = argc > 6 ? atof(argv[6]) : 33.0;
+
+  if (!channels || channels > util::kCVFileMaxChannels || !WriteFile(rate, channels, frames)) {
+    fprintf(stderr, "Can't write %s\n", kPath);
+    return 1;
+  }
+  device.file = fopen(kPath, "rb");
+
+  static util::BlockPlayer<FileBlockDevice, kBufferSize> player;
+  if (player.Open(&device) != player.ERROR_NONE) {
+    fprintf(stderr, "Can't open %s\n", kPath);
+    return 1;
+  }
+  player.Prefetch();
+
+  printf("%u Hz x %u channels, %.1f ms per block; read latency %.1f ms, %.1f%% stalls of %.0f ms, loop every %.0f ms\n",
+         (unsigned)rate, (unsigned)channels, 1000.0 * player.header().frames_per_block / rate,
+         device.latency_ms, 100.0 * device.stall_probability, device.stall_ms, loop_ms);
+
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    while (!done) {
+      player.Prefetch();
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(loop_ms));
+    }
+  });
+
+  // Consumer ticks in batches of 1 ms to stay close to real time
+  uint32_t played = 0, mismatches = 0, min_buffered = UINT32_MAX;
+  auto next = Clock::now();
+  const uint32_t batch = rate / 1000 ? rate / 1000 : 1;
+  while (!player.finished()) {
+    next += std::chrono::microseconds(1000000 * batch / rate);
+    std::this_thread::sleep_until(next);
+    uint32_t buffered = player.buffered();
+    if (buffered < min_buffered)
+      min_buffered = buffered;
+    for (uint32_t i = 0; i < batch; ++i) {
+      const uint16_t *frame = player.Next();
+      if (!frame)
+        continue;
+      for (size_t channel = 0; channel < channels; ++channel)
+        mismatches += frame[channel] != Expected(played, channel);
+      ++played;
+    }
+  }
+  done = true;
+  producer.join();
+  fclose(device.file);
+  remove(kPath);
+
+  printf("played %u/%u frames, %u mismatched samples, %u underruns, min buffered %u frames\n",
+         (unsigned)played, (unsigned)frames, (unsigned)mismatches, (unsigned)player.underruns(),
+         (unsigned)min_buffered);
+  printf("%u blocks read, mean read %.1f ms, max %.1f ms\n", (unsigned)player.blocks_read(),
+         device.read_time.count() / device.reads, device.max_read_ms);
+  return mismatches || played != frames;
+}
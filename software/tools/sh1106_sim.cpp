@@ -0,0 +1,252 @@
+// sh1106_sim.cpp - Host build of the SH1106 display path with an emulated OLED
+//
+// Runs the firmware's SH1106 driver, PagedDisplayDriver, frame buffer and
+// weegfx against an SH1106 model fed from the host SPI stand-in. Frames are
+// drawn the way Main.cpp does. Each one is checked pixel for pixel against
+// the model's display RAM. The tool reports how many pages were sent or
+// skipped and the bus time per frame at the driver's SPI clock.
+//
+// A second run mirrors frames through CompositeDisplayDriver to the OLED and a
+// slow stand-in backend (a TFT-sized page time). Frames come faster than the
+// slow backend can keep up with. The OLED must still show every frame, and
+// the slow backend must end up on the last frame.
+//
+// The driver starts up as a coroutine task (reset waits, then a DMA clear of
+// each page), so Init() has to return before the display is on and the task
+// is polled the way loop() does until it is.
+//
+// Build and run from the software/ directory:
+//   g++ -O2 -std=gnu++20 -Wno-volatile -Itools/host -o sh1106_sim tools/sh1106_sim.cpp
+//       src/src/drivers/SH1106_driver.cpp src/src/drivers/display.cpp
+//       src/src/drivers/weegfx.cpp src/src/OC_coro.cpp
+//   ./sh1106_sim
+
+#include <stdio.h>
+#include <Arduino.h>
+#include <SPI.h>
+#include "../src/src/drivers/display.h"
+#include "../src/src/drivers/composite_display_driver.h"
+#include "../src/src/OC_coro.h"
+#include "host/sh1106_model.h"
+
+static constexpr size_t kFrameSize = SH1106_128x64_Driver::kFrameSize;
+
+static SH1106Model oled;
+
+static void OnByte(uint8_t byte) {
+  if (host_pins[SH1106_CS_PIN] == LOW)
+    oled.Write(byte, host_pins[SH1106_DC_PIN] == HIGH);
+}
+
+static int Compare(const uint8_t *frame, uint8_t offset) {
+  int errors = 0;
+  for (int y = 0; y < 64; ++y) {
+    for (int x = 0; x < 128; ++x) {
+      bool expected = (frame[(y / 8) * 128 + x] >> (y % 8)) & 1;
+      errors += oled.pixel(x, y, offset) != expected;
+    }
+  }
+  return errors;
+}
+
+struct Result {
+  uint32_t frames = 0;
+  uint32_t errors = 0;
+  uint64_t cycles = 0;
+};
+
+// Hand the frame to the driver and run display updates until every page has
+// been sent or skipped, as the main loop does between redraws
+static void Present(Result &result, const uint8_t *expected, uint8_t offset) {
+  uint32_t start = ARM_DWT_CYCCNT;
+  display::Update();
+  while (display::driver.frame_valid())
+    display::Update();
+  display::Flush();
+  result.cycles += ARM_DWT_CYCCNT - start;
+  result.errors += Compare(expected, offset);
+  ++result.frames;
+}
+
+static void Report(const char *label, const Result &result, const SH1106_128x64_Driver::Stats &stats) {
+  printf("%-22s %4u frames: %5.2f pages sent/frame, %5.2f skipped, %6.1f us bus/frame, %u pixel errors\n",
+         label, (unsigned)result.frames, static_cast<double>(stats.pages) / result.frames,
+         static_cast<double>(stats.skipped) / result.frames,
+         1e6 * result.cycles / result.frames / F_CPU, (unsigned)result.errors);
+}
+
+// Stays busy for a TFT page time after each page it accepts
+struct SlowBackend {
+  static constexpr size_t kFrameSize = SH1106_Driver::kFrameSize;
+  static constexpr size_t kNumPages = SH1106_Driver::kNumPages;
+  static constexpr size_t kPageSize = SH1106_Driver::kPageSize;
+  static constexpr uint8_t kDefaultOffset = 0;
+  static constexpr uint32_t kPageCycles = F_CPU / 1000 * 22 / 10;  // 2.2 ms
+  typedef SH1106_Driver::Stats Stats;
+
+  static inline uint8_t screen[kNumPages][kPageSize];
+  static inline uint32_t start;
+  static inline bool in_flight;
+  static inline Stats transfer_stats;
+
+  static void Init() { in_flight = false; }
+  static void Clear() {}
+  static void Flush() {}
+  static void Poll() {}
+  static bool busy() {
+    if (in_flight && ARM_DWT_CYCCNT - start >= kPageCycles) {
+      in_flight = false;
+      transfer_stats.busy_cycles += kPageCycles;
+    }
+    return in_flight;
+  }
+  static bool SendPage(uint_fast8_t index, const uint8_t *data) {
+    if (busy())
+      return false;
+    memcpy(screen[index], data, kPageSize);
+    start = ARM_DWT_CYCCNT;
+    in_flight = true;
+    ++transfer_stats.pages;
+    return true;
+  }
+  static void SPI_send(void *, size_t) {}
+  static void AdjustOffset(uint8_t) {}
+  static void ChangeSpeed(uint32_t) {}
+  static void SetFlipMode(bool) {}
+  static void SetContrast(uint8_t) {}
+  static Stats stats() { return transfer_stats; }
+  static void ResetStats() { transfer_stats = {}; }
+};
+
+// Poll the start-up task every 10 us of loop time until the display is on.
+// Returns the cycles Init() took, or ~0 if it blocked until the display was on.
+template <typename Init>
+static uint32_t StartUp(Init init) {
+  uint32_t start = ARM_DWT_CYCCNT;
+  init();
+  uint32_t init_cycles = ARM_DWT_CYCCNT - start;
+  if (!SH1106_Driver::busy())
+    return ~0u;
+  while (SH1106_Driver::busy()) {
+    ARM_DWT_CYCCNT += F_CPU / 100000;
+    OC::CORO::Poll();
+  }
+  printf("start-up: Init() %.1f us, display on after %.1f ms, %u coroutine frames in use\n",
+         init_cycles * 1e6 / F_CPU, (ARM_DWT_CYCCNT - start) * 1e3 / F_CPU,
+         static_cast<unsigned>(OC::CORO::frame_stats().in_use));
+  return init_cycles;
+}
+
+static int RunMirror() {
+  typedef CompositeDisplayDriver<SH1106_Driver, SlowBackend> Mirror;
+  static PagedDisplayDriver<Mirror> mirror;
+  static constexpr uint32_t kFrameCycles = F_CPU / 200;  // 5 ms per frame
+  static constexpr uint32_t kLoopCycles = F_CPU / 100000;  // 10 us main loop
+  static uint8_t frame[kFrameSize];
+
+  StartUp([] { mirror.Init(); });
+  SH1106_Driver::AdjustOffset(SH1106_Driver::kDefaultOffset);
+  int oled_errors = 0;
+  const int kFrames = 200;
+  for (int i = 0; i < kFrames; ++i) {
+    for (size_t byte = 0; byte < kFrameSize; ++byte)
+      frame[byte] = static_cast<uint8_t>(byte * 7 + i * 13);
+    mirror.Begin(frame);
+    while (mirror.frame_valid())
+      mirror.Update();
+    for (uint32_t t = 0; t < kFrameCycles; t += kLoopCycles) {
+      ARM_DWT_CYCCNT += kLoopCycles;
+      mirror.Poll();
+    }
+    oled_errors += Compare(frame, SH1106_Driver::kDefaultOffset) != 0;
+  }
+  while (Mirror::busy()) {
+    ARM_DWT_CYCCNT += kLoopCycles;
+    mirror.Poll();
+  }
+  bool slow_current = !memcmp(SlowBackend::screen, frame, kFrameSize);
+
+  printf("mirror %d frames every 5 ms: OLED %u pages, %d frames wrong; slow backend %u pages (%.1f frames), %s\n",
+         kFrames, (unsigned)SH1106_Driver::stats().pages, oled_errors,
+         (unsigned)SlowBackend::stats().pages,
+         static_cast<double>(SlowBackend::stats().pages) / SlowBackend::kNumPages,
+         slow_current ? "ends on the last frame" : "NOT on the last frame");
+  return oled_errors + !slow_current;
+}
+
+int main() {
+  SPI.device = OnByte;
+  OC::CORO::Init();
+  int failures = 0;
+  if (StartUp(display::Init) == ~0u) {
+    printf("Init() blocked until the display was on\n");
+    ++failures;
+  }
+  uint8_t blank[kFrameSize] = {};
+  if (!oled.on() || Compare(blank, SH1106_128x64_Driver::kDefaultOffset)) {
+    printf("display not initialized\n");
+    ++failures;
+  }
+
+  static uint8_t expected[kFrameSize];
+
+  // Mostly static screen: title and border with a moving ball, as Main.cpp
+  SH1106_128x64_Driver::ResetStats();
+  Result demo;
+  int ball_x = 64, ball_y = 32, ball_dx = 2, ball_dy = 1;
+  for (int i = 0; i < 300; ++i) {
+    ball_x += ball_dx;
+    ball_y += ball_dy;
+    if (ball_x <= 4 || ball_x >= 123) ball_dx = -ball_dx;
+    if (ball_y <= 4 || ball_y >= 59) ball_dy = -ball_dy;
+    GRAPHICS_BEGIN_FRAME(true);
+    graphics.drawFrame(0, 0, 128, 64);
+    graphics.drawStr(20, 2, "O_C Phazerville");
+    graphics.drawCircle(ball_x, ball_y, 4);
+    memcpy(expected, frame, kFrameSize);
+    GRAPHICS_END_FRAME();
+    Present(demo, expected, SH1106_128x64_Driver::kDefaultOffset);
+  }
+  Report("ball", demo, SH1106_128x64_Driver::stats());
+
+  // Every page changes on every frame
+  SH1106_128x64_Driver::ResetStats();
+  Result inverting;
+  for (int i = 0; i < 100; ++i) {
+    GRAPHICS_BEGIN_FRAME(true);
+    graphics.drawStr(2, 2, "invert");
+    if (i & 1)
+      graphics.invertRect(0, 0, 128, 64);
+    memcpy(expected, frame, kFrameSize);
+    GRAPHICS_END_FRAME();
+    Present(inverting, expected, SH1106_128x64_Driver::kDefaultOffset);
+  }
+  Report("invert", inverting, SH1106_128x64_Driver::stats());
+
+  // A new offset has to rewrite every page even though the frame is the same
+  display::AdjustOffset(0);
+  SH1106_128x64_Driver::ResetStats();
+  Result moved;
+  GRAPHICS_BEGIN_FRAME(true);
+  graphics.drawStr(2, 2, "invert");
+  graphics.invertRect(0, 0, 128, 64);
+  memcpy(expected, frame, kFrameSize);
+  GRAPHICS_END_FRAME();
+  Present(moved, expected, 0);
+  Report("offset 0", moved, SH1106_128x64_Driver::stats());
+  if (SH1106_128x64_Driver::stats().pages != SH1106_128x64_Driver::kNumPages) {
+    printf("offset change did not resend all pages\n");
+    ++failures;
+  }
+
+  display::SetContrast(0x40);
+  if (oled.contrast() != 0x40) {
+    printf("contrast not set\n");
+    ++failures;
+  }
+
+  failures += demo.errors + inverting.errors + moved.errors;
+  failures += RunMirror();
+  printf("%s\n", failures ? "FAILED" : "display matches");
+  return failures != 0;
+}
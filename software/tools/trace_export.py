@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""trace_export.py - Timeline of the module's event trace for Perfetto
+
+Starts the trace described in src/src/OC_trace.h with 'E', waits, sends 'E'
+again and reads the dump. The records are converted to Chrome trace JSON,
+which https://ui.perfetto.dev and chrome://tracing open directly: one track
+per ISR, the main loop and each bus, with the begin/end pairs as slices and
+the page, strip or word count as an argument.
+
+The records carry the low 32 bits of the cycle counter, which wraps every
+7 s at 600 MHz. Records are stored in order, so each one is unwrapped
+against the one before. A record interrupted between claiming its slot and
+reading the counter lands before the interrupt's own records with a later
+time, so records are sorted after unwrapping.
+
+Examples:
+  tools/trace_export.py /dev/ttyACM0 --seconds 0.5 -o trace.json
+
+  # Keep the raw dump and convert it again later
+  tools/trace_export.py /dev/ttyACM0 --save trace.bin -o trace.json
+  tools/trace_export.py --load trace.bin -o trace.json
+
+The ring keeps the last 16384 records. The core tick and its DAC writes
+alone take about 8 per 60 us tick, so that is on the order of 100 ms; a
+longer capture only keeps the end of it. Requires pyserial (not with --load).
+"""
+
+import argparse
+import json
+import struct
+import sys
+import time
+
+# Framing and packet types as in src/src/OC_packet.h
+SYNC = 0xA5
+PACKET_HEADER = 0x30
+PACKET_NAMES = 0x31
+PACKET_RECORDS = 0x32
+HEADER = struct.Struct("<IIII")
+RECORD = struct.Struct("<IBBH")
+PHASES = {0: "B", 1: "E", 2: "i"}
+
+
+class Dump:
+    def __init__(self):
+        self.header = None
+        self.events = []
+        self.records = []
+        self.text = bytearray()
+
+    def complete(self):
+        return self.header is not None and len(self.records) >= self.header["records"]
+
+    def parse(self, data):
+        """Parse a capture; bytes outside the trace packets are debug text."""
+        pos = 0
+        packets = (PACKET_HEADER, PACKET_NAMES, PACKET_RECORDS)
+        while pos < len(data):
+            if data[pos] != SYNC or pos + 4 > len(data):
+                self.text.append(data[pos])
+                pos += 1
+                continue
+            _, packet_type, length = struct.unpack_from("<BBH", data, pos)
+            if packet_type not in packets or pos + 4 + length > len(data):
+                self.text.append(data[pos])
+                pos += 1
+                continue
+            payload = data[pos + 4:pos + 4 + length]
+            pos += 4 + length
+            if packet_type == PACKET_HEADER and length == HEADER.size:
+                names = ("cpu_hz", "records", "lost", "record_cycles")
+                self.header = dict(zip(names, HEADER.unpack(payload)))
+                self.events = []
+                self.records = []
+            elif packet_type == PACKET_NAMES and self.header is not None:
+                strings = payload.split(b"\0")[:-1]
+                self.events = [(strings[i].decode(), strings[i + 1].decode())
+                               for i in range(0, len(strings) - 1, 2)]
+            elif packet_type == PACKET_RECORDS and self.header is not None:
+                self.records += [RECORD.unpack_from(payload, i) for i in range(0, length, RECORD.size)]
+
+
+def capture(port_name, seconds):
+    import serial
+
+    port = serial.Serial(port_name, timeout=0.1)
+    port.reset_input_buffer()
+    port.write(b"E")
+    print("tracing for %.2f s..." % seconds, file=sys.stderr)
+    time.sleep(seconds)
+    port.reset_input_buffer()
+    port.write(b"E")
+    data = bytearray()
+    deadline = time.monotonic() + 5.0
+    while time.monotonic() < deadline:
+        data += port.read(port.in_waiting or 1)
+        dump = Dump()
+        dump.parse(bytes(data))
+        if dump.complete():
+            break
+    return bytes(data)
+
+
+def unwrap(records):
+    """(cycles, phase, event, arg) with 64-bit cycles, sorted by time."""
+    unwrapped = []
+    cycles = None
+    for low, phase, event, arg in records:
+        if cycles is None:
+            cycles = low
+        else:
+            delta = (low - cycles) & 0xFFFFFFFF
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            cycles += delta
+        unwrapped.append((cycles, phase, event, arg))
+    unwrapped.sort(key=lambda record: record[0])
+    return unwrapped
+
+
+def export(dump):
+    header = dump.header
+    cycles_per_us = header["cpu_hz"] / 1e6
+    tracks = []
+    for _, track in dump.events:
+        if track not in tracks:
+            tracks.append(track)
+
+    trace = [{"ph": "M", "pid": 1, "name": "process_name", "args": {"name": "O_C"}}]
+    for tid, track in enumerate(tracks):
+        trace.append({"ph": "M", "pid": 1, "tid": tid, "name": "thread_name", "args": {"name": track}})
+        trace.append({"ph": "M", "pid": 1, "tid": tid, "name": "thread_sort_index", "args": {"sort_index": tid}})
+
+    records = unwrap(dump.records)
+    start = records[0][0] if records else 0
+    # Records lost to the ring may leave an end without its begin, which
+    # would close a slice that isn't open. Slices on a track may nest (an ISR
+    # writing the DAC while the core tick does).
+    depth = [0] * len(dump.events)
+    unknown = 0
+    for cycles, phase, event, arg in records:
+        if event >= len(dump.events) or phase not in PHASES:
+            unknown += 1
+            continue
+        name, track = dump.events[event]
+        if phase == 0:
+            depth[event] += 1
+        elif phase == 1:
+            if not depth[event]:
+                continue
+            depth[event] -= 1
+        entry = {"ph": PHASES[phase], "pid": 1, "tid": tracks.index(track), "name": name,
+                 "ts": round((cycles - start) / cycles_per_us, 3)}
+        if phase == 0:
+            entry["args"] = {"arg": arg}
+        elif phase == 2:
+            entry["s"] = "t"
+            entry["args"] = {"arg": arg}
+        trace.append(entry)
+
+    span_ms = (records[-1][0] - start) / cycles_per_us / 1000 if records else 0
+    print("%d records over %.2f ms, %d lost, %d cycles per record" % (
+        len(records), span_ms, header["lost"], header["record_cycles"]), file=sys.stderr)
+    if len(dump.records) < header["records"]:
+        print("warning: dump incomplete, %d of %d records" % (len(dump.records), header["records"]),
+              file=sys.stderr)
+    if unknown:
+        print("warning: %d records with an unknown event or phase" % unknown, file=sys.stderr)
+    return {"traceEvents": trace, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", nargs="?")
+    parser.add_argument("--seconds", type=float, default=0.2, help="how long to trace")
+    parser.add_argument("-o", "--output", default="trace.json", help="JSON to write (default %(default)s)")
+    parser.add_argument("--save", metavar="FILE", help="also write the raw capture to FILE")
+    parser.add_argument("--load", metavar="FILE", help="convert a saved capture instead of tracing")
+    args = parser.parse_args()
+
+    if args.load:
+        with open(args.load, "rb") as f:
+            data = f.read()
+    elif args.port:
+        data = capture(args.port, args.seconds)
+    else:
+        parser.error("a port or --load is required")
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(data)
+
+    dump = Dump()
+    dump.parse(data)
+    if dump.header is None:
+        sys.exit("no trace in the capture")
+    with open(args.output, "w") as f:
+        json.dump(export(dump), f)
+
+
+if __name__ == "__main__":
+    main()